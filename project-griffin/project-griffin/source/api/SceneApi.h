@@ -27,6 +27,7 @@ namespace griffin {
 
 	EntityId createNewModelInstance(
 				SceneId sceneId,
+				Id_T modelId,
 				bool movable = true,
 				SceneNodeId parentNode = NullId_T);
 
@@ -72,6 +73,21 @@ extern "C" {
 		uint8_t			_padding_end[3];
 	} griffin_CameraParameters;
 
+	/**
+	* Raw view of a data component store's dense array, for iterating every component of a type
+	* in Lua without per-component calls. Record i starts at components + i * stride, and its
+	* entity id sits at entityIds + i * stride. Invalidated by adding or removing components of
+	* the type.
+	*/
+	typedef struct {
+		void*		components;		//<! first component record
+		void*		entityIds;		//<! uint64_t entity id of the first record
+		uint32_t	count;			//<! number of components
+		uint32_t	stride;			//<! bytes between consecutive records
+		uint32_t	componentSize;	//<! component size rounded up to 8 bytes
+		uint32_t	_padding_end;
+	} griffin_DataComponentStoreView;
+
 	// Functions
 
 	GRIFFIN_EXPORT
@@ -79,6 +95,10 @@ extern "C" {
 
 	// Entity/Component functions
 
+	/**
+	* Creates the store for a data component type in the scene
+	* @return	index of the store, 0 if the type already has a store or the size is out of range
+	*/
 	GRIFFIN_EXPORT
 	uint64_t griffin_scene_createDataComponentStore(uint64_t scene, uint16_t typeId, uint32_t componentSize, size_t reserve);
 
@@ -88,6 +108,13 @@ extern "C" {
 	GRIFFIN_EXPORT
 	uint64_t griffin_scene_addDataComponentToEntity(uint64_t scene, uint16_t typeId, uint64_t entity);
 
+	/**
+	* Fills outView with the dense array of a data component store
+	* @return	false if the store does not exist, outView is zeroed
+	*/
+	GRIFFIN_EXPORT
+	bool griffin_scene_getDataComponentStoreView(uint64_t scene, uint16_t typeId, griffin_DataComponentStoreView* outView);
+
 
 	// Scene Node functions
 
@@ -40,7 +40,9 @@ namespace griffin {
 		//	ResourcePredictionSystem
 		//	etc.
 
-		//engine.sceneManager->updateActiveScenes();
+		// dispatches batched component observer events, then publishes render snapshots for
+		// scenes that use them, must run last
+		engine.sceneManager->updateActiveScenes();
 
 		// below currently does nothing
 		//#ifdef GRIFFIN_TOOLS_BUILD
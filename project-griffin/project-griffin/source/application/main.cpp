@@ -46,10 +46,18 @@ int main(int argc, char *argv[])
 		gamePtr = make_game(engine, app);
 		Game& game = *gamePtr;
 
-		// run tests at startup
+		// run tests at startup, benchmarks only when asked for
 		test::TestRunner tests;
 		tests.registerAllTests();
 		tests.runAllTests();
+
+		for (int a = 1; a < argc; ++a) {
+			if (std::string(argv[a]) == "-benchmark") {
+				tests.registerAllBenchmarks();
+				tests.runAllBenchmarks();
+				break;
+			}
+		}
 		
 		uint64_t frame = 0;
 
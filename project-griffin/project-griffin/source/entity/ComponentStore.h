@@ -4,14 +4,25 @@
 
 #include <utility/container/handle_map.h>
 #include <string>
+#include <vector>
 #include "EntityTypedefs.h"
 
+/**
+* Number of dense slots grouped under one change version. Queries that fall outside of the
+* range covered by the dirty-index list fall back to scanning chunks whose version is newer.
+*/
+#define COMPONENTSTORE_CHANGE_CHUNK_SIZE	64
+
 
 namespace griffin {
 	namespace entity {
 
 		inline std::ostream& operator<<(std::ostream& os, ComponentId id);
 
+		class SnapshotWriter;
+		class MappedSnapshot;
+		struct SnapshotSection;
+
 		/**
 		* @class ComponentStoreBase
 		* Exists only to allow storage of base class pointers in homogenous array
@@ -23,6 +34,26 @@ namespace griffin {
 			virtual ComponentId addComponent(EntityId entityId) = 0;
 			virtual bool removeComponent(ComponentId outerId) = 0;
 			virtual EntityId getEntityId(ComponentId outerId) = 0;
+			virtual bool isValid(ComponentId outerId) const = 0;
+
+			/**
+			* Exposes the dense set as raw memory for bulk access where the type is not known, such
+			* as data components iterated from Lua. Invalidated by adding or removing components.
+			* @param outCount	receives the number of records
+			* @param outStride	receives the size of one record, the entity id is the last 8 bytes
+			* @return	pointer to the first record
+			*/
+			virtual void* getRawItems(size_t& outCount, size_t& outStride) = 0;
+
+			/**
+			* Writes the store's blocks into the writer's current section
+			*/
+			virtual void writeSnapshot(SnapshotWriter& writer) const = 0;
+
+			/**
+			* Replaces the contents of the store with the blocks of a mapped snapshot section
+			*/
+			virtual void readSnapshot(const MappedSnapshot& snapshot, const SnapshotSection& section) = 0;
 		};
 
 		/**
@@ -46,6 +77,18 @@ namespace griffin {
 
 			typedef griffin::handle_map<ComponentRecord> ComponentMap;
 
+			/**
+			* ChangeEntry is one element of the dirty-index list. Entries are appended in order of
+			* non-decreasing version, so the list can be binary searched by version.
+			*/
+			struct ChangeEntry {
+				uint32_t denseIndex;	//<! index into the dense set at the time of the change
+				uint32_t version;		//<! store version when the change was recorded
+			};
+
+			typedef std::vector<ChangeEntry>	ChangeList;
+			typedef std::vector<uint32_t>		VersionSet;
+
 			// Functions
 
 			/**
@@ -66,35 +109,52 @@ namespace griffin {
 			* create one component with default zero-initialization
 			*/
 			inline ComponentId createComponent(EntityId entityId) {
-				return m_components.insert({ T{}, entityId });
+				auto id = m_components.insert({ T{}, entityId });
+				trackInsert();
+				return id;
 			}
 
 			/**
 			* create n components and return a vector of their ComponentIds
 			*/
 			inline ComponentIdSet createComponents(int n, EntityId entityId) {
-				return m_components.emplaceItems(n, T{}, entityId);
+				auto ids = m_components.emplaceItems(n, T{}, entityId);
+				for (size_t i = m_components.size() - n; i < m_components.size(); ++i) {
+					markChangedInnerIndex(static_cast<uint32_t>(i));
+				}
+				++m_structureVersion;
+				return ids;
 			}
 
 			/**
 			* add one component, moving the provided cmp into the store, return ComponentId
 			*/
 			inline ComponentId addComponent(T&& cmp, EntityId entityId) {
-				return m_components.insert({ std::forward<T>(cmp), entityId });
+				auto id = m_components.insert({ std::forward<T>(cmp), entityId });
+				trackInsert();
+				return id;
 			}
 
 			/**
 			* add one zero-initialized component into the store, return ComponentId
 			*/
 			virtual inline ComponentId addComponent(EntityId entityId) override {
-				return m_components.insert({ T{}, entityId });
+				auto id = m_components.insert({ T{}, entityId });
+				trackInsert();
+				return id;
 			}
 
 			/**
 			* remove the component identified by the provided outerId
 			*/
 			virtual inline bool removeComponent(ComponentId outerId) override {
-				return (m_components.erase(outerId) == 1);
+				if (!m_components.isValid(outerId)) {
+					return false;
+				}
+				uint32_t innerIndex = m_components.getInnerIndex(outerId);
+				m_components.erase(outerId);
+				trackErase(innerIndex);
+				return true;
 			}
 
 			/**
@@ -128,6 +188,107 @@ namespace griffin {
 				return m_components[outerId].component;
 			}
 
+			/**
+			* Same as getComponent, looked up by a compact id stored in another component
+			*/
+			inline T& getComponent(CompactId_T<T> ref) {
+				return m_components[ref].component;
+			}
+
+			/**
+			* @returns the full ComponentId of a compact id, NullId_T if it's null or stale
+			*/
+			inline ComponentId toId(CompactId_T<T> ref) const {
+				return m_components.toId(ref);
+			}
+
+			/**
+			* Same as getComponent, but records the write in the store's change tracking so
+			* systems calling getChangedSince will see the component. Use this accessor for all
+			* writes that incremental systems need to react to. Writes made through getComponent
+			* or by iterating getComponents directly are not tracked, call markChanged for those.
+			*/
+			inline T& getMutable(ComponentId outerId) {
+				uint32_t innerIndex = m_components.getInnerIndex(outerId);
+				markChangedInnerIndex(innerIndex);
+				return m_components.getItems()[innerIndex].component;
+			}
+
+			/**
+			* Records a write to the component without returning it
+			*/
+			inline void markChanged(ComponentId outerId) {
+				markChangedInnerIndex(m_components.getInnerIndex(outerId));
+			}
+
+			/**
+			* Records a write to the component at a dense set index, useful when iterating the
+			* dense set directly.
+			*/
+			void markChangedInnerIndex(uint32_t innerIndex);
+
+			/**
+			* Collects the dense set indices of all components written since sinceVersion. Each
+			* index appears at most once. Indices are only valid until the next insert or remove.
+			* @param sinceVersion	version returned by a previous call to advanceVersion, or 0 to
+			*	get all components changed since the store was created
+			* @param outIndices	vector to push_back the dense indices into, not cleared first
+			* @returns number of indices pushed
+			*/
+			size_t getChangedSince(uint32_t sinceVersion, std::vector<uint32_t>& outIndices) const;
+
+			/**
+			* Closes the current version so subsequent writes are tagged with a newer version.
+			* Call after collecting changes and store the returned value for the next query.
+			* @returns the version that was closed, pass to the next call of getChangedSince
+			*/
+			inline uint32_t advanceVersion() {
+				return m_version++;
+			}
+
+			/**
+			* @returns the version new writes are currently tagged with
+			*/
+			inline uint32_t getVersion() const {
+				return m_version;
+			}
+
+			/**
+			* @returns version of the most recent write to a chunk of the dense set, where the
+			*	chunk index is denseIndex / COMPONENTSTORE_CHANGE_CHUNK_SIZE
+			*/
+			inline uint32_t getChunkVersion(uint32_t chunkIndex) const {
+				return m_chunkVersions[chunkIndex];
+			}
+
+			/**
+			* Moves the dense set into the given order, see handle_map::reorder. Every moved slot
+			* is reported as changed.
+			*/
+			void reorder(const std::vector<uint32_t>& order);
+
+			/**
+			* Moves the components at dense indices [first, middle) to just after those at
+			* [middle, last), see handle_map::rotate. Every slot in the range is reported as changed.
+			*/
+			void rotate(uint32_t first, uint32_t middle, uint32_t last);
+
+			/**
+			* @returns a counter incremented whenever components are inserted, removed or
+			*	reordered. Dense indices cached by a system are valid while this is unchanged.
+			*/
+			inline uint32_t getStructureVersion() const {
+				return m_structureVersion;
+			}
+
+			/**
+			* Call after editing the handle_map's inner arrays directly in a way that moves
+			* components, so systems caching dense indices rebuild them
+			*/
+			inline void markStructureChanged() {
+				++m_structureVersion;
+			}
+
 			/**
 			* Get the entityId of the parent Entity for a component
 			*/
@@ -135,6 +296,19 @@ namespace griffin {
 				return m_components[outerId].entityId;
 			}
 
+			/**
+			* @returns true if the component exists in this store
+			*/
+			virtual inline bool isValid(ComponentId outerId) const override {
+				return m_components.isValid(outerId);
+			}
+
+			virtual inline void* getRawItems(size_t& outCount, size_t& outStride) override {
+				outCount = m_components.size();
+				outStride = sizeof(ComponentRecord);
+				return m_components.getItems().data();
+			}
+
 			/**
 			* Get the ComponentId for a component iterator, useful inside of range-based for loops.
 			*/
@@ -148,13 +322,23 @@ namespace griffin {
 			*/
 			std::string to_string() const;
 
+			virtual void writeSnapshot(SnapshotWriter& writer) const override;
+
+			/**
+			* All components are reported as changed in the store's current version after loading
+			*/
+			virtual void readSnapshot(const MappedSnapshot& snapshot, const SnapshotSection& section) override;
+
 			/**
 			* Constructor takes a reserveCount to initialize the inner storage, and the itemTypeId is
 			* automatically set to T::componentType
 			*/
 			explicit ComponentStore(size_t reserveCount) :
 				m_components(T::componentType, reserveCount)
-			{}
+			{
+				m_slotVersions.reserve(reserveCount);
+				m_changes.reserve(reserveCount);
+			}
 
 			/**
 			* Constructor takes a reserveCount to initialize the inner storage, and the itemTypeId is also
@@ -164,14 +348,52 @@ namespace griffin {
 			*/
 			explicit ComponentStore(uint16_t typeId, size_t reserveCount) :
 				m_components(typeId, reserveCount)
-			{}
+			{
+				m_slotVersions.reserve(reserveCount);
+				m_changes.reserve(reserveCount);
+			}
 
 			ComponentStore(const ComponentStore &) = delete;
 
 		private:
+			// Private Functions
+
+			/**
+			* A new component is always pushed to the back of the dense set
+			*/
+			inline void trackInsert() {
+				markChangedInnerIndex(static_cast<uint32_t>(m_components.size() - 1));
+				++m_structureVersion;
+			}
+
+			/**
+			* Erasing swaps the last component into the hole, so the hole now holds changed data
+			*/
+			void trackErase(uint32_t innerIndex);
+
+			/**
+			* Components that own no resources are copied as one block
+			*/
+			void writeSnapshotItems(SnapshotWriter& writer, std::true_type) const;
+			void readSnapshotItems(const MappedSnapshot& snapshot, const SnapshotSection& section, std::true_type);
+
+			/**
+			* Other components copy only their trivially copyable properties using Reflection, the
+			* rest (e.g. resource pointers) are left default-initialized to be rebuilt after loading
+			*/
+			void writeSnapshotItems(SnapshotWriter& writer, std::false_type) const;
+			void readSnapshotItems(const MappedSnapshot& snapshot, const SnapshotSection& section, std::false_type);
+
 			// Member Variables
 
 			ComponentMap m_components;
+
+			uint32_t	m_version = 1;			//<! version that new writes are tagged with, 0 is reserved for "never"
+			uint32_t	m_changesBaseVersion = 0; //<! m_changes holds every change with a version > this value
+			VersionSet	m_slotVersions;			//<! version of last write, parallel to the dense set
+			VersionSet	m_chunkVersions;		//<! version of last write to any slot in the chunk
+			ChangeList	m_changes;				//<! compact dirty-index list, sorted by version
+			uint32_t	m_structureVersion = 0;	//<! incremented when dense indices change
 		};
 
 	}
@@ -0,0 +1,174 @@
+/**
+* @file ComponentStoreHistory.h
+* @author Jeff Kiah
+*/
+#pragma once
+#ifndef GRIFFIN_COMPONENTSTOREHISTORY_H_
+#define GRIFFIN_COMPONENTSTOREHISTORY_H_
+
+#include <vector>
+#include <cstdint>
+#include "ComponentStore.h"
+#include "EntitySnapshot.h"
+
+namespace griffin {
+	namespace entity {
+
+		/**
+		* @class ComponentStoreHistory
+		* Captures frame-to-frame delta snapshots of a ComponentStore for rollback, replay and
+		* autosave. A mirror of the store's dense items, sparse ids and meta arrays is kept as of
+		* the last capture. Each capture diffs only the slots reported by the store's change
+		* tracking against the mirror and stores the XOR of the elements that differ, so a delta
+		* is its own inverse and applying or reverting it is the same operation. Deltas are kept
+		* in a ring of fixed depth, the oldest is overwritten when the ring is full.
+		*
+		* Writes to the store must go through getMutable or markChanged to be captured, or pass
+		* fullScan to capture to compare every slot. Captures don't advance the store's version,
+		* the systems consuming its changes do. Slots written in a version still open at the last
+		* capture are compared again, so advance the version once per frame to keep a capture's
+		* cost proportional to the frame's writes.
+		*
+		* A capture costs 0.6-0.7us per touched slot once the store and mirror are larger than
+		* the cache, nearly all of it misses into the items, meta and ids of both. Microsecond
+		* captures are in reach at a few writes per frame, a 100k SceneNode store taking 500
+		* writes and 45 inserts and erases per frame captures in 300-400us, still far below
+		* copying the 12MB store (see benchmarkComponentStoreHistory).
+		* @tparam T  the component type, must own no resources (see is_snapshot_raw)
+		*/
+		template <typename T>
+		class ComponentStoreHistory {
+		public:
+			static_assert(is_snapshot_raw<T>::value, "ComponentStoreHistory requires a plain data component");
+
+			// Typedefs
+
+			typedef typename ComponentStore<T>::ComponentRecord	ComponentRecord;
+			typedef typename ComponentStore<T>::ComponentMap	ComponentMap;
+			typedef typename ComponentMap::Meta_T				Meta_T;
+
+			/**
+			* One frame of changes. Index arrays are parallel to the XOR payloads. Elements beyond
+			* the end of an array are treated as zeroed bytes, so XOR payloads for grown or shrunk
+			* ranges hold the full element.
+			*/
+			struct Delta {
+				uint32_t	oldNumItems;
+				uint32_t	newNumItems;
+				uint32_t	oldNumIds;
+				uint32_t	newNumIds;
+				uint32_t	oldFreeList[2];		//<! front and back
+				uint32_t	newFreeList[2];		//<! front and back
+
+				std::vector<uint32_t>			itemIndices;
+				std::vector<ComponentRecord>	itemXor;
+				std::vector<uint32_t>			metaIndices;
+				std::vector<Meta_T>				metaXor;
+				std::vector<uint32_t>			idIndices;
+				std::vector<Id_T>				idXor;
+
+				/**
+				* @returns bytes of payload held by the delta
+				*/
+				size_t payloadSize() const {
+					return (itemIndices.size() + metaIndices.size() + idIndices.size()) * sizeof(uint32_t)
+						+ itemXor.size() * sizeof(ComponentRecord)
+						+ metaXor.size() * sizeof(Meta_T)
+						+ idXor.size() * sizeof(Id_T);
+				}
+			};
+
+			// Functions
+
+			/**
+			* Records the changes made to the store since the previous capture as a new delta. Any
+			* deltas that were reverted and not reapplied are discarded.
+			* @param fullScan	compare every slot instead of only the slots reported by the store's
+			*	change tracking, use when writes may have bypassed getMutable
+			* @returns the delta's payload size in bytes, 0 if nothing changed
+			*/
+			size_t capture(bool fullScan = false);
+
+			/**
+			* Reverts the store to its state before the most recently applied delta. Changes made
+			* to the store since the last capture belong to no delta, so call capture first.
+			* @returns false if there is no delta left to revert
+			*/
+			bool revert();
+
+			/**
+			* Re-applies the most recently reverted delta
+			* @returns false if there is no reverted delta
+			*/
+			bool reapply();
+
+			/**
+			* @returns number of deltas that can be reverted
+			*/
+			uint32_t getNumApplied() const { return m_numApplied; }
+
+			/**
+			* @returns number of reverted deltas that can be reapplied
+			*/
+			uint32_t getNumReverted() const { return m_numReverted; }
+
+			/**
+			* @param age	0 for the most recently applied delta, 1 for the one before, etc.
+			*/
+			const Delta& getDelta(uint32_t age) const {
+				assert(age < m_numApplied && "delta age out of range");
+				return m_ring[(m_head + m_depth - 1 - age) % m_depth];
+			}
+
+			/**
+			* Constructor takes the store to track and copies its current state as the baseline
+			* @param store	store to capture, must outlive this object
+			* @param depth	number of deltas kept in the ring
+			*/
+			explicit ComponentStoreHistory(ComponentStore<T>& store, uint32_t depth);
+
+			ComponentStoreHistory(const ComponentStoreHistory&) = delete;
+
+		private:
+			// Private Functions
+
+			/**
+			* XORs the delta into a handle_map's arrays, sizing them to the delta's new state if
+			* forward is true, or its old state if false
+			*/
+			static void applyDelta(IdSet_T& ids, std::vector<Meta_T>& meta, std::vector<ComponentRecord>& items,
+								   const Delta& delta, bool forward);
+
+			/**
+			* Applies a delta to both the store and the mirror, reporting the touched slots to the
+			* store's change tracking
+			*/
+			void applyToStore(const Delta& delta, bool forward);
+
+			// Member Variables
+
+			ComponentStore<T>&				m_store;
+
+			uint32_t						m_depth;			//<! ring capacity
+			uint32_t						m_head = 0;			//<! ring slot the next capture writes to
+			uint32_t						m_numApplied = 0;	//<! deltas behind m_head that can be reverted
+			uint32_t						m_numReverted = 0;	//<! deltas at and after m_head that can be reapplied
+			uint32_t						m_sinceVersion = 0;	//<! writes tagged after this store version are candidates for the next capture
+
+			std::vector<Delta>				m_ring;
+
+			std::vector<ComponentRecord>	m_mirrorItems;		//<! store state as of the last capture
+			std::vector<Meta_T>				m_mirrorMeta;
+			IdSet_T							m_mirrorIds;
+			uint32_t						m_mirrorFreeList[2];
+
+			std::vector<uint32_t>			m_dirty;			//<! scratch buffer for dense indices
+			std::vector<uint32_t>			m_dirtyIds;			//<! scratch buffer for sparse indices
+		};
+
+	}
+}
+
+#include "impl/ComponentStoreHistory-inl.h"
+
+#endif
\ No newline at end of file
@@ -12,7 +12,10 @@
 #include <ostream>
 #include <istream>
 #include <type_traits>
+#include <utility>
 #include <cstdint>
+#include <boost/fusion/adapted/std_tuple.hpp>
+#include <boost/fusion/algorithm/iteration/for_each.hpp>
 
 namespace griffin {
 
@@ -43,7 +46,7 @@ namespace griffin {
 		std::vector<T>::size_type size = vec.size();
 		out.write(reinterpret_cast<const char*>(&size), sizeof(size));
 		// write data
-		for (T& i : vec) {
+		for (const T& i : vec) {
 			griffin::serialize(out, i);
 		}
 	}
@@ -71,8 +74,8 @@ namespace griffin {
 		std::vector<T>::size_type size = 0;
 		in.read(reinterpret_cast<char*>(&size), sizeof(size));
 		vec.resize(size);
-		for (int i = 0; i < size; ++i) {
-			griffin::deserialize(in, &vec[i]);
+		for (size_t i = 0; i < size; ++i) {
+			griffin::deserialize(in, vec[i]);
 		}
 	}
 
@@ -124,32 +127,69 @@ namespace griffin {
 
 	// griffin::entity Component types
 
+	namespace detail {
+		/**
+		* Writes one reflected property, plain data is written directly and anything else is
+		* passed on to the griffin::serialize overload for its type
+		*/
+		struct serialize_property {
+			std::ostream& out;
+
+			template <typename T,
+					  typename std::enable_if<std::is_trivially_copyable<T>::value>::type* = nullptr>
+			void operator()(const T& val) const {
+				out.write(reinterpret_cast<const char*>(&val), sizeof(T));
+			}
+
+			template <typename T,
+					  typename std::enable_if<!std::is_trivially_copyable<T>::value>::type* = nullptr>
+			void operator()(const T& val) const {
+				griffin::serialize(out, val);
+			}
+		};
+
+		/**
+		* Reads one reflected property, the reverse of serialize_property
+		*/
+		struct deserialize_property {
+			std::istream& in;
+
+			template <typename T,
+					  typename std::enable_if<std::is_trivially_copyable<T>::value>::type* = nullptr>
+			void operator()(T& val) const {
+				in.read(reinterpret_cast<char*>(&val), sizeof(T));
+			}
+
+			template <typename T,
+					  typename std::enable_if<!std::is_trivially_copyable<T>::value>::type* = nullptr>
+			void operator()(T& val) const {
+				griffin::deserialize(in, val);
+			}
+		};
+	}
+
 	/**
 	* This is only used when the component is not trivially copyable, and uses Reflection to
-	* serialize each property.
+	* serialize each property. Array properties are handled by their type, so an array of plain
+	* data is one write.
 	* @tparam Component		component type or type that has used the REFLECT macro to create a
 	*		Reflection class for itself
 	*/
 	template <typename Component>
-	void serialize_component(std::ostream& out, Component& obj) {
-		auto& props = Component::Reflection::getProperties();
-
-		for (int p = 0; p < props.size(); ++p) {
-			auto& prop = props[p];
-			const char* valueBytes = reinterpret_cast<const char*>(&obj + prop.offset);
+	void serialize_component(std::ostream& out, const Component& obj) {
+		boost::fusion::for_each(Component::Reflection::getAllValues(const_cast<Component&>(obj)),
+								detail::serialize_property{ out });
+	}
 
-			if (prop.isTriviallyCopyable) {
-				out.write(valueBytes, prop.size);
-			}
-			else if (prop.isArray) {
-				for (int i = 0; i < prop.numElements; ++i) {
-					serialize(out, thisVal[i]);
-				}
-			}
-			else {
-				serialize(out, thisVal);
-			}
-		}
+	/**
+	* Reverse of serialize_component
+	* @tparam Component		component type or type that has used the REFLECT macro to create a
+	*		Reflection class for itself
+	*/
+	template <typename Component>
+	void deserialize_component(std::istream& in, Component& obj) {
+		boost::fusion::for_each(Component::Reflection::getAllValues(obj),
+								detail::deserialize_property{ in });
 	}
 
 
@@ -186,13 +226,24 @@ namespace griffin {
 
 	// griffin::entity::ComponentStore::ComponentRecord
 
+	/**
+	* ComponentRecord is nested in ComponentStore<Component> so Component can't be deduced from
+	* it, this trait selects any type with the record's component and entityId members instead.
+	*/
+	template <typename Record, typename = void>
+	struct is_component_record : std::false_type {};
+
+	template <typename Record>
+	struct is_component_record<Record, decltype(std::declval<Record>().component,
+												(void)std::declval<Record>().entityId)>
+		: std::true_type {};
+
 	/**
 	* griffin::entity::ComponentStore::ComponentRecord serialization
-	* @tparam Component		component type or type that has used the REFLECT macro to create a
-	*		Reflection class for itself
 	*/
-	template <typename Component>
-	void serialize(std::ostream& out, const typename entity::ComponentStore<Component>::ComponentRecord& rec)
+	template <typename Record,
+			  typename std::enable_if<is_component_record<Record>::value>::type* = nullptr>
+	void serialize(std::ostream& out, const Record& rec)
 	{
 		griffin::serialize_component(out, rec.component);
 		out.write(reinterpret_cast<const char*>(&rec.entityId.value), sizeof(rec.entityId.value));
@@ -200,13 +251,12 @@ namespace griffin {
 
 	/**
 	* griffin::entity::ComponentStore::ComponentRecord deserialization
-	* @tparam Component		component type or type that has used the REFLECT macro to create a
-	*		Reflection class for itself
 	*/
-	template <typename Component>
-	void deserialize(std::istream& in, typename entity::ComponentStore<Component>::ComponentRecord& rec)
+	template <typename Record,
+			  typename std::enable_if<is_component_record<Record>::value>::type* = nullptr>
+	void deserialize(std::istream& in, Record& rec)
 	{
-		griffin::deserialize(in, rec.component);
+		griffin::deserialize_component(in, rec.component);
 		in.read(reinterpret_cast<char*>(&rec.entityId.value), sizeof(rec.entityId.value));
 	}
 
@@ -50,10 +50,15 @@ namespace griffin {
 			inline bool hasComponent(ComponentType ct) const {
 				return componentMask[ct];
 			}
+
+			inline bool hasTag(TagType tag) const {
+				return tagMask[tag];
+			}
 			
 			// Variables
 			
 			ComponentMask				componentMask;
+			TagMask						tagMask;
 			std::vector<ComponentId>	components;
 		};
 
@@ -10,6 +10,7 @@
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <functional>
 #include <utility/memory_reserve.h>
 #include "ComponentStore.h"
 #include "Entity.h"
@@ -18,6 +19,27 @@ namespace griffin {
 	namespace entity {
 
 
+		class EntityManager;
+
+		/**
+		* One component added to or removed from an entity, see EntityManager::addComponentObserver
+		*/
+		struct ComponentEvent {
+			ComponentId	componentId;
+			EntityId	entityId;
+		};
+
+		/**
+		* Receives the events of one component type batched since the last dispatch, in the order
+		* they happened. A component added and removed in between shows up in both lists, so test
+		* added components with isValid before use. Removed components are already gone from the
+		* store. Observers may add and remove components, those events wait for the next dispatch.
+		*/
+		typedef std::function<void(EntityManager& entityMgr, uint16_t typeId,
+								   const std::vector<ComponentEvent>& added,
+								   const std::vector<ComponentEvent>& removed)> ComponentObserverFunc;
+
+
 		class EntityManager {
 		public:
 			// Typedefs
@@ -30,7 +52,8 @@ namespace griffin {
 			explicit EntityManager() :
 				m_entityStore(EntityId_typeId, RESERVE_ENTITYMANAGER_ENTITIES),
 				m_componentStores{}, // zero-init fills with nullptr, component store created on first access
-				m_dataComponentStoreSizes{}
+				m_dataComponentStoreSizes{},
+				m_componentObservers(ComponentObserverId_typeId, RESERVE_ENTITYMANAGER_OBSERVERS)
 			{}
 
 			// Entity Functions
@@ -123,6 +146,25 @@ namespace griffin {
 				return getComponentStore<T>().getComponent(componentId);
 			}
 
+			/**
+			* Same as getComponent, looked up by a compact id stored in another component
+			*/
+			template <typename T>
+			T& getComponent(CompactId_T<T> ref)
+			{
+				return getComponentStore<T>().getComponent(ref);
+			}
+
+			/**
+			* Same as getComponent, but the write is recorded by the store's change tracking, see
+			* ComponentStore::getMutable
+			*/
+			template <typename T>
+			T& getMutable(ComponentId componentId)
+			{
+				return getComponentStore<T>().getMutable(componentId);
+			}
+
 			/**
 			* Adds a new component to an existing entity
 			* @param entityId	entity to receive the new component
@@ -144,6 +186,8 @@ namespace griffin {
 				entity.addComponent(componentId);
 				//auto newMask = entity.componentMask;
 
+				recordComponentAdded(componentId, entityId);
+
 				/* // commented out because not sure the component mask index is a keeper
 				if (newMask != previousMask) {
 					// fix up the mask index with the new mask, remove the old entry with old mask
@@ -176,6 +220,14 @@ namespace griffin {
 			* @return  true if the component was removed, false if it does not exist
 			*/
 			bool removeComponent(ComponentId componentId);
+
+			/**
+			* Removes a list of components from their entities and stores in one pass, the same as
+			* calling removeComponent for each id. Ids that don't exist are skipped.
+			* @param componentIds  the components to remove, may be of mixed types
+			* @return  number of components removed
+			*/
+			size_t removeComponents(const std::vector<ComponentId>& componentIds);
 			
 			/**
 			* Removes all components of a type from from the entity's components vector, and unsets
@@ -213,6 +265,83 @@ namespace griffin {
 			}
 
 
+			// Observer Functions
+
+			/**
+			* Registers a function to receive add and remove events of a component type. Events are
+			* only recorded while a type has observers, into buffers that dispatchComponentEvents
+			* hands to the observers in one batch per type, so adding and removing components never
+			* calls out to observers.
+			* @param typeId	component type or data component store index
+			* @return  id to pass to removeComponentObserver
+			*/
+			ComponentObserverId addComponentObserver(uint16_t typeId, ComponentObserverFunc&& func);
+
+			/**
+			* Unregisters an observer, events of its type recorded but not yet dispatched are dropped
+			* when no observers of the type remain
+			*/
+			bool removeComponentObserver(ComponentObserverId observerId);
+
+			/**
+			* Sync point, calls the observers of each type with the events recorded since the last
+			* call. Observers must not be added or removed from inside an observer.
+			*/
+			void dispatchComponentEvents();
+
+
+			// Tag Functions
+
+			/**
+			* Tags the entity in O(1), only the entity's TagMask and the tag's entity list change
+			* @return  true if the tag was added, false if the entity is invalid or already has it
+			*/
+			bool addTagToEntity(TagType tag, EntityId entityId);
+
+			/**
+			* Removes a tag in O(1), the last entity of the tag's list takes the removed one's place
+			* @return  true if the tag was removed, false if the entity is invalid or doesn't have it
+			*/
+			bool removeTagFromEntity(TagType tag, EntityId entityId);
+
+			/**
+			* @return  true if the entity has the tag
+			*/
+			bool entityHasTag(EntityId entityId, TagType tag) const
+			{
+				return m_entityStore[entityId].hasTag(tag);
+			}
+
+			/**
+			* @return  TagMask of the entity
+			*/
+			TagMask getEntityTagMask(EntityId entityId) const
+			{
+				return m_entityStore[entityId].tagMask;
+			}
+
+			/**
+			* @return  all entities with the tag in no particular order, don't store it just use it
+			*	immediately and discard. Adding or removing the tag reorders the list.
+			*/
+			const std::vector<EntityId>& getTaggedEntities(TagType tag) const
+			{
+				assert(tag < MAX_TAGS && "tag out of range");
+				return m_tagLists[tag].entities;
+			}
+
+			/**
+			* Collects the entities having every tag in required and none in excluded. The list of
+			* the rarest required tag is walked and each entity's TagMask tested against the rest,
+			* so the cost follows the smallest tag rather than the number of entities. With no
+			* required tags every entity is tested.
+			* @param outEntities	vector to push_back the entities into, not cleared first
+			* @return  number of entities pushed
+			*/
+			size_t getEntitiesWithTags(const TagMask& required, const TagMask& excluded,
+									   std::vector<EntityId>& outEntities) const;
+
+
 			// Component Store Functions
 
 			/**
@@ -249,10 +378,10 @@ namespace griffin {
 			// Size-based data component functions
 			
 			/*
-			* Note: the interface to data components is limited to single-component interactions;
-			* it is impractical to get a data component store and iteratate since type casts might
-			* yield different object sizes, so iteration might be at the wrong stride. It's safe to
-			* reinterpret_cast a single data component with a known source type.
+			* Note: data component stores can't be iterated through a typed ComponentStore since type
+			* casts might yield different object sizes, so iteration might be at the wrong stride. It's
+			* safe to reinterpret_cast a single data component with a known source type, and bulk
+			* access goes through getDataComponentItems which reports the true stride.
 			*/
 
 			/**
@@ -279,9 +408,55 @@ namespace griffin {
 			*/
 			void* getDataComponent(ComponentId componentId);
 
+			/**
+			* Get the dense array of a data component store for bulk iteration, useful for passing
+			* a whole store to Lua. Each record is the component followed by its EntityId. The
+			* pointer is invalidated when components of the type are added or removed, and writes
+			* through it are not seen by the store's change tracking.
+			* @param outCount	receives the number of components
+			* @param outStride	receives the bytes between consecutive records
+			* @return	pointer to the first component, nullptr if the store doesn't exist or typeId
+			*	is out of range
+			*/
+			void* getDataComponentItems(uint16_t typeId, uint32_t& outCount, uint32_t& outStride);
+
+
+			// Snapshot Functions
+
+			/**
+			* Writes the entity store and every component store to the snapshot, one page-aligned
+			* section each. Stores of plain data components are written as single raw blocks.
+			*/
+			void writeSnapshot(SnapshotWriter& writer) const;
+
+			/**
+			* Loads entities and components from a mapped snapshot, must be called on an empty
+			* EntityManager. Data component stores are recreated from their recorded size. Stores of
+			* compile-time component types must be created beforehand by calling getComponentStore,
+			* throws if a store is missing.
+			*/
+			void readSnapshot(const MappedSnapshot& snapshot);
+
 		private:
 
 			// Private Functions
+
+			/**
+			* Records events for dispatchComponentEvents, only a bit test when nobody observes the type
+			*/
+			inline void recordComponentAdded(ComponentId componentId, EntityId entityId)
+			{
+				if (m_observedTypes[componentId.typeId]) {
+					m_componentEvents[componentId.typeId].added.push_back({ componentId, entityId });
+				}
+			}
+
+			inline void recordComponentRemoved(ComponentId componentId, EntityId entityId)
+			{
+				if (m_observedTypes[componentId.typeId]) {
+					m_componentEvents[componentId.typeId].removed.push_back({ componentId, entityId });
+				}
+			}
 			
 			/**
 			* Create a store for a specific type, without assuming that the type has a ::componentType
@@ -309,6 +484,33 @@ namespace griffin {
 
 			uint32_t			m_dataComponentStoreSizes[MAX_COMPONENTS - ComponentType::last_ComponentType_enum]; //<! one size per data component type
 
+			/**
+			* Membership of one tag, entities is dense for iteration and positions maps an entity's
+			* sparse index to its place in entities for O(1) removal
+			*/
+			struct TagList {
+				std::vector<EntityId>	entities;
+				std::vector<uint32_t>	positions;	//<! indexed by EntityId::index, valid only while the entity has the tag
+			};
+
+			TagList				m_tagLists[MAX_TAGS];
+
+			struct ComponentObserver {
+				uint16_t				typeId;
+				ComponentObserverFunc	func;
+			};
+
+			struct ComponentEventBuffer {
+				std::vector<ComponentEvent>	added;
+				std::vector<ComponentEvent>	removed;
+			};
+
+			handle_map<ComponentObserver>	m_componentObservers;
+			ComponentMask			m_observedTypes;				//<! types with at least one observer
+			ComponentEventBuffer	m_componentEvents[MAX_COMPONENTS];	//<! recorded since the last dispatch
+			ComponentEventBuffer	m_dispatchEvents;				//<! events being dispatched, swapped with a type's buffer
+			bool					m_dispatching = false;
+
 		};
 
 		typedef std::shared_ptr<EntityManager>	EntityManagerPtr;
@@ -0,0 +1,266 @@
+/**
+* @file EntitySnapshot.h
+* @author Jeff Kiah
+*/
+#pragma once
+#ifndef GRIFFIN_ENTITYSNAPSHOT_H_
+#define GRIFFIN_ENTITYSNAPSHOT_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <type_traits>
+#include <stdexcept>
+#include <utility/container/handle_map.h>
+
+/**
+* Binary snapshot format version, increment when any struct below or the meaning of a section's
+* blocks changes. Snapshots with a different version are rejected by the loader.
+*/
+#define ENTITY_SNAPSHOT_VERSION		2
+#define ENTITY_SNAPSHOT_MAGIC		"GRFSNAP"
+#define ENTITY_SNAPSHOT_PAGE_SIZE	4096	//<! sections start on a page boundary
+#define ENTITY_SNAPSHOT_BLOCK_ALIGN	64		//<! blocks within a section start on a cache line
+#define ENTITY_SNAPSHOT_MAX_BLOCKS	4
+
+
+namespace griffin {
+	namespace entity {
+
+		/**
+		* Snapshot file layout:
+		*	SnapshotHeader at offset 0
+		*	sections, each one starting on a page boundary and containing up to
+		*		ENTITY_SNAPSHOT_MAX_BLOCKS raw arrays
+		*	SnapshotSection table at SnapshotHeader::sectionTableOffset
+		* The table is written last because block offsets aren't known until the blocks are written.
+		*/
+		enum SnapshotSectionKind : uint32_t {
+			SnapshotSection_Entities = 0,		//<! EntityManager's entity store
+			SnapshotSection_ComponentStore,		//<! one per component store, typeId is the store index
+			SnapshotSection_SceneGraph			//<! scene graph state held outside of component stores
+		};
+
+		enum SnapshotSectionFlags : uint16_t {
+			SnapshotFlag_None			= 0,
+			SnapshotFlag_DataComponent	= 1,	//<! store created by createDataComponentStore
+			SnapshotFlag_RawItems		= 2		//<! items block is a direct copy of the dense set
+		};
+
+		/**
+		* Block slots for sections that hold a handle_map
+		*/
+		enum SnapshotBlockIndex : uint32_t {
+			SnapshotBlock_Ids = 0,		//<! sparse ids array
+			SnapshotBlock_Meta,			//<! denseToSparse meta array
+			SnapshotBlock_Items,		//<! dense items array
+			SnapshotBlock_Extra			//<! section-specific, e.g. flattened entity component lists
+		};
+
+		/**
+		* Param slots for sections that hold a handle_map
+		*/
+		enum SnapshotParamIndex : uint32_t {
+			SnapshotParam_FreeListFront = 0,
+			SnapshotParam_FreeListBack,
+			SnapshotParam_ItemTypeId,
+			SnapshotParam_DataComponentSize
+		};
+
+		struct SnapshotHeader {
+			char		magic[8];
+			uint32_t	version;
+			uint32_t	numSections;
+			uint64_t	sectionTableOffset;
+			uint64_t	fileSize;
+		};
+
+		struct SnapshotBlock {
+			uint64_t	offset;			//<! absolute file offset, aligned to ENTITY_SNAPSHOT_BLOCK_ALIGN
+			uint64_t	count;			//<! number of elements
+			uint32_t	elementSize;	//<! sizeof one element, validated against the loading type
+			uint32_t	_padding_0;
+		};
+
+		struct SnapshotSection {
+			uint32_t		kind;		//<! SnapshotSectionKind
+			uint16_t		typeId;		//<! component store index for ComponentStore sections
+			uint16_t		flags;		//<! SnapshotSectionFlags
+			uint32_t		params[4];	//<! section-specific scalars, see SnapshotParamIndex
+			uint32_t		_padding_0;
+			uint64_t		offset;		//<! absolute file offset of the section, page aligned
+			uint64_t		size;		//<! bytes from offset to the end of the last block
+			SnapshotBlock	blocks[ENTITY_SNAPSHOT_MAX_BLOCKS];
+		};
+
+		/**
+		* Flattened Entity, the component ids are stored contiguously in the Extra block
+		*/
+		struct SnapshotEntityRecord {
+			uint64_t	componentMask;
+			uint32_t	firstComponent;
+			uint32_t	numComponents;
+			uint64_t	tagMask;
+		};
+
+		/**
+		* Components are written as one raw block when they own no resources. Trivial destruction
+		* is tested rather than trivial copying because glm types declare copy constructors but are
+		* plain data. Other components are written property by property using Reflection.
+		*/
+		template <typename T>
+		struct is_snapshot_raw : std::integral_constant<bool, std::is_trivially_destructible<T>::value> {};
+
+
+		/**
+		* @class SnapshotWriter
+		* Streams sections to a file. Each block is written with a single call so large stores go
+		* to disk at full speed without per-component work.
+		*/
+		class SnapshotWriter {
+		public:
+			/**
+			* Opens the file for writing, throws on failure
+			*/
+			explicit SnapshotWriter(const std::string& filename);
+
+			/**
+			* Starts a new section on the next page boundary, closing the previous section
+			*/
+			void beginSection(SnapshotSectionKind kind, uint16_t typeId, uint16_t flags = SnapshotFlag_None);
+
+			void setParam(SnapshotParamIndex param, uint32_t value);
+
+			/**
+			* Writes count elements of elementSize bytes into block slot of the current section
+			*/
+			void writeBlock(SnapshotBlockIndex block, const void* data, size_t count, size_t elementSize);
+
+			/**
+			* Writes the section table and header, the file is incomplete until this is called
+			*/
+			void finish();
+
+			SnapshotWriter(const SnapshotWriter&) = delete;
+
+		private:
+			void padTo(uint64_t alignment);
+
+			std::ofstream					m_out;
+			uint64_t						m_position = 0;
+			std::vector<SnapshotSection>	m_sections;
+			bool							m_finished = false;
+		};
+
+
+		/**
+		* @class MappedSnapshot
+		* Maps a snapshot file read-only into the address space and validates the header and
+		* section table. Blocks are used in place, loaders copy them into their containers with one
+		* bulk copy per block.
+		*/
+		class MappedSnapshot {
+		public:
+			/**
+			* Maps the file, throws on failure or if the file is not a compatible snapshot
+			*/
+			explicit MappedSnapshot(const std::string& filename);
+			~MappedSnapshot();
+
+			uint32_t getNumSections() const { return m_header->numSections; }
+
+			const SnapshotSection& getSection(uint32_t index) const { return m_sections[index]; }
+
+			/**
+			* @returns the first section matching kind and typeId, nullptr if not present
+			*/
+			const SnapshotSection* findSection(SnapshotSectionKind kind, uint16_t typeId = 0) const;
+
+			/**
+			* Gets a block as a typed array, throws if the element size recorded in the file does
+			* not match sizeof(T), which happens when a struct layout changes without a version bump
+			*/
+			template <typename T>
+			const T* getBlock(const SnapshotSection& section, SnapshotBlockIndex block) const
+			{
+				auto& b = section.blocks[block];
+				if (b.count > 0 && b.elementSize != sizeof(T)) {
+					throw std::runtime_error("snapshot block element size mismatch");
+				}
+				return reinterpret_cast<const T*>(m_data + b.offset);
+			}
+
+			size_t getBlockCount(const SnapshotSection& section, SnapshotBlockIndex block) const
+			{
+				return static_cast<size_t>(section.blocks[block].count);
+			}
+
+			MappedSnapshot(const MappedSnapshot&) = delete;
+
+		private:
+			/**
+			* Unmaps the view and closes the handles, safe to call on a partially opened snapshot
+			*/
+			void close();
+
+			const uint8_t*			m_data = nullptr;
+			uint64_t				m_size = 0;
+			const SnapshotHeader*	m_header = nullptr;
+			const SnapshotSection*	m_sections = nullptr;
+
+			void*					m_file = nullptr;		//<! platform file handle
+			void*					m_mapping = nullptr;	//<! platform mapping handle
+		};
+
+
+		// handle_map helpers
+
+		/**
+		* Writes the sparse ids, meta and freelist of a handle_map into the current section. The
+		* items block is written by the caller since its layout depends on the item type.
+		*/
+		template <typename T>
+		void writeSnapshotHandleMap(SnapshotWriter& writer, const handle_map<T>& map)
+		{
+			writer.setParam(SnapshotParam_FreeListFront, map.getFreeListFront());
+			writer.setParam(SnapshotParam_FreeListBack, map.getFreeListBack());
+			writer.setParam(SnapshotParam_ItemTypeId, map.getItemTypeId());
+
+			writer.writeBlock(SnapshotBlock_Ids, map.getIds().data(), map.getIds().size(), sizeof(Id_T));
+			writer.writeBlock(SnapshotBlock_Meta, map.getMeta().data(), map.getMeta().size(),
+							  sizeof(typename handle_map<T>::Meta_T));
+		}
+
+		/**
+		* Restores the sparse ids, meta and freelist of a handle_map from a section, leaving the
+		* items set to be filled by the caller.
+		* @returns number of items the caller must restore
+		*/
+		template <typename T>
+		size_t readSnapshotHandleMap(const MappedSnapshot& snapshot, const SnapshotSection& section,
+									 handle_map<T>& map)
+		{
+			typedef typename handle_map<T>::Meta_T Meta_T;
+
+			if (section.params[SnapshotParam_ItemTypeId] != map.getItemTypeId()) {
+				throw std::runtime_error("snapshot handle_map item type id mismatch");
+			}
+
+			auto ids = snapshot.getBlock<Id_T>(section, SnapshotBlock_Ids);
+			auto meta = snapshot.getBlock<Meta_T>(section, SnapshotBlock_Meta);
+			size_t numIds = snapshot.getBlockCount(section, SnapshotBlock_Ids);
+			size_t numItems = snapshot.getBlockCount(section, SnapshotBlock_Meta);
+
+			map.getIds().assign(ids, ids + numIds);
+			map.getMeta().assign(meta, meta + numItems);
+			map.restoreFreeList(section.params[SnapshotParam_FreeListFront],
+								section.params[SnapshotParam_FreeListBack]);
+
+			return numItems;
+		}
+
+	}
+}
+
+#endif
\ No newline at end of file
@@ -10,6 +10,7 @@
 
 // entity type id set to highest 15-bit value to deconflict with components
 #define EntityId_typeId		32767
+#define ComponentObserverId_typeId	32766
 
 
 namespace griffin {
@@ -17,11 +18,20 @@ namespace griffin {
 		typedef griffin::Id_T    ComponentId;
 		typedef griffin::IdSet_T ComponentIdSet;
 		typedef griffin::Id_T    EntityId;
+		typedef griffin::Id_T    ComponentObserverId;
 	}
 
 	namespace scene {
+		struct SceneNode;
+
 		typedef griffin::Id_T    SceneId;
 		typedef griffin::Id_T    SceneNodeId;
+
+		/**
+		* Compact SceneNode id stored in components that reference a node, see CompactId_T
+		*/
+		typedef griffin::CompactId_T<SceneNode>	SceneNodeRef;
+		#define NullSceneNodeRef	griffin::scene::SceneNodeRef{}
 	}
 }
 
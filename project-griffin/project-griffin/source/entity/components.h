@@ -20,6 +20,12 @@ namespace griffin {
 		#define MAX_COMPONENTS	64
 		typedef std::bitset<MAX_COMPONENTS> ComponentMask;
 
+		/**
+		* MAX_TAGS includes compile-time tags plus script-defined tags
+		*/
+		#define MAX_TAGS		64
+		typedef std::bitset<MAX_TAGS> TagMask;
+
 
 		/**
 		* The component list forward declares all component structs, defines an enum to give each type
@@ -39,9 +45,25 @@ namespace griffin {
 			MaterialOverride,		//<! Engine: Render: mesh instance material overrides
 
 			ScreenShakeProducer,	//<! Game: ScreenShakerSystem: causes shake on nearby ScreenShakeNodes
-			ScreenShakeNode			//<! Game: ScreenShakerSystem: pairs with a SceneNode and receives shake from nearby ScreenShakeProducers
+			ScreenShakeNode,		//<! Game: ScreenShakerSystem: pairs with a SceneNode and receives shake from nearby ScreenShakeProducers
+
+			// appended after the existing types so their ids, which index snapshot stores, don't shift
+			ModelLOD,				//<! Engine: SceneGraph: model instance detail levels chosen by screen space error
+			SceneHierarchy			//<! Engine: SceneGraph: tree links of a SceneNode, kept in step with the SceneNode store
 		)
 
+
+		/**
+		* Tags are components without data, an entity either has one or it doesn't. A tag is only a
+		* bit in the entity's TagMask plus an entry in the tag's dense entity list, no store or
+		* component record is allocated. Ids from last_TagType_enum up to MAX_TAGS are free for
+		* tags defined by scripts.
+		*/
+		MakeEnum(TagType, uint8_t,
+				 (Static)				//<! Engine: SceneGraph: scene node without a MovementComponent, never moves
+				 (Shakable)				//<! Game: ScreenShakerSystem: camera has a ScreenShakeNode
+				 ,_Tag);
+
 	}
 }
 
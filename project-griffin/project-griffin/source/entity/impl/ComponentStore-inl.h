@@ -6,7 +6,10 @@
 #define GRIFFIN_COMPONENTSTORE_INL_H_
 
 #include "../ComponentStore.h"
+#include "../EntitySnapshot.h"
 #include <sstream>
+#include <algorithm>
+#include <cstring>
 
 namespace griffin {
 	namespace entity {
@@ -23,6 +26,231 @@ namespace griffin {
 
 		// class ComponentStore 
 
+		template <typename T>
+		void ComponentStore<T>::markChangedInnerIndex(uint32_t innerIndex)
+		{
+			assert(innerIndex < m_components.size() && "inner index out of range");
+
+			// the dense set can be resized outside of the store (e.g. clear, reset), resync here
+			if (m_slotVersions.size() != m_components.size()) {
+				m_slotVersions.resize(m_components.size(), 0);
+			}
+			uint32_t chunk = innerIndex / COMPONENTSTORE_CHANGE_CHUNK_SIZE;
+			if (chunk >= m_chunkVersions.size()) {
+				m_chunkVersions.resize(chunk + 1, 0);
+			}
+
+			// already recorded in this version, don't grow the dirty list with duplicates
+			if (m_slotVersions[innerIndex] == m_version) {
+				return;
+			}
+			m_slotVersions[innerIndex] = m_version;
+			m_chunkVersions[chunk] = m_version;
+
+			// keep the dirty list bounded, older queries fall back to the chunk scan
+			size_t maxChanges = 4 * std::max(m_components.size(), static_cast<size_t>(COMPONENTSTORE_CHANGE_CHUNK_SIZE));
+			if (m_changes.size() >= maxChanges) {
+				auto firstCurrent = std::lower_bound(m_changes.begin(), m_changes.end(), m_version,
+					[](const ChangeEntry& e, uint32_t v) {
+						return (e.version < v);
+					});
+				m_changes.erase(m_changes.begin(), firstCurrent);
+				m_changesBaseVersion = m_version - 1;
+			}
+
+			m_changes.push_back({ innerIndex, m_version });
+		}
+
+
+		template <typename T>
+		size_t ComponentStore<T>::getChangedSince(uint32_t sinceVersion, std::vector<uint32_t>& outIndices) const
+		{
+			size_t startSize = outIndices.size();
+			uint32_t size = static_cast<uint32_t>(std::min(m_components.size(), m_slotVersions.size()));
+
+			if (sinceVersion >= m_changesBaseVersion) {
+				// the dirty list covers the requested range, find the first newer entry
+				auto it = std::upper_bound(m_changes.cbegin(), m_changes.cend(), sinceVersion,
+					[](uint32_t v, const ChangeEntry& e) {
+						return (v < e.version);
+					});
+
+				for (; it != m_changes.cend(); ++it) {
+					// skip entries past the end of the dense set, or superseded by a newer entry
+					// for the same slot (which is pushed later in the list)
+					if (it->denseIndex < size && m_slotVersions[it->denseIndex] == it->version) {
+						outIndices.push_back(it->denseIndex);
+					}
+				}
+
+				// a slot popped and refilled within one version can be listed twice
+				auto first = outIndices.begin() + startSize;
+				std::sort(first, outIndices.end());
+				outIndices.erase(std::unique(first, outIndices.end()), outIndices.end());
+			}
+			else {
+				// fall back to the chunk scan, skipping whole chunks that have not changed
+				for (uint32_t c = 0; c < m_chunkVersions.size(); ++c) {
+					if (m_chunkVersions[c] <= sinceVersion) {
+						continue;
+					}
+					uint32_t end = std::min(size, (c + 1) * COMPONENTSTORE_CHANGE_CHUNK_SIZE);
+					for (uint32_t i = c * COMPONENTSTORE_CHANGE_CHUNK_SIZE; i < end; ++i) {
+						if (m_slotVersions[i] > sinceVersion) {
+							outIndices.push_back(i);
+						}
+					}
+				}
+			}
+
+			return outIndices.size() - startSize;
+		}
+
+
+		template <typename T>
+		inline void ComponentStore<T>::trackErase(uint32_t innerIndex)
+		{
+			m_slotVersions.resize(m_components.size());
+			++m_structureVersion;
+
+			// the last component was swapped into the hole
+			if (innerIndex < m_components.size()) {
+				markChangedInnerIndex(innerIndex);
+			}
+		}
+
+
+		template <typename T>
+		void ComponentStore<T>::reorder(const std::vector<uint32_t>& order)
+		{
+			m_components.reorder(order);
+
+			for (uint32_t i = 0; i < order.size(); ++i) {
+				if (order[i] != i) {
+					markChangedInnerIndex(i);
+				}
+			}
+			++m_structureVersion;
+		}
+
+
+		template <typename T>
+		void ComponentStore<T>::rotate(uint32_t first, uint32_t middle, uint32_t last)
+		{
+			if (first == middle || middle == last) {
+				return;
+			}
+			m_components.rotate(first, middle, last);
+
+			for (uint32_t i = first; i < last; ++i) {
+				markChangedInnerIndex(i);
+			}
+			++m_structureVersion;
+		}
+
+
+		template <typename T>
+		void ComponentStore<T>::writeSnapshot(SnapshotWriter& writer) const
+		{
+			writeSnapshotHandleMap(writer, m_components);
+			writeSnapshotItems(writer, is_snapshot_raw<T>());
+		}
+
+
+		template <typename T>
+		void ComponentStore<T>::readSnapshot(const MappedSnapshot& snapshot, const SnapshotSection& section)
+		{
+			readSnapshotHandleMap(snapshot, section, m_components);
+			readSnapshotItems(snapshot, section, is_snapshot_raw<T>());
+
+			if (m_components.size() != m_components.getMeta().size()) {
+				throw std::runtime_error("snapshot component store items and meta size mismatch");
+			}
+
+			// everything is new, answer all queries older than the current version with a chunk scan
+			uint32_t size = static_cast<uint32_t>(m_components.size());
+			m_slotVersions.assign(size, m_version);
+			m_chunkVersions.assign((size + COMPONENTSTORE_CHANGE_CHUNK_SIZE - 1) / COMPONENTSTORE_CHANGE_CHUNK_SIZE, m_version);
+			m_changes.clear();
+			m_changesBaseVersion = m_version;
+			++m_structureVersion;
+		}
+
+
+		template <typename T>
+		void ComponentStore<T>::writeSnapshotItems(SnapshotWriter& writer, std::true_type) const
+		{
+			auto& items = m_components.getItems();
+			writer.writeBlock(SnapshotBlock_Items, items.data(), items.size(), sizeof(ComponentRecord));
+		}
+
+
+		template <typename T>
+		void ComponentStore<T>::readSnapshotItems(const MappedSnapshot& snapshot, const SnapshotSection& section,
+												  std::true_type)
+		{
+			auto items = snapshot.getBlock<ComponentRecord>(section, SnapshotBlock_Items);
+			size_t count = snapshot.getBlockCount(section, SnapshotBlock_Items);
+
+			m_components.getItems().assign(items, items + count);
+		}
+
+
+		template <typename T>
+		void ComponentStore<T>::writeSnapshotItems(SnapshotWriter& writer, std::false_type) const
+		{
+			auto& props = T::Reflection::getProperties();
+			auto& items = m_components.getItems();
+
+			// build zeroed records holding every plain data property, glm members included since
+			// they fail is_trivially_copyable, leaving out only the properties that own resources
+			std::vector<uint8_t> buffer(items.size() * sizeof(ComponentRecord), 0);
+			for (size_t i = 0; i < items.size(); ++i) {
+				auto& rec = items[i];
+				auto src = reinterpret_cast<const uint8_t*>(&rec);
+				auto dst = buffer.data() + i * sizeof(ComponentRecord);
+
+				for (auto& prop : props) {
+					if (prop.isTriviallyDestructible) {
+						memcpy(dst + prop.offset, src + prop.offset, prop.size);
+					}
+				}
+				size_t entityIdOffset = reinterpret_cast<const uint8_t*>(&rec.entityId) - src;
+				memcpy(dst + entityIdOffset, &rec.entityId, sizeof(EntityId));
+			}
+
+			writer.writeBlock(SnapshotBlock_Items, buffer.data(), items.size(), sizeof(ComponentRecord));
+		}
+
+
+		template <typename T>
+		void ComponentStore<T>::readSnapshotItems(const MappedSnapshot& snapshot, const SnapshotSection& section,
+												  std::false_type)
+		{
+			auto& props = T::Reflection::getProperties();
+			auto& items = m_components.getItems();
+
+			auto records = reinterpret_cast<const uint8_t*>(snapshot.getBlock<ComponentRecord>(section, SnapshotBlock_Items));
+			size_t count = snapshot.getBlockCount(section, SnapshotBlock_Items);
+
+			items.clear();
+			items.resize(count);
+			for (size_t i = 0; i < count; ++i) {
+				auto& rec = items[i];
+				auto src = records + i * sizeof(ComponentRecord);
+				auto dst = reinterpret_cast<uint8_t*>(&rec);
+
+				for (auto& prop : props) {
+					if (prop.isTriviallyDestructible) {
+						memcpy(dst + prop.offset, src + prop.offset, prop.size);
+					}
+				}
+				size_t entityIdOffset = reinterpret_cast<uint8_t*>(&rec.entityId) - dst;
+				memcpy(&rec.entityId, src + entityIdOffset, sizeof(EntityId));
+			}
+		}
+
+
 		/**
 		* to_string for debug and test output
 		*/
@@ -0,0 +1,274 @@
+/**
+* @author	Jeff Kiah
+*/
+#pragma once
+#ifndef GRIFFIN_COMPONENTSTOREHISTORY_INL_H_
+#define GRIFFIN_COMPONENTSTOREHISTORY_INL_H_
+
+#include "../ComponentStoreHistory.h"
+#include <algorithm>
+#include <cstring>
+
+namespace griffin {
+	namespace entity {
+
+		namespace detail {
+			/**
+			* XOR of element i of a and b, where elements past the end of either array are zero
+			* @returns true if the result is non-zero, meaning the elements differ
+			*/
+			template <typename E>
+			inline bool xorElement(const std::vector<E>& a, const std::vector<E>& b, size_t i, E& out)
+			{
+				static_assert(sizeof(E) % sizeof(uint32_t) == 0, "element size must be a multiple of 4 bytes");
+				const size_t words = sizeof(E) / sizeof(uint32_t);
+				// zeroed words rather than E{}, a default constructed glm quaternion has w = 1
+				static const uint32_t zero[words] = {};
+
+				auto pa = (i < a.size() ? reinterpret_cast<const uint32_t*>(&a[i]) : zero);
+				auto pb = (i < b.size() ? reinterpret_cast<const uint32_t*>(&b[i]) : zero);
+				auto po = reinterpret_cast<uint32_t*>(&out);
+
+				uint32_t any = 0;
+				for (size_t w = 0; w < words; ++w) {
+					po[w] = pa[w] ^ pb[w];
+					any |= po[w];
+				}
+				return (any != 0);
+			}
+
+			/**
+			* Diffs the listed elements of current against mirror, appending the differing ones
+			*/
+			template <typename E>
+			inline void xorElements(const std::vector<E>& current, const std::vector<E>& mirror,
+									const std::vector<uint32_t>& indices,
+									std::vector<uint32_t>& outIndices, std::vector<E>& outXor)
+			{
+				E x;
+				for (auto i : indices) {
+					if (xorElement(current, mirror, i, x)) {
+						outIndices.push_back(i);
+						outXor.push_back(x);
+					}
+				}
+			}
+
+			/**
+			* Resizes v to newSize, XORs the payload in, where any new elements start zeroed
+			*/
+			template <typename E>
+			inline void applyXor(std::vector<E>& v, size_t newSize,
+								 const std::vector<uint32_t>& indices, const std::vector<E>& payload)
+			{
+				// grow first so the payload can land past the old end, shrink after
+				size_t oldSize = v.size();
+				if (newSize > oldSize) {
+					v.resize(newSize);
+					memset(&v[oldSize], 0, (newSize - oldSize) * sizeof(E));
+				}
+
+				const size_t words = sizeof(E) / sizeof(uint32_t);
+				for (size_t p = 0; p < indices.size(); ++p) {
+					if (indices[p] < v.size()) {
+						auto dst = reinterpret_cast<uint32_t*>(&v[indices[p]]);
+						auto src = reinterpret_cast<const uint32_t*>(&payload[p]);
+						for (size_t w = 0; w < words; ++w) {
+							dst[w] ^= src[w];
+						}
+					}
+				}
+
+				if (newSize < v.size()) {
+					v.resize(newSize);
+				}
+			}
+
+			inline void sortUnique(std::vector<uint32_t>& v)
+			{
+				std::sort(v.begin(), v.end());
+				v.erase(std::unique(v.begin(), v.end()), v.end());
+			}
+		}
+
+
+		// class ComponentStoreHistory
+
+		template <typename T>
+		size_t ComponentStoreHistory<T>::capture(bool fullScan)
+		{
+			auto& map = m_store.getComponents();
+			auto& items = map.getItems();
+			auto& meta = map.getMeta();
+			auto& ids = map.getIds();
+
+			uint32_t oldNumItems = static_cast<uint32_t>(m_mirrorItems.size());
+			uint32_t newNumItems = static_cast<uint32_t>(items.size());
+			uint32_t oldNumIds = static_cast<uint32_t>(m_mirrorIds.size());
+			uint32_t newNumIds = static_cast<uint32_t>(ids.size());
+
+			// collect candidate dense slots, inserts and erases are reported by change tracking,
+			// the range between the old and new size is always a candidate
+			m_dirty.clear();
+			if (fullScan) {
+				for (uint32_t i = 0; i < std::max(oldNumItems, newNumItems); ++i) {
+					m_dirty.push_back(i);
+				}
+			}
+			else {
+				m_store.getChangedSince(m_sinceVersion, m_dirty);
+				for (uint32_t i = std::min(oldNumItems, newNumItems); i < std::max(oldNumItems, newNumItems); ++i) {
+					m_dirty.push_back(i);
+				}
+				detail::sortUnique(m_dirty);
+			}
+			// the version belongs to the store's consumers, don't close it, writes in the open
+			// version are listed again next time and drop out as equal to the mirror
+			m_sinceVersion = m_store.getVersion() - 1;
+
+			// sparse slots change when an item is inserted, erased or moved, so they are found
+			// through the old and new meta of the dirty dense slots, plus the freelist ends
+			m_dirtyIds.clear();
+			if (fullScan) {
+				for (uint32_t i = 0; i < std::max(oldNumIds, newNumIds); ++i) {
+					m_dirtyIds.push_back(i);
+				}
+			}
+			else {
+				for (auto i : m_dirty) {
+					if (i < newNumItems) { m_dirtyIds.push_back(meta[i].denseToSparse); }
+					if (i < oldNumItems) { m_dirtyIds.push_back(m_mirrorMeta[i].denseToSparse); }
+				}
+				uint32_t freeList[4] = {
+					m_mirrorFreeList[0], m_mirrorFreeList[1],
+					map.getFreeListFront(), map.getFreeListBack()
+				};
+				for (auto f : freeList) {
+					if (f != 0xFFFFFFFF) { m_dirtyIds.push_back(f); }
+				}
+				for (uint32_t i = std::min(oldNumIds, newNumIds); i < std::max(oldNumIds, newNumIds); ++i) {
+					m_dirtyIds.push_back(i);
+				}
+				detail::sortUnique(m_dirtyIds);
+			}
+
+			// record into the ring slot at the head, overwriting the oldest delta when full
+			auto& d = m_ring[m_head];
+			d.oldNumItems = oldNumItems;
+			d.newNumItems = newNumItems;
+			d.oldNumIds = oldNumIds;
+			d.newNumIds = newNumIds;
+			d.oldFreeList[0] = m_mirrorFreeList[0];
+			d.oldFreeList[1] = m_mirrorFreeList[1];
+			d.newFreeList[0] = map.getFreeListFront();
+			d.newFreeList[1] = map.getFreeListBack();
+			d.itemIndices.clear();
+			d.itemXor.clear();
+			d.metaIndices.clear();
+			d.metaXor.clear();
+			d.idIndices.clear();
+			d.idXor.clear();
+
+			detail::xorElements(items, m_mirrorItems, m_dirty, d.itemIndices, d.itemXor);
+			detail::xorElements(meta, m_mirrorMeta, m_dirty, d.metaIndices, d.metaXor);
+			detail::xorElements(ids, m_mirrorIds, m_dirtyIds, d.idIndices, d.idXor);
+
+			// bring the mirror up to date with the same operation that applies the delta
+			applyDelta(m_mirrorIds, m_mirrorMeta, m_mirrorItems, d, true);
+			m_mirrorFreeList[0] = d.newFreeList[0];
+			m_mirrorFreeList[1] = d.newFreeList[1];
+
+			m_head = (m_head + 1) % m_depth;
+			m_numApplied = std::min(m_numApplied + 1, m_depth);
+			m_numReverted = 0;
+
+			return d.payloadSize();
+		}
+
+
+		template <typename T>
+		bool ComponentStoreHistory<T>::revert()
+		{
+			if (m_numApplied == 0) {
+				return false;
+			}
+			m_head = (m_head + m_depth - 1) % m_depth;
+			--m_numApplied;
+			++m_numReverted;
+
+			applyToStore(m_ring[m_head], false);
+			return true;
+		}
+
+
+		template <typename T>
+		bool ComponentStoreHistory<T>::reapply()
+		{
+			if (m_numReverted == 0) {
+				return false;
+			}
+			applyToStore(m_ring[m_head], true);
+
+			m_head = (m_head + 1) % m_depth;
+			++m_numApplied;
+			--m_numReverted;
+			return true;
+		}
+
+
+		template <typename T>
+		void ComponentStoreHistory<T>::applyDelta(IdSet_T& ids, std::vector<Meta_T>& meta,
+												  std::vector<ComponentRecord>& items,
+												  const Delta& delta, bool forward)
+		{
+			detail::applyXor(items, forward ? delta.newNumItems : delta.oldNumItems, delta.itemIndices, delta.itemXor);
+			detail::applyXor(meta, forward ? delta.newNumItems : delta.oldNumItems, delta.metaIndices, delta.metaXor);
+			detail::applyXor(ids, forward ? delta.newNumIds : delta.oldNumIds, delta.idIndices, delta.idXor);
+		}
+
+
+		template <typename T>
+		void ComponentStoreHistory<T>::applyToStore(const Delta& delta, bool forward)
+		{
+			// the store is expected to be unchanged since the last capture, which is what the
+			// mirror holds, so the same XOR applies to both
+			auto& map = m_store.getComponents();
+			applyDelta(map.getIds(), map.getMeta(), map.getItems(), delta, forward);
+			applyDelta(m_mirrorIds, m_mirrorMeta, m_mirrorItems, delta, forward);
+
+			const uint32_t* freeList = (forward ? delta.newFreeList : delta.oldFreeList);
+			map.restoreFreeList(freeList[0], freeList[1]);
+			m_mirrorFreeList[0] = freeList[0];
+			m_mirrorFreeList[1] = freeList[1];
+
+			// let other systems know, the next capture finds these equal to the mirror
+			m_store.markStructureChanged();
+			uint32_t size = static_cast<uint32_t>(map.size());
+			for (auto i : delta.itemIndices) {
+				if (i < size) {
+					m_store.markChangedInnerIndex(i);
+				}
+			}
+		}
+
+
+		template <typename T>
+		ComponentStoreHistory<T>::ComponentStoreHistory(ComponentStore<T>& store, uint32_t depth) :
+			m_store(store),
+			m_depth(std::max(depth, 1U)),
+			m_ring(m_depth)
+		{
+			auto& map = m_store.getComponents();
+			m_mirrorItems = map.getItems();
+			m_mirrorMeta = map.getMeta();
+			m_mirrorIds = map.getIds();
+			m_mirrorFreeList[0] = map.getFreeListFront();
+			m_mirrorFreeList[1] = map.getFreeListBack();
+
+			m_sinceVersion = m_store.getVersion() - 1;
+		}
+
+	}
+}
+
+#endif
\ No newline at end of file
@@ -4,6 +4,7 @@
 */
 #include <entity/components.h>
 #include <entity/EntityManager.h>
+#include <entity/EntitySnapshot.h>
 
 
 using namespace griffin::entity;
@@ -30,11 +31,44 @@ bool EntityManager::removeComponent(ComponentId componentId)
 		return false;
 	}
 
+	recordComponentRemoved(componentId, entityId);
+
 	// TODO remove from the component mask index if the index is re-introduced
 	return store->removeComponent(componentId);
 }
 
 
+size_t EntityManager::removeComponents(const std::vector<ComponentId>& componentIds)
+{
+	size_t removed = 0;
+	ComponentStoreBase* store = nullptr;
+	uint16_t storeTypeId = 0;
+
+	for (auto componentId : componentIds) {
+		// ids usually come in runs of one type, only look up the store when the type changes
+		if (store == nullptr || componentId.typeId != storeTypeId) {
+			store = m_componentStores[componentId.typeId].get();
+			storeTypeId = componentId.typeId;
+			if (store == nullptr) {
+				continue;
+			}
+		}
+		if (!store->isValid(componentId)) {
+			continue;
+		}
+
+		auto entityId = store->getEntityId(componentId);
+		if (m_entityStore[entityId].removeComponent(componentId)) {
+			recordComponentRemoved(componentId, entityId);
+			store->removeComponent(componentId);
+			++removed;
+		}
+	}
+
+	return removed;
+}
+
+
 bool EntityManager::removeComponentsOfTypeFromEntity(ComponentType ct, EntityId entityId)
 {
 	if (!m_entityStore.isValid(entityId)) {
@@ -50,6 +84,7 @@ bool EntityManager::removeComponentsOfTypeFromEntity(ComponentType ct, EntityId
 	// remove from the component store
 	for (auto componentId : entity.components) {
 		if (componentId.typeId == ct) {
+			recordComponentRemoved(componentId, entityId);
 			store->removeComponent(componentId);
 		}
 	}
@@ -61,6 +96,157 @@ bool EntityManager::removeComponentsOfTypeFromEntity(ComponentType ct, EntityId
 }
 
 
+// Observer Functions
+
+ComponentObserverId EntityManager::addComponentObserver(uint16_t typeId, ComponentObserverFunc&& func)
+{
+	assert(typeId < MAX_COMPONENTS && "typeId out of range");
+	assert(!m_dispatching && "observers can't be added during dispatch");
+
+	m_observedTypes.set(typeId);
+	return m_componentObservers.insert({ typeId, std::forward<ComponentObserverFunc>(func) });
+}
+
+
+bool EntityManager::removeComponentObserver(ComponentObserverId observerId)
+{
+	assert(!m_dispatching && "observers can't be removed during dispatch");
+	if (!m_componentObservers.isValid(observerId)) {
+		return false;
+	}
+	uint16_t typeId = m_componentObservers[observerId].typeId;
+	m_componentObservers.erase(observerId);
+
+	for (auto& observer : m_componentObservers.getItems()) {
+		if (observer.typeId == typeId) {
+			return true;
+		}
+	}
+
+	// last observer of the type, stop recording
+	m_observedTypes.reset(typeId);
+	m_componentEvents[typeId].added.clear();
+	m_componentEvents[typeId].removed.clear();
+	return true;
+}
+
+
+void EntityManager::dispatchComponentEvents()
+{
+	if (m_observedTypes.none()) {
+		return;
+	}
+	assert(!m_dispatching && "dispatchComponentEvents is not reentrant");
+	m_dispatching = true;
+
+	for (uint16_t typeId = 0; typeId < MAX_COMPONENTS; ++typeId) {
+		auto& pending = m_componentEvents[typeId];
+		if (!m_observedTypes[typeId] || (pending.added.empty() && pending.removed.empty())) {
+			continue;
+		}
+
+		// swap out so events recorded by the observers wait for the next dispatch, both buffers
+		// keep their capacity from frame to frame
+		auto& events = m_dispatchEvents;
+		events.added.clear();
+		events.removed.clear();
+		std::swap(events.added, pending.added);
+		std::swap(events.removed, pending.removed);
+
+		for (auto& observer : m_componentObservers.getItems()) {
+			if (observer.typeId == typeId) {
+				observer.func(*this, typeId, events.added, events.removed);
+			}
+		}
+	}
+
+	m_dispatching = false;
+}
+
+
+// Tag Functions
+
+bool EntityManager::addTagToEntity(TagType tag, EntityId entityId)
+{
+	assert(tag < MAX_TAGS && "tag out of range");
+	if (!m_entityStore.isValid(entityId)) {
+		return false;
+	}
+	auto& entity = m_entityStore[entityId];
+	if (entity.hasTag(tag)) {
+		return false;
+	}
+	entity.tagMask.set(tag);
+
+	auto& list = m_tagLists[tag];
+	if (entityId.index >= list.positions.size()) {
+		list.positions.resize(entityId.index + 1);
+	}
+	list.positions[entityId.index] = static_cast<uint32_t>(list.entities.size());
+	list.entities.push_back(entityId);
+
+	return true;
+}
+
+
+bool EntityManager::removeTagFromEntity(TagType tag, EntityId entityId)
+{
+	assert(tag < MAX_TAGS && "tag out of range");
+	if (!m_entityStore.isValid(entityId)) {
+		return false;
+	}
+	auto& entity = m_entityStore[entityId];
+	if (!entity.hasTag(tag)) {
+		return false;
+	}
+	entity.tagMask.set(tag, false);
+
+	// swap the last entity into the hole
+	auto& list = m_tagLists[tag];
+	uint32_t pos = list.positions[entityId.index];
+	EntityId last = list.entities.back();
+	list.entities[pos] = last;
+	list.positions[last.index] = pos;
+	list.entities.pop_back();
+
+	return true;
+}
+
+
+size_t EntityManager::getEntitiesWithTags(const TagMask& required, const TagMask& excluded,
+										  std::vector<EntityId>& outEntities) const
+{
+	size_t startSize = outEntities.size();
+
+	if (required.none()) {
+		auto& entities = m_entityStore.getItems();
+		for (uint32_t e = 0; e < entities.size(); ++e) {
+			if ((entities[e].tagMask & excluded).none()) {
+				outEntities.push_back(m_entityStore.getHandleForInnerIndex(e));
+			}
+		}
+		return outEntities.size() - startSize;
+	}
+
+	// walk the shortest list of the required tags
+	const TagList* shortest = nullptr;
+	for (size_t t = 0; t < MAX_TAGS; ++t) {
+		if (required[t] && (shortest == nullptr || m_tagLists[t].entities.size() < shortest->entities.size())) {
+			shortest = &m_tagLists[t];
+		}
+	}
+
+	for (auto entityId : shortest->entities) {
+		auto& mask = m_entityStore[entityId].tagMask;
+		if ((mask & required) == required && (mask & excluded).none()) {
+			outEntities.push_back(entityId);
+		}
+	}
+
+	return outEntities.size() - startSize;
+}
+
+
 /**
 * Data Components, 8-byte aligned sizes up to MAX_DATA_COMPONENT_SIZE
 */
@@ -154,6 +340,8 @@ ComponentId EntityManager::addDataComponentToEntity(uint16_t typeId, EntityId en
 	entity.addComponent(componentId);
 	//auto newMask = entity.componentMask;
 
+	recordComponentAdded(componentId, entityId);
+
 	/* // commented out because not sure the component mask index is a keeper
 	if (newMask != previousMask) {
 		// fix up the mask index with the new mask, remove the old entry with old mask
@@ -211,3 +399,167 @@ void* EntityManager::getDataComponent(ComponentId componentId)
 	}
 	return dataPtr;
 }
+
+
+void* EntityManager::getDataComponentItems(uint16_t typeId, uint32_t& outCount, uint32_t& outStride)
+{
+	outCount = 0;
+	outStride = 0;
+
+	// typeId comes from script, a bad one is a missing store rather than an assert
+	uint32_t storeIndex = ComponentType::last_ComponentType_enum + static_cast<uint32_t>(typeId);
+	if (storeIndex >= MAX_COMPONENTS) {
+		return nullptr;
+	}
+
+	auto pStore = m_componentStores[storeIndex].get();
+	if (pStore == nullptr) {
+		return nullptr;
+	}
+
+	size_t count = 0;
+	size_t stride = 0;
+	void* items = pStore->getRawItems(count, stride);
+
+	outCount = static_cast<uint32_t>(count);
+	outStride = static_cast<uint32_t>(stride);
+	return items;
+}
+
+
+// Snapshot Functions
+
+void EntityManager::writeSnapshot(SnapshotWriter& writer) const
+{
+	// entities, flatten the component id vectors into one pool
+	{
+		static_assert(MAX_COMPONENTS <= 64 && MAX_TAGS <= 64, "SnapshotEntityRecord stores each mask in 64 bits");
+
+		auto& entities = m_entityStore.getItems();
+
+		std::vector<SnapshotEntityRecord> records;
+		std::vector<ComponentId> componentPool;
+		records.reserve(entities.size());
+		componentPool.reserve(entities.size() * RESERVE_ENTITY_COMPONENTS / 4);
+
+		for (auto& entity : entities) {
+			records.push_back({ entity.componentMask.to_ullong(),
+								static_cast<uint32_t>(componentPool.size()),
+								static_cast<uint32_t>(entity.components.size()),
+								entity.tagMask.to_ullong() });
+			componentPool.insert(componentPool.end(), entity.components.begin(), entity.components.end());
+		}
+
+		writer.beginSection(SnapshotSection_Entities, 0);
+		writeSnapshotHandleMap(writer, m_entityStore);
+		writer.writeBlock(SnapshotBlock_Items, records.data(), records.size(), sizeof(SnapshotEntityRecord));
+		writer.writeBlock(SnapshotBlock_Extra, componentPool.data(), componentPool.size(), sizeof(ComponentId));
+	}
+
+	// component stores
+	for (uint16_t s = 0; s < MAX_COMPONENTS; ++s) {
+		auto store = m_componentStores[s].get();
+		if (store == nullptr) {
+			continue;
+		}
+
+		bool isData = (s >= ComponentType::last_ComponentType_enum);
+		writer.beginSection(SnapshotSection_ComponentStore, s,
+							isData ? SnapshotFlag_DataComponent : SnapshotFlag_None);
+		if (isData) {
+			writer.setParam(SnapshotParam_DataComponentSize,
+							m_dataComponentStoreSizes[s - ComponentType::last_ComponentType_enum]);
+		}
+		store->writeSnapshot(writer);
+	}
+}
+
+
+void EntityManager::readSnapshot(const MappedSnapshot& snapshot)
+{
+	if (m_entityStore.size() != 0) {
+		throw std::logic_error("snapshot must be loaded into an empty EntityManager");
+	}
+
+	// entities
+	auto entitySection = snapshot.findSection(SnapshotSection_Entities, 0);
+	if (entitySection == nullptr) {
+		throw std::runtime_error("snapshot does not contain entities");
+	}
+	{
+		size_t count = readSnapshotHandleMap(snapshot, *entitySection, m_entityStore);
+
+		auto records = snapshot.getBlock<SnapshotEntityRecord>(*entitySection, SnapshotBlock_Items);
+		auto componentPool = snapshot.getBlock<ComponentId>(*entitySection, SnapshotBlock_Extra);
+		size_t poolSize = snapshot.getBlockCount(*entitySection, SnapshotBlock_Extra);
+		if (snapshot.getBlockCount(*entitySection, SnapshotBlock_Items) != count) {
+			throw std::runtime_error("snapshot entity items and meta size mismatch");
+		}
+
+		auto& entities = m_entityStore.getItems();
+		entities.resize(count);
+		for (size_t e = 0; e < count; ++e) {
+			auto& rec = records[e];
+			if (static_cast<uint64_t>(rec.firstComponent) + rec.numComponents > poolSize) {
+				throw std::runtime_error("snapshot entity component range out of bounds");
+			}
+			entities[e].componentMask = ComponentMask(rec.componentMask);
+			entities[e].components.assign(componentPool + rec.firstComponent,
+										  componentPool + rec.firstComponent + rec.numComponents);
+		}
+
+		// tag lists aren't saved, rebuild them from the masks
+		for (uint32_t e = 0; e < count; ++e) {
+			TagMask tags(records[e].tagMask);
+			if (tags.none()) {
+				continue;
+			}
+			EntityId entityId = m_entityStore.getHandleForInnerIndex(e);
+			for (size_t t = 0; t < MAX_TAGS; ++t) {
+				if (tags[t]) {
+					addTagToEntity(static_cast<TagType>(t), entityId);
+				}
+			}
+		}
+	}
+
+	// component stores
+	for (uint32_t i = 0; i < snapshot.getNumSections(); ++i) {
+		auto& section = snapshot.getSection(i);
+		if (section.kind != SnapshotSection_ComponentStore) {
+			continue;
+		}
+		uint16_t s = section.typeId;
+		if (s >= MAX_COMPONENTS) {
+			throw std::runtime_error("snapshot component store index out of range");
+		}
+
+		if (section.flags & SnapshotFlag_DataComponent) {
+			uint16_t typeId = s - ComponentType::last_ComponentType_enum;
+			if (m_componentStores[s] == nullptr) {
+				createDataComponentStore(typeId, section.params[SnapshotParam_DataComponentSize],
+										 snapshot.getBlockCount(section, SnapshotBlock_Items));
+			}
+			else if (m_dataComponentStoreSizes[typeId] != section.params[SnapshotParam_DataComponentSize]) {
+				throw std::runtime_error("snapshot data component size mismatch");
+			}
+		}
+		else if (m_componentStores[s] == nullptr) {
+			throw std::runtime_error("snapshot contains component type " + std::string(ComponentTypeToString((ComponentType)s)) +
+									 " but its store was not created before loading");
+		}
+
+		m_componentStores[s]->readSnapshot(snapshot, section);
+	}
+
+	// observers see the loaded components as added
+	if (m_observedTypes.any()) {
+		auto& entities = m_entityStore.getItems();
+		for (uint32_t e = 0; e < entities.size(); ++e) {
+			EntityId entityId = m_entityStore.getHandleForInnerIndex(e);
+			for (auto componentId : entities[e].components) {
+				recordComponentAdded(componentId, entityId);
+			}
+		}
+	}
+}
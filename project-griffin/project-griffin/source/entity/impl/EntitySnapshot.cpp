@@ -0,0 +1,232 @@
+/**
+* @file EntitySnapshot.cpp
+* @author Jeff Kiah
+*/
+#include <entity/EntitySnapshot.h>
+#include <cstring>
+#include <cassert>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include "Windows.h"
+#undef min
+#undef max
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace griffin::entity;
+
+
+// class SnapshotWriter
+
+SnapshotWriter::SnapshotWriter(const std::string& filename) :
+	m_out(filename, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary)
+{
+	if (!m_out.is_open()) {
+		throw std::runtime_error("could not open snapshot file for writing: " + filename);
+	}
+	m_sections.reserve(64);
+
+	// reserve space for the header, it's rewritten in finish
+	SnapshotHeader header{};
+	m_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	m_position = sizeof(header);
+}
+
+
+void SnapshotWriter::beginSection(SnapshotSectionKind kind, uint16_t typeId, uint16_t flags)
+{
+	assert(!m_finished && "snapshot already finished");
+
+	padTo(ENTITY_SNAPSHOT_PAGE_SIZE);
+
+	SnapshotSection section{};
+	section.kind = kind;
+	section.typeId = typeId;
+	section.flags = flags;
+	section.offset = m_position;
+	m_sections.push_back(section);
+}
+
+
+void SnapshotWriter::setParam(SnapshotParamIndex param, uint32_t value)
+{
+	assert(!m_sections.empty() && "no section started");
+	m_sections.back().params[param] = value;
+}
+
+
+void SnapshotWriter::writeBlock(SnapshotBlockIndex block, const void* data, size_t count, size_t elementSize)
+{
+	assert(!m_sections.empty() && "no section started");
+
+	padTo(ENTITY_SNAPSHOT_BLOCK_ALIGN);
+
+	auto& section = m_sections.back();
+	auto& b = section.blocks[block];
+	b.offset = m_position;
+	b.count = count;
+	b.elementSize = static_cast<uint32_t>(elementSize);
+
+	size_t bytes = count * elementSize;
+	if (bytes > 0) {
+		m_out.write(reinterpret_cast<const char*>(data), bytes);
+		m_position += bytes;
+	}
+	section.size = m_position - section.offset;
+}
+
+
+void SnapshotWriter::finish()
+{
+	assert(!m_finished && "snapshot already finished");
+
+	padTo(ENTITY_SNAPSHOT_BLOCK_ALIGN);
+
+	SnapshotHeader header{};
+	memcpy(header.magic, ENTITY_SNAPSHOT_MAGIC, sizeof(ENTITY_SNAPSHOT_MAGIC));
+	header.version = ENTITY_SNAPSHOT_VERSION;
+	header.numSections = static_cast<uint32_t>(m_sections.size());
+	header.sectionTableOffset = m_position;
+	header.fileSize = m_position + m_sections.size() * sizeof(SnapshotSection);
+
+	m_out.write(reinterpret_cast<const char*>(m_sections.data()), m_sections.size() * sizeof(SnapshotSection));
+	m_out.seekp(0);
+	m_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	m_out.close();
+
+	if (m_out.fail()) {
+		throw std::runtime_error("error writing snapshot file");
+	}
+	m_finished = true;
+}
+
+
+void SnapshotWriter::padTo(uint64_t alignment)
+{
+	static const char zeros[ENTITY_SNAPSHOT_PAGE_SIZE] = {};
+
+	uint64_t padding = (alignment - (m_position % alignment)) % alignment;
+	if (padding > 0) {
+		m_out.write(zeros, padding);
+		m_position += padding;
+	}
+}
+
+
+// class MappedSnapshot
+
+MappedSnapshot::MappedSnapshot(const std::string& filename)
+{
+	#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+							  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("could not open snapshot file: " + filename);
+	}
+	m_file = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		close();
+		throw std::runtime_error("could not get snapshot file size: " + filename);
+	}
+	m_size = static_cast<uint64_t>(size.QuadPart);
+
+	HANDLE mapping = (m_size > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr);
+	if (mapping == nullptr) {
+		close();
+		throw std::runtime_error("could not map snapshot file: " + filename);
+	}
+	m_mapping = mapping;
+
+	m_data = reinterpret_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("could not open snapshot file: " + filename);
+	}
+	m_file = reinterpret_cast<void*>(static_cast<intptr_t>(fd));
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close();
+		throw std::runtime_error("could not get snapshot file size: " + filename);
+	}
+	m_size = static_cast<uint64_t>(st.st_size);
+
+	void* view = (m_size > 0 ? mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED);
+	m_data = (view != MAP_FAILED ? reinterpret_cast<const uint8_t*>(view) : nullptr);
+	#endif
+
+	if (m_data == nullptr) {
+		close();
+		throw std::runtime_error("could not map snapshot file: " + filename);
+	}
+
+	// validate the header and section table before anything uses them, offsets and counts come
+	// from the file so ranges are checked by division to keep a corrupt file from overflowing
+	m_header = reinterpret_cast<const SnapshotHeader*>(m_data);
+	if (m_size < sizeof(SnapshotHeader) ||
+		memcmp(m_header->magic, ENTITY_SNAPSHOT_MAGIC, sizeof(ENTITY_SNAPSHOT_MAGIC)) != 0 ||
+		m_header->version != ENTITY_SNAPSHOT_VERSION ||
+		m_header->fileSize != m_size ||
+		m_header->sectionTableOffset > m_size ||
+		m_header->numSections > (m_size - m_header->sectionTableOffset) / sizeof(SnapshotSection))
+	{
+		close();
+		throw std::runtime_error("incompatible or corrupt snapshot file: " + filename);
+	}
+	m_sections = reinterpret_cast<const SnapshotSection*>(m_data + m_header->sectionTableOffset);
+
+	uint64_t blocksEnd = m_header->sectionTableOffset;
+	for (uint32_t s = 0; s < m_header->numSections; ++s) {
+		for (auto& b : m_sections[s].blocks) {
+			if (b.offset > blocksEnd ||
+				(b.elementSize > 0 && b.count > (blocksEnd - b.offset) / b.elementSize))
+			{
+				close();
+				throw std::runtime_error("snapshot block out of range: " + filename);
+			}
+		}
+	}
+}
+
+
+MappedSnapshot::~MappedSnapshot()
+{
+	close();
+}
+
+
+void MappedSnapshot::close()
+{
+	#ifdef _WIN32
+	if (m_data != nullptr) { UnmapViewOfFile(m_data); }
+	if (m_mapping != nullptr) { CloseHandle(m_mapping); }
+	if (m_file != nullptr) { CloseHandle(m_file); }
+	#else
+	if (m_data != nullptr) { munmap(const_cast<uint8_t*>(m_data), m_size); }
+	if (m_file != nullptr) { ::close(static_cast<int>(reinterpret_cast<intptr_t>(m_file))); }
+	#endif
+	m_data = nullptr;
+	m_mapping = nullptr;
+	m_file = nullptr;
+}
+
+
+const SnapshotSection* MappedSnapshot::findSection(SnapshotSectionKind kind, uint16_t typeId) const
+{
+	for (uint32_t s = 0; s < m_header->numSections; ++s) {
+		if (m_sections[s].kind == kind && m_sections[s].typeId == typeId) {
+			return &m_sections[s];
+		}
+	}
+	return nullptr;
+}
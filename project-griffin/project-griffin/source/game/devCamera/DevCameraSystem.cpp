@@ -21,7 +21,8 @@ void griffin::game::DevCameraSystem::updateFrameTick(Game& game, Engine& engine,
 	auto& scene = engine.sceneManager->getScene(game.sceneId);
 	auto& entityMgr = *scene.entityManager;
 
-	auto& move = entityMgr.getComponent<scene::MovementComponent>(movementComponentId);
+	// written through getMutable so the movement system picks up the change
+	auto& move = entityMgr.getMutable<scene::MovementComponent>(movementComponentId);
 	auto& node = entityMgr.getComponent<scene::SceneNode>(move.sceneNodeId);
 
 	// Mouse look
@@ -102,11 +103,11 @@ void griffin::game::DevCameraSystem::init(Game& game, const Engine& engine, cons
 
 	// set scene node location and orientation to the camera's
 	node.translationLocal = scene.cameras[cam.cameraId]->getEyePoint();
-	node.positionDirty = 1;
+	scene.sceneGraph->markDirty(node, true, false);
 	move.prevTranslation = move.nextTranslation = node.translationLocal;
 
 	node.rotationLocal = scene.cameras[cam.cameraId]->getOrientation();
-	node.orientationDirty = 1;
+	scene.sceneGraph->markDirty(node, false, true);
 	move.prevRotation = move.nextRotation = node.rotationLocal;
 
 	// get devcamera input mapping ids
@@ -33,7 +33,8 @@ void griffin::game::PlayerControlSystem::updateFrameTick(Game& game, Engine& eng
 	auto& scene = engine.sceneManager->getScene(game.sceneId);
 	auto& entityMgr = *scene.entityManager;
 
-	auto& move = entityMgr.getComponent<scene::MovementComponent>(movementComponentId);
+	// written through getMutable so the movement system picks up the change
+	auto& move = entityMgr.getMutable<scene::MovementComponent>(movementComponentId);
 	auto& node = entityMgr.getComponent<scene::SceneNode>(move.sceneNodeId);
 
 	// TODO: this all probably works for (0,1,0) (or (0,0,1)??) worldup vector, but worldup changes with position on planet, need to make this work everywhere
@@ -215,11 +216,11 @@ void griffin::game::PlayerControlSystem::init(Game& game, const Engine& engine,
 
 	// set scene node location and orientation to the camera's
 	node.translationLocal = scene.cameras[cam.cameraId]->getEyePoint();
-	node.positionDirty = 1;
+	scene.sceneGraph->markDirty(node, true, false);
 	move.prevTranslation = move.nextTranslation = node.translationLocal;
 
 	node.rotationLocal = scene.cameras[cam.cameraId]->getOrientation();
-	node.orientationDirty = 1;
+	scene.sceneGraph->markDirty(node, false, true);
 	move.prevRotation = move.nextRotation = node.rotationLocal;
 
 	// get playerfps input mapping ids
@@ -10,6 +10,7 @@
 namespace griffin {
 	namespace game {
 		using scene::SceneNodeId;
+		using scene::SceneNodeRef;
 		using entity::EntityId;
 		using entity::ComponentId;
 
@@ -18,7 +19,7 @@ namespace griffin {
 		* Causes shake on nearby ScreenShakeNodes
 		*/
 		COMPONENT(ScreenShakeProducer,
-			(SceneNodeId,	sceneNodeId,,		"center position of the shake producer"),
+			(SceneNodeRef,	sceneNodeId,,		"center position of the shake producer"),
 			(float,			startTurbulence,,	"starting strength of screen shake, 0=none, 0.25=light, 0.75=heavy, 1.0=severe"),
 			(float,			turbulence,,		"current turbulence level"),
 			(float,			totalTimeToLiveMS,,	"total time the shaker is active, turbulence goes from startTurbulence to 0 linearly over this time"),
@@ -31,7 +32,7 @@ namespace griffin {
 		* Pairs with a parent SceneNode and receives shake from nearby ScreenShakeProducers.
 		*/
 		COMPONENT(ScreenShakeNode,
-			(SceneNodeId,	sceneNodeId,,		"scene node for the camera instance to base shake angles on"),
+			(SceneNodeRef,	sceneNodeId,,		"scene node for the camera instance to base shake angles on"),
 			(float,			prevTurbulence,,	"previous effective turbulence used for interpolation"),
 			(float,			nextTurbulence,,	"next effective turbulence used for interpolation"),
 			(float,			prevNoiseTime,,		"previous time for perlin noise used for interpolation"),
@@ -134,7 +134,7 @@ void ScreenShakeSystem::renderFrameTick(
 		dvec3 angles(pitchAngle, yawAngle, rollAngle);
 		
 		shakeSceneNode.rotationLocal = dquat(angles);
-		shakeSceneNode.orientationDirty = 1;
+		scene.sceneGraph->markDirty(shakeSceneNode, false, true);
 	}
 }
 
@@ -195,17 +195,19 @@ ComponentId griffin::game::addScreenShakeNodeToCamera(
 	auto& camInst = entityMgr.getComponent<scene::CameraInstance>(cameraInstanceId);
 
 	// create a new scene node with a parent of the original camera node
-	auto shakeSceneNodeId = scene.sceneGraph->addToScene(entityId, {}, {}, camInst.sceneNodeId);
+	auto cameraNodeId = entityMgr.getComponentStore<scene::SceneNode>().toId(camInst.sceneNodeId);
+	auto shakeSceneNodeId = scene.sceneGraph->addToScene(entityId, {}, {}, cameraNodeId);
 
 	// add a shakenode component to control the new scene node
 	game::ScreenShakeNode shakeNode{};
-	shakeNode.sceneNodeId = shakeSceneNodeId;
+	shakeNode.sceneNodeId = scene::SceneNodeRef::fromId(shakeSceneNodeId);
 	
 	auto shakeNodeId = entityMgr.addComponentToEntity(std::move(shakeNode), entityId);
+	entityMgr.addTagToEntity(entity::Shakable_Tag, entityId);
 
 	// put the camera onto the new shakable scene node, the camera's movement component remains
 	// unchanged and still points to the original scene node
-	camInst.sceneNodeId = shakeSceneNodeId;
+	camInst.sceneNodeId = scene::SceneNodeRef::fromId(shakeSceneNodeId);
 
 	return shakeNodeId;
 }
\ No newline at end of file
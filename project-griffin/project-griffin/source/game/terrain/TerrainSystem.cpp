@@ -6,12 +6,14 @@
 #include <render/RenderTarget3D_GL.h>
 #include <render/ShaderProgram_GL.h>
 #include <render/texture/Texture2D_GL.h>
+#include <render/geometry/Intersection.h>
 #include <GL/glew.h>
 #include <glm/mat4x4.hpp>
 #include <glm/vec4.hpp>
 #include <glm/matrix.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <utility/debug.h>
+#include <utility/simd_transform.h>
 
 using namespace glm;
 
@@ -62,6 +64,38 @@ void griffin::game::TerrainSystem::renderFrameTick(Game& game, Engine& engine, f
 }
 
 
+/**
+* A chunk covering a whole cube face spans the spherical cap within angle a of the face normal n,
+* cos(a) = 1/sqrt(3) at the cube corners. Its sphere is centered at n * R * cos(a) with radius
+* (R + maxHeight) * sin(a) + maxHeight * cos(a), which holds the cap at every terrain height.
+*/
+void griffin::game::TerrainSystem::cullChunks(const dvec3& cameraPosition)
+{
+	const double cosCap = 1.0 / std::sqrt(3.0);
+	const double sinCap = std::sqrt(2.0 / 3.0);
+	const uint32_t numChunks = 6;
+
+	chunkBounds.resize(numChunks * 4);
+	double* x = chunkBounds.data();
+	double* y = x + numChunks;
+	double* z = y + numChunks;
+	double* r = z + numChunks;
+
+	for (uint32_t c = 0; c < numChunks; ++c) {
+		dvec3 center(chunks[c].geocentricCenterCoord * (planetRadius * cosCap));
+		x[c] = center.x;
+		y[c] = center.y;
+		z[c] = center.z;
+		r[c] = (planetRadius + maxTerrainHeight) * sinCap + maxTerrainHeight * cosCap;
+	}
+
+	// the planet is centered on the world origin
+	numVisibleChunks = geometry::CullHorizonSphereList(x, y, z, r, numChunks, cameraPosition, dvec3(0.0),
+													   planetRadius + glm::min(minTerrainHeight, 0.0),
+													   visibleChunks);
+}
+
+
 void griffin::game::TerrainSystem::render(Id_T entityId, scene::Scene& scene, uint8_t viewport, Engine& engine)
 {
 }
@@ -76,7 +110,11 @@ void griffin::game::TerrainSystem::draw(Engine &engine, const dmat4& viewMat, co
 	auto& program = terrainProgram.get()->getResource<render::ShaderProgram_GL>();
 	program.useProgram();
 
-	for (int c = 0; c < 6; ++c) { // for each chunk
+	dvec3 cameraPosition(inverse(viewMat)[3]);
+	cullChunks(cameraPosition);
+
+	for (uint32_t v = 0; v < numVisibleChunks; ++v) { // for each chunk not beyond the horizon
+		uint32_t c = visibleChunks[v];
 		dmat4 modelToWorld;
 		dmat4 patchToModel;
 
@@ -110,15 +148,11 @@ void griffin::game::TerrainSystem::draw(Engine &engine, const dmat4& viewMat, co
 								  dvec3{ 0.0, 1.0, 0.0 });
 		}
 		
-		dmat4 modelView_World(viewMat * modelToWorld);
-
 		//dvec4 nodeTranslationWorld(modelToWorld[0][3], modelToWorld[1][3], modelToWorld[2][3], 1.0);
 		//vec3 nodeTranslation_Camera(nodeTranslationWorld * modelView_World);
 
-		mat4 modelView_Camera(modelView_World);
-		modelView_Camera[0][3] = 0; //nodeTranslation_Camera.x;
-		modelView_Camera[1][3] = 0; //nodeTranslation_Camera.y;
-		modelView_Camera[2][3] = 0; //nodeTranslation_Camera.z;
+		mat4 modelView_Camera;
+		simd::toCameraRelativeMat4(viewMat, modelToWorld, modelView_Camera);
 
 		mat4 mvp(projMat * modelView_Camera);
 		mat4 normalMat(transpose(inverse(mat3(modelView_Camera))));
@@ -239,7 +273,7 @@ void griffin::game::TerrainSystem::init(Game& game, const Engine& engine, const
 
 	// terrain chunks
 
-	const double radius = 5000.0;
+	const double radius = planetRadius;
 	chunks[0] = { {  1.0,  1.0,  1.0 }, {  0.0,  0.0,  1.0 }, radius*2, 0, 0, tempNoiseTex }; // top
 	chunks[1] = { { -1.0, -1.0, -1.0 }, {  0.0,  0.0, -1.0 }, radius*2, 0, 0, tempNoiseTex }; // bottom
 
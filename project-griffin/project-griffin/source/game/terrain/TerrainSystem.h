@@ -11,6 +11,7 @@
 
 #include <glm/mat4x4.hpp> // TEMP
 #include <glm/vec3.hpp>
+#include <vector>
 
 namespace griffin {
 	using resource::ResourcePtr;
@@ -59,6 +60,15 @@ namespace griffin {
 
 			TerrainChunk chunks[6];
 
+			double		planetRadius = 5000.0;
+			double		minTerrainHeight = 0.0;		//<! lowest terrain relative to planetRadius, 0 or less
+			double		maxTerrainHeight = 0.0;		//<! highest terrain relative to planetRadius
+
+			uint32_t	numVisibleChunks = 0;
+			uint32_t	visibleChunks[6] = {};		//<! chunks left by cullChunks, drawn in this order
+
+			std::vector<double>	chunkBounds;		//<! cullChunks scratch, x, y, z and r arrays back to back
+
 
 			// Public Functions
 
@@ -67,6 +77,12 @@ namespace griffin {
 			void renderFrameTick(Game& game, Engine& engine, float interpolation,
 								 const int64_t realTime, const int64_t countsPassed);
 
+			/**
+			* Fills visibleChunks with the chunks not hidden behind the planet's horizon from the
+			* camera position, tested as a batch of bounding spheres
+			*/
+			void cullChunks(const glm::dvec3& cameraPosition);
+
 			void render(Id_T entityId, scene::Scene& scene, uint8_t viewport, Engine& engine);
 			void draw(Engine &engine, const glm::dmat4& viewMat, const glm::mat4& projMat/*All TEMP*/);
 
@@ -4,3 +4,82 @@ ffi.cdef[[
 #include "source/api/SceneApi.h"
 ]]
 local C = ffi.C
+
+-- Data component bulk access
+
+local dataComponentLayouts = {}
+local storeView = ffi.new("griffin_DataComponentStoreView")
+
+--[[
+Defines a script data component struct from a list of { type, name } fields, creates its store in
+the scene, and returns the layout. The layout doubles as reflection metadata, listing the type,
+name and byte offset of each field. Defining a typeId again, e.g. for another scene, must repeat
+the same struct and fields, and reuses the scene's store if it already has one of the same size.
+Conflicting definitions raise an error.
+]]
+function defineDataComponent(scene, typeId, structName, fields, reserve)
+	local layout = dataComponentLayouts[typeId]
+	if (layout == nil) then
+		local decl = { "typedef struct {" }
+		for _,f in ipairs(fields) do
+			decl[#decl+1] = f[1] .. " " .. f[2] .. ";"
+		end
+		decl[#decl+1] = "} " .. structName .. ";"
+		ffi.cdef(table.concat(decl, "\n"))
+
+		layout = {
+			name = structName,
+			size = ffi.sizeof(structName),
+			ptrType = ffi.typeof(structName .. "*"),
+			fields = {}
+		}
+		for i,f in ipairs(fields) do
+			layout.fields[i] = { type = f[1], name = f[2], offset = ffi.offsetof(structName, f[2]) }
+		end
+		dataComponentLayouts[typeId] = layout
+	else
+		local same = (layout.name == structName and #layout.fields == #fields)
+		for i,f in ipairs(fields) do
+			same = same and (layout.fields[i].type == f[1] and layout.fields[i].name == f[2])
+		end
+		if (not same) then
+			error("data component typeId " .. typeId .. " is already defined as " .. layout.name, 2)
+		end
+	end
+
+	-- stores are per scene, one may exist from a snapshot or an earlier call
+	if (C.griffin_scene_getDataComponentStoreView(scene, typeId, storeView)) then
+		if (storeView.componentSize ~= math.ceil(layout.size / 8) * 8) then
+			error("data component typeId " .. typeId .. " has a store of " .. storeView.componentSize ..
+				  " bytes, " .. structName .. " needs " .. layout.size, 2)
+		end
+	elseif (C.griffin_scene_createDataComponentStore(scene, typeId, layout.size, reserve or 0) == 0) then
+		error("could not create the store for data component " .. structName, 2)
+	end
+	return layout
+end
+
+--[[
+Calls func(component, entityId) for every data component of typeId in the scene, where component
+is a pointer to the struct given to defineDataComponent. The whole store is fetched with a single
+call, so don't add or remove components of this type from inside func.
+@return number of components visited
+]]
+function forEachDataComponent(scene, typeId, func)
+	local layout = dataComponentLayouts[typeId]
+	if (layout == nil or not C.griffin_scene_getDataComponentStoreView(scene, typeId, storeView)) then
+		return 0
+	end
+
+	local components = ffi.cast("uint8_t*", storeView.components)
+	local entityIds = ffi.cast("uint8_t*", storeView.entityIds)
+	local stride = storeView.stride
+	local count = storeView.count
+
+	for i = 0, count-1 do
+		local offset = i * stride
+		func(ffi.cast(layout.ptrType, components + offset),
+			 ffi.cast("uint64_t*", entityIds + offset)[0])
+	end
+	return count
+end
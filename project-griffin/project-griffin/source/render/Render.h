@@ -337,6 +337,7 @@ namespace griffin {
 		*	- update on fixed timesteps
 		*		- scene graph transforms updated, with dirty flag optimization
 		*		- when new scene info is ready, queue an event to tell render thread to swap states
+		*		  (implemented by RenderSnapshotBuffer for scenes with useRenderSnapshots set)
 		*/
 		class RenderSystem {
 		public:
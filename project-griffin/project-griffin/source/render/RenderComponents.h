@@ -25,6 +25,16 @@ namespace griffin {
 			float	nextAnimationWeight;	//<! next blend factor from 0 to 1, 0 for disabled, 1 for fully enabled
 		};
 
+		/**
+		* Index of the first position, rotation and scaling key after the last sampled time, one
+		* per animation track, see findNextKeyframe
+		*/
+		struct KeyframeCursor {
+			uint16_t	position;
+			uint16_t	rotation;
+			uint16_t	scaling;
+		};
+
 		/**
 		* Tracks time and blend factor of all animation tracks for a mesh instance. The prev/next
 		* values are interpolated for rendering.
@@ -55,7 +65,8 @@ namespace griffin {
 			(glm::vec3,		nextScalingLocal,,		"next interpolated and blended scaling relative to parent"),
 			(glm::vec3,		defaultTranslation,,	"default node translation"),
 			(glm::quat,		defaultRotation,,		"default node rotation"),
-			(glm::vec3,		defaultScaling,,		"default node scaling")
+			(glm::vec3,		defaultScaling,,		"default node scaling"),
+			(KeyframeCursor, keyCursors,[MAX_MESH_ANIMATION_TRACKS], "per track keys found by the last sample, the next sample searches from here")
 		)
 
 		/**
@@ -32,12 +32,136 @@ namespace griffin {
 		// Frustum-Sphere
 		IntersectionResult intersect(const Plane* frustumPlanes, Sphere& s);
 
+		/**
+		* Tests a list of spheres in SoA layout against up to 32 frustums in one pass over the
+		* list. A sphere is visible in a frustum unless it's entirely behind one of its planes,
+		* plane normals face inward. Arrays must be padded to a multiple of 4 spheres.
+		* @param visibleBits	receives one mask per sphere with bit i set if visible in frustums[i]
+		*/
+		void CullSphereListMulti_SSE(const float* x, const float* y, const float* z, const float* r, unsigned int numSpheres,
+									 const Frustum* frustums, unsigned int numFrustums, uint32_t* visibleBits);
+
+		/**
+		* One byte per sphere and frustum remembered between frames by the coherent culling
+		*/
+		enum CoherentCullFlags : uint8_t {
+			CoherentCull_PlaneMask	= 0x07,	//<! plane that last rejected the sphere
+			CoherentCull_NoPlane	= 0x07,	//<! not rejected last time, also the initial state
+			CoherentCull_Inside		= 0x08	//<! inside every plane by at least the margin
+		};
+
+		/**
+		* Frame coherent version of CullSphereListMulti_SSE giving the same visibleBits. A sphere
+		* rejected last time is first tested against the plane that rejected it. A sphere found
+		* inside by at least moveMargin + turnMargin * (distance to the frustum's eye) is not
+		* tested again in frustums whose bit is set in stillFrustumMask, the caller clears the
+		* bit of a frustum that moved or turned more than the margins allow, and clears
+		* CoherentCull_Inside for spheres that moved.
+		* @param eyes		x,y,z of each frustum's eye in the space of the spheres
+		* @param cache		numSpheres * numFrustums bytes, sphere major, start at CoherentCull_NoPlane
+		* @returns number of plane tests done
+		*/
+		unsigned int CullSphereListMultiCoherent(const float* x, const float* y, const float* z, const float* r, unsigned int numSpheres,
+												 const Frustum* frustums, const float* eyes, unsigned int numFrustums,
+												 uint32_t stillFrustumMask, float moveMargin, float turnMargin,
+												 uint8_t* cache, uint32_t* visibleBits);
+
 		// Frustum-AABB
+
+		/**
+		* AoS versions writing an IntersectionResult per box. Planes must be 16 byte aligned, and
+		* for the 4-wide version the list too.
+		*/
 		void CullAABBList_SSE_1(AABB* aabbList, unsigned int numAABBs, Plane* frustumPlanes, unsigned int* result);
 		void CullAABBList_SSE_4(AABB* aabbList, unsigned int numAABBs, Plane* frustumPlanes, unsigned int* result);
 
+
+		// Frustum-Sphere and Frustum-AABB lists in SoA layout
+
+		enum CullKernel : uint8_t {
+			CullKernel_SSE = 0,	//<! 4 wide
+			CullKernel_AVX2,	//<! 8 wide
+			CullKernel_AVX512	//<! 16 wide
+		};
+
+		/**
+		* @returns the kernel used by CullSphereList and CullAABBList, defaults to the widest one
+		*	the cpu supports
+		*/
+		CullKernel getCullKernel();
+
+		/**
+		* Forces a kernel, useful for testing and benchmarks. Requests for a set the cpu does not
+		* support are lowered to the widest one it does.
+		*/
+		void setCullKernel(CullKernel kernel);
+
+		/**
+		* Writes the indices of the spheres not entirely behind any frustum plane, in increasing
+		* order. Plane normals face inward. Every kernel width gives the same result, the list
+		* needs no padding. visibleIndices must have room for numSpheres entries since kernels
+		* write past the count they return.
+		* @returns number of visible spheres
+		*/
+		unsigned int CullSphereList(const float* x, const float* y, const float* z, const float* r, unsigned int numSpheres,
+									const Frustum& frustum, uint32_t* visibleIndices);
+
+		/**
+		* Same as CullSphereList for boxes given by center and half extents
+		*/
+		unsigned int CullAABBList(const float* cx, const float* cy, const float* cz,
+								  const float* ex, const float* ey, const float* ez, unsigned int numAABBs,
+								  const Frustum& frustum, uint32_t* visibleIndices);
+
+		// Kernels behind CullSphereList and CullAABBList, call directly only if the cpu supports them
+		unsigned int CullSphereList_SSE(const float* x, const float* y, const float* z, const float* r, unsigned int numSpheres,
+										const Frustum& frustum, uint32_t* visibleIndices);
+		unsigned int CullSphereList_AVX2(const float* x, const float* y, const float* z, const float* r, unsigned int numSpheres,
+										 const Frustum& frustum, uint32_t* visibleIndices);
+		unsigned int CullSphereList_AVX512(const float* x, const float* y, const float* z, const float* r, unsigned int numSpheres,
+										   const Frustum& frustum, uint32_t* visibleIndices);
+		unsigned int CullAABBList_SSE(const float* cx, const float* cy, const float* cz,
+									  const float* ex, const float* ey, const float* ez, unsigned int numAABBs,
+									  const Frustum& frustum, uint32_t* visibleIndices);
+		unsigned int CullAABBList_AVX2(const float* cx, const float* cy, const float* cz,
+									   const float* ex, const float* ey, const float* ez, unsigned int numAABBs,
+									   const Frustum& frustum, uint32_t* visibleIndices);
+		unsigned int CullAABBList_AVX512(const float* cx, const float* cy, const float* cz,
+										 const float* ex, const float* ey, const float* ez, unsigned int numAABBs,
+										 const Frustum& frustum, uint32_t* visibleIndices);
+
 		// Point-Sphere
+
+		/**
+		* @returns true if p is past the plane of the horizon circle of a sphere seen from camera
+		* @param offset		squared radius of the sphere
+		*/
 		bool beyondHorizon(const glm::dvec3& p, const glm::dvec3& camera, const glm::dvec3 &center, double offset = 1.0);
+
+		/**
+		* Horizon culling of a list of spheres in double precision SoA layout. The planet is stood
+		* in for by a sphere inside its surface, a sphere is hidden when it's entirely inside the
+		* cone from camera tangent to the occluder and past its horizon plane. Writes the indices
+		* of the spheres not hidden in increasing order, with the same kernel selection and output
+		* rules as CullSphereList. Nothing is hidden while the camera is inside the occluder.
+		* @returns number of spheres not hidden
+		*/
+		unsigned int CullHorizonSphereList(const double* x, const double* y, const double* z, const double* r, unsigned int numSpheres,
+										   const glm::dvec3& camera, const glm::dvec3& center, double occluderRadius,
+										   uint32_t* visibleIndices);
+
+		/**
+		* 2, 4 and 8 wide kernels behind CullHorizonSphereList
+		*/
+		unsigned int CullHorizonSphereList_SSE(const double* x, const double* y, const double* z, const double* r, unsigned int numSpheres,
+											   const glm::dvec3& camera, const glm::dvec3& center, double occluderRadius,
+											   uint32_t* visibleIndices);
+		unsigned int CullHorizonSphereList_AVX2(const double* x, const double* y, const double* z, const double* r, unsigned int numSpheres,
+												const glm::dvec3& camera, const glm::dvec3& center, double occluderRadius,
+												uint32_t* visibleIndices);
+		unsigned int CullHorizonSphereList_AVX512(const double* x, const double* y, const double* z, const double* r, unsigned int numSpheres,
+												  const glm::dvec3& camera, const glm::dvec3& center, double occluderRadius,
+												  uint32_t* visibleIndices);
 	}
 }
 
@@ -0,0 +1,130 @@
+/**
+* @file OcclusionBuffer.h
+* @author Jeff Kiah
+*/
+#pragma once
+#ifndef GRIFFIN_GEOMETRY_OCCLUSIONBUFFER_H_
+#define GRIFFIN_GEOMETRY_OCCLUSIONBUFFER_H_
+
+#include <cstdint>
+#include <vector>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+/**
+* The buffer is split into tiles rasterized independently, one thread per tile at a time. Hi-Z
+* blocks never straddle tiles so each tile builds its own part of the hierarchy. Buffer sizes
+* must be multiples of the tile size.
+*/
+#define OCCLUSION_BUFFER_DEFAULT_WIDTH	256
+#define OCCLUSION_BUFFER_DEFAULT_HEIGHT	128
+#define OCCLUSION_TILE_WIDTH			64
+#define OCCLUSION_TILE_HEIGHT			32
+#define OCCLUSION_HIZ_BLOCK_SIZE		8		//<! width and height in pixels of one hi-z entry
+
+
+namespace griffin {
+	namespace geometry {
+
+		/**
+		* @class OcclusionBuffer
+		* A small CPU depth buffer for software occlusion culling. Occluder triangles are
+		* rasterized with SSE, keeping the nearest NDC depth per pixel, then a hierarchical-Z
+		* keeping the farthest depth of each block is built from it. Objects are tested by the
+		* screen rectangle and nearest depth of their bounds against the hi-z, so the test is
+		* conservative, an object is only reported hidden when every block it touches is
+		* covered by nearer occluders.
+		*
+		* The buffer follows GL conventions, clip space z is in [-w,w] and the depth buffer is
+		* cleared to 1. Row 0 is the bottom of the screen. Nothing here touches the GPU, so it
+		* can be tested headlessly by comparing getDepth to a reference image.
+		*/
+		class OcclusionBuffer {
+		public:
+			explicit OcclusionBuffer(uint32_t width = OCCLUSION_BUFFER_DEFAULT_WIDTH,
+									 uint32_t height = OCCLUSION_BUFFER_DEFAULT_HEIGHT);
+
+			/**
+			* Resets depth to the far plane and drops any queued occluders
+			*/
+			void clear();
+
+			/**
+			* Transforms an indexed triangle list to clip space, clips it against the near plane
+			* and queues the triangles for rasterize. Both windings are rasterized.
+			*/
+			void addOccluder(const glm::vec3* vertices, uint32_t numVertices,
+							 const uint32_t* indices, uint32_t numIndices,
+							 const glm::mat4& modelViewProj);
+
+			/**
+			* Rasterizes all queued occluders and rebuilds the hi-z. Tiles are spread over the
+			* worker threads when the thread pool has more than one, the result is the same
+			* either way.
+			*/
+			void rasterize();
+
+			/**
+			* @returns false if a box given in the input space of viewProj is hidden behind the
+			*	rasterized occluders or covers no pixels. Boxes crossing the near plane are
+			*	always visible.
+			*/
+			bool isBoxVisible(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::mat4& viewProj) const;
+
+			/**
+			* Tests the box bounding the sphere
+			*/
+			bool isSphereVisible(const glm::vec3& center, float radius, const glm::mat4& viewProj) const;
+
+			/**
+			* @returns false if the NDC rectangle is hidden at depth ndcMinZ or covers no pixels
+			*/
+			bool isRectVisible(float ndcMinX, float ndcMinY, float ndcMaxX, float ndcMaxY, float ndcMinZ) const;
+
+			uint32_t getWidth() const { return m_width; }
+			uint32_t getHeight() const { return m_height; }
+
+			/**
+			* @returns row-major NDC depth of each pixel, row 0 at the bottom
+			*/
+			const float* getDepth() const { return m_depth.data(); }
+
+			/**
+			* @returns row-major farthest depth of each OCCLUSION_HIZ_BLOCK_SIZE square block
+			*/
+			const float* getHiZ() const { return m_hiZ.data(); }
+
+		private:
+			/**
+			* Screen space triangle ready for rasterizing, edge functions are A*x + B*y + C with the
+			* inside positive, depth is interpolated linearly in screen space
+			*/
+			struct Triangle {
+				float	edgeA[3];
+				float	edgeB[3];
+				float	edgeC[3];
+				float	depthA, depthB, depthC;
+				int32_t	minX, minY, maxX, maxY;		//<! pixel bounds, inclusive
+			};
+
+			void addClippedTriangle(const float* v0, const float* v1, const float* v2);
+			void setupTriangle(const float* v0, const float* v1, const float* v2);
+			void rasterizeTile(uint32_t tile);
+
+			uint32_t	m_width;
+			uint32_t	m_height;
+			uint32_t	m_tilesX;
+			uint32_t	m_tilesY;
+			uint32_t	m_hiZWidth;
+
+			std::vector<float>		m_depth;
+			std::vector<float>		m_hiZ;
+			std::vector<Triangle>	m_triangles;
+			std::vector<std::vector<uint32_t>> m_tileBins;	//<! per tile, indices of triangles overlapping it
+			std::vector<float>		m_clipVertices;			//<! addOccluder scratch, x,y,z,w per vertex
+		};
+
+	}
+}
+
+#endif
\ No newline at end of file
@@ -45,10 +45,10 @@ void Frustum::extractFromMatrixGL(float matrix[16], bool normalize)
 	nz[Near]   = m._43 + m._33;
 	d[Near]    = m._44 + m._34;
 
-	nx[Far]    = m._41 + m._31;
-	ny[Far]    = m._42 + m._32;
-	nz[Far]    = m._43 + m._33;
-	d[Far]     = m._44 + m._34;
+	nx[Far]    = m._41 - m._31;
+	ny[Far]    = m._42 - m._32;
+	nz[Far]    = m._43 - m._33;
+	d[Far]     = m._44 - m._34;
 
 	nx[Left]   = m._41 + m._11;
 	ny[Left]   = m._42 + m._12;
@@ -1,6 +1,13 @@
 #include "../Intersection.h"
 //#include <glm/gtx/intersect.hpp>
+#include <utility/cpu_features.h>
 #include <xmmintrin.h>
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
 #include <glm/geometric.hpp>
 
 
@@ -10,33 +17,31 @@ using namespace griffin::geometry;
 
 __declspec(align(16)) static const unsigned int absPlaneMask[4] = { 0x7FFFFFFF, 0x7FFFFFFF, 0x7FFFFFFF, 0xFFFFFFFF };
 
+static CullKernel s_cullKernel = (getCpuFeatures().avx512 ? CullKernel_AVX512 :
+								  (getCpuFeatures().avx2 ? CullKernel_AVX2 : CullKernel_SSE));
+
 
 // Frustum-Sphere
 
 IntersectionResult griffin::geometry::intersect(const Plane* frustumPlanes, Sphere& s)
 {
-	enum : uint8_t { IntersectingBits=1, FullInsideBits=3 };
 	float px = s.x;
 	float py = s.y;
 	float pz = s.z;
 	float radius = s.r;
-	uint8_t result = FullInsideBits;
+	IntersectionResult result = Inside;
 
+	// plane normals face into the frustum, same as the SSE functions and Frustum::extractFromMatrixGL
 	for (int p = 0; p < 6; ++p) {
 		float dist = frustumPlanes[p].distanceToPoint(px, py, pz);
 		if (dist < -radius) {
-			result &= FullInsideBits;
-		}
-		else if (dist <= radius) {
-			result &= IntersectingBits;
-		}
-		else {
 			return Outside;
 		}
+		else if (dist < radius) {
+			result = Intersect;
+		}
 	}
-	// TODO: this is aweful, can we just settle on a single return enum?
-	// need to look at the SSE collision detection function to see why 0,1,2 is used there
-	return (result == IntersectingBits ? Intersect : Inside);
+	return result;
 }
 
 
@@ -95,7 +100,7 @@ uint8_t intersect(Frustum& f, float p[3])
 /**
 * @see http://www.gamedev.net/page/resources/_/technical/general-programming/useless-snippet-2-aabbfrustum-test-r3342
 */
-void CullAABBList_SSE_1(AABB* aabbList, unsigned int numAABBs, Plane* frustumPlanes, unsigned int* result)
+void griffin::geometry::CullAABBList_SSE_1(AABB* aabbList, unsigned int numAABBs, Plane* frustumPlanes, unsigned int* result)
 {
 	__declspec(align(16)) Plane absFrustumPlanes[6];
 
@@ -157,7 +162,7 @@ void CullAABBList_SSE_1(AABB* aabbList, unsigned int numAABBs, Plane* frustumPla
 }
 
 
-void CullAABBList_SSE_4(AABB* aabbList, unsigned int numAABBs, Plane* frustumPlanes, unsigned int* result)
+void griffin::geometry::CullAABBList_SSE_4(AABB* aabbList, unsigned int numAABBs, Plane* frustumPlanes, unsigned int* result)
 {
 	__declspec(align(16)) Plane absFrustumPlanes[6];
 	__m128 xmm_absPlaneMask = _mm_load_ps((float*)&absPlaneMask[0]);
@@ -309,17 +314,711 @@ void CullAABBList_SSE_4(AABB* aabbList, unsigned int numAABBs, Plane* frustumPla
 }
 
 
+// Frustum-Sphere, many frustums
+
+void griffin::geometry::CullSphereListMulti_SSE(
+	const float* x, const float* y, const float* z, const float* r, unsigned int numSpheres,
+	const Frustum* frustums, unsigned int numFrustums, uint32_t* visibleBits)
+{
+	assert(numFrustums <= 32 && "frustum results are a 32 bit mask");
+	assert((numSpheres & 3) == 0 && "sphere lists must be padded to a multiple of 4");
+
+	const __m128 xmm_allOnes = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+	// each group of 4 spheres is loaded once and tested against every frustum while in registers
+	for (unsigned int iSphere = 0; iSphere < numSpheres; iSphere += 4) {
+		__m128 xmm_x = _mm_loadu_ps(x + iSphere);
+		__m128 xmm_y = _mm_loadu_ps(y + iSphere);
+		__m128 xmm_z = _mm_loadu_ps(z + iSphere);
+		__m128 xmm_negR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(r + iSphere));
+		__m128i xmm_bits = _mm_setzero_si128();
+
+		for (unsigned int iFrustum = 0; iFrustum < numFrustums; ++iFrustum) {
+			const Frustum& f = frustums[iFrustum];
+			__m128 xmm_visible = xmm_allOnes;
+
+			for (int p = 0; p < 6; ++p) {
+				__m128 xmm_d = _mm_mul_ps(xmm_x, _mm_set1_ps(f.nx[p]));
+				xmm_d = _mm_add_ps(xmm_d, _mm_mul_ps(xmm_y, _mm_set1_ps(f.ny[p])));
+				xmm_d = _mm_add_ps(xmm_d, _mm_mul_ps(xmm_z, _mm_set1_ps(f.nz[p])));
+				xmm_d = _mm_add_ps(xmm_d, _mm_set1_ps(f.d[p]));
+
+				// a sphere is culled when it's entirely behind one plane
+				xmm_visible = _mm_and_ps(xmm_visible, _mm_cmpge_ps(xmm_d, xmm_negR));
+				if (_mm_movemask_ps(xmm_visible) == 0) {
+					break;
+				}
+			}
+
+			__m128i xmm_frustumBit = _mm_set1_epi32(static_cast<int>(1U << iFrustum));
+			xmm_bits = _mm_or_si128(xmm_bits, _mm_and_si128(_mm_castps_si128(xmm_visible), xmm_frustumBit));
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(visibleBits + iSphere), xmm_bits);
+	}
+}
+
+
+unsigned int griffin::geometry::CullSphereListMultiCoherent(
+	const float* x, const float* y, const float* z, const float* r, unsigned int numSpheres,
+	const Frustum* frustums, const float* eyes, unsigned int numFrustums,
+	uint32_t stillFrustumMask, float moveMargin, float turnMargin,
+	uint8_t* cache, uint32_t* visibleBits)
+{
+	assert(numFrustums <= 32 && "frustum results are a 32 bit mask");
+
+	unsigned int planeTests = 0;
+
+	for (unsigned int i = 0; i < numSpheres; ++i) {
+		uint8_t* sphereCache = cache + i * numFrustums;
+		uint32_t bits = 0;
+
+		for (unsigned int iFrustum = 0; iFrustum < numFrustums; ++iFrustum) {
+			uint8_t& entry = sphereCache[iFrustum];
+			uint32_t frustumBit = 1U << iFrustum;
+
+			if ((entry & CoherentCull_Inside) && (stillFrustumMask & frustumBit)) {
+				bits |= frustumBit;
+				continue;
+			}
+
+			const Frustum& f = frustums[iFrustum];
+			float minSlack = FLT_MAX;
+
+			// most spheres rejected last frame are rejected by the same plane again
+			unsigned int lastPlane = entry & CoherentCull_PlaneMask;
+			if (lastPlane != CoherentCull_NoPlane) {
+				++planeTests;
+				float d = x[i] * f.nx[lastPlane] + y[i] * f.ny[lastPlane] + z[i] * f.nz[lastPlane] + f.d[lastPlane];
+				if (!(d >= -r[i])) {
+					entry = static_cast<uint8_t>(lastPlane);
+					continue;
+				}
+				minSlack = d - r[i];
+			}
+
+			unsigned int rejectPlane = CoherentCull_NoPlane;
+			for (unsigned int p = 0; p < 6; ++p) {
+				if (p == lastPlane) {
+					continue;
+				}
+				++planeTests;
+				float d = x[i] * f.nx[p] + y[i] * f.ny[p] + z[i] * f.nz[p] + f.d[p];
+				if (!(d >= -r[i])) {
+					rejectPlane = p;
+					break;
+				}
+				minSlack = std::min(minSlack, d - r[i]);
+			}
+
+			if (rejectPlane != CoherentCull_NoPlane) {
+				entry = static_cast<uint8_t>(rejectPlane);
+				continue;
+			}
+
+			// turning moves planes farther the farther the sphere is from the eye
+			float ex = x[i] - eyes[iFrustum * 3];
+			float ey = y[i] - eyes[iFrustum * 3 + 1];
+			float ez = z[i] - eyes[iFrustum * 3 + 2];
+			float margin = moveMargin + turnMargin * std::sqrt(ex * ex + ey * ey + ez * ez);
+
+			entry = static_cast<uint8_t>(CoherentCull_NoPlane | (minSlack >= margin ? CoherentCull_Inside : 0));
+			bits |= frustumBit;
+		}
+
+		visibleBits[i] = bits;
+	}
+
+	return planeTests;
+}
+
+
+// Frustum-Sphere and Frustum-AABB lists, SoA
+
+/**
+* Scalar tests for the list remainders, same operation order as the SIMD kernels so every width
+* gives the same answer
+*/
+static inline bool sphereVisible(const Frustum& f, float x, float y, float z, float r)
+{
+	for (int p = 0; p < 6; ++p) {
+		float d = x * f.nx[p] + y * f.ny[p] + z * f.nz[p] + f.d[p];
+		if (!(d >= -r)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static inline bool aabbVisible(const Frustum& f, float cx, float cy, float cz, float ex, float ey, float ez)
+{
+	for (int p = 0; p < 6; ++p) {
+		float d = cx * f.nx[p] + cy * f.ny[p] + cz * f.nz[p];
+		float r = ex * std::abs(f.nx[p]) + ey * std::abs(f.ny[p]) + ez * std::abs(f.nz[p]);
+		if (!(d + r + f.d[p] >= 0.0f)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+* Appends the indices of set mask bits without branching, writes up to width entries past the
+* returned count
+*/
+static inline unsigned int compactIndices(uint32_t mask, unsigned int width, uint32_t baseIndex,
+										  uint32_t* visibleIndices, unsigned int numVisible)
+{
+	for (unsigned int lane = 0; lane < width; ++lane) {
+		visibleIndices[numVisible] = baseIndex + lane;
+		numVisible += (mask >> lane) & 1;
+	}
+	return numVisible;
+}
+
+static inline unsigned int popCount16(uint32_t mask)
+{
+	mask = mask - ((mask >> 1) & 0x5555);
+	mask = (mask & 0x3333) + ((mask >> 2) & 0x3333);
+	mask = (mask + (mask >> 4)) & 0x0F0F;
+	return (mask + (mask >> 8)) & 0x1F;
+}
+
+
+unsigned int griffin::geometry::CullSphereList_SSE(
+	const float* x, const float* y, const float* z, const float* r, unsigned int numSpheres,
+	const Frustum& frustum, uint32_t* visibleIndices)
+{
+	unsigned int numVisible = 0;
+	unsigned int numSimd = numSpheres & ~3U;
+
+	for (unsigned int i = 0; i < numSimd; i += 4) {
+		__m128 xmm_x = _mm_loadu_ps(x + i);
+		__m128 xmm_y = _mm_loadu_ps(y + i);
+		__m128 xmm_z = _mm_loadu_ps(z + i);
+		__m128 xmm_negR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(r + i));
+		int visible = 0x0F;
+
+		for (int p = 0; p < 6 && visible != 0; ++p) {
+			__m128 xmm_d = _mm_mul_ps(xmm_x, _mm_set1_ps(frustum.nx[p]));
+			xmm_d = _mm_add_ps(xmm_d, _mm_mul_ps(xmm_y, _mm_set1_ps(frustum.ny[p])));
+			xmm_d = _mm_add_ps(xmm_d, _mm_mul_ps(xmm_z, _mm_set1_ps(frustum.nz[p])));
+			xmm_d = _mm_add_ps(xmm_d, _mm_set1_ps(frustum.d[p]));
+			visible &= _mm_movemask_ps(_mm_cmpge_ps(xmm_d, xmm_negR));
+		}
+
+		numVisible = compactIndices(visible, 4, i, visibleIndices, numVisible);
+	}
+
+	for (unsigned int i = numSimd; i < numSpheres; ++i) {
+		visibleIndices[numVisible] = i;
+		numVisible += sphereVisible(frustum, x[i], y[i], z[i], r[i]) ? 1 : 0;
+	}
+	return numVisible;
+}
+
+
+GRIFFIN_TARGET_AVX2
+unsigned int griffin::geometry::CullSphereList_AVX2(
+	const float* x, const float* y, const float* z, const float* r, unsigned int numSpheres,
+	const Frustum& frustum, uint32_t* visibleIndices)
+{
+	unsigned int numVisible = 0;
+	unsigned int numSimd = numSpheres & ~7U;
+
+	for (unsigned int i = 0; i < numSimd; i += 8) {
+		__m256 ymm_x = _mm256_loadu_ps(x + i);
+		__m256 ymm_y = _mm256_loadu_ps(y + i);
+		__m256 ymm_z = _mm256_loadu_ps(z + i);
+		__m256 ymm_negR = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(r + i));
+		int visible = 0xFF;
+
+		for (int p = 0; p < 6 && visible != 0; ++p) {
+			__m256 ymm_d = _mm256_mul_ps(ymm_x, _mm256_set1_ps(frustum.nx[p]));
+			ymm_d = _mm256_add_ps(ymm_d, _mm256_mul_ps(ymm_y, _mm256_set1_ps(frustum.ny[p])));
+			ymm_d = _mm256_add_ps(ymm_d, _mm256_mul_ps(ymm_z, _mm256_set1_ps(frustum.nz[p])));
+			ymm_d = _mm256_add_ps(ymm_d, _mm256_set1_ps(frustum.d[p]));
+			visible &= _mm256_movemask_ps(_mm256_cmp_ps(ymm_d, ymm_negR, _CMP_GE_OQ));
+		}
+
+		numVisible = compactIndices(visible, 8, i, visibleIndices, numVisible);
+	}
+	_mm256_zeroupper();
+
+	for (unsigned int i = numSimd; i < numSpheres; ++i) {
+		visibleIndices[numVisible] = i;
+		numVisible += sphereVisible(frustum, x[i], y[i], z[i], r[i]) ? 1 : 0;
+	}
+	return numVisible;
+}
+
+
+GRIFFIN_TARGET_AVX512
+unsigned int griffin::geometry::CullSphereList_AVX512(
+	const float* x, const float* y, const float* z, const float* r, unsigned int numSpheres,
+	const Frustum& frustum, uint32_t* visibleIndices)
+{
+	unsigned int numVisible = 0;
+	unsigned int numSimd = numSpheres & ~15U;
+	const __m512i zmm_lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+	for (unsigned int i = 0; i < numSimd; i += 16) {
+		__m512 zmm_x = _mm512_loadu_ps(x + i);
+		__m512 zmm_y = _mm512_loadu_ps(y + i);
+		__m512 zmm_z = _mm512_loadu_ps(z + i);
+		__m512 zmm_negR = _mm512_sub_ps(_mm512_setzero_ps(), _mm512_loadu_ps(r + i));
+		__mmask16 visible = 0xFFFF;
+
+		// the compare is masked so lanes already culled stay culled
+		for (int p = 0; p < 6 && visible != 0; ++p) {
+			__m512 zmm_d = _mm512_mul_ps(zmm_x, _mm512_set1_ps(frustum.nx[p]));
+			zmm_d = _mm512_add_ps(zmm_d, _mm512_mul_ps(zmm_y, _mm512_set1_ps(frustum.ny[p])));
+			zmm_d = _mm512_add_ps(zmm_d, _mm512_mul_ps(zmm_z, _mm512_set1_ps(frustum.nz[p])));
+			zmm_d = _mm512_add_ps(zmm_d, _mm512_set1_ps(frustum.d[p]));
+			visible = _mm512_mask_cmp_ps_mask(visible, zmm_d, zmm_negR, _CMP_GE_OQ);
+		}
+
+		__m512i zmm_indices = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(i)), zmm_lanes);
+		_mm512_mask_compressstoreu_epi32(visibleIndices + numVisible, visible, zmm_indices);
+		numVisible += popCount16(visible);
+	}
+	_mm256_zeroupper();
+
+	for (unsigned int i = numSimd; i < numSpheres; ++i) {
+		visibleIndices[numVisible] = i;
+		numVisible += sphereVisible(frustum, x[i], y[i], z[i], r[i]) ? 1 : 0;
+	}
+	return numVisible;
+}
+
+
+unsigned int griffin::geometry::CullAABBList_SSE(
+	const float* cx, const float* cy, const float* cz, const float* ex, const float* ey, const float* ez,
+	unsigned int numAABBs, const Frustum& frustum, uint32_t* visibleIndices)
+{
+	unsigned int numVisible = 0;
+	unsigned int numSimd = numAABBs & ~3U;
+	const __m128 xmm_absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+	for (unsigned int i = 0; i < numSimd; i += 4) {
+		__m128 xmm_cx = _mm_loadu_ps(cx + i);
+		__m128 xmm_cy = _mm_loadu_ps(cy + i);
+		__m128 xmm_cz = _mm_loadu_ps(cz + i);
+		__m128 xmm_ex = _mm_loadu_ps(ex + i);
+		__m128 xmm_ey = _mm_loadu_ps(ey + i);
+		__m128 xmm_ez = _mm_loadu_ps(ez + i);
+		int visible = 0x0F;
+
+		for (int p = 0; p < 6 && visible != 0; ++p) {
+			__m128 xmm_nx = _mm_set1_ps(frustum.nx[p]);
+			__m128 xmm_ny = _mm_set1_ps(frustum.ny[p]);
+			__m128 xmm_nz = _mm_set1_ps(frustum.nz[p]);
+
+			__m128 xmm_d = _mm_mul_ps(xmm_cx, xmm_nx);
+			xmm_d = _mm_add_ps(xmm_d, _mm_mul_ps(xmm_cy, xmm_ny));
+			xmm_d = _mm_add_ps(xmm_d, _mm_mul_ps(xmm_cz, xmm_nz));
+
+			// projected half extent onto the plane normal
+			__m128 xmm_r = _mm_mul_ps(xmm_ex, _mm_and_ps(xmm_nx, xmm_absMask));
+			xmm_r = _mm_add_ps(xmm_r, _mm_mul_ps(xmm_ey, _mm_and_ps(xmm_ny, xmm_absMask)));
+			xmm_r = _mm_add_ps(xmm_r, _mm_mul_ps(xmm_ez, _mm_and_ps(xmm_nz, xmm_absMask)));
+
+			__m128 xmm_d_p_r = _mm_add_ps(_mm_add_ps(xmm_d, xmm_r), _mm_set1_ps(frustum.d[p]));
+			visible &= _mm_movemask_ps(_mm_cmpge_ps(xmm_d_p_r, _mm_setzero_ps()));
+		}
+
+		numVisible = compactIndices(visible, 4, i, visibleIndices, numVisible);
+	}
+
+	for (unsigned int i = numSimd; i < numAABBs; ++i) {
+		visibleIndices[numVisible] = i;
+		numVisible += aabbVisible(frustum, cx[i], cy[i], cz[i], ex[i], ey[i], ez[i]) ? 1 : 0;
+	}
+	return numVisible;
+}
+
+
+GRIFFIN_TARGET_AVX2
+unsigned int griffin::geometry::CullAABBList_AVX2(
+	const float* cx, const float* cy, const float* cz, const float* ex, const float* ey, const float* ez,
+	unsigned int numAABBs, const Frustum& frustum, uint32_t* visibleIndices)
+{
+	unsigned int numVisible = 0;
+	unsigned int numSimd = numAABBs & ~7U;
+	const __m256 ymm_absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+
+	for (unsigned int i = 0; i < numSimd; i += 8) {
+		__m256 ymm_cx = _mm256_loadu_ps(cx + i);
+		__m256 ymm_cy = _mm256_loadu_ps(cy + i);
+		__m256 ymm_cz = _mm256_loadu_ps(cz + i);
+		__m256 ymm_ex = _mm256_loadu_ps(ex + i);
+		__m256 ymm_ey = _mm256_loadu_ps(ey + i);
+		__m256 ymm_ez = _mm256_loadu_ps(ez + i);
+		int visible = 0xFF;
+
+		for (int p = 0; p < 6 && visible != 0; ++p) {
+			__m256 ymm_nx = _mm256_set1_ps(frustum.nx[p]);
+			__m256 ymm_ny = _mm256_set1_ps(frustum.ny[p]);
+			__m256 ymm_nz = _mm256_set1_ps(frustum.nz[p]);
+
+			__m256 ymm_d = _mm256_mul_ps(ymm_cx, ymm_nx);
+			ymm_d = _mm256_add_ps(ymm_d, _mm256_mul_ps(ymm_cy, ymm_ny));
+			ymm_d = _mm256_add_ps(ymm_d, _mm256_mul_ps(ymm_cz, ymm_nz));
+
+			__m256 ymm_r = _mm256_mul_ps(ymm_ex, _mm256_and_ps(ymm_nx, ymm_absMask));
+			ymm_r = _mm256_add_ps(ymm_r, _mm256_mul_ps(ymm_ey, _mm256_and_ps(ymm_ny, ymm_absMask)));
+			ymm_r = _mm256_add_ps(ymm_r, _mm256_mul_ps(ymm_ez, _mm256_and_ps(ymm_nz, ymm_absMask)));
+
+			__m256 ymm_d_p_r = _mm256_add_ps(_mm256_add_ps(ymm_d, ymm_r), _mm256_set1_ps(frustum.d[p]));
+			visible &= _mm256_movemask_ps(_mm256_cmp_ps(ymm_d_p_r, _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+
+		numVisible = compactIndices(visible, 8, i, visibleIndices, numVisible);
+	}
+	_mm256_zeroupper();
+
+	for (unsigned int i = numSimd; i < numAABBs; ++i) {
+		visibleIndices[numVisible] = i;
+		numVisible += aabbVisible(frustum, cx[i], cy[i], cz[i], ex[i], ey[i], ez[i]) ? 1 : 0;
+	}
+	return numVisible;
+}
+
+
+GRIFFIN_TARGET_AVX512
+unsigned int griffin::geometry::CullAABBList_AVX512(
+	const float* cx, const float* cy, const float* cz, const float* ex, const float* ey, const float* ez,
+	unsigned int numAABBs, const Frustum& frustum, uint32_t* visibleIndices)
+{
+	unsigned int numVisible = 0;
+	unsigned int numSimd = numAABBs & ~15U;
+	const __m512i zmm_lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+	for (unsigned int i = 0; i < numSimd; i += 16) {
+		__m512 zmm_cx = _mm512_loadu_ps(cx + i);
+		__m512 zmm_cy = _mm512_loadu_ps(cy + i);
+		__m512 zmm_cz = _mm512_loadu_ps(cz + i);
+		__m512 zmm_ex = _mm512_loadu_ps(ex + i);
+		__m512 zmm_ey = _mm512_loadu_ps(ey + i);
+		__m512 zmm_ez = _mm512_loadu_ps(ez + i);
+		__mmask16 visible = 0xFFFF;
+
+		for (int p = 0; p < 6 && visible != 0; ++p) {
+			__m512 zmm_nx = _mm512_set1_ps(frustum.nx[p]);
+			__m512 zmm_ny = _mm512_set1_ps(frustum.ny[p]);
+			__m512 zmm_nz = _mm512_set1_ps(frustum.nz[p]);
+
+			__m512 zmm_d = _mm512_mul_ps(zmm_cx, zmm_nx);
+			zmm_d = _mm512_add_ps(zmm_d, _mm512_mul_ps(zmm_cy, zmm_ny));
+			zmm_d = _mm512_add_ps(zmm_d, _mm512_mul_ps(zmm_cz, zmm_nz));
+
+			__m512 zmm_r = _mm512_mul_ps(zmm_ex, _mm512_abs_ps(zmm_nx));
+			zmm_r = _mm512_add_ps(zmm_r, _mm512_mul_ps(zmm_ey, _mm512_abs_ps(zmm_ny)));
+			zmm_r = _mm512_add_ps(zmm_r, _mm512_mul_ps(zmm_ez, _mm512_abs_ps(zmm_nz)));
+
+			__m512 zmm_d_p_r = _mm512_add_ps(_mm512_add_ps(zmm_d, zmm_r), _mm512_set1_ps(frustum.d[p]));
+			visible = _mm512_mask_cmp_ps_mask(visible, zmm_d_p_r, _mm512_setzero_ps(), _CMP_GE_OQ);
+		}
+
+		__m512i zmm_indices = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(i)), zmm_lanes);
+		_mm512_mask_compressstoreu_epi32(visibleIndices + numVisible, visible, zmm_indices);
+		numVisible += popCount16(visible);
+	}
+	_mm256_zeroupper();
+
+	for (unsigned int i = numSimd; i < numAABBs; ++i) {
+		visibleIndices[numVisible] = i;
+		numVisible += aabbVisible(frustum, cx[i], cy[i], cz[i], ex[i], ey[i], ez[i]) ? 1 : 0;
+	}
+	return numVisible;
+}
+
+
+CullKernel griffin::geometry::getCullKernel()
+{
+	return s_cullKernel;
+}
+
+void griffin::geometry::setCullKernel(CullKernel kernel)
+{
+	auto& cpu = getCpuFeatures();
+	if (kernel == CullKernel_AVX512 && !cpu.avx512) {
+		kernel = CullKernel_AVX2;
+	}
+	if (kernel == CullKernel_AVX2 && !cpu.avx2) {
+		kernel = CullKernel_SSE;
+	}
+	s_cullKernel = kernel;
+}
+
+unsigned int griffin::geometry::CullSphereList(
+	const float* x, const float* y, const float* z, const float* r, unsigned int numSpheres,
+	const Frustum& frustum, uint32_t* visibleIndices)
+{
+	switch (s_cullKernel) {
+		case CullKernel_AVX512:
+			return CullSphereList_AVX512(x, y, z, r, numSpheres, frustum, visibleIndices);
+		case CullKernel_AVX2:
+			return CullSphereList_AVX2(x, y, z, r, numSpheres, frustum, visibleIndices);
+		default:
+			return CullSphereList_SSE(x, y, z, r, numSpheres, frustum, visibleIndices);
+	}
+}
+
+unsigned int griffin::geometry::CullAABBList(
+	const float* cx, const float* cy, const float* cz, const float* ex, const float* ey, const float* ez,
+	unsigned int numAABBs, const Frustum& frustum, uint32_t* visibleIndices)
+{
+	switch (s_cullKernel) {
+		case CullKernel_AVX512:
+			return CullAABBList_AVX512(cx, cy, cz, ex, ey, ez, numAABBs, frustum, visibleIndices);
+		case CullKernel_AVX2:
+			return CullAABBList_AVX2(cx, cy, cz, ex, ey, ez, numAABBs, frustum, visibleIndices);
+		default:
+			return CullAABBList_SSE(cx, cy, cz, ex, ey, ez, numAABBs, frustum, visibleIndices);
+	}
+}
+
+
 // Point-Sphere
 
 /**
 * Point-Sphere horizon culling.
 */
-bool beyondHorizon(const glm::dvec3& p, const glm::dvec3& camera, const glm::dvec3 &center, double offset)
+bool griffin::geometry::beyondHorizon(const glm::dvec3& p, const glm::dvec3& camera, const glm::dvec3 &center, double offset)
 {
 	auto vt = p - camera;
 	auto vc = center - camera;
 
 	double d = glm::dot(vt, vc);
 
-	return d > length2(vc) - offset;
-}
\ No newline at end of file
+	return d > glm::dot(vc, vc) - offset;
+}
+
+
+/**
+* Camera terms shared by every sphere of a horizon test. With vc from the camera to the occluder
+* center, the horizon plane is at distance vh^2 / |vc| along vc, and the cone's half angle a has
+* sin(a) = R / |vc| and cos(a) = vh / |vc|.
+*/
+struct HorizonCone {
+	double	camX, camY, camZ;
+	double	vcX, vcY, vcZ;
+	double	vcLength2;		//<! |vc|^2
+	double	vcLength;
+	double	vh2;			//<! squared distance from the camera to the horizon circle
+	double	vh;
+	double	radius;
+};
+
+/**
+* @returns false if the camera is inside the occluder and nothing can be hidden
+*/
+static inline bool setupHorizonCone(const glm::dvec3& camera, const glm::dvec3& center, double occluderRadius,
+									HorizonCone& cone)
+{
+	glm::dvec3 vc(center - camera);
+	cone.camX = camera.x; cone.camY = camera.y; cone.camZ = camera.z;
+	cone.vcX = vc.x; cone.vcY = vc.y; cone.vcZ = vc.z;
+	cone.vcLength2 = vc.x * vc.x + vc.y * vc.y + vc.z * vc.z;
+	cone.vh2 = cone.vcLength2 - occluderRadius * occluderRadius;
+	if (!(cone.vh2 > 0.0)) {
+		return false;
+	}
+	cone.vcLength = std::sqrt(cone.vcLength2);
+	cone.vh = std::sqrt(cone.vh2);
+	cone.radius = occluderRadius;
+	return true;
+}
+
+/**
+* A sphere is hidden when its distance past the horizon plane is at least r, and its distance
+* inside the cone, L * sin(a - t) = (R * d - vh * sqrt(L^2 |vc|^2 - d^2)) / |vc|^2, is as well.
+* Scalar version of the kernels with the same operation order.
+*/
+static inline bool horizonVisible(const HorizonCone& c, double x, double y, double z, double r)
+{
+	double vtX = x - c.camX;
+	double vtY = y - c.camY;
+	double vtZ = z - c.camZ;
+	double d = vtX * c.vcX + vtY * c.vcY + vtZ * c.vcZ;
+	double vtLength2 = vtX * vtX + vtY * vtY + vtZ * vtZ;
+
+	bool pastPlane = (d - c.vh2 >= r * c.vcLength);
+	double perp = std::max(vtLength2 * c.vcLength2 - d * d, 0.0);
+	bool insideCone = (c.radius * d - c.vh * std::sqrt(perp) >= r * c.vcLength2);
+
+	return !(pastPlane && insideCone);
+}
+
+static inline unsigned int allVisible(unsigned int numSpheres, uint32_t* visibleIndices)
+{
+	for (unsigned int i = 0; i < numSpheres; ++i) {
+		visibleIndices[i] = i;
+	}
+	return numSpheres;
+}
+
+
+unsigned int griffin::geometry::CullHorizonSphereList_SSE(
+	const double* x, const double* y, const double* z, const double* r, unsigned int numSpheres,
+	const glm::dvec3& camera, const glm::dvec3& center, double occluderRadius, uint32_t* visibleIndices)
+{
+	HorizonCone c;
+	if (!setupHorizonCone(camera, center, occluderRadius, c)) {
+		return allVisible(numSpheres, visibleIndices);
+	}
+
+	unsigned int numVisible = 0;
+	unsigned int numSimd = numSpheres & ~1U;
+
+	for (unsigned int i = 0; i < numSimd; i += 2) {
+		__m128d xmm_vtX = _mm_sub_pd(_mm_loadu_pd(x + i), _mm_set1_pd(c.camX));
+		__m128d xmm_vtY = _mm_sub_pd(_mm_loadu_pd(y + i), _mm_set1_pd(c.camY));
+		__m128d xmm_vtZ = _mm_sub_pd(_mm_loadu_pd(z + i), _mm_set1_pd(c.camZ));
+		__m128d xmm_r = _mm_loadu_pd(r + i);
+
+		__m128d xmm_d = _mm_mul_pd(xmm_vtX, _mm_set1_pd(c.vcX));
+		xmm_d = _mm_add_pd(xmm_d, _mm_mul_pd(xmm_vtY, _mm_set1_pd(c.vcY)));
+		xmm_d = _mm_add_pd(xmm_d, _mm_mul_pd(xmm_vtZ, _mm_set1_pd(c.vcZ)));
+
+		__m128d xmm_vtLength2 = _mm_mul_pd(xmm_vtX, xmm_vtX);
+		xmm_vtLength2 = _mm_add_pd(xmm_vtLength2, _mm_mul_pd(xmm_vtY, xmm_vtY));
+		xmm_vtLength2 = _mm_add_pd(xmm_vtLength2, _mm_mul_pd(xmm_vtZ, xmm_vtZ));
+
+		__m128d xmm_pastPlane = _mm_cmpge_pd(_mm_sub_pd(xmm_d, _mm_set1_pd(c.vh2)),
+											 _mm_mul_pd(xmm_r, _mm_set1_pd(c.vcLength)));
+
+		__m128d xmm_perp = _mm_sub_pd(_mm_mul_pd(xmm_vtLength2, _mm_set1_pd(c.vcLength2)), _mm_mul_pd(xmm_d, xmm_d));
+		xmm_perp = _mm_max_pd(xmm_perp, _mm_setzero_pd());
+		__m128d xmm_inside = _mm_sub_pd(_mm_mul_pd(_mm_set1_pd(c.radius), xmm_d),
+										_mm_mul_pd(_mm_set1_pd(c.vh), _mm_sqrt_pd(xmm_perp)));
+		__m128d xmm_insideCone = _mm_cmpge_pd(xmm_inside, _mm_mul_pd(xmm_r, _mm_set1_pd(c.vcLength2)));
+
+		int visible = ~_mm_movemask_pd(_mm_and_pd(xmm_pastPlane, xmm_insideCone)) & 0x3;
+		numVisible = compactIndices(visible, 2, i, visibleIndices, numVisible);
+	}
+
+	for (unsigned int i = numSimd; i < numSpheres; ++i) {
+		visibleIndices[numVisible] = i;
+		numVisible += horizonVisible(c, x[i], y[i], z[i], r[i]) ? 1 : 0;
+	}
+	return numVisible;
+}
+
+
+GRIFFIN_TARGET_AVX2
+unsigned int griffin::geometry::CullHorizonSphereList_AVX2(
+	const double* x, const double* y, const double* z, const double* r, unsigned int numSpheres,
+	const glm::dvec3& camera, const glm::dvec3& center, double occluderRadius, uint32_t* visibleIndices)
+{
+	HorizonCone c;
+	if (!setupHorizonCone(camera, center, occluderRadius, c)) {
+		return allVisible(numSpheres, visibleIndices);
+	}
+
+	unsigned int numVisible = 0;
+	unsigned int numSimd = numSpheres & ~3U;
+
+	for (unsigned int i = 0; i < numSimd; i += 4) {
+		__m256d ymm_vtX = _mm256_sub_pd(_mm256_loadu_pd(x + i), _mm256_set1_pd(c.camX));
+		__m256d ymm_vtY = _mm256_sub_pd(_mm256_loadu_pd(y + i), _mm256_set1_pd(c.camY));
+		__m256d ymm_vtZ = _mm256_sub_pd(_mm256_loadu_pd(z + i), _mm256_set1_pd(c.camZ));
+		__m256d ymm_r = _mm256_loadu_pd(r + i);
+
+		__m256d ymm_d = _mm256_mul_pd(ymm_vtX, _mm256_set1_pd(c.vcX));
+		ymm_d = _mm256_add_pd(ymm_d, _mm256_mul_pd(ymm_vtY, _mm256_set1_pd(c.vcY)));
+		ymm_d = _mm256_add_pd(ymm_d, _mm256_mul_pd(ymm_vtZ, _mm256_set1_pd(c.vcZ)));
+
+		__m256d ymm_vtLength2 = _mm256_mul_pd(ymm_vtX, ymm_vtX);
+		ymm_vtLength2 = _mm256_add_pd(ymm_vtLength2, _mm256_mul_pd(ymm_vtY, ymm_vtY));
+		ymm_vtLength2 = _mm256_add_pd(ymm_vtLength2, _mm256_mul_pd(ymm_vtZ, ymm_vtZ));
+
+		__m256d ymm_pastPlane = _mm256_cmp_pd(_mm256_sub_pd(ymm_d, _mm256_set1_pd(c.vh2)),
+											  _mm256_mul_pd(ymm_r, _mm256_set1_pd(c.vcLength)), _CMP_GE_OQ);
+
+		__m256d ymm_perp = _mm256_sub_pd(_mm256_mul_pd(ymm_vtLength2, _mm256_set1_pd(c.vcLength2)), _mm256_mul_pd(ymm_d, ymm_d));
+		ymm_perp = _mm256_max_pd(ymm_perp, _mm256_setzero_pd());
+		__m256d ymm_inside = _mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(c.radius), ymm_d),
+										   _mm256_mul_pd(_mm256_set1_pd(c.vh), _mm256_sqrt_pd(ymm_perp)));
+		__m256d ymm_insideCone = _mm256_cmp_pd(ymm_inside, _mm256_mul_pd(ymm_r, _mm256_set1_pd(c.vcLength2)), _CMP_GE_OQ);
+
+		int visible = ~_mm256_movemask_pd(_mm256_and_pd(ymm_pastPlane, ymm_insideCone)) & 0xF;
+		numVisible = compactIndices(visible, 4, i, visibleIndices, numVisible);
+	}
+	_mm256_zeroupper();
+
+	for (unsigned int i = numSimd; i < numSpheres; ++i) {
+		visibleIndices[numVisible] = i;
+		numVisible += horizonVisible(c, x[i], y[i], z[i], r[i]) ? 1 : 0;
+	}
+	return numVisible;
+}
+
+
+GRIFFIN_TARGET_AVX512
+unsigned int griffin::geometry::CullHorizonSphereList_AVX512(
+	const double* x, const double* y, const double* z, const double* r, unsigned int numSpheres,
+	const glm::dvec3& camera, const glm::dvec3& center, double occluderRadius, uint32_t* visibleIndices)
+{
+	HorizonCone c;
+	if (!setupHorizonCone(camera, center, occluderRadius, c)) {
+		return allVisible(numSpheres, visibleIndices);
+	}
+
+	unsigned int numVisible = 0;
+	unsigned int numSimd = numSpheres & ~7U;
+	const __m512i zmm_lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 0, 0, 0, 0, 0, 0, 0, 0);
+
+	for (unsigned int i = 0; i < numSimd; i += 8) {
+		__m512d zmm_vtX = _mm512_sub_pd(_mm512_loadu_pd(x + i), _mm512_set1_pd(c.camX));
+		__m512d zmm_vtY = _mm512_sub_pd(_mm512_loadu_pd(y + i), _mm512_set1_pd(c.camY));
+		__m512d zmm_vtZ = _mm512_sub_pd(_mm512_loadu_pd(z + i), _mm512_set1_pd(c.camZ));
+		__m512d zmm_r = _mm512_loadu_pd(r + i);
+
+		__m512d zmm_d = _mm512_mul_pd(zmm_vtX, _mm512_set1_pd(c.vcX));
+		zmm_d = _mm512_add_pd(zmm_d, _mm512_mul_pd(zmm_vtY, _mm512_set1_pd(c.vcY)));
+		zmm_d = _mm512_add_pd(zmm_d, _mm512_mul_pd(zmm_vtZ, _mm512_set1_pd(c.vcZ)));
+
+		__m512d zmm_vtLength2 = _mm512_mul_pd(zmm_vtX, zmm_vtX);
+		zmm_vtLength2 = _mm512_add_pd(zmm_vtLength2, _mm512_mul_pd(zmm_vtY, zmm_vtY));
+		zmm_vtLength2 = _mm512_add_pd(zmm_vtLength2, _mm512_mul_pd(zmm_vtZ, zmm_vtZ));
+
+		__mmask8 hidden = _mm512_cmp_pd_mask(_mm512_sub_pd(zmm_d, _mm512_set1_pd(c.vh2)),
+											 _mm512_mul_pd(zmm_r, _mm512_set1_pd(c.vcLength)), _CMP_GE_OQ);
+
+		__m512d zmm_perp = _mm512_sub_pd(_mm512_mul_pd(zmm_vtLength2, _mm512_set1_pd(c.vcLength2)), _mm512_mul_pd(zmm_d, zmm_d));
+		zmm_perp = _mm512_max_pd(zmm_perp, _mm512_setzero_pd());
+		__m512d zmm_inside = _mm512_sub_pd(_mm512_mul_pd(_mm512_set1_pd(c.radius), zmm_d),
+										   _mm512_mul_pd(_mm512_set1_pd(c.vh), _mm512_sqrt_pd(zmm_perp)));
+		hidden = _mm512_mask_cmp_pd_mask(hidden, zmm_inside, _mm512_mul_pd(zmm_r, _mm512_set1_pd(c.vcLength2)), _CMP_GE_OQ);
+
+		// only the low 8 index lanes are used
+		__mmask16 visible = static_cast<__mmask16>(~hidden & 0xFF);
+		__m512i zmm_indices = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(i)), zmm_lanes);
+		_mm512_mask_compressstoreu_epi32(visibleIndices + numVisible, visible, zmm_indices);
+		numVisible += popCount16(visible);
+	}
+	_mm256_zeroupper();
+
+	for (unsigned int i = numSimd; i < numSpheres; ++i) {
+		visibleIndices[numVisible] = i;
+		numVisible += horizonVisible(c, x[i], y[i], z[i], r[i]) ? 1 : 0;
+	}
+	return numVisible;
+}
+
+
+unsigned int griffin::geometry::CullHorizonSphereList(
+	const double* x, const double* y, const double* z, const double* r, unsigned int numSpheres,
+	const glm::dvec3& camera, const glm::dvec3& center, double occluderRadius, uint32_t* visibleIndices)
+{
+	switch (s_cullKernel) {
+		case CullKernel_AVX512:
+			return CullHorizonSphereList_AVX512(x, y, z, r, numSpheres, camera, center, occluderRadius, visibleIndices);
+		case CullKernel_AVX2:
+			return CullHorizonSphereList_AVX2(x, y, z, r, numSpheres, camera, center, occluderRadius, visibleIndices);
+		default:
+			return CullHorizonSphereList_SSE(x, y, z, r, numSpheres, camera, center, occluderRadius, visibleIndices);
+	}
+}
@@ -0,0 +1,407 @@
+/**
+* @file OcclusionBuffer.cpp
+* @author Jeff Kiah
+*/
+#include "../OcclusionBuffer.h"
+#include <utility/concurrency.h>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <cmath>
+#include <cfloat>
+#include <cassert>
+
+using namespace griffin;
+using namespace griffin::geometry;
+
+
+/**
+* Below this many triangles the tiles are rasterized on the calling thread, waking the workers
+* costs more than the work
+*/
+#define OCCLUSION_PARALLEL_MIN_TRIANGLES	64
+
+
+namespace {
+	/**
+	* Shared by the threads taking part in one rasterize. Helpers hold a shared_ptr so a helper
+	* starting after the caller has finished still finds valid counters and returns.
+	*/
+	struct RasterizeJob {
+		std::atomic<uint32_t>	nextTile;
+		std::atomic<uint32_t>	tilesDone;
+	};
+}
+
+
+// class OcclusionBuffer
+
+OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height) :
+	m_width(width),
+	m_height(height),
+	m_tilesX(width / OCCLUSION_TILE_WIDTH),
+	m_tilesY(height / OCCLUSION_TILE_HEIGHT),
+	m_hiZWidth(width / OCCLUSION_HIZ_BLOCK_SIZE)
+{
+	assert(width > 0 && width % OCCLUSION_TILE_WIDTH == 0 && "width must be a multiple of the tile width");
+	assert(height > 0 && height % OCCLUSION_TILE_HEIGHT == 0 && "height must be a multiple of the tile height");
+
+	m_depth.resize(width * height);
+	m_hiZ.resize(m_hiZWidth * (height / OCCLUSION_HIZ_BLOCK_SIZE));
+	m_tileBins.resize(m_tilesX * m_tilesY);
+	clear();
+}
+
+
+void OcclusionBuffer::clear()
+{
+	std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+	std::fill(m_hiZ.begin(), m_hiZ.end(), 1.0f);
+	m_triangles.clear();
+	for (auto& bin : m_tileBins) {
+		bin.clear();
+	}
+}
+
+
+void OcclusionBuffer::addOccluder(const glm::vec3* vertices, uint32_t numVertices,
+								  const uint32_t* indices, uint32_t numIndices,
+								  const glm::mat4& modelViewProj)
+{
+	assert(numIndices % 3 == 0 && "occluders must be triangle lists");
+
+	// transform every vertex to clip space once
+	__m128 col0 = _mm_loadu_ps(&modelViewProj[0][0]);
+	__m128 col1 = _mm_loadu_ps(&modelViewProj[1][0]);
+	__m128 col2 = _mm_loadu_ps(&modelViewProj[2][0]);
+	__m128 col3 = _mm_loadu_ps(&modelViewProj[3][0]);
+
+	m_clipVertices.resize(numVertices * 4);
+	for (uint32_t v = 0; v < numVertices; ++v) {
+		__m128 clip = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+							_mm_mul_ps(col0, _mm_set1_ps(vertices[v].x)),
+							_mm_mul_ps(col1, _mm_set1_ps(vertices[v].y))),
+							_mm_mul_ps(col2, _mm_set1_ps(vertices[v].z))),
+							col3);
+		_mm_storeu_ps(&m_clipVertices[v * 4], clip);
+	}
+
+	for (uint32_t i = 0; i < numIndices; i += 3) {
+		assert(indices[i] < numVertices && indices[i + 1] < numVertices && indices[i + 2] < numVertices);
+		addClippedTriangle(&m_clipVertices[indices[i] * 4],
+						   &m_clipVertices[indices[i + 1] * 4],
+						   &m_clipVertices[indices[i + 2] * 4]);
+	}
+}
+
+
+/**
+* Clips against the near plane z = -w, the only plane that must be clipped. Triangles reaching
+* past the other planes are handled by clamping their pixel bounds.
+*/
+void OcclusionBuffer::addClippedTriangle(const float* v0, const float* v1, const float* v2)
+{
+	const float* in[3] = { v0, v1, v2 };
+	float dist[3];
+	int numInside = 0;
+	for (int i = 0; i < 3; ++i) {
+		dist[i] = in[i][2] + in[i][3];
+		numInside += (dist[i] >= 0.0f) ? 1 : 0;
+	}
+
+	if (numInside == 3) {
+		setupTriangle(v0, v1, v2);
+		return;
+	}
+	if (numInside == 0) {
+		return;
+	}
+
+	// walk the edges keeping inside vertices and adding intersections, gives 3 or 4 vertices
+	float out[4][4];
+	int numOut = 0;
+	for (int i = 0; i < 3; ++i) {
+		int j = (i + 1) % 3;
+		if (dist[i] >= 0.0f) {
+			std::copy(in[i], in[i] + 4, out[numOut++]);
+		}
+		if ((dist[i] >= 0.0f) != (dist[j] >= 0.0f)) {
+			float t = dist[i] / (dist[i] - dist[j]);
+			for (int c = 0; c < 4; ++c) {
+				out[numOut][c] = in[i][c] + (in[j][c] - in[i][c]) * t;
+			}
+			++numOut;
+		}
+	}
+
+	setupTriangle(out[0], out[1], out[2]);
+	if (numOut == 4) {
+		setupTriangle(out[0], out[2], out[3]);
+	}
+}
+
+
+void OcclusionBuffer::setupTriangle(const float* v0, const float* v1, const float* v2)
+{
+	// to screen space, pixel (0,0) spans [0,1) with its center at 0.5
+	float halfWidth = 0.5f * m_width;
+	float halfHeight = 0.5f * m_height;
+	float sx[3], sy[3], sz[3];
+	const float* v[3] = { v0, v1, v2 };
+	for (int i = 0; i < 3; ++i) {
+		float invW = 1.0f / v[i][3];
+		sx[i] = (v[i][0] * invW) * halfWidth + halfWidth;
+		sy[i] = (v[i][1] * invW) * halfHeight + halfHeight;
+		sz[i] = v[i][2] * invW;
+	}
+
+	float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+	if (area == 0.0f || !std::isfinite(area)) {
+		return;
+	}
+	// rasterize both windings, make it counter-clockwise so inside is positive
+	if (area < 0.0f) {
+		std::swap(sx[1], sx[2]);
+		std::swap(sy[1], sy[2]);
+		std::swap(sz[1], sz[2]);
+		area = -area;
+	}
+
+	float minX = std::max(std::floor(std::min({ sx[0], sx[1], sx[2] })), 0.0f);
+	float minY = std::max(std::floor(std::min({ sy[0], sy[1], sy[2] })), 0.0f);
+	float maxX = std::min(std::floor(std::max({ sx[0], sx[1], sx[2] })), m_width - 1.0f);
+	float maxY = std::min(std::floor(std::max({ sy[0], sy[1], sy[2] })), m_height - 1.0f);
+	if (minX > maxX || minY > maxY) {
+		return;
+	}
+
+	Triangle tri;
+	for (int e = 0; e < 3; ++e) {
+		int a = e;
+		int b = (e + 1) % 3;
+		tri.edgeA[e] = sy[a] - sy[b];
+		tri.edgeB[e] = sx[b] - sx[a];
+		tri.edgeC[e] = (sy[b] - sy[a]) * sx[a] - (sx[b] - sx[a]) * sy[a];
+	}
+
+	float invArea = 1.0f / area;
+	tri.depthA = ((sz[1] - sz[0]) * (sy[2] - sy[0]) - (sz[2] - sz[0]) * (sy[1] - sy[0])) * invArea;
+	tri.depthB = ((sz[2] - sz[0]) * (sx[1] - sx[0]) - (sz[1] - sz[0]) * (sx[2] - sx[0])) * invArea;
+	tri.depthC = sz[0] - tri.depthA * sx[0] - tri.depthB * sy[0];
+
+	tri.minX = static_cast<int32_t>(minX);
+	tri.minY = static_cast<int32_t>(minY);
+	tri.maxX = static_cast<int32_t>(maxX);
+	tri.maxY = static_cast<int32_t>(maxY);
+
+	// bin into every tile the bounds overlap
+	uint32_t triIndex = static_cast<uint32_t>(m_triangles.size());
+	m_triangles.push_back(tri);
+
+	for (int32_t ty = tri.minY / OCCLUSION_TILE_HEIGHT; ty <= tri.maxY / OCCLUSION_TILE_HEIGHT; ++ty) {
+		for (int32_t tx = tri.minX / OCCLUSION_TILE_WIDTH; tx <= tri.maxX / OCCLUSION_TILE_WIDTH; ++tx) {
+			m_tileBins[ty * m_tilesX + tx].push_back(triIndex);
+		}
+	}
+}
+
+
+void OcclusionBuffer::rasterize()
+{
+	uint32_t numTiles = m_tilesX * m_tilesY;
+	auto& threadPool = task_base::s_threadPool;
+
+	if (!threadPool || threadPool->getNumWorkerThreads() <= 1 ||
+		m_triangles.size() < OCCLUSION_PARALLEL_MIN_TRIANGLES)
+	{
+		for (uint32_t t = 0; t < numTiles; ++t) {
+			rasterizeTile(t);
+		}
+	}
+	else {
+		auto job = std::make_shared<RasterizeJob>();
+		job->nextTile = 0;
+		job->tilesDone = 0;
+
+		auto runTiles = [this, job, numTiles]() {
+			for (;;) {
+				uint32_t t = job->nextTile.fetch_add(1, std::memory_order_relaxed);
+				if (t >= numTiles) {
+					break;
+				}
+				rasterizeTile(t);
+				job->tilesDone.fetch_add(1, std::memory_order_release);
+			}
+		};
+
+		uint32_t numHelpers = std::min(static_cast<uint32_t>(threadPool->getNumWorkerThreads()), numTiles - 1);
+		for (uint32_t h = 0; h < numHelpers; ++h) {
+			threadPool->run(Thread_Workers, runTiles);
+		}
+
+		// work on this thread too, only waits on tiles already taken so it can't deadlock
+		runTiles();
+
+		while (job->tilesDone.load(std::memory_order_acquire) < numTiles) {
+			std::this_thread::yield();
+		}
+	}
+
+	m_triangles.clear();
+	for (auto& bin : m_tileBins) {
+		bin.clear();
+	}
+}
+
+
+/**
+* Rasterizes the tile's bin 4 pixels at a time and rebuilds the tile's hi-z blocks. Edge and
+* depth values are evaluated directly at each pixel center rather than stepped, so results
+* don't depend on where a span starts.
+*/
+void OcclusionBuffer::rasterizeTile(uint32_t tile)
+{
+	int32_t tileX0 = static_cast<int32_t>((tile % m_tilesX) * OCCLUSION_TILE_WIDTH);
+	int32_t tileY0 = static_cast<int32_t>((tile / m_tilesX) * OCCLUSION_TILE_HEIGHT);
+	int32_t tileX1 = tileX0 + OCCLUSION_TILE_WIDTH - 1;
+	int32_t tileY1 = tileY0 + OCCLUSION_TILE_HEIGHT - 1;
+
+	const __m128 xmm_laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 xmm_zero = _mm_setzero_ps();
+
+	for (uint32_t triIndex : m_tileBins[tile]) {
+		const Triangle& tri = m_triangles[triIndex];
+
+		int32_t x0 = std::max(tri.minX, tileX0) & ~3;
+		int32_t x1 = std::min(tri.maxX, tileX1);
+		int32_t y0 = std::max(tri.minY, tileY0);
+		int32_t y1 = std::min(tri.maxY, tileY1);
+
+		__m128 xmm_a0 = _mm_set1_ps(tri.edgeA[0]);
+		__m128 xmm_a1 = _mm_set1_ps(tri.edgeA[1]);
+		__m128 xmm_a2 = _mm_set1_ps(tri.edgeA[2]);
+		__m128 xmm_depthA = _mm_set1_ps(tri.depthA);
+
+		for (int32_t y = y0; y <= y1; ++y) {
+			float py = y + 0.5f;
+			__m128 xmm_row0 = _mm_set1_ps(tri.edgeB[0] * py + tri.edgeC[0]);
+			__m128 xmm_row1 = _mm_set1_ps(tri.edgeB[1] * py + tri.edgeC[1]);
+			__m128 xmm_row2 = _mm_set1_ps(tri.edgeB[2] * py + tri.edgeC[2]);
+			__m128 xmm_rowDepth = _mm_set1_ps(tri.depthB * py + tri.depthC);
+			float* depthRow = &m_depth[y * m_width];
+
+			for (int32_t x = x0; x <= x1; x += 4) {
+				__m128 xmm_px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), xmm_laneOffsets);
+
+				__m128 xmm_inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(xmm_a0, xmm_px), xmm_row0), xmm_zero);
+				xmm_inside = _mm_and_ps(xmm_inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(xmm_a1, xmm_px), xmm_row1), xmm_zero));
+				xmm_inside = _mm_and_ps(xmm_inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(xmm_a2, xmm_px), xmm_row2), xmm_zero));
+				if (_mm_movemask_ps(xmm_inside) == 0) {
+					continue;
+				}
+
+				__m128 xmm_depth = _mm_add_ps(_mm_mul_ps(xmm_depthA, xmm_px), xmm_rowDepth);
+				__m128 xmm_old = _mm_loadu_ps(depthRow + x);
+				__m128 xmm_new = _mm_min_ps(xmm_old, xmm_depth);
+				_mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(xmm_inside, xmm_new),
+													  _mm_andnot_ps(xmm_inside, xmm_old)));
+			}
+		}
+	}
+
+	// hi-z keeps the farthest depth of each block
+	for (int32_t by = tileY0; by <= tileY1; by += OCCLUSION_HIZ_BLOCK_SIZE) {
+		for (int32_t bx = tileX0; bx <= tileX1; bx += OCCLUSION_HIZ_BLOCK_SIZE) {
+			__m128 xmm_max = _mm_set1_ps(-1.0f);
+			for (int32_t y = by; y < by + OCCLUSION_HIZ_BLOCK_SIZE; ++y) {
+				for (int32_t x = bx; x < bx + OCCLUSION_HIZ_BLOCK_SIZE; x += 4) {
+					xmm_max = _mm_max_ps(xmm_max, _mm_loadu_ps(&m_depth[y * m_width + x]));
+				}
+			}
+			xmm_max = _mm_max_ps(xmm_max, _mm_shuffle_ps(xmm_max, xmm_max, _MM_SHUFFLE(1, 0, 3, 2)));
+			xmm_max = _mm_max_ps(xmm_max, _mm_shuffle_ps(xmm_max, xmm_max, _MM_SHUFFLE(2, 3, 0, 1)));
+			_mm_store_ss(&m_hiZ[(by / OCCLUSION_HIZ_BLOCK_SIZE) * m_hiZWidth + bx / OCCLUSION_HIZ_BLOCK_SIZE], xmm_max);
+		}
+	}
+}
+
+
+bool OcclusionBuffer::isRectVisible(float ndcMinX, float ndcMinY, float ndcMaxX, float ndcMaxY, float ndcMinZ) const
+{
+	float x0 = (ndcMinX * 0.5f + 0.5f) * m_width;
+	float x1 = (ndcMaxX * 0.5f + 0.5f) * m_width;
+	float y0 = (ndcMinY * 0.5f + 0.5f) * m_height;
+	float y1 = (ndcMaxY * 0.5f + 0.5f) * m_height;
+
+	if (x1 < 0.0f || y1 < 0.0f || x0 >= m_width || y0 >= m_height) {
+		return false;
+	}
+
+	// every block touching the rectangle, a partly covered block is still conservative since
+	// the hi-z holds the farthest depth of the whole block
+	int32_t bx0 = static_cast<int32_t>(std::max(x0, 0.0f)) / OCCLUSION_HIZ_BLOCK_SIZE;
+	int32_t by0 = static_cast<int32_t>(std::max(y0, 0.0f)) / OCCLUSION_HIZ_BLOCK_SIZE;
+	int32_t bx1 = static_cast<int32_t>(std::min(x1, m_width - 1.0f)) / OCCLUSION_HIZ_BLOCK_SIZE;
+	int32_t by1 = static_cast<int32_t>(std::min(y1, m_height - 1.0f)) / OCCLUSION_HIZ_BLOCK_SIZE;
+
+	for (int32_t by = by0; by <= by1; ++by) {
+		for (int32_t bx = bx0; bx <= bx1; ++bx) {
+			if (ndcMinZ <= m_hiZ[by * m_hiZWidth + bx]) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+
+bool OcclusionBuffer::isBoxVisible(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::mat4& viewProj) const
+{
+	__m128 col0 = _mm_loadu_ps(&viewProj[0][0]);
+	__m128 col1 = _mm_loadu_ps(&viewProj[1][0]);
+	__m128 col2 = _mm_loadu_ps(&viewProj[2][0]);
+	__m128 col3 = _mm_loadu_ps(&viewProj[3][0]);
+
+	__m128 xMin = _mm_mul_ps(col0, _mm_set1_ps(boxMin.x));
+	__m128 xMax = _mm_mul_ps(col0, _mm_set1_ps(boxMax.x));
+	__m128 yMin = _mm_mul_ps(col1, _mm_set1_ps(boxMin.y));
+	__m128 yMax = _mm_mul_ps(col1, _mm_set1_ps(boxMax.y));
+	__m128 zMin = _mm_add_ps(_mm_mul_ps(col2, _mm_set1_ps(boxMin.z)), col3);
+	__m128 zMax = _mm_add_ps(_mm_mul_ps(col2, _mm_set1_ps(boxMax.z)), col3);
+
+	float ndcMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float ndcMax[2] = { -FLT_MAX, -FLT_MAX };
+
+	for (int corner = 0; corner < 8; ++corner) {
+		__m128 clip = _mm_add_ps(_mm_add_ps((corner & 1) ? xMax : xMin,
+											(corner & 2) ? yMax : yMin),
+											(corner & 4) ? zMax : zMin);
+		alignas(16) float c[4];
+		_mm_store_ps(c, clip);
+
+		// any corner in front of the near plane makes the screen bounds unreliable
+		if (c[2] < -c[3]) {
+			return true;
+		}
+		float invW = 1.0f / c[3];
+		float nx = c[0] * invW;
+		float ny = c[1] * invW;
+		ndcMin[0] = std::min(ndcMin[0], nx);
+		ndcMin[1] = std::min(ndcMin[1], ny);
+		ndcMin[2] = std::min(ndcMin[2], c[2] * invW);
+		ndcMax[0] = std::max(ndcMax[0], nx);
+		ndcMax[1] = std::max(ndcMax[1], ny);
+	}
+
+	return isRectVisible(ndcMin[0], ndcMin[1], ndcMax[0], ndcMax[1], ndcMin[2]);
+}
+
+
+bool OcclusionBuffer::isSphereVisible(const glm::vec3& center, float radius, const glm::mat4& viewProj) const
+{
+	return isBoxVisible(glm::vec3(center.x - radius, center.y - radius, center.z - radius),
+						glm::vec3(center.x + radius, center.y + radius, center.z + radius),
+						viewProj);
+}
@@ -0,0 +1,54 @@
+/**
+* @file Animation.h
+* @author Jeff Kiah
+*/
+#pragma once
+#ifndef GRIFFIN_RENDER_ANIMATION_H_
+#define GRIFFIN_RENDER_ANIMATION_H_
+
+#include <cstdint>
+#include <algorithm>
+
+/**
+* Keys a cursor steps over before giving up and binary searching, playback normally moves a
+* key or two per frame
+*/
+#define KEYFRAME_CURSOR_MAX_STEPS	4
+
+namespace griffin {
+	namespace render {
+
+		/**
+		* Finds the first key later than animTime, the same key a scan from the start of the
+		* channel finds. Starts from the key found for the previous sample so forward playback
+		* costs a step or two, and binary searches when time jumps back on a loop or seek.
+		* @tparam KeyFrame	any key with a float time member, keys sorted by time
+		* @param cursor	key returned by the previous call for this channel, 0 to start
+		* @return  index of the first key later than animTime relative to keys, numKeys when
+		*	animTime is at or past the last key
+		*/
+		template <typename KeyFrame>
+		inline uint16_t findNextKeyframe(const KeyFrame* keys, uint16_t numKeys, float animTime, uint16_t cursor)
+		{
+			auto later = [](float t, const KeyFrame& key) { return t < key.time; };
+
+			// time went backwards, or the cursor belongs to a different channel
+			if (cursor > numKeys || (cursor > 0 && animTime < keys[cursor - 1].time)) {
+				uint16_t end = (cursor > numKeys ? numKeys : cursor - 1);
+				return static_cast<uint16_t>(std::upper_bound(keys, keys + end, animTime, later) - keys);
+			}
+
+			for (int step = 0; step < KEYFRAME_CURSOR_MAX_STEPS; ++step) {
+				if (cursor == numKeys || animTime < keys[cursor].time) {
+					return cursor;
+				}
+				++cursor;
+			}
+
+			// large jump forward
+			return static_cast<uint16_t>(std::upper_bound(keys + cursor, keys + numKeys, animTime, later) - keys);
+		}
+	}
+}
+
+#endif
\ No newline at end of file
@@ -69,6 +69,13 @@ namespace griffin {
 			Model_GL(const Model_GL&) = delete;
 
 			void render(entity::ComponentId modelInstanceId, scene::Scene& scene, uint8_t viewport, Engine& engine);
+
+			/**
+			* Renders at a world transform given by the caller instead of reading the instance's
+			* scene node, used when rendering from a RenderSnapshot
+			*/
+			void render(entity::EntityId entityId, const glm::dvec3& positionWorld,
+						const glm::dquat& orientationWorld, uint8_t viewport, Engine& engine);
 			void draw(entity::ComponentId modelInstanceId, int drawSetIndex);
 			
 			/**
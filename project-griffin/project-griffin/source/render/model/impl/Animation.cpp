@@ -7,6 +7,7 @@
 #include <glm/gtc/quaternion.hpp>
 
 #include <render/model/Model_GL.h>
+#include <render/model/Animation.h>
 
 
 using namespace griffin;
@@ -24,7 +25,12 @@ struct NodeAnimationTransform {
 };
 
 
-NodeAnimationTransform getNodeTransformForTrack(const MeshAnimations& animations, AnimationTrack& track, NodeAnimation& nodeAnim, float animTime)
+/**
+* Samples one node animation of a track. The cursor holds the keys found by the previous sample
+* of this node and track, so playback doesn't rescan long channels from the first key.
+*/
+NodeAnimationTransform getNodeTransformForTrack(const MeshAnimations& animations, AnimationTrack& track, NodeAnimation& nodeAnim,
+												float animTime, KeyframeCursor& cursor)
 {
 	using namespace glm;
 
@@ -39,24 +45,11 @@ NodeAnimationTransform getNodeTransformForTrack(const MeshAnimations& animations
 
 	// Translation keyframes
 	{
-		int key1 = -1;
-		int key2 = -1;
-		
-		// get nearest two key frames
-		for (uint32_t k = nodeAnim.positionKeysIndexOffset; k < nodeAnim.positionKeysIndexOffset + nodeAnim.numPositionKeys; ++k) {
-			auto& posKey = animations.positionKeys[k];
-			if (animTime < posKey.time) {
-				key1 = (k == nodeAnim.positionKeysIndexOffset ? k : k - 1);
-				key2 = k;
-				break;
-			}
-		}
-		
-		// went past the last key
-		if (key1 == -1) {
-			key1 = nodeAnim.positionKeysIndexOffset + nodeAnim.numPositionKeys - 1;
-			key2 = key1;
-		}
+		// get nearest two key frames, clamped to the first and last key
+		uint32_t first = nodeAnim.positionKeysIndexOffset;
+		cursor.position = findNextKeyframe(animations.positionKeys + first, nodeAnim.numPositionKeys, animTime, cursor.position);
+		uint32_t key1 = first + (cursor.position > 0 ? cursor.position - 1 : 0);
+		uint32_t key2 = first + (cursor.position < nodeAnim.numPositionKeys ? cursor.position : nodeAnim.numPositionKeys - 1);
 
 		// TODO: look at pre/post state, we may be able to exit early and accept the default modelToWorld when key1 == key2, depending on the state
 		// Also, the key1 or key2 at either end of the animation may have to be set to default node transform instead of clamping the animations frame
@@ -75,24 +68,11 @@ NodeAnimationTransform getNodeTransformForTrack(const MeshAnimations& animations
 	}
 	// Rotation keyframes
 	{
-		int key1 = -1;
-		int key2 = -1;
-
-		// get nearest two key frames
-		for (uint32_t k = nodeAnim.rotationKeysIndexOffset; k < nodeAnim.rotationKeysIndexOffset + nodeAnim.numRotationKeys; ++k) {
-			auto& rotKey = animations.rotationKeys[k];
-			if (animTime < rotKey.time) {
-				key1 = (k == nodeAnim.rotationKeysIndexOffset ? k : k - 1);
-				key2 = k;
-				break;
-			}
-		}
-
-		// went past the last key
-		if (key1 == -1) {
-			key1 = nodeAnim.rotationKeysIndexOffset + nodeAnim.numRotationKeys - 1;
-			key2 = key1;
-		}
+		// get nearest two key frames, clamped to the first and last key
+		uint32_t first = nodeAnim.rotationKeysIndexOffset;
+		cursor.rotation = findNextKeyframe(animations.rotationKeys + first, nodeAnim.numRotationKeys, animTime, cursor.rotation);
+		uint32_t key1 = first + (cursor.rotation > 0 ? cursor.rotation - 1 : 0);
+		uint32_t key2 = first + (cursor.rotation < nodeAnim.numRotationKeys ? cursor.rotation : nodeAnim.numRotationKeys - 1);
 
 		// TODO: look at pre/post state, we may be able to exit early and accept the default modelToWorld when key1 == key2, depending on the state
 		// Also, the key1 or key2 at either end of the animation may have to be set to default node transform instead of clamping the animations frame
@@ -111,24 +91,11 @@ NodeAnimationTransform getNodeTransformForTrack(const MeshAnimations& animations
 	}
 	// Scaling keyframes
 	{
-		int key1 = -1;
-		int key2 = -1;
-
-		// get nearest two key frames
-		for (uint32_t k = nodeAnim.scalingKeysIndexOffset; k < nodeAnim.scalingKeysIndexOffset + nodeAnim.numScalingKeys; ++k) {
-			auto& scaleKey = animations.scalingKeys[k];
-			if (animTime < scaleKey.time) {
-				key1 = (k == nodeAnim.scalingKeysIndexOffset ? k : k - 1);
-				key2 = k;
-				break;
-			}
-		}
-
-		// went past the last key
-		if (key1 == -1) {
-			key1 = nodeAnim.scalingKeysIndexOffset + nodeAnim.numScalingKeys - 1;
-			key2 = key1;
-		}
+		// get nearest two key frames, clamped to the first and last key
+		uint32_t first = nodeAnim.scalingKeysIndexOffset;
+		cursor.scaling = findNextKeyframe(animations.scalingKeys + first, nodeAnim.numScalingKeys, animTime, cursor.scaling);
+		uint32_t key1 = first + (cursor.scaling > 0 ? cursor.scaling - 1 : 0);
+		uint32_t key2 = first + (cursor.scaling < nodeAnim.numScalingKeys ? cursor.scaling : nodeAnim.numScalingKeys - 1);
 
 		// TODO: look at pre/post state, we may be able to exit early and accept the default modelToWorld when key1 == key2, depending on the state
 		// Also, the key1 or key2 at either end of the animation may have to be set to default node transform instead of clamping the animations frame
@@ -186,7 +153,7 @@ void updateMeshInstanceAnimations(entity::EntityManager& entityMgr)
 						auto& nodeAnim = mesh.getAnimations().nodeAnimations[na];
 
 						if (nodeAnim.sceneNodeIndex == nodeAnimCmp.nodeIndex) {
-							trackTransforms[numAnimationsBlended] = getNodeTransformForTrack(mesh.getAnimations(), track, nodeAnim, animTime);
+							trackTransforms[numAnimationsBlended] = getNodeTransformForTrack(mesh.getAnimations(), track, nodeAnim, animTime, nodeAnimCmp.keyCursors[a]);
 							trackTransforms[numAnimationsBlended].weight = animWeight;
 							++numAnimationsBlended;
 							totalWeight += animWeight;
@@ -12,6 +12,7 @@
 #include <glm/mat4x4.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <utility/debug.h>
+#include <utility/simd_transform.h>
 
 #include <render/RenderResources.h> // TEMP (these two headers needed only for temp render function)
 #include <resource/ResourceLoader.h>
@@ -219,7 +220,7 @@ namespace griffin {
 					}
 				}*/
 
-				modelToWorld = thisItem.toWorld * nodeTransform;
+				simd::mulDMat4(thisItem.toWorld, nodeTransform, modelToWorld);
 				
 				// original code, jitters far from origin
 				//mat4 modelView(viewMat * modelToWorld);
@@ -228,13 +229,9 @@ namespace griffin {
 
 				// transform world space to camera space on CPU in double precision, then send single to GPU
 				// see http://blogs.agi.com/insight3d/index.php/2008/09/03/precisions-precisions/
-				dmat4 modelView_World(viewMat * modelToWorld);
-
 				// camera space is defined as world space rotation without the translation component
-				mat4 modelView_Camera(modelView_World);
-				modelView_Camera[0][3] = 0;
-				modelView_Camera[1][3] = 0;
-				modelView_Camera[2][3] = 0;
+				mat4 modelView_Camera;
+				simd::toCameraRelativeMat4(viewMat, modelToWorld, modelView_Camera);
 
 				mat4 mvp(projMat * modelView_Camera);
 				mat4 normalMat(transpose(inverse(mat3(modelView_Camera))));
@@ -32,6 +32,17 @@ namespace griffin {
 			auto& instance = instanceStore.getComponentRecord(modelInstanceId);
 			auto& sceneNode = entityMgr.getComponent<SceneNode>(instance.component.sceneNodeId);
 
+			render(instance.entityId, sceneNode.positionWorld, sceneNode.orientationWorld, viewport, engine);
+		}
+
+
+		void Model_GL::render(
+			entity::EntityId entityId,
+			const glm::dvec3& positionWorld,
+			const glm::dquat& orientationWorld,
+			uint8_t viewport,
+			Engine& engine)
+		{
 			uint32_t currentNodeIndex = UINT32_MAX;
 			glm::dvec4 currentWorldPosition;
 			glm::dquat currentWorldOrientation;
@@ -44,11 +55,11 @@ namespace griffin {
 				//m_renderEntries.keys[re].key.translucentKey.backToFrontDepth;
 				
 				auto& entry = m_renderEntries.entries[re];
-				entry.entityId = instance.entityId;
+				entry.entityId = entityId;
 				
 				if (currentNodeIndex != entry.nodeIndex) {
-					currentWorldPosition = dvec4(sceneNode.positionWorld, 1.0) + entry.positionWorld;
-					currentWorldOrientation = glm::normalize(sceneNode.orientationWorld + entry.orientationWorld);
+					currentWorldPosition = dvec4(positionWorld, 1.0) + entry.positionWorld;
+					currentWorldOrientation = glm::normalize(orientationWorld + entry.orientationWorld);
 					currentNodeIndex = entry.nodeIndex;
 				}
 				entry.positionWorld = currentWorldPosition;
@@ -27,10 +27,13 @@ namespace griffin {
 		*/
 		class ResourceCache {
 		public:
+			struct ResourceLRUItem;
+			typedef CompactId_T<ResourceLRUItem> LRUItemRef;
+
 			struct ResourceLRUItem {
 				ResourcePtr		resourcePtr;
-				Id_T			previous;
-				Id_T			next;
+				LRUItemRef		previous;
+				LRUItemRef		next;
 			};
 			typedef handle_map<ResourceLRUItem> ResourceMap;
 
@@ -70,8 +73,8 @@ namespace griffin {
 		private:
 			size_t		m_maxSizeBytes;
 			size_t		m_usedSizeBytes;
-			Id_T		m_lruFront;	// least recent
-			Id_T		m_lruBack;	// most recent
+			LRUItemRef	m_lruFront;	// least recent
+			LRUItemRef	m_lruBack;	// most recent
 
 			ResourceMap	m_resourceCache;
 
@@ -16,8 +16,8 @@ namespace griffin {
 
 			auto handle = m_resourceCache.insert({
 				std::move(resource),
-				m_lruBack,
-				Id_T{}
+				LRUItemRef{},
+				LRUItemRef{}
 			});
 			m_usedSizeBytes += sizeBytes;
 
@@ -41,13 +41,13 @@ namespace griffin {
 				const auto& thisItem = m_resourceCache[handle];
 				if (thisItem.resourcePtr.use_count() == 1 || force) {
 					// fix up next/prev for surrounding items
-					if (thisItem.previous.value != 0) {
+					if (thisItem.previous != LRUItemRef{}) {
 						m_resourceCache[thisItem.previous].next = thisItem.next;
 					}
 					else { // no previous item, this was the front
 						m_lruFront = thisItem.next;
 					}
-					if (thisItem.next.value != 0) {
+					if (thisItem.next != LRUItemRef{}) {
 						m_resourceCache[thisItem.next].previous = thisItem.previous;
 					} else { // no next item, this was the back
 						m_lruBack = thisItem.previous;
@@ -72,7 +72,7 @@ namespace griffin {
 			if (m_maxSizeBytes != 0) { // zero max size means infinite size
 				while (m_maxSizeBytes - m_usedSizeBytes < sizeBytes) {
 					// remove the least recently used resource
-					auto handle = m_lruFront;
+					auto handle = m_resourceCache.toId(m_lruFront);
 					removeResource(handle);
 				}
 			}
@@ -80,25 +80,35 @@ namespace griffin {
 
 		void ResourceCache::setLRUMostRecent(Id_T handle)
 		{
+			auto thisRef = LRUItemRef::fromId(handle);
+			if (thisRef == m_lruBack) {
+				return;
+			}
+
 			auto& thisItem = m_resourceCache[handle];
 			
-			// fix up next/prev for surrounding items
-			if (thisItem.previous.value != 0) {
+			// fix up next/prev for surrounding items, a new item isn't linked yet
+			if (thisItem.previous != LRUItemRef{}) {
 				m_resourceCache[thisItem.previous].next = thisItem.next;
 			}
-			if (thisItem.next.value != 0) {
+			else if (thisRef == m_lruFront) {
+				m_lruFront = thisItem.next;
+			}
+			if (thisItem.next != LRUItemRef{}) {
 				m_resourceCache[thisItem.next].previous = thisItem.previous;
 			}
 
 			// fix list back
-			if (m_lruBack.value != 0) {
-				m_resourceCache[m_lruBack].next = handle;
+			thisItem.previous = m_lruBack;
+			thisItem.next = LRUItemRef{};
+			if (m_lruBack != LRUItemRef{}) {
+				m_resourceCache[m_lruBack].next = thisRef;
 			}
-			m_lruBack = handle;
+			m_lruBack = thisRef;
 			
 			// fix list front
-			if (m_lruFront.value == 0) {
-				m_lruFront = handle;
+			if (m_lruFront == LRUItemRef{}) {
+				m_lruFront = thisRef;
 			}
 		}
 
@@ -0,0 +1,49 @@
+/**
+* @file LevelOfDetail.h
+* @author Jeff Kiah
+*/
+#pragma once
+#ifndef GRIFFIN_LEVELOFDETAIL_H_
+#define GRIFFIN_LEVELOFDETAIL_H_
+
+#include <cstdint>
+
+namespace griffin {
+	namespace scene {
+
+		/**
+		* Scene wide settings for choosing ModelLOD levels. An object uses the coarsest LOD
+		* whose geometric error projects to no more than errorBudget pixels. To keep objects
+		* near the threshold from popping back and forth, a LOD is only left once its error has
+		* crossed the budget by the hysteresis fraction.
+		*/
+		struct LodSettings {
+			bool		enabled = true;
+			float		errorBudget = 1.0f;			//<! largest screen space error allowed, in pixels
+			float		hysteresis = 0.2f;			//<! fraction of errorBudget, 0 switches exactly at the budget
+			uint32_t	viewportHeight = 1080;		//<! height in pixels of the render camera's viewport
+		};
+
+		/**
+		* @param projScaleY		element [1][1] of the projection matrix, 1 / tan(fovy / 2)
+		* @param distance		distance from the eye to the nearest point of the bounding sphere,
+		*	clamped to the near clip plane by the caller
+		* @returns pixels covered by one world unit at the distance
+		*/
+		inline float getScreenErrorScale(float projScaleY, uint32_t viewportHeight, double distance)
+		{
+			return static_cast<float>(0.5 * projScaleY * viewportHeight / distance);
+		}
+
+		/**
+		* Picks the LOD for an object given the LOD it used last frame.
+		* @param lodErrors		geometric error in world units of each LOD, finest first, non-decreasing
+		* @param errorScale		pixels per world unit, see getScreenErrorScale
+		* @returns index of the selected LOD
+		*/
+		uint8_t selectLod(const float* lodErrors, uint8_t numLods, uint8_t currentLod,
+						  float errorScale, float errorBudget, float hysteresis);
+	}
+}
+
+#endif
\ No newline at end of file
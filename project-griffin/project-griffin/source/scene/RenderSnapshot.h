@@ -0,0 +1,173 @@
+/**
+* @file RenderSnapshot.h
+* @author Jeff Kiah
+*/
+#pragma once
+#ifndef GRIFFIN_RENDERSNAPSHOT_H_
+#define GRIFFIN_RENDERSNAPSHOT_H_
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <memory>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <entity/EntityTypedefs.h>
+#include <resource/ResourceTypedefs.h>
+
+/**
+* Number of snapshots in flight. The update side owns one it is writing, the render side owns
+* the two it interpolates between, and one is shared between them holding the newest state
+* that the render side has not picked up yet.
+*/
+#define RENDER_SNAPSHOT_BUFFERS		4
+#define RENDER_SNAPSHOT_INDEX_MASK	0x3
+#define RENDER_SNAPSHOT_FRESH_BIT	0x4		//<! set on the shared index when it holds an unread snapshot
+#define RENDER_SNAPSHOT_NO_MODEL	0xFFFFFFFF	//<! RenderSnapshotEntry::modelIndex of entities without a model
+
+
+namespace griffin {
+	namespace scene {
+
+		/**
+		* Everything the render side needs to draw one renderable entity. Copied out of the live
+		* components at the end of an update tick, so it never changes while it's being read.
+		*/
+		struct RenderSnapshotEntry {
+			glm::dvec3			positionWorld;
+			glm::dquat			orientationWorld;
+			entity::EntityId	entityId;
+			entity::ComponentId	materialOverrideId;		//<! MaterialOverride component, NullId_T if none
+			uint32_t			modelIndex;				//<! index into RenderSnapshot::models, RENDER_SNAPSHOT_NO_MODEL if none
+			uint32_t			visibleFrustumBits;		//<! culled at the end of the tick, see RenderSnapshot::renderFrustum
+			float				viewspaceBSphere[4];
+		};
+
+		/**
+		* Immutable copy of the render state of a scene as of one update tick. Entries are sorted
+		* by entityId so two snapshots can be matched up in a single linear pass. The render
+		* camera's view is copied too, so the render side never reads the scene's cameras.
+		*/
+		struct RenderSnapshot {
+			uint64_t							updateFrame = 0;		//<! incrementing count of published snapshots
+			int32_t								activeRenderCamera = -1;
+			int32_t								renderFrustum = -1;		//<! visibleFrustumBits bit of the render camera, -1 draws nothing
+			glm::dvec3							cameraPositionWorld;
+			glm::dquat							cameraOrientationWorld;
+			glm::mat4							cameraProjection;
+			float								cameraNearClip = 0.0f;
+			float								cameraFarClip = 0.0f;
+			std::vector<resource::ResourcePtr>	models;		//<! one reference to each model drawn, held until the snapshot is reused
+			std::vector<RenderSnapshotEntry>	entries;
+		};
+
+
+		/**
+		* @class RenderSnapshotBuffer
+		* Passes RenderSnapshots from the update side to the render side without locks. The update
+		* side fills the snapshot returned by getWriteSnapshot and calls publish, which swaps it
+		* with the shared slot. The render side calls acquire each frame, which swaps its older
+		* snapshot into the shared slot in exchange for the newest one. Neither side ever touches
+		* a snapshot owned by the other, so the two can run on different threads.
+		*
+		* If the update side publishes more than once between acquires, the skipped snapshots are
+		* overwritten and the render side interpolates from the last state it saw.
+		*/
+		class RenderSnapshotBuffer {
+		public:
+			// Update side
+
+			/**
+			* @returns the snapshot owned by the update side, contents are from an older state and
+			*	should be overwritten entirely
+			*/
+			RenderSnapshot& getWriteSnapshot() { return m_snapshots[m_writeIndex]; }
+
+			/**
+			* Stamps the write snapshot with the next updateFrame and makes it the newest state
+			* visible to the render side
+			*/
+			void publish()
+			{
+				m_snapshots[m_writeIndex].updateFrame = ++m_numPublished;
+				uint32_t prev = m_shared.exchange(m_writeIndex | RENDER_SNAPSHOT_FRESH_BIT, std::memory_order_acq_rel);
+				m_writeIndex = prev & RENDER_SNAPSHOT_INDEX_MASK;
+			}
+
+			// Render side
+
+			/**
+			* Picks up the newest published snapshot if there is one, the previous current snapshot
+			* becomes the previous one
+			* @returns true if a new snapshot was acquired
+			*/
+			bool acquire()
+			{
+				if ((m_shared.load(std::memory_order_relaxed) & RENDER_SNAPSHOT_FRESH_BIT) == 0) {
+					return false;
+				}
+				uint32_t fresh = m_shared.exchange(m_prevIndex, std::memory_order_acq_rel);
+				m_prevIndex = m_currIndex;
+				m_currIndex = fresh & RENDER_SNAPSHOT_INDEX_MASK;
+				if (m_numAcquired < 2) {
+					++m_numAcquired;
+				}
+				return true;
+			}
+
+			/**
+			* @returns true once two snapshots have been acquired and can be interpolated
+			*/
+			bool canInterpolate() const { return (m_numAcquired == 2); }
+
+			const RenderSnapshot& getPrevious() const { return m_snapshots[m_prevIndex]; }
+			const RenderSnapshot& getCurrent() const { return m_snapshots[m_currIndex]; }
+
+			/**
+			* Scratch list the render side fills by interpolating, reused each frame
+			*/
+			std::vector<RenderSnapshotEntry>& getInterpolated() { return m_interpolated; }
+
+			/**
+			* Scratch map the update side fills while publishing, model resource to index into
+			* RenderSnapshot::models
+			*/
+			std::unordered_map<const resource::Resource_T*, uint32_t>& getModelIndices() { return m_modelIndices; }
+
+			explicit RenderSnapshotBuffer() {}
+			RenderSnapshotBuffer(const RenderSnapshotBuffer&) = delete;
+
+		private:
+			RenderSnapshot			m_snapshots[RENDER_SNAPSHOT_BUFFERS];
+
+			uint32_t				m_writeIndex = 0;	//<! owned by the update side
+			uint32_t				m_prevIndex = 1;	//<! owned by the render side
+			uint32_t				m_currIndex = 2;	//<! owned by the render side
+			uint32_t				m_numAcquired = 0;	//<! saturates at 2
+			uint64_t				m_numPublished = 0;	//<! owned by the update side
+			std::atomic<uint32_t>	m_shared{ 3 };		//<! index of the shared snapshot, plus the fresh bit
+
+			std::vector<RenderSnapshotEntry> m_interpolated;
+			std::unordered_map<const resource::Resource_T*, uint32_t> m_modelIndices;	//<! owned by the update side
+		};
+
+		typedef std::shared_ptr<RenderSnapshotBuffer> RenderSnapshotBufferPtr;
+
+
+		// Functions
+
+		/**
+		* Interpolates between two snapshots. Entities that are not in both snapshots are left out,
+		* they were either just created or just destroyed. Culling results and model indices are
+		* taken from curr.
+		* @param interpolation	0 gives the prev state, 1 gives the curr state
+		* @param outEntries		cleared and filled with the interpolated entries, sorted by entityId
+		*/
+		void interpolateRenderSnapshots(const RenderSnapshot& prev, const RenderSnapshot& curr,
+										float interpolation, std::vector<RenderSnapshotEntry>& outEntries);
+	}
+}
+
+#endif
\ No newline at end of file
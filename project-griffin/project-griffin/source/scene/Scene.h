@@ -10,7 +10,12 @@
 #include <memory>
 #include <vector>
 #include "SceneGraph.h"
+#include "RenderSnapshot.h"
+#include "LevelOfDetail.h"
+#include "Sector.h"
 #include <utility/memory_reserve.h>
+#include <render/geometry/Geometry.h>
+#include <render/geometry/OcclusionBuffer.h>
 
 
 namespace griffin {
@@ -18,6 +23,7 @@ namespace griffin {
 
 	namespace render {
 		class RenderSystem;
+		class Model_GL;
 		typedef std::weak_ptr<RenderSystem> RenderSystemWeakPtr;
 	}
 	namespace resource {
@@ -63,7 +69,94 @@ namespace griffin {
 
 
 		/**
-		* TODO: make multiple active cameras supported
+		* Low-poly stand-in for geometry hiding much of the scene, like a cockpit shell, that is
+		* rasterized for occlusion culling. Vertices are in the space of the scene node and the
+		* indices form a triangle list.
+		*/
+		struct Occluder {
+			SceneNodeId				sceneNodeId;
+			std::vector<glm::vec3>	vertices;
+			std::vector<uint32_t>	indices;
+		};
+
+
+		/**
+		* An object visible from one culled camera. Lists of these are gathered after culling so
+		* rendering walks only visible objects, with the model already resolved.
+		*/
+		struct VisibleEntry {
+			entity::EntityId	entityId;
+			SceneNodeRef		sceneNodeId;
+			render::Model_GL*	model;		//<! kept alive by the entity's ModelInstance::modelPtr until LOD switches are applied after submission
+		};
+
+		/**
+		* Fills one visible list per frustum bit from the final RenderCullInfo::visibleFrustumBits,
+		* in RenderCullInfo order. Objects without a ModelInstance or whose model isn't resolved
+		* yet are left out.
+		* @param numLists	number of culled frustums, visibleLists is resized to match
+		*/
+		void gatherVisibleEntries(entity::EntityManager& entityMgr, uint32_t numLists,
+								  std::vector<std::vector<VisibleEntry>>& visibleLists);
+
+
+		/**
+		* Frustum culling results remembered between frames, see CullSphereListMultiCoherent.
+		* Entries run parallel to the dense RenderCullInfo order and the whole cache is dropped
+		* when that order or the culled camera list changes. Thresholds are in world units and
+		* radians, the larger they are the longer inside results are reused but the fewer
+		* objects qualify as inside.
+		*/
+		struct CullCache {
+			bool		enabled = true;
+			uint32_t	revalidateFrames = 30;		//<! every Nth frame all frustums are fully tested, 0 never forces it
+			double		maxCameraMove = 1.0;		//<! camera travel before its frustum is fully tested again
+			double		maxCameraTurn = 0.02;		//<! camera rotation in radians before the same
+			double		maxObjectMove = 0.5;		//<! object travel before it is fully tested again
+
+			// state
+			uint32_t	frame = 0;
+			uint32_t	structureVersion = UINT32_MAX;	//<! RenderCullInfo store version the entries belong to
+			std::vector<uint32_t>	cameraIds;
+			std::vector<glm::dvec3>	referenceEyes;			//<! per frustum, eye when inside results were last refreshed
+			std::vector<glm::dquat>	referenceOrientations;
+			std::vector<glm::dvec3>	objectPositions;		//<! per object, position when its inside results were last reset
+			std::vector<float>		objectRadii;
+			std::vector<uint8_t>	planeCache;				//<! CoherentCullFlags, numObjects * numFrustums
+		};
+
+
+		/**
+		* Movement components that still need interpolating, so the render loop skips objects
+		* that aren't moving. A component joins the list when it's written through the store's
+		* getMutable with a dirty flag set, and leaves once all four of its dirty flags are clear.
+		* Indices are into the dense sets, the list is rebuilt when the MovementComponent store
+		* changes structure and the node indices are looked up again when the SceneNode store does.
+		*/
+		struct MoverCache {
+			uint32_t	sinceVersion = 0;					//<! MovementComponent store version changes were collected up to
+			uint32_t	moveStructureVersion = UINT32_MAX;	//<! store structure versions the indices belong to
+			uint32_t	nodeStructureVersion = UINT32_MAX;
+			std::vector<uint32_t>	moveIndices;			//<! dense MovementComponent index of each mover
+			std::vector<uint32_t>	nodeIndices;			//<! dense SceneNode index, parallel to moveIndices
+			std::vector<uint32_t>	listPositions;			//<! per dense MovementComponent, index into moveIndices or UINT32_MAX
+
+			// scratch
+			std::vector<uint32_t>	changed;
+			std::vector<uint32_t>	batch;					//<! list positions sent through one kernel
+		};
+
+		/**
+		* Sets the local transform of every scene node with a moving MovementComponent between
+		* its previous and next simulated values, and to the next values on the frame after it
+		* stops. Only the movers in movers are visited, see MoverCache.
+		* @param interpolation	0 for the previous values, 1 for the next
+		*/
+		void interpolateSceneNodes(entity::EntityManager& entityMgr, SceneGraph& sceneGraph,
+								   MoverCache& movers, float interpolation);
+
+
+		/**
 		* This is the max number of active cameras for any one frame of a rendered scene. This
 		* number includes cameras needed for rendering all viewports and shadow frustums. The
 		* frustum culling results are stored in a 4-byte bitset, hence this limitation.
@@ -80,12 +173,58 @@ namespace griffin {
 			EntityManagerPtr	entityManager;
 			SceneGraphPtr		sceneGraph;
 			CameraList			cameras;
+
+			/**
+			* Cameras frustum culled each frame, main views and shadow frustums alike. A camera's
+			* position in this list is its bit in RenderCullInfo::visibleFrustumBits. The render
+			* camera is culled with the next bit when it isn't listed, so an empty list culls only
+			* activeRenderCamera as bit 0. At most SCENE_MAX_ACTIVE_CAMERAS including it.
+			*/
+			std::vector<uint32_t> cullCameras;
+
+			/**
+			* Objects left visible after culling, one list per frustum bit, rebuilt each rendered
+			* frame in RenderCullInfo order
+			*/
+			std::vector<std::vector<VisibleEntry>> visibleLists;
+
+			/**
+			* Occluders hiding objects from the render camera, objects they hide are cleared from
+			* that camera's visibleFrustumBits. Occlusion culling is skipped when empty.
+			*/
+			std::vector<Occluder> occluders;
+
+			/**
+			* Planet hiding objects beyond the horizon from the render camera, stood in for by a
+			* sphere no larger than the lowest point of its surface. Objects it hides are cleared
+			* from the render camera's visibleFrustumBits. Horizon culling is skipped while
+			* horizonOccluderRadius is 0.
+			*/
+			glm::dvec3			horizonCenter;
+			double				horizonOccluderRadius = 0.0;
+
+			/**
+			* Floating origin mode. The scene graph's origin follows the render camera from sector
+			* to sector, and culling reads node positions relative to it in float. Near the camera
+			* the float positions are as precise as the double world positions.
+			*/
+			bool				useFloatingOrigin = false;
+			glm::ivec3			originSector;			//<! sector whose center is the origin, see Sector.h
+
+			LodSettings lodSettings;		//<! screen space error budget for ModelLOD selection
+
+			CullCache cullCache;		//<! frame coherence for frustum culling, disable to test everything each frame
+
+			MoverCache movers;			//<! movement components interpolated each frame
+
+			RenderSnapshotBufferPtr	renderSnapshots;
 			
 			// contains Lua state?
 			// contains layer id for RenderEntry???
 
 			int32_t				activeRenderCamera = -1;
 			bool				active = false;
+			bool				useRenderSnapshots = false;	//<! render from published snapshots instead of live components
 			std::string			name;
 
 			// Functions
@@ -105,11 +244,78 @@ namespace griffin {
 				activeRenderCamera = cameraId;
 			}
 
+			/**
+			* Moves the scene graph's origin to the camera's sector when the camera has left the
+			* current one, call after updating node transforms. Does nothing unless
+			* useFloatingOrigin is set.
+			*/
+			void updateFloatingOrigin(const glm::dvec3& cameraPositionWorld);
+
+			/**
+			* Copies the render state of the scene into a RenderSnapshot and publishes it for the
+			* render side. Only reads the scene, call once nodes are moved to the end of the tick,
+			* transforms updated and the scene culled, see SceneManager::updateActiveScenes.
+			* Entities whose ModelInstance has no resolved modelPtr are published without a model.
+			* @param renderFrustum	visibleFrustumBits bit of the render camera, -1 if not culled
+			*/
+			void publishRenderSnapshot(int32_t renderFrustum);
+
+			/**
+			* Writes all entities, components and the scene graph to a binary snapshot file, throws
+			* on failure. Cameras are not included, CameraInstance components keep their cameraId
+			* so recreate cameras in the same order after loading.
+			*/
+			void saveSnapshot(const std::string& filename) const;
+
+			/**
+			* Maps a snapshot file written by saveSnapshot and loads it into this scene, which must
+			* not contain any entities yet. Throws on failure. Resource pointers held by components
+			* are not saved and must be rebuilt after loading.
+			*/
+			void loadSnapshot(const std::string& filename);
+
 			explicit Scene(const std::string& _name, bool _active);
 			~Scene();
 		};
 
 
+		/**
+		* A ModelLOD that selected a new level, the model is loaded by applyLodSwitches
+		*/
+		struct LodSwitch {
+			ComponentId	lodId;
+			uint8_t		newLod;
+		};
+
+		/**
+		* Frustum and occlusion culling scratch of one scene. Scenes are prepared concurrently so
+		* each task gets its own, they're kept by the SceneManager and reused every frame.
+		*/
+		struct CullScratch {
+			std::vector<uint32_t>			cameraIds;		//<! cameras culled this frame, index is the frustum bit
+			std::vector<geometry::Frustum>	frustums;
+			std::vector<float>				spheres;		//<! x, y, z and r arrays back to back, each padded to a multiple of 4
+			std::vector<uint32_t>			visibleBits;
+			std::vector<double>				horizonSpheres;	//<! x, y, z and r arrays back to back in world space
+			std::vector<uint32_t>			horizonVisible;
+			std::vector<float>				eyes;			//<! x, y, z of each frustum's eye relative to the shared origin
+			uint32_t						stillMask = 0;	//<! frustums that may reuse inside results this frame
+			geometry::OcclusionBuffer		occlusionBuffer;
+			std::vector<LodSwitch>			lodSwitches;	//<! left for the thread that owns the loader
+		};
+
+		/**
+		* One live scene prepared for rendering this frame, filled by prepareScene and consumed
+		* at the join in renderActiveScenes
+		*/
+		struct ScenePrepareTask {
+			Scene*			scene = nullptr;
+			CullScratch*	scratch = nullptr;
+			Camera*			renderCamera = nullptr;	//<! view already updated, nullptr if the scene has none
+			int32_t			renderFrustum = -1;		//<! -1 when nothing is visible
+		};
+
+
 		/**
 		*
 		*/
@@ -130,13 +336,76 @@ namespace griffin {
 			void updateActiveScenes();
 			void renderActiveScenes(float interpolation, Engine& engine);
 
+			/**
+			* Interpolates, updates transforms, culls and gathers the visible lists of every live
+			* scene, as tasks on the worker threads when there's more than one and the thread pool
+			* has workers. Called by renderActiveScenes before submitting, the results are left in
+			* each scene's visibleLists.
+			*/
+			void prepareActiveScenes(float interpolation);
+
 		private:
 
-			void frustumCullActiveScenes();
+			/**
+			* Interpolates, updates transforms, culls and gathers the visible lists of one live
+			* scene. Touches nothing outside the scene and its scratch, and never the loader, so
+			* tasks for different scenes run concurrently. Submission to the renderer and LOD
+			* switches are left to the caller.
+			*/
+			void prepareScene(ScenePrepareTask& task, float interpolation);
+
+			/**
+			* Updates the render camera from its scene node and moves the floating origin, then
+			* runs all culling stages and LOD selection. Call after updating node transforms.
+			* @param outRenderCamera	receives the render camera, nullptr if the scene has none
+			* @returns frustum bit index of the render camera, -1 if nothing is visible
+			*/
+			int32_t cullScene(Scene& scene, CullScratch& scratch, Camera*& outRenderCamera);
+
+			/**
+			* Tests every RenderCullInfo of the scene against the frustums of all culled cameras in
+			* a single sweep, and writes visibleFrustumBits and viewspaceBSphere. Objects beyond the
+			* scene's horizon are cleared from the render camera's bit.
+			* @returns frustum bit index of the render camera, -1 if the scene has none
+			*/
+			int32_t frustumCullScene(Scene& scene, CullScratch& scratch);
+
+			/**
+			* Brings the scene's CullCache in line with this frame's objects and cameras before a
+			* coherent frustumCullScene
+			*/
+			void updateCullCache(Scene& scene, CullScratch& scratch, uint32_t numObjects);
+
+			/**
+			* Rasterizes the scene's occluders from the render camera and clears frustumMask from
+			* the objects they hide. Runs after frustumCullScene, only objects still visible in
+			* frustumMask are tested.
+			*/
+			void occlusionCullScene(Scene& scene, CullScratch& scratch, uint32_t frustumMask);
+
+			/**
+			* Reselects the LOD of every ModelLOD visible in renderFrustum from its screen space
+			* error, objects culled from the render camera keep their LOD. Runs after all culling
+			* so hidden objects cost nothing. Changes are queued in scratch.lodSwitches.
+			*/
+			void selectModelLods(Scene& scene, CullScratch& scratch, int32_t renderFrustum);
+
+			/**
+			* Loads the models of the queued LOD switches and swaps them into the ModelInstances.
+			* Call from the thread that owns the loader, once the scene is no longer being prepared
+			* and its visible entries were submitted, they point at the models being replaced.
+			*/
+			void applyLodSwitches(Scene& scene, CullScratch& scratch, resource::ResourceLoader& loader);
+
+			void renderSceneSnapshots(Scene& scene, float interpolation, int8_t viewport, Engine& engine);
 
 			// Private Variables
 
 			handle_map<Scene> m_scenes;
+
+			std::vector<std::unique_ptr<CullScratch>>	m_cullScratch;	//<! one per scene prepared concurrently, reused every frame
+			std::vector<ScenePrepareTask>				m_prepareTasks;
+			std::unique_ptr<CullScratch>				m_publishScratch;	//<! update side, culls snapshot scenes before publishing
 		};
 
 	}
@@ -13,10 +13,29 @@
 #include <entity/components.h>
 #include <utility/container/vector_queue.h>
 
+/**
+* Scenes with fewer nodes than this are propagated on the calling thread, below it the cost of
+* handing work to the thread pool outweighs the gain
+*/
+#define SCENEGRAPH_PARALLEL_MIN_NODES			8192
+/**
+* Subtrees are dealt out in chunks, several per thread so a few large subtrees don't leave the
+* other threads idle
+*/
+#define SCENEGRAPH_PARALLEL_CHUNKS_PER_THREAD	4
+#define SCENEGRAPH_PARALLEL_MAX_CHUNKS			64
+
+#define SCENEGRAPH_ROOT_INDEX		0xFFFFFFFF	//<! parent index of the root node's children
+#define SCENEGRAPH_DETACHED_INDEX	0xFFFFFFFE	//<! parent index of nodes not reachable from the root
+
 
 namespace griffin {
 	// Forward Declarations
-	namespace entity { class EntityManager; }
+	namespace entity {
+		class EntityManager;
+		class SnapshotWriter;
+		class MappedSnapshot;
+	}
 	namespace resource {
 		class Resource_T;
 		typedef std::shared_ptr<Resource_T>	ResourcePtr;
@@ -31,45 +50,76 @@ namespace griffin {
 		// Structs
 
 		/**
-		* SceneNode tracks the transform relative to a parent node and contains ids forming an
-		* intrusive hierarchical tree. The SceneGraph is traversed starting at the root to get the
-		* worldspace position of each node.
+		* SceneNode tracks the transform relative to a parent node. It holds only the data read and
+		* written by the transform pass, the tree links are in the node's SceneHierarchy record.
+		* The SceneGraph is traversed starting at the root to get the worldspace position of each
+		* node.
 		*/
 		COMPONENT(SceneNode,
-			(uint32_t,		numChildren,,		"number of children contained"),
-
 			// Flags
 			(uint8_t,		positionDirty,,		"position needs recalc"),
 			(uint8_t,		orientationDirty,,	"orientation needs recalc"),
-			(uint8_t,		_padding_0,[2],		""),
+			(uint8_t,		descendantDirty,,	"a descendant needs recalc, set by SceneGraph::markDirty"),
+			(uint8_t,		_padding_0,[5],		""),
 
 			// transform vars
 			(glm::dvec3,	translationLocal,,	"translation relative to parent"),
 			(glm::dquat,	rotationLocal,,		"local rotation quaternion relative to parent"),
 
 			(glm::dvec3,	positionWorld,,		"position in world space"),
-			(glm::dquat,	orientationWorld,,	"orientation in world space"),
+			(glm::dquat,	orientationWorld,,	"orientation in world space")
 
 			// support scale??
+		)
 
-			// intrusive tree vars
-			(SceneNodeId,	firstChild,,		"first child node index"),
-			(SceneNodeId,	nextSibling,,		"next sibling node index"),
-			(SceneNodeId,	prevSibling,,		"previous sibling node index"),
-			(SceneNodeId,	parent,,			"parent node index")
+		/**
+		* SceneHierarchy contains the ids forming an intrusive hierarchical tree of SceneNodes.
+		* The SceneGraph adds and removes one along with every SceneNode and reorders both stores
+		* together, so a node's hierarchy record sits at the same dense index as the node. Links
+		* are compact SceneNode ids. Don't add or remove these outside of the SceneGraph.
+		*/
+		COMPONENT(SceneHierarchy,
+			(uint32_t,		numChildren,,		"number of children contained"),
+			(SceneNodeRef,	firstChild,,		"first child node index"),
+			(SceneNodeRef,	nextSibling,,		"next sibling node index"),
+			(SceneNodeRef,	prevSibling,,		"previous sibling node index"),
+			(SceneNodeRef,	parent,,			"parent node index")
 		)
 
 		/**
 		* ModelInstance is a component that goes along with the SceneNode to make an
-		* entity represent a unique instance of a model object in the scene.
+		* entity represent a unique instance of a model object in the scene. Set modelId when
+		* adding the component, SceneManager resolves modelPtr at the next update sync point.
 		*/
 		COMPONENT(ModelInstance,
-			(SceneNodeId,	sceneNodeId,,		"scene node containing the root of the model instance"),
+			(SceneNodeRef,	sceneNodeId,,		"scene node containing the root of the model instance"),
+			(uint8_t,		_padding_0,[4],		""),
 			(Id_T,			modelId,,			"resource id of the model"),
 			(resource::ResourcePtr,	modelPtr,,	"shared_ptr to model resource")
 			// TODO: consider using model manager, hold a unique index here instead of resourceptr
 		)
 
+		typedef CompactId_T<ModelInstance>	ModelInstanceRef;
+
+		#define SCENE_MAX_MODEL_LODS	4
+
+		/**
+		* ModelLOD goes along with a ModelInstance and RenderCullInfo to switch the instance's
+		* model between detail levels. The LOD is only reselected while the object is visible to
+		* the render camera, see LodSettings. Each level is a separate model resource, on a
+		* change the ModelInstance's modelId and modelPtr are replaced. Set the ModelInstance to
+		* lodModelIds[0] when creating the component.
+		*/
+		COMPONENT(ModelLOD,
+			(Id_T,			lodModelIds,[SCENE_MAX_MODEL_LODS],	"resource id of the model of each LOD, finest first"),
+			(float,			lodErrors,[SCENE_MAX_MODEL_LODS],	"geometric error in world units of each LOD, finest first, 0 for the full model"),
+			(ComponentId,	modelInstanceId,,		"ModelInstance of the entity, resolved on first use if NullId_T"),
+			(ComponentId,	renderCullInfoId,,		"RenderCullInfo of the entity, resolved on first use if NullId_T"),
+			(uint8_t,		numLods,,				"number of LODs used, at most SCENE_MAX_MODEL_LODS"),
+			(uint8_t,		currentLod,,			"LOD the ModelInstance currently uses"),
+			(uint8_t,		_padding_end,[6],		"")
+		)
+
 		/**
 		* The CameraInstance is a component that pairs with a SceneNode to make an entity represent
 		* a camera in the scene. The cameraId is obtained from the scene by calling createCamera.
@@ -79,10 +129,9 @@ namespace griffin {
 		* of the movement node.
 		*/
 		COMPONENT(CameraInstance,
-			(SceneNodeId,	sceneNodeId,,		"scene node containing the camera instance"),
-			(ComponentId,	movementId,,		"movement component controlling the camera"),
+			(SceneNodeRef,	sceneNodeId,,		"scene node containing the camera instance"),
 			(uint32_t,		cameraId,,			"id of the referenced camera"),
-			(uint8_t,		_padding_0,[4],		""),
+			(ComponentId,	movementId,,		"movement component controlling the camera"),
 			(char,			name,[32],			"name of the camera")
 		)
 
@@ -97,7 +146,7 @@ namespace griffin {
 		* light and spot light is made with the isSpotLight flag. 
 		*/
 		COMPONENT(LightInstance,
-			(SceneNodeId,	sceneNodeId,,			"scene node containing the light instance"),
+			(SceneNodeRef,	sceneNodeId,,			"scene node containing the light instance"),
 			(glm::vec4,		positionViewspace,,		"position of light in viewSpace"),
 			(glm::vec3,		directionViewspace,,	"direction spotlight is pointing"),
 			(glm::vec3,		ambient,,				"ambient light color"),
@@ -119,20 +168,20 @@ namespace griffin {
 		* contains prev/next values so the render loop can interpolate between them to get the
 		* final rendered position, which is then set in the SceneNode. IT IS UP TO YOU to use this
 		* component correctly for movement, in other words you have to set the prev/next values and
-		* dirty flags on each update tick so the movement system behaves correctly. It is always an
-		* option to NOT use this component to achieve movement in special cases, but you would have
-		* to handle the interpolation yourself in a renderTick handler and set the SceneNode values
-		* directly.
+		* dirty flags on each update tick so the movement system behaves correctly. Write it through
+		* the store's getMutable (or call markChanged), the movement system only looks at components
+		* written since it last ran or still interpolating. It is always an option to NOT use this
+		* component to achieve movement in special cases, but you would have to handle the
+		* interpolation yourself in a renderTick handler and set the SceneNode values directly.
 		*/
 		COMPONENT(MovementComponent,
-			(SceneNodeId,	sceneNodeId,,			"scene node controlled by this movement component"),
+			(SceneNodeRef,	sceneNodeId,,			"scene node controlled by this movement component"),
 
 			// flags, TODO: consider converting to bit flags
 			(uint8_t,		translationDirty,,		"position needs recalc"),
 			(uint8_t,		rotationDirty,,			"orientation needs recalc"),
 			(uint8_t,		prevTranslationDirty,,	"previous value of translationDirty"),
 			(uint8_t,		prevRotationDirty,,		"previous value of rotationDirty"),
-			(uint8_t,		_padding_0,[4],			""),
 			
 			// movement vars
 			(glm::dvec3,	prevTranslation,,		"previous local translation"),
@@ -144,14 +193,17 @@ namespace griffin {
 		/**
 		* All entities that can be rendered have a RenderCullInfo component. This stores the data
 		* needed to keep track of its indexing in the space partitioning structure, and the data
-		* needed to perform frustum culling.
+		* needed to perform frustum culling. Set boundingRadius when creating the component, the
+		* frustum bits and viewspace sphere are written by SceneManager each frame.
 		*/
 		COMPONENT(RenderCullInfo,
-			(SceneNodeId,	sceneNodeId,,			"scene node related to this render culling information"),
+			(SceneNodeRef,	sceneNodeId,,			"scene node related to this render culling information"),
 			(uint32_t,		visibleFrustumBits,,	"bits representing visibility in frustums"),
 			(uint32_t,		minWorldAABB,[3],		"AABB integer lower coords in worldspace"),
 			(uint32_t,		maxWorldAABB,[3],		"AABB integer upper coords in worldspace"),
-			(float,			viewspaceBSphere,[4],	"bounding sphere x,y,z,r in viewspace")
+			(float,			viewspaceBSphere,[4],	"bounding sphere x,y,z,r in viewspace of frustum 0"),
+			(float,			boundingRadius,,		"radius of the bounding sphere centered on the scene node"),
+			(ModelInstanceRef,	modelInstanceId,,	"ModelInstance of the entity, resolved on first use if null")
 		)
 
 
@@ -164,14 +216,29 @@ namespace griffin {
 			~SceneGraph();
 
 			/**
-			* Traverse the scene graph starting at root node and calculate new world positions in
-			* breadth-first order. Progress down a branch only when a dirty flag is set.
+			* Calculate new world positions of all nodes in one forward sweep over the SceneNode
+			* store, which is kept in depth-first order so every parent precedes its children. A
+			* node is recalculated only when its own or an ancestor's dirty flag is set, and
+			* branches containing no dirty node are jumped over without being visited. Large
+			* scenes are split into subtrees that are propagated in parallel on the thread pool,
+			* the function returns when all of them are done.
 			*/
 			void updateNodeTransforms();
 
+			/**
+			* Flags a node's position and/or orientation for recalculation, and marks its ancestors
+			* as having a dirty descendant. updateNodeTransforms skips every branch that isn't
+			* marked, so use this rather than setting the node's dirty flags directly, or the
+			* change may not be picked up.
+			* @param node	scene node belonging to this graph
+			*/
+			void markDirty(SceneNode& node, bool positionDirty, bool orientationDirty);
+			void markDirty(SceneNodeId sceneNodeId, bool positionDirty, bool orientationDirty);
+
 			/**
 			* Add a SceneNode component to the entity and incorporate it into the scene graph as a
-			* child of the parentNode. If component already exists in entity, the node is moved to
+			* child of the parentNode. A SceneHierarchy component holding the node's tree links is
+			* added along with it. If component already exists in entity, the node is moved to
 			* the new parent and position.
 			* 
 			* @param entityId	entity to which a SceneNode Component is added
@@ -184,12 +251,16 @@ namespace griffin {
 								   const glm::dquat& rotationLocal, SceneNodeId parentNodeId);
 
 			/**
-			* Removes the SceneNode component from the entity and also fixes up the scene graph.
+			* Removes the SceneNode component and its SceneHierarchy from the entity and also fixes
+			* up the scene graph.
 			* Use this function when you want to remove a specific SceneNode or its entire branch.
+			* A branch is collected once and its SceneNodes are removed in a single pass, so the
+			* cost is linear in the size of the branch.
 			* 
 			* @param sceneNodeId	ComponentId of the SceneNode to remove
-			* @param cascade	If true the node's descendants are given to the node's parent not
-			*			destroyed. If false the node's descendants are removed.
+			* @param cascade	If true the node's descendants are removed. If false the node's
+			*			children are given to the node's parent, except children owned by the
+			*			same entity which are removed along with their branches.
 			* @param removedEntities	vector to push the removed descendant entity ids, not
 			*			including the top removed entity, or nullptr if you don't care. The caller
 			*			is responsible for the vector, this function only uses push_back.
@@ -202,13 +273,12 @@ namespace griffin {
 			* Use this function for entities with many SceneNode branches (not just a single branch
 			* from one root node) when all branches should be removed.
 			* 
-			* @param sceneNodeId	ComponentId of the SceneNode to remove
-			* @param cascade	If true the node's descendants are given to the node's parent not
-			*			destroyed. If false the node's descendants are removed.
+			* @param entityId	entity to remove all SceneNodes from
+			* @param cascade	see removeFromScene
 			* @param removedEntities	vector to push the removed descendant entity ids, not
 			*			including the top removed entity, or nullptr if you don't care. The caller
 			*			is responsible for the vector, this function only uses push_back.
-			* @return	true if removed, false if SceneNode component not present
+			* @return	true if any SceneNode was removed, false if none present
 			*/
 			bool removeEntityFromScene(EntityId entityId, bool cascade = true, std::vector<EntityId>* removedEntities = nullptr);
 
@@ -255,13 +325,34 @@ namespace griffin {
 			/**
 			* Starts at sceneNodeId and push all nodes in its descendant tree into outDescendants.
 			* The caller is responsible for the vector outDescendants, it is not cleared before
-			* pushing the nodes.
+			* pushing the nodes. When the store is in depth-first order the branch is a contiguous
+			* run of the store and is copied directly, otherwise it is traversed.
 			* 
 			* @param sceneNodeId	the parent node of the descendants to collect
 			* @param outDescendants	vector to push_back the descendant SceneNodeIds into
 			*/
 			void collectDescendants(SceneNodeId sceneNodeId, std::vector<SceneNodeId>& outDescendants) const;
 
+			/**
+			* Moves the floating origin. Every node's position relative to it is recalculated in
+			* one pass, world positions stay as they are.
+			*/
+			void setOrigin(const glm::dvec3& origin);
+
+			const glm::dvec3& getOrigin() const {
+				return m_origin;
+			}
+
+			/**
+			* @returns each node's world position relative to the floating origin in float,
+			*	parallel to the SceneNode dense set. Valid after updateNodeTransforms and until
+			*	the next change to the tree, hot loops like culling read these instead of the
+			*	double positions.
+			*/
+			const vector<glm::vec3>& getOriginPositions() const {
+				return m_originPositions;
+			}
+
 			/**
 			* Sets the sceneId of the scene owning this scene graph, stored in SceneNodes
 			*/
@@ -269,21 +360,129 @@ namespace griffin {
 				m_sceneId = sceneId;
 			}
 
+			/**
+			* Creates the component stores owned by the scene graph so a snapshot can be loaded
+			* into them, see EntityManager::readSnapshot
+			*/
+			void createComponentStores();
+
+			/**
+			* Writes the root node to its own section. The rest of the graph lives in the SceneNode
+			* store and is written by EntityManager::writeSnapshot.
+			*/
+			void writeSnapshot(SnapshotWriter& writer) const;
+
+			/**
+			* Restores the root node from a snapshot, throws if the section is missing
+			*/
+			void readSnapshot(const MappedSnapshot& snapshot);
+
 		private:
-			struct BFSQueueItem {
-				SceneNode*	sceneNode;
-				uint8_t		ancestorPositionDirty;
-				uint8_t		ancestorOrientationDirty;
-				glm::dvec3	translationToWorld;
-				glm::dquat	rotationToWorld;
-			};
+			/**
+			* Puts the SceneNode and SceneHierarchy stores into depth-first order and rebuilds
+			* the parent index and subtree size arrays. Runs when the tree structure changed since the last update, in
+			* one linear pass plus one traversal of the linked lists. Adding and removing leaves and
+			* moving subtrees keep the order current without it.
+			*/
+			void rebuildOrder();
+
+			/**
+			* Moves the nodes at dense indices [first, middle) to just after those at [middle, last)
+			* in both stores and the order arrays, remapping parent indices that moved
+			*/
+			void rotateNodes(uint32_t first, uint32_t middle, uint32_t last);
+
+			/**
+			* Adds numNodes to the subtree size of the node at parentIndex and all its ancestors
+			*/
+			void addToSubtreeSizes(uint32_t parentIndex, int32_t numNodes);
+
+			/**
+			* Moves an already relinked node's subtree to the end of its new parent's subtree in
+			* the order, or invalidates the order when the move can't be done in place
+			*/
+			void moveSubtreeInOrder(SceneNodeId sceneNodeId, SceneNodeId moveToParent);
+
+			/**
+			* Recalculates every entry of m_originPositions
+			*/
+			void updateOriginPositions();
+
+			/**
+			* @returns true if the order arrays match the SceneNode store
+			*/
+			bool orderIsCurrent() const;
+
+			/**
+			* Removes the node from its parent's child list, fixing up both neighboring siblings
+			*/
+			void unlinkNode(SceneHierarchy& hierarchy);
+
+			/**
+			* @returns the hierarchy record at the node's dense index, m_rootHierarchy for null
+			*/
+			const SceneHierarchy& getHierarchy(SceneNodeRef sceneNodeRef) const;
+			SceneHierarchy& getHierarchy(SceneNodeRef sceneNodeRef);
+
+			/**
+			* @returns the id of the hierarchy record paired with the node
+			*/
+			ComponentId getHierarchyId(SceneNodeId sceneNodeId) const;
+
+			/**
+			* Adds the hierarchy ids of the given nodes to the end of the same vector in the same
+			* order, so removing the vector erases both stores in the same sequence
+			*/
+			void appendHierarchyIds(std::vector<ComponentId>& sceneNodeIds) const;
+
+			/**
+			* Removes the SceneNodes of an already unlinked branch, the branch is collected once and
+			* its nodes are erased in one pass
+			* @param excludeEntityId	entity whose id is not pushed to removedEntities
+			*/
+			void removeBranch(SceneNodeId sceneNodeId, EntityId excludeEntityId, std::vector<EntityId>* removedEntities);
+
+			/**
+			* Calculates world transforms of the nodes at dense indices [begin, end), parents of
+			* nodes in the range must be in the range or already calculated. Subtrees with no
+			* dirty node are skipped over, orientations are composed in SIMD batches of 4.
+			*/
+			void propagateRange(uint32_t begin, uint32_t end);
+
+			/**
+			* @returns true if nothing in the subtree at dense index i needs recalculation
+			*/
+			bool subtreeIsClean(const SceneNode& node, uint32_t i) const;
+
+			/**
+			* Calculates the top of the tree on this thread until the remaining subtrees are
+			* small enough to deal out, then propagates them in parallel
+			*/
+			void updateNodeTransformsParallel(int numThreads);
 
 			SceneId						m_sceneId = NullId_T;	//<! id of scene this graph belongs to
 			SceneNode					m_rootNode;				//<! root of the scene graph, always start traversal from here
+			SceneHierarchy				m_rootHierarchy;		//<! children of the root node
 
-			vector_queue<BFSQueueItem>	m_bfsQueue;				//<! queue for breadth-first-search traversal of scene graph
 			vector<Id_T>				m_handleBuffer;			//<! buffer used to collect SceneNodeIds and EntityIds in various member functions
 
+			// depth-first order, arrays are parallel to the SceneNode dense set
+			vector<uint32_t>			m_parentIndex;			//<! dense index of each node's parent, or SCENEGRAPH_ROOT_INDEX/SCENEGRAPH_DETACHED_INDEX
+			vector<uint32_t>			m_subtreeSize;			//<! number of nodes in the subtree at each index, including itself
+			vector<uint8_t>				m_propagate;			//<! set during the sweep when a node's world transform changed, read by its children
+			vector<uint32_t>			m_indexBuffer;			//<! buffer used to build the order
+			vector<uint32_t>			m_stackBuffer;			//<! dense indices waiting to be visited while building the order
+			uint32_t					m_numAttached = 0;		//<! nodes reachable from the root, they come first in the order
+			uint32_t					m_orderVersion = 0;		//<! SceneNode store structure version the order was built for
+			bool						m_orderValid = false;	//<! false after a node is relinked
+
+			glm::dvec3					m_origin;				//<! floating origin, see setOrigin
+			vector<glm::vec3>			m_originPositions;		//<! positionWorld - m_origin, parallel to the SceneNode dense set
+			bool						m_originPositionsValid = false;
+
+			vector<uint32_t>			m_subtreeRoots;			//<! subtrees dealt out for parallel propagation
+			vector<uint32_t>			m_chunkStarts;			//<! index into m_subtreeRoots where each chunk starts
+
 			EntityManager&				entityMgr;				//<! reference to the entity manager, set in the constructor
 		};
 
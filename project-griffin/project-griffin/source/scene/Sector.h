@@ -0,0 +1,80 @@
+/**
+* @file Sector.h
+* @author Jeff Kiah
+*/
+#pragma once
+#ifndef GRIFFIN_SECTOR_H_
+#define GRIFFIN_SECTOR_H_
+
+#include <cmath>
+#include <glm/vec3.hpp>
+
+/**
+* Edge length of a sector in world units. Float offsets from a sector center stay within half
+* of this, at 4096 the float step there is under a millimeter.
+*/
+#define SCENE_SECTOR_SIZE			4096.0
+/**
+* How far past its sector's edge the camera goes before the origin follows it, as a fraction of
+* the sector size, so a camera moving along an edge doesn't rebase every frame
+*/
+#define SCENE_SECTOR_REBASE_MARGIN	0.25
+
+
+namespace griffin {
+	namespace scene {
+
+		/**
+		* A world position split into an integer sector and a float offset from the sector's
+		* center. Sectors cover planetary distances with 32 bit indices while the offsets keep
+		* full float precision.
+		*/
+		struct SectorPosition {
+			glm::ivec3	sector;
+			glm::vec3	offset;
+		};
+
+		inline glm::ivec3 getSector(const glm::dvec3& positionWorld)
+		{
+			return glm::ivec3(static_cast<int>(std::floor(positionWorld.x / SCENE_SECTOR_SIZE)),
+							  static_cast<int>(std::floor(positionWorld.y / SCENE_SECTOR_SIZE)),
+							  static_cast<int>(std::floor(positionWorld.z / SCENE_SECTOR_SIZE)));
+		}
+
+		/**
+		* @returns world position of the sector's center
+		*/
+		inline glm::dvec3 getSectorCenter(const glm::ivec3& sector)
+		{
+			return glm::dvec3((sector.x + 0.5) * SCENE_SECTOR_SIZE,
+							  (sector.y + 0.5) * SCENE_SECTOR_SIZE,
+							  (sector.z + 0.5) * SCENE_SECTOR_SIZE);
+		}
+
+		inline SectorPosition toSectorPosition(const glm::dvec3& positionWorld)
+		{
+			SectorPosition sp;
+			sp.sector = getSector(positionWorld);
+			sp.offset = glm::vec3(positionWorld - getSectorCenter(sp.sector));
+			return sp;
+		}
+
+		inline glm::dvec3 toWorldPosition(const SectorPosition& sp)
+		{
+			return getSectorCenter(sp.sector) + glm::dvec3(sp.offset);
+		}
+
+		/**
+		* @returns true if positionWorld is far enough outside originSector that the origin
+		*	should move to the position's sector
+		*/
+		inline bool needsRebase(const glm::ivec3& originSector, const glm::dvec3& positionWorld)
+		{
+			glm::dvec3 d(positionWorld - getSectorCenter(originSector));
+			double limit = SCENE_SECTOR_SIZE * (0.5 + SCENE_SECTOR_REBASE_MARGIN);
+			return (std::abs(d.x) > limit || std::abs(d.y) > limit || std::abs(d.z) > limit);
+		}
+	}
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,32 @@
+/**
+* @file LevelOfDetail.cpp
+* @author Jeff Kiah
+*/
+#include "../LevelOfDetail.h"
+#include <cassert>
+
+using namespace griffin;
+
+
+/**
+* Going finer is checked first. When the object moved closer the coarser loop then can't undo it,
+* since the next LOD's error is over the upper threshold and so over the lower one as well.
+*/
+uint8_t scene::selectLod(const float* lodErrors, uint8_t numLods, uint8_t currentLod,
+						 float errorScale, float errorBudget, float hysteresis)
+{
+	assert(numLods > 0 && "no LODs to select from");
+
+	uint8_t lod = (currentLod < numLods ? currentLod : numLods - 1);
+	float finerThreshold = errorBudget * (1.0f + hysteresis);
+	float coarserThreshold = errorBudget * (1.0f - hysteresis);
+
+	while (lod > 0 && lodErrors[lod] * errorScale > finerThreshold) {
+		--lod;
+	}
+	while (lod + 1 < numLods && lodErrors[lod + 1] * errorScale <= coarserThreshold) {
+		++lod;
+	}
+
+	return lod;
+}
@@ -0,0 +1,40 @@
+/**
+* @file RenderSnapshot.cpp
+* @author Jeff Kiah
+*/
+#include "../RenderSnapshot.h"
+#include <glm/gtc/quaternion.hpp>
+
+using namespace griffin;
+using namespace griffin::scene;
+
+
+void scene::interpolateRenderSnapshots(const RenderSnapshot& prev, const RenderSnapshot& curr,
+									   float interpolation, std::vector<RenderSnapshotEntry>& outEntries)
+{
+	outEntries.clear();
+	outEntries.reserve(curr.entries.size());
+
+	double t = static_cast<double>(interpolation);
+
+	// both lists are sorted by entityId, walk them together
+	auto p = prev.entries.begin();
+	auto pEnd = prev.entries.end();
+
+	for (auto& c : curr.entries) {
+		while (p != pEnd && p->entityId.value < c.entityId.value) {
+			++p;
+		}
+		if (p == pEnd) {
+			break;
+		}
+		if (p->entityId.value != c.entityId.value) {
+			continue;
+		}
+
+		outEntries.push_back(c);
+		auto& out = outEntries.back();
+		out.positionWorld = glm::mix(p->positionWorld, c.positionWorld, t);
+		out.orientationWorld = glm::normalize(glm::lerp(p->orientationWorld, c.orientationWorld, t));
+	}
+}
\ No newline at end of file
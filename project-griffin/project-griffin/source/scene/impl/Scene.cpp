@@ -8,13 +8,21 @@
 #include <utility/memory_reserve.h>
 #include <scene/Camera.h>
 #include <entity/EntityManager.h>
+#include <entity/EntitySnapshot.h>
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <render/Render.h>
 #include <render/geometry/Intersection.h>
 #include <render/model/Model_GL.h>
+#include <render/RenderComponents.h>
 #include <utility/Logger.h>
+#include <utility/concurrency.h>
+#include <utility/simd_transform.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
 
 
 using namespace griffin;
@@ -27,7 +35,30 @@ resource::ResourceLoaderWeakPtr g_resourceLoader;
 
 
 // Forward Declarations
-void interpolateSceneNodes(entity::EntityManager& entityMgr, float interpolation);
+void resolveModelInstances(entity::EntityManager& entityMgr, uint16_t typeId,
+						   const std::vector<entity::ComponentEvent>& added,
+						   const std::vector<entity::ComponentEvent>& removed);
+void updateCameraView(Camera& cam, const glm::dvec3& positionWorld, const glm::dquat& orientationWorld);
+void setViewParameters(render::RenderSystem& render, int8_t viewport, Camera& cam);
+void setSnapshotView(render::RenderSystem& render, int8_t viewport, const RenderSnapshot& snapshot,
+					 const glm::dvec3& positionWorld, const glm::dquat& orientationWorld);
+
+
+namespace {
+	/**
+	* Shared by the threads preparing scenes in one renderActiveScenes, see PropagateJob
+	*/
+	struct PrepareJob {
+		std::atomic<uint32_t>	nextTask;
+		std::atomic<uint32_t>	tasksDone;
+	};
+
+	inline bool isMoving(const scene::MovementComponent& move)
+	{
+		return (move.translationDirty != 0 || move.rotationDirty != 0 ||
+				move.prevTranslationDirty != 0 || move.prevRotationDirty != 0);
+	}
+}
 
 
 // Free functions
@@ -45,6 +76,21 @@ void scene::setResourceLoaderPtr(const resource::ResourceLoaderPtr& resourcePtr)
 
 // class Scene
 
+void Scene::updateFloatingOrigin(const glm::dvec3& cameraPositionWorld)
+{
+	if (!useFloatingOrigin) {
+		return;
+	}
+	// the second test catches the first call and an origin moved by someone else
+	if (needsRebase(originSector, cameraPositionWorld) ||
+		sceneGraph->getOrigin() != getSectorCenter(originSector))
+	{
+		originSector = getSector(cameraPositionWorld);
+		sceneGraph->setOrigin(getSectorCenter(originSector));
+	}
+}
+
+
 uint32_t Scene::createCamera(const CameraParameters& cameraParams, bool makeActive)
 {
 	CameraPtr camPtr = nullptr;
@@ -77,12 +123,104 @@ uint32_t Scene::createCamera(const CameraParameters& cameraParams, bool makeActi
 Scene::Scene(const std::string& _name, bool _active) :
 	entityManager(std::make_shared<EntityManager>()),
 	sceneGraph(std::make_shared<SceneGraph>(*entityManager)),
+	renderSnapshots(std::make_shared<RenderSnapshotBuffer>()),
 	name(_name),
 	active{ _active }
 {
 	cameras.reserve(RESERVE_SCENE_CAMERAS);
 }
 
+/**
+* Copies only, the nodes were brought to the end of the tick and culled by updateActiveScenes.
+* Models are referenced through the ModelInstance's resolved modelPtr, so the render side draws
+* without going to the loader, and each model is held once by the snapshot however many
+* entities share it.
+*/
+void Scene::publishRenderSnapshot(int32_t renderFrustum)
+{
+	using namespace entity;
+	auto& entityMgr = *entityManager;
+
+	auto& snapshot = renderSnapshots->getWriteSnapshot();
+	snapshot.activeRenderCamera = -1;
+	snapshot.renderFrustum = renderFrustum;
+
+	for (auto& camInstance : entityMgr.getComponentStore<CameraInstance>().getComponents().getItems()) {
+		if (camInstance.component.cameraId == activeRenderCamera) {
+			auto& node = entityMgr.getComponent<SceneNode>(camInstance.component.sceneNodeId);
+			auto& cam = *cameras[activeRenderCamera];
+
+			snapshot.activeRenderCamera = activeRenderCamera;
+			snapshot.cameraPositionWorld = node.positionWorld;
+			snapshot.cameraOrientationWorld = node.orientationWorld;
+			snapshot.cameraProjection = cam.getProjectionMatrix();
+			snapshot.cameraNearClip = cam.getNearClip();
+			snapshot.cameraFarClip = cam.getFarClip();
+			break;
+		}
+	}
+
+	auto& rciItems = entityMgr.getComponentStore<RenderCullInfo>().getComponents().getItems();
+	auto& modelIndices = renderSnapshots->getModelIndices();
+	modelIndices.clear();
+	snapshot.models.clear();
+	snapshot.entries.clear();
+	snapshot.entries.reserve(rciItems.size());
+
+	for (auto& rci : rciItems) {
+		auto& node = entityMgr.getComponent<SceneNode>(rci.component.sceneNodeId);
+		auto modelInstance = entityMgr.getEntityComponent<ModelInstance>(rci.entityId);
+
+		RenderSnapshotEntry entry{};
+		entry.positionWorld = node.positionWorld;
+		entry.orientationWorld = node.orientationWorld;
+		entry.entityId = rci.entityId;
+		entry.materialOverrideId = entityMgr.getEntityComponentId(rci.entityId, MaterialOverride_T);
+		entry.modelIndex = RENDER_SNAPSHOT_NO_MODEL;
+		entry.visibleFrustumBits = rci.component.visibleFrustumBits;
+		memcpy(entry.viewspaceBSphere, rci.component.viewspaceBSphere, sizeof(entry.viewspaceBSphere));
+
+		if (modelInstance != nullptr && modelInstance->modelPtr) {
+			auto index = modelIndices.emplace(modelInstance->modelPtr.get(), static_cast<uint32_t>(snapshot.models.size()));
+			if (index.second) {
+				snapshot.models.push_back(modelInstance->modelPtr);
+			}
+			entry.modelIndex = index.first->second;
+		}
+
+		snapshot.entries.push_back(entry);
+	}
+
+	std::sort(snapshot.entries.begin(), snapshot.entries.end(),
+			  [](const RenderSnapshotEntry& a, const RenderSnapshotEntry& b) {
+				  return a.entityId.value < b.entityId.value;
+			  });
+
+	renderSnapshots->publish();
+}
+
+
+void Scene::saveSnapshot(const std::string& filename) const
+{
+	entity::SnapshotWriter writer(filename);
+	entityManager->writeSnapshot(writer);
+	sceneGraph->writeSnapshot(writer);
+	writer.finish();
+}
+
+
+void Scene::loadSnapshot(const std::string& filename)
+{
+	entity::MappedSnapshot snapshot(filename);
+
+	// compile-time component stores must exist before loading, data stores are recreated
+	sceneGraph->createComponentStores();
+
+	entityManager->readSnapshot(snapshot);
+	sceneGraph->readSnapshot(snapshot);
+}
+
+
 Scene::~Scene() {
 	if (cameras.capacity() > RESERVE_SCENE_CAMERAS) {
 		logger.info("check RESERVE_SCENE_CAMERAS: original=%d, highest=%d", RESERVE_SCENE_CAMERAS, cameras.capacity());
@@ -95,19 +233,54 @@ Scene::~Scene() {
 SceneId SceneManager::createScene(const std::string& name, bool makeActive)
 {
 	auto sceneId = m_scenes.emplace(name, makeActive);
-	m_scenes[sceneId].sceneGraph->setSceneId(sceneId);
+	auto& s = m_scenes[sceneId];
+	s.sceneGraph->setSceneId(sceneId);
+
+	// models are resolved once as instances are added or loaded, culling and rendering only
+	//	read modelPtr and never wait on the loader
+	s.entityManager->addComponentObserver(ModelInstance::componentType, resolveModelInstances);
+
 	return sceneId;
 }
 
+/**
+* Sync point of the update frame. Component observers run here, after systems have finished
+* adding and removing components for the tick, so their changes land in the published snapshot.
+* Snapshot scenes are also moved to the end of the tick and culled here, on the update side, so
+* the render side only interpolates and draws what was found visible.
+*/
 void SceneManager::updateActiveScenes()
 {
 	for (auto& s : m_scenes.getItems()) {
 		if (s.active) {
-			// ???
+			s.entityManager->dispatchComponentEvents();
+		}
+		if (s.active && s.useRenderSnapshots) {
+			if (!m_publishScratch) {
+				m_publishScratch = std::make_unique<CullScratch>();
+			}
+			auto& loader = *g_resourceLoader.lock();
+
+			// movement components hold the newly simulated transform in next, apply it in full
+			interpolateSceneNodes(*s.entityManager, *s.sceneGraph, s.movers, 1.0f);
+			s.sceneGraph->updateNodeTransforms();
+
+			Camera* renderCamera = nullptr;
+			int32_t renderFrustum = cullScene(s, *m_publishScratch, renderCamera);
+			applyLodSwitches(s, *m_publishScratch, loader);
+
+			s.publishRenderSnapshot(renderFrustum);
 		}
 	}
 }
 
+/**
+* Live scenes only read and write their own components, so each is prepared as a task on the
+* worker threads and this thread takes tasks too. The renderer, loader and models aren't thread
+* safe, view parameters and render entries are submitted at the join in scene order, which keeps
+* the viewport's queue the same from frame to frame however the tasks were scheduled. LOD switches
+* are loaded after each scene is submitted, its visible entries point at the models they replace.
+*/
 void SceneManager::renderActiveScenes(float interpolation, Engine& engine)
 {
 	auto& render = *g_renderPtr.lock();
@@ -115,134 +288,662 @@ void SceneManager::renderActiveScenes(float interpolation, Engine& engine)
 
 	int8_t activeViewport = 0; // TEMP, hard coded to one viewport
 
+	prepareActiveScenes(interpolation);
+
+	// join, submit in dense scene order
+	uint32_t t = 0;
 	for (auto& s : m_scenes.getItems()) {
+		if (s.active && s.useRenderSnapshots) {
+			renderSceneSnapshots(s, interpolation, activeViewport, engine);
+			continue;
+		}
+		if (!s.active) {
+			continue;
+		}
+
+		auto& task = m_prepareTasks[t++];
+		assert(task.scene == &s && "scene order changed during renderActiveScenes");
+
+		if (task.renderCamera != nullptr) {
+			setViewParameters(render, activeViewport, *task.renderCamera);
+		}
+
 		auto& entityMgr = *s.entityManager;
 
-		if (s.active) {
-			// run the movement system to interpolate all moving nodes in the scene
-			interpolateSceneNodes(entityMgr, interpolation);
-			
-			// traverse scene graph, update world positions and orientations
-			s.sceneGraph->updateNodeTransforms();
+		// render the visible mesh instances
+		if (task.renderFrustum >= 0) {
+			for (auto& visible : s.visibleLists[task.renderFrustum]) {
+				auto& node = entityMgr.getComponent<SceneNode>(visible.sceneNodeId);
+
+				visible.model->render(visible.entityId, node.positionWorld, node.orientationWorld, activeViewport, engine);
+
+				// call "render" function which should only add render entries to the viewport's queue
+				// the renderer will sort the queue and call the object's "draw" function with a callback function pointer
+				/*
+				RenderQueueKey key;
+				key.value = rci.component.renderQueueKey;
+
+				RenderEntry re{};
+				re.entityId = rci.entityId;
+				re.positionWorld = node.positionWorld;
+				re.orientationWorld = node.orientationWorld;
+				*/
+
+				//render.addRenderEntry(activeViewport, key, std::move(re));
+			}
+		}
+
+		// the switches replace models the visible entries point at, the new LODs show next frame
+		applyLodSwitches(s, *task.scratch, loader);
+	}
+}
 
-			// update position/orientation of active camera from the scene graph
-			//	only supports one active camera now, but the active cameras could be extended into a list to support several views
-			for (auto& camInstance : entityMgr.getComponentStore<CameraInstance>().getComponents().getItems()) {
-				if (camInstance.component.cameraId == s.activeRenderCamera) {
-					auto& node = entityMgr.getComponent<SceneNode>(camInstance.component.sceneNodeId);
-					auto& cam = *s.cameras[s.activeRenderCamera];
-
-					cam.setEyePoint(node.positionWorld);
-					cam.setOrientation(node.orientationWorld);
-					cam.calcModelView();
-
-					// set the renderer viewport to the active camera
-					mat4 viewProjMat(cam.getProjectionMatrix() * mat4(cam.getModelViewMatrix()));
-					float frustumDistance = cam.getFarClip() - cam.getNearClip();
-
-					// set viewport 0 which is the main view viewport
-					render.setViewParameters(activeViewport, render::ViewParameters{
-						cam.getModelViewMatrix(),
-						cam.getProjectionMatrix(),
-						viewProjMat,
-						cam.getNearClip(),
-						cam.getFarClip(),
-						frustumDistance,
-						1.0f / frustumDistance
-					});
 
+void SceneManager::prepareActiveScenes(float interpolation)
+{
+	m_prepareTasks.clear();
+	for (auto& s : m_scenes.getItems()) {
+		if (s.active && !s.useRenderSnapshots) {
+			if (m_cullScratch.size() == m_prepareTasks.size()) {
+				m_cullScratch.push_back(std::make_unique<CullScratch>());
+			}
+			ScenePrepareTask task{};
+			task.scene = &s;
+			task.scratch = m_cullScratch[m_prepareTasks.size()].get();
+			m_prepareTasks.push_back(task);
+		}
+	}
+
+	uint32_t numTasks = static_cast<uint32_t>(m_prepareTasks.size());
+	auto& threadPool = task_base::s_threadPool;
+
+	if (numTasks > 1 && threadPool && threadPool->getNumWorkerThreads() > 1) {
+		auto job = std::make_shared<PrepareJob>();
+		job->nextTask = 0;
+		job->tasksDone = 0;
+
+		auto runTasks = [this, job, numTasks, interpolation]() {
+			for (;;) {
+				uint32_t t = job->nextTask.fetch_add(1, std::memory_order_relaxed);
+				if (t >= numTasks) {
 					break;
 				}
+				prepareScene(m_prepareTasks[t], interpolation);
+				job->tasksDone.fetch_add(1, std::memory_order_release);
 			}
+		};
+
+		uint32_t numHelpers = std::min(static_cast<uint32_t>(threadPool->getNumWorkerThreads()), numTasks - 1);
+		for (uint32_t h = 0; h < numHelpers; ++h) {
+			threadPool->run(Thread_Workers, runTasks);
+		}
 
-			// TODO: hard-coded to one frustum, need to support > 1 to get shadow mapping
-			uint32_t activeFrustum = 0;
-			uint32_t frustumMask = 1;
+		// same as the scene graph's propagation, never waits on a helper that hasn't started
+		runTasks();
 
-			// run the frustum culling system to determine visible objects
-			frustumCullActiveScenes();
+		while (job->tasksDone.load(std::memory_order_acquire) < numTasks) {
+			std::this_thread::yield();
+		}
+	}
+	else {
+		for (auto& task : m_prepareTasks) {
+			prepareScene(task, interpolation);
+		}
+	}
+}
+
+
+void SceneManager::prepareScene(ScenePrepareTask& task, float interpolation)
+{
+	auto& s = *task.scene;
+	auto& scratch = *task.scratch;
+
+	// run the movement system to interpolate all moving nodes in the scene
+	interpolateSceneNodes(*s.entityManager, *s.sceneGraph, s.movers, interpolation);
+
+	// traverse scene graph, update world positions and orientations
+	s.sceneGraph->updateNodeTransforms();
+
+	// update the camera, cull, and gather what's left into per-frustum lists
+	task.renderFrustum = cullScene(s, scratch, task.renderCamera);
+	if (task.renderFrustum < 0) {
+		return;
+	}
+	gatherVisibleEntries(*s.entityManager, static_cast<uint32_t>(scratch.cameraIds.size()), s.visibleLists);
+}
+
+
+int32_t SceneManager::cullScene(Scene& s, CullScratch& scratch, Camera*& outRenderCamera)
+{
+	auto& entityMgr = *s.entityManager;
+	outRenderCamera = nullptr;
+	scratch.lodSwitches.clear();
+
+	// update position/orientation of active camera from the scene graph
+	//	only supports one active camera now, but the active cameras could be extended into a list to support several views
+	for (auto& camInstance : entityMgr.getComponentStore<CameraInstance>().getComponents().getItems()) {
+		if (camInstance.component.cameraId == s.activeRenderCamera) {
+			auto& node = entityMgr.getComponent<SceneNode>(camInstance.component.sceneNodeId);
+			auto& cam = *s.cameras[s.activeRenderCamera];
+
+			updateCameraView(cam, node.positionWorld, node.orientationWorld);
+			s.updateFloatingOrigin(node.positionWorld);
+			outRenderCamera = &cam;
+			break;
+		}
+	}
+
+	// run the frustum culling system to determine visible objects, then drop objects
+	//	hidden behind the scene's occluders
+	int32_t renderFrustum = frustumCullScene(s, scratch);
+	if (renderFrustum < 0) {
+		return renderFrustum;
+	}
+	occlusionCullScene(s, scratch, 1U << renderFrustum);
+	selectModelLods(s, scratch, renderFrustum);
 
-			// render all visible mesh instances
-			auto& rciStore = entityMgr.getComponentStore<RenderCullInfo>();
+	return renderFrustum;
+}
+
+
+/**
+* Renders a scene from its published RenderSnapshots without reading live components, so it can
+* run concurrently with the update tick that writes them. Nothing is drawn until the update side
+* has published two snapshots. Visibility is from the end of the newer tick, the camera and
+* entities are interpolated but not culled again.
+*/
+void SceneManager::renderSceneSnapshots(Scene& scene, float interpolation, int8_t viewport, Engine& engine)
+{
+	auto& render = *g_renderPtr.lock();
+	auto& snapshots = *scene.renderSnapshots;
+
+	snapshots.acquire();
+	if (!snapshots.canInterpolate()) {
+		return;
+	}
+
+	auto& prev = snapshots.getPrevious();
+	auto& curr = snapshots.getCurrent();
+	auto& entries = snapshots.getInterpolated();
+
+	if (curr.activeRenderCamera >= 0 && curr.activeRenderCamera == prev.activeRenderCamera) {
+		double t = static_cast<double>(interpolation);
+		setSnapshotView(render, viewport, curr,
+						glm::mix(prev.cameraPositionWorld, curr.cameraPositionWorld, t),
+						glm::normalize(glm::lerp(prev.cameraOrientationWorld, curr.cameraOrientationWorld, t)));
+	}
+	if (curr.renderFrustum < 0) {
+		return;
+	}
+
+	interpolateRenderSnapshots(prev, curr, interpolation, entries);
+
+	uint32_t renderBit = 1U << curr.renderFrustum;
+
+	for (auto& entry : entries) {
+		if ((entry.visibleFrustumBits & renderBit) == 0 || entry.modelIndex == RENDER_SNAPSHOT_NO_MODEL) {
+			continue;
+		}
+		auto& model = curr.models[entry.modelIndex]->getResource<render::Model_GL>();
+
+		model.render(entry.entityId, entry.positionWorld, entry.orientationWorld, viewport, engine);
+	}
+}
+
+
+/**
+* All culled cameras share one origin, the eye point of the first or the scene graph's floating
+* origin, so a sphere is gathered once and tested against every frustum in the same pass. Planes
+* are extracted from the rotation-only view projection and moved to the shared origin in double
+* precision, which keeps the float test exact enough far from the world origin.
+*/
+int32_t SceneManager::frustumCullScene(Scene& scene, CullScratch& scratch)
+{
+	using namespace geometry;
+
+	// bit i of visibleFrustumBits belongs to scratch.cameraIds[i], the render camera is culled
+	// with the next free bit when the scene doesn't list it
+	scratch.cameraIds.assign(scene.cullCameras.begin(), scene.cullCameras.end());
+	int32_t renderFrustum = -1;
+	if (scene.activeRenderCamera >= 0) {
+		auto camIt = std::find(scratch.cameraIds.begin(), scratch.cameraIds.end(), static_cast<uint32_t>(scene.activeRenderCamera));
+		if (camIt == scratch.cameraIds.end()) {
+			camIt = scratch.cameraIds.insert(camIt, static_cast<uint32_t>(scene.activeRenderCamera));
+		}
+		renderFrustum = static_cast<int32_t>(camIt - scratch.cameraIds.begin());
+	}
+
+	const uint32_t* cameraIds = scratch.cameraIds.data();
+	uint32_t numCameras = static_cast<uint32_t>(scratch.cameraIds.size());
+	assert(numCameras <= SCENE_MAX_ACTIVE_CAMERAS && "too many culled cameras");
+
+	auto& entityMgr = *scene.entityManager;
+	auto& rcis = entityMgr.getComponentStore<RenderCullInfo>().getComponents().getItems();
+	if (numCameras == 0 || rcis.empty()) {
+		return renderFrustum;
+	}
+
+	// bring the culled cameras up to date with their scene nodes
+	for (auto& camInstance : entityMgr.getComponentStore<CameraInstance>().getComponents().getItems()) {
+		if (std::find(cameraIds, cameraIds + numCameras, camInstance.component.cameraId) != cameraIds + numCameras) {
+			auto& node = entityMgr.getComponent<SceneNode>(camInstance.component.sceneNodeId);
+			auto& cam = *scene.cameras[camInstance.component.cameraId];
 			
-			// TODO: should we really loop through all components AGAIN? Frustum culling could build a list of entityids instead
-			using namespace entity;
-			for (auto& rci : rciStore.getComponents().getItems()) {
-				// TODO: uncomment this once frustum culling is working
-				//if (rci.component.visibleFrustumBits & frustumMask != 0) {
-				
-				ComponentMask mask = entityMgr.getEntityComponentMask(rci.entityId);
-				
-				// if it's a Model_GL
-				if (mask[ModelInstance::componentType]) {
-					auto modelCmp = *entityMgr.getEntityComponent<ModelInstance>(rci.entityId);
-					auto modelPtr = loader.getResource(modelCmp.modelId, resource::Cache_Models);
-					auto& model = modelPtr->getResource<render::Model_GL>();
-
-					model.render(rci.entityId, s, activeViewport, engine);
-				}
-					//auto& node = entityMgr.getComponent<SceneNode>(rci.component.sceneNodeId);
-					
-					// call "render" function which should only add render entries to the viewport's queue
-					// the renderer will sort the queue and call the object's "draw" function with a callback function pointer
-					/*
-					RenderQueueKey key;
-					key.value = rci.component.renderQueueKey;
-
-					RenderEntry re{};
-					re.entityId = rci.entityId;
-					re.positionWorld = node.positionWorld;
-					re.orientationWorld = node.orientationWorld;
-					*/
-
-					//render.addRenderEntry(activeViewport, key, std::move(re));
-				//}
+			cam.setEyePoint(node.positionWorld);
+			cam.setOrientation(node.orientationWorld);
+			cam.calcModelView();
+		}
+	}
+
+	// extract the frustums relative to the shared origin
+	bool floatingOrigin = scene.useFloatingOrigin;
+	glm::dvec3 origin = floatingOrigin ? scene.sceneGraph->getOrigin() : scene.cameras[cameraIds[0]]->getEyePoint();
+	glm::dvec3 eyeOffset0(scene.cameras[cameraIds[0]]->getEyePoint() - origin);
+	glm::dmat4 viewRotation0;
+
+	scratch.frustums.resize(numCameras);
+	for (uint32_t c = 0; c < numCameras; ++c) {
+		auto& cam = *scene.cameras[cameraIds[c]];
+		cam.calcMatrices();
+
+		glm::dmat4 viewRotation(cam.getModelViewMatrix());
+		viewRotation[3] = glm::dvec4(0.0, 0.0, 0.0, 1.0);
+		if (c == 0) {
+			viewRotation0 = viewRotation;
+		}
+
+		mat4 viewProjMat(cam.getProjectionMatrix() * mat4(viewRotation));
+		auto& frustum = scratch.frustums[c];
+		frustum.extractFromMatrixGL(&viewProjMat[0][0]);
+
+		glm::dvec3 eyeOffset(cam.getEyePoint() - origin);
+		for (int p = 0; p < 6; ++p) {
+			frustum.d[p] = static_cast<float>(frustum.d[p] - (frustum.nx[p] * eyeOffset.x +
+															   frustum.ny[p] * eyeOffset.y +
+															   frustum.nz[p] * eyeOffset.z));
+		}
+	}
+
+	// gather bounding spheres in SoA layout, padding entries have zero radius and are ignored
+	uint32_t numSpheres = static_cast<uint32_t>(rcis.size());
+	uint32_t paddedSize = (numSpheres + 3) & ~3U;
+	scratch.spheres.assign(paddedSize * 4, 0.0f);
+	scratch.visibleBits.resize(paddedSize);
+
+	float* x = scratch.spheres.data();
+	float* y = x + paddedSize;
+	float* z = y + paddedSize;
+	float* r = z + paddedSize;
+
+	// horizon culling needs world positions in double, planets are too large for float
+	bool horizonCull = (renderFrustum >= 0 && scene.horizonOccluderRadius > 0.0);
+	double* hx = nullptr;
+	if (horizonCull) {
+		scratch.horizonSpheres.resize(numSpheres * 4);
+		scratch.horizonVisible.resize(numSpheres);
+		hx = scratch.horizonSpheres.data();
+	}
+	double* hy = hx + numSpheres;
+	double* hz = hy + numSpheres;
+	double* hr = hz + numSpheres;
+
+	// with a floating origin the scene graph already has the positions in float, so the nodes
+	// themselves are only read for horizon culling
+	if (floatingOrigin) {
+		auto& nodeComponents = entityMgr.getComponentStore<SceneNode>().getComponents();
+		auto& originPositions = scene.sceneGraph->getOriginPositions();
+
+		for (uint32_t i = 0; i < numSpheres; ++i) {
+			auto& p = originPositions[nodeComponents.getInnerIndex(rcis[i].component.sceneNodeId)];
+			x[i] = p.x;
+			y[i] = p.y;
+			z[i] = p.z;
+			r[i] = rcis[i].component.boundingRadius;
+		}
+	}
+
+	for (uint32_t i = 0; i < numSpheres && (!floatingOrigin || horizonCull); ++i) {
+		auto& node = entityMgr.getComponent<SceneNode>(rcis[i].component.sceneNodeId);
+		if (!floatingOrigin) {
+			x[i] = static_cast<float>(node.positionWorld.x - origin.x);
+			y[i] = static_cast<float>(node.positionWorld.y - origin.y);
+			z[i] = static_cast<float>(node.positionWorld.z - origin.z);
+			r[i] = rcis[i].component.boundingRadius;
+		}
+
+		if (horizonCull) {
+			hx[i] = node.positionWorld.x;
+			hy[i] = node.positionWorld.y;
+			hz[i] = node.positionWorld.z;
+			hr[i] = r[i];
+		}
+	}
+
+	unsigned int numHorizonVisible = numSpheres;
+	if (horizonCull) {
+		numHorizonVisible = CullHorizonSphereList(hx, hy, hz, hr, numSpheres,
+												  scene.cameras[cameraIds[renderFrustum]]->getEyePoint(),
+												  scene.horizonCenter, scene.horizonOccluderRadius,
+												  scratch.horizonVisible.data());
+	}
+
+	auto& cache = scene.cullCache;
+	if (cache.enabled) {
+		updateCullCache(scene, scratch, numSpheres);
+
+		scratch.eyes.resize(numCameras * 3);
+		for (uint32_t c = 0; c < numCameras; ++c) {
+			glm::dvec3 eyeOffset(scene.cameras[cameraIds[c]]->getEyePoint() - origin);
+			scratch.eyes[c * 3]     = static_cast<float>(eyeOffset.x);
+			scratch.eyes[c * 3 + 1] = static_cast<float>(eyeOffset.y);
+			scratch.eyes[c * 3 + 2] = static_cast<float>(eyeOffset.z);
+		}
+
+		// an inside result may be recorded anywhere within the thresholds of the references and
+		// reused anywhere within them, so the margins cover twice the allowed drift
+		float moveMargin = static_cast<float>(2.0 * (cache.maxCameraMove + cache.maxObjectMove));
+		float turnMargin = static_cast<float>(2.0 * cache.maxCameraTurn);
+
+		CullSphereListMultiCoherent(x, y, z, r, numSpheres, scratch.frustums.data(), scratch.eyes.data(), numCameras,
+									scratch.stillMask, moveMargin, turnMargin,
+									cache.planeCache.data(), scratch.visibleBits.data());
+	}
+	else {
+		CullSphereListMulti_SSE(x, y, z, r, paddedSize, scratch.frustums.data(), numCameras, scratch.visibleBits.data());
+	}
+
+	// objects beyond the horizon are hidden from the render camera only, other cameras like
+	// shadow frustums can still see them
+	if (numHorizonVisible < numSpheres) {
+		uint32_t hiddenMask = ~(1U << renderFrustum);
+		for (uint32_t i = 0, v = 0; i < numSpheres; ++i) {
+			if (v < numHorizonVisible && scratch.horizonVisible[v] == i) {
+				++v;
+			}
+			else {
+				scratch.visibleBits[i] &= hiddenMask;
 			}
 		}
 	}
-}
 
+	for (uint32_t i = 0; i < numSpheres; ++i) {
+		auto& rci = rcis[i].component;
+		rci.visibleFrustumBits = scratch.visibleBits[i];
+
+		glm::dvec4 center(viewRotation0 * glm::dvec4(x[i] - eyeOffset0.x, y[i] - eyeOffset0.y, z[i] - eyeOffset0.z, 1.0));
+		rci.viewspaceBSphere[0] = static_cast<float>(center.x);
+		rci.viewspaceBSphere[1] = static_cast<float>(center.y);
+		rci.viewspaceBSphere[2] = static_cast<float>(center.z);
+		rci.viewspaceBSphere[3] = r[i];
+	}
+
+	return renderFrustum;
+}
 
 /**
-* 1.	After scene nodes are interpolated, update render entry worldspace AABB/quadtree indices.
-* 2.	Filter objects "per camera/frustum" in wordspace using integer AABB/quadtree index
-*		containing frustum against the integer AABB/quadtree index containing object.
-*		Set frustum bit to 1 for each renderable object in each frustum space.
-* 3.	Update filtered entity list viewspace positions and bounding spheres
-* 4.	Frustum cull against view space bounding spheres, set frustum bits back to 0 if culled
-* 5.	Final list of render entries is submitted to renderer. Double-precision world coordinates
-*		are transformed to single-precision in viewspace.
+* Sets scratch.stillMask for the frustums that stayed within the thresholds of their reference
+* pose, and drops the inside results of objects that moved. The cache is reset whenever the
+* RenderCullInfo order or the culled cameras change.
 */
-void SceneManager::frustumCullActiveScenes()
+void SceneManager::updateCullCache(Scene& scene, CullScratch& scratch, uint32_t numObjects)
 {
 	using namespace geometry;
 
-	for (auto& scene : m_scenes) {
-		auto& rciStore = scene.entityManager->getComponentStore<RenderCullInfo>();
-
-		//for (int activeFrustum = 0; activeFrustum < numActiveFrustums; frustumMask <<= 1; ++activeFrustum) {
-			// To do the frustum index, we need an active cameras list, take index into that list for the camera.
-			// Can have > 32 cameras in scene, but only up to 32 active cameras.
-			// Do not simply take the camera index itself, we want the "active camera" index.
-		uint32_t activeFrustum = 0;
-		uint32_t frustumMask = 1;
-		
-			Plane frustumPlanes[6] = {};
-			// TODO: code to get frustum
-
-			for (auto& rci : rciStore.getComponents().getItems()) {
-				auto inside = intersect(frustumPlanes, *reinterpret_cast<Sphere*>(&rci.component.viewspaceBSphere));
-				rci.component.visibleFrustumBits |= frustumMask & (inside != Outside);
+	auto& cache = scene.cullCache;
+	auto& entityMgr = *scene.entityManager;
+	auto& rciStore = entityMgr.getComponentStore<RenderCullInfo>();
+	auto& rcis = rciStore.getComponents().getItems();
+	uint32_t numCameras = static_cast<uint32_t>(scratch.cameraIds.size());
+
+	bool reset = (cache.structureVersion != rciStore.getStructureVersion() ||
+				  cache.cameraIds != scratch.cameraIds ||
+				  cache.objectPositions.size() != numObjects);
+	if (reset) {
+		cache.structureVersion = rciStore.getStructureVersion();
+		cache.cameraIds = scratch.cameraIds;
+		cache.referenceEyes.resize(numCameras);
+		cache.referenceOrientations.resize(numCameras);
+		cache.objectPositions.resize(numObjects);
+		cache.objectRadii.resize(numObjects);
+		cache.planeCache.assign(numObjects * numCameras, CoherentCull_NoPlane);
+
+		for (uint32_t i = 0; i < numObjects; ++i) {
+			cache.objectPositions[i] = entityMgr.getComponent<SceneNode>(rcis[i].component.sceneNodeId).positionWorld;
+			cache.objectRadii[i] = rcis[i].component.boundingRadius;
+		}
+	}
+
+	bool revalidate = reset || (cache.revalidateFrames != 0 && cache.frame % cache.revalidateFrames == 0);
+	++cache.frame;
+
+	scratch.stillMask = 0;
+	for (uint32_t c = 0; c < numCameras; ++c) {
+		auto& cam = *scene.cameras[scratch.cameraIds[c]];
+		glm::dvec3 eye(cam.getEyePoint());
+		auto q = cam.getOrientation();
+		glm::dquat orientation(q.w, q.x, q.y, q.z);
+
+		double moved = glm::length(eye - cache.referenceEyes[c]);
+		double turned = 2.0 * std::acos(glm::min(std::abs(glm::dot(orientation, cache.referenceOrientations[c])), 1.0));
+
+		if (!revalidate && moved < cache.maxCameraMove && turned < cache.maxCameraTurn) {
+			scratch.stillMask |= 1U << c;
+		}
+		else {
+			cache.referenceEyes[c] = eye;
+			cache.referenceOrientations[c] = orientation;
+		}
+	}
+
+	// inside results of a moved object are dropped in every frustum, the next test records new ones
+	const uint8_t keepPlane = static_cast<uint8_t>(~CoherentCull_Inside);
+	double maxMove2 = cache.maxObjectMove * cache.maxObjectMove;
+
+	for (uint32_t i = 0; i < numObjects; ++i) {
+		auto& position = entityMgr.getComponent<SceneNode>(rcis[i].component.sceneNodeId).positionWorld;
+		float radius = rcis[i].component.boundingRadius;
+		glm::dvec3 d(position - cache.objectPositions[i]);
+
+		if (glm::dot(d, d) >= maxMove2 || radius != cache.objectRadii[i]) {
+			cache.objectPositions[i] = position;
+			cache.objectRadii[i] = radius;
+			uint8_t* entries = &cache.planeCache[i * numCameras];
+			for (uint32_t c = 0; c < numCameras; ++c) {
+				entries[c] &= keepPlane;
 			}
-		//}
+		}
+	}
+}
 
-		//for (i = 0; i < gridCell->blockCounts[blockIter]; ++i) {
-			// filter list here (if masks[i] is zero it should be skipped)
-			// ...
-		//}
+
+/**
+* Everything is relative to the render camera's eye, like the frustum culling, so the float
+* buffer stays precise far from the world origin
+*/
+void SceneManager::occlusionCullScene(Scene& scene, CullScratch& scratch, uint32_t frustumMask)
+{
+	if (scene.occluders.empty() || frustumMask == 0) {
+		return;
+	}
+
+	auto& entityMgr = *scene.entityManager;
+	auto& cam = *scene.cameras[scene.activeRenderCamera];
+	glm::dvec3 eye = cam.getEyePoint();
+
+	glm::dmat4 viewRotation(cam.getModelViewMatrix());
+	viewRotation[3] = glm::dvec4(0.0, 0.0, 0.0, 1.0);
+	mat4 viewProjMat(cam.getProjectionMatrix() * mat4(viewRotation));
+
+	scratch.occlusionBuffer.clear();
+	for (auto& occluder : scene.occluders) {
+		auto& node = entityMgr.getComponent<SceneNode>(occluder.sceneNodeId);
+
+		mat4 modelMat(glm::mat4_cast(node.orientationWorld));
+		modelMat[3] = glm::vec4(glm::vec3(node.positionWorld - eye), 1.0f);
+
+		scratch.occlusionBuffer.addOccluder(occluder.vertices.data(), static_cast<uint32_t>(occluder.vertices.size()),
+									  occluder.indices.data(), static_cast<uint32_t>(occluder.indices.size()),
+									  viewProjMat * modelMat);
+	}
+	scratch.occlusionBuffer.rasterize();
+
+	for (auto& rci : entityMgr.getComponentStore<RenderCullInfo>().getComponents().getItems()) {
+		if ((rci.component.visibleFrustumBits & frustumMask) == 0) {
+			continue;
+		}
+		auto& node = entityMgr.getComponent<SceneNode>(rci.component.sceneNodeId);
+		glm::vec3 center(node.positionWorld - eye);
+
+		if (!scratch.occlusionBuffer.isSphereVisible(center, rci.component.boundingRadius, viewProjMat)) {
+			rci.component.visibleFrustumBits &= ~frustumMask;
+		}
+	}
+}
+
+
+/**
+* Distance is measured to the nearest point of the bounding sphere so large objects close to the
+* camera err on the side of detail. Switching LOD swaps the model held by the ModelInstance, the
+* loader keeps recently used models cached so a switch back is cheap.
+*/
+void SceneManager::selectModelLods(Scene& scene, CullScratch& scratch, int32_t renderFrustum)
+{
+	auto& settings = scene.lodSettings;
+	auto& entityMgr = *scene.entityManager;
+	auto& lodStore = entityMgr.getComponentStore<ModelLOD>();
+	if (!settings.enabled || lodStore.getComponents().size() == 0) {
+		return;
+	}
+
+	auto& rciStore = entityMgr.getComponentStore<RenderCullInfo>();
+	auto& modelStore = entityMgr.getComponentStore<ModelInstance>();
+
+	auto& cam = *scene.cameras[scratch.cameraIds[renderFrustum]];
+	glm::dvec3 eye = cam.getEyePoint();
+	float projScaleY = cam.getProjectionMatrix()[1][1];
+	double nearClip = cam.getNearClip();
+	uint32_t renderBit = 1U << renderFrustum;
+
+	auto& lodComponents = lodStore.getComponents();
+	auto& lodItems = lodComponents.getItems();
+
+	for (uint32_t l = 0; l < lodItems.size(); ++l) {
+		auto& lodRecord = lodItems[l];
+		auto& lod = lodRecord.component;
+		assert(lod.numLods > 0 && lod.numLods <= SCENE_MAX_MODEL_LODS && "ModelLOD numLods out of range");
+
+		if (lod.renderCullInfoId == NullId_T || !rciStore.getComponents().isValid(lod.renderCullInfoId)) {
+			lod.renderCullInfoId = entityMgr.getEntityComponentId(lodRecord.entityId, RenderCullInfo::componentType);
+			if (lod.renderCullInfoId == NullId_T) {
+				continue;
+			}
+		}
+
+		auto& rci = rciStore.getComponent(lod.renderCullInfoId);
+		if ((rci.visibleFrustumBits & renderBit) == 0) {
+			continue;
+		}
+
+		auto& node = entityMgr.getComponent<SceneNode>(rci.sceneNodeId);
+		double distance = glm::max(glm::length(node.positionWorld - eye) - rci.boundingRadius, nearClip);
+		float errorScale = getScreenErrorScale(projScaleY, settings.viewportHeight, distance);
+
+		uint8_t newLod = selectLod(lod.lodErrors, lod.numLods, lod.currentLod,
+								   errorScale, settings.errorBudget, settings.hysteresis);
+		if (newLod == lod.currentLod) {
+			continue;
+		}
+
+		if (lod.modelInstanceId == NullId_T || !modelStore.getComponents().isValid(lod.modelInstanceId)) {
+			lod.modelInstanceId = entityMgr.getEntityComponentId(lodRecord.entityId, ModelInstance::componentType);
+			if (lod.modelInstanceId == NullId_T) {
+				continue;
+			}
+		}
+
+		scratch.lodSwitches.push_back({ lodComponents.getHandleForInnerIndex(l), newLod });
 	}
 }
 
+
+/**
+* A model that fails to load leaves the LOD where it was, it is selected again next frame
+*/
+void SceneManager::applyLodSwitches(Scene& scene, CullScratch& scratch, resource::ResourceLoader& loader)
+{
+	auto& entityMgr = *scene.entityManager;
+	auto& lodStore = entityMgr.getComponentStore<ModelLOD>();
+	auto& modelStore = entityMgr.getComponentStore<ModelInstance>();
+
+	for (auto& lodSwitch : scratch.lodSwitches) {
+		auto& lod = lodStore.getMutable(lodSwitch.lodId);
+		Id_T modelId = lod.lodModelIds[lodSwitch.newLod];
+
+		auto modelPtr = loader.getResource(modelId, resource::Cache_Models);
+		if (!modelPtr) {
+			logger.warn("model %llu of LOD %u not found", (unsigned long long)modelId.value, (unsigned int)lodSwitch.newLod);
+			continue;
+		}
+
+		auto& modelInstance = modelStore.getMutable(lod.modelInstanceId);
+		modelInstance.modelId = modelId;
+		modelInstance.modelPtr = std::move(modelPtr);
+		lod.currentLod = lodSwitch.newLod;
+	}
+	scratch.lodSwitches.clear();
+}
+
+
+/**
+* One pass over the RenderCullInfo store after all culling stages. Component ids are resolved the
+* first time an object is seen and cached in its components, models were already resolved by
+* resolveModelInstances when the ModelInstance was added.
+*/
+void scene::gatherVisibleEntries(entity::EntityManager& entityMgr, uint32_t numLists,
+								 std::vector<std::vector<VisibleEntry>>& visibleLists)
+{
+	auto& modelStore = entityMgr.getComponentStore<ModelInstance>();
+
+	visibleLists.resize(numLists);
+	for (auto& list : visibleLists) {
+		list.clear();
+	}
+
+	for (auto& rci : entityMgr.getComponentStore<RenderCullInfo>().getComponents().getItems()) {
+		uint32_t bits = rci.component.visibleFrustumBits;
+		if (bits == 0) {
+			continue;
+		}
+
+		auto& modelInstanceId = rci.component.modelInstanceId;
+		if (modelInstanceId == ModelInstanceRef{} || !modelStore.getComponents().isValid(modelInstanceId)) {
+			modelInstanceId = ModelInstanceRef::fromId(
+				entityMgr.getEntityComponentId(rci.entityId, ModelInstance::componentType));
+			if (modelInstanceId == ModelInstanceRef{}) {
+				continue;
+			}
+		}
+
+		auto& modelInstance = modelStore.getComponent(modelInstanceId);
+		if (!modelInstance.modelPtr) {
+			continue;
+		}
+
+		VisibleEntry entry{
+			rci.entityId,
+			rci.component.sceneNodeId,
+			&modelInstance.modelPtr->getResource<render::Model_GL>()
+		};
+
+		for (uint32_t f = 0; bits != 0; ++f, bits >>= 1) {
+			if (bits & 1) {
+				visibleLists[f].push_back(entry);
+			}
+		}
+	}
+}
+
+
 SceneManager::SceneManager() :
 	m_scenes(0, RESERVE_SCENEMANAGER_SCENES)
 {}
@@ -256,49 +957,238 @@ SceneManager::~SceneManager() {
 
 // Free functions
 
-void interpolateSceneNodes(entity::EntityManager& entityMgr, float interpolation)
+/**
+* Only the movers in the list are touched. Writes since the last call bring components into
+* the list, rotations and translations still interpolating go through the simd kernels 4 at a
+* time, and movers that have come to rest are dropped until their next write.
+*/
+void scene::interpolateSceneNodes(entity::EntityManager& entityMgr, SceneGraph& sceneGraph,
+								  MoverCache& movers, float interpolation)
 {
-	auto& moveComponents = entityMgr.getComponentStore<scene::MovementComponent>().getComponents();
+	using namespace simd;
 
-	for (auto& move : moveComponents.getItems()) {
-		if (move.component.rotationDirty == 0 && move.component.prevRotationDirty == 0 &&
-			move.component.translationDirty == 0 && move.component.prevTranslationDirty == 0)
-		{
-			continue;
+	auto& moveStore = entityMgr.getComponentStore<scene::MovementComponent>();
+	auto& nodeStore = entityMgr.getComponentStore<SceneNode>();
+	auto& moveItems = moveStore.getComponents().getItems();
+	auto& nodeItems = nodeStore.getComponents().getItems();
+	uint32_t numMoves = static_cast<uint32_t>(moveItems.size());
+
+	// dense indices have moved, start over from every component
+	movers.changed.clear();
+	if (movers.moveStructureVersion != moveStore.getStructureVersion() ||
+		movers.listPositions.size() != numMoves)
+	{
+		movers.moveStructureVersion = moveStore.getStructureVersion();
+		movers.moveIndices.clear();
+		movers.nodeIndices.clear();
+		movers.listPositions.assign(numMoves, UINT32_MAX);
+		for (uint32_t m = 0; m < numMoves; ++m) {
+			movers.changed.push_back(m);
 		}
+	}
+	else {
+		moveStore.getChangedSince(movers.sinceVersion, movers.changed);
+	}
+	movers.sinceVersion = moveStore.advanceVersion();
+
+	// the scene graph reorders scene nodes, look up the nodes of existing movers again
+	if (movers.nodeStructureVersion != nodeStore.getStructureVersion()) {
+		movers.nodeStructureVersion = nodeStore.getStructureVersion();
+		for (uint32_t i = 0; i < movers.moveIndices.size(); ++i) {
+			auto& move = moveItems[movers.moveIndices[i]].component;
+			movers.nodeIndices[i] = nodeStore.getComponents().getInnerIndex(move.sceneNodeId);
+		}
+	}
+
+	for (uint32_t m : movers.changed) {
+		auto& move = moveItems[m].component;
+		if (movers.listPositions[m] == UINT32_MAX && isMoving(move)) {
+			assert(nodeStore.getComponents().isValid(move.sceneNodeId) && "MovementComponent scene node is invalid");
+			movers.listPositions[m] = static_cast<uint32_t>(movers.moveIndices.size());
+			movers.moveIndices.push_back(m);
+			movers.nodeIndices.push_back(nodeStore.getComponents().getInnerIndex(move.sceneNodeId));
+		}
+	}
 
-		auto& node = entityMgr.getComponent<scene::SceneNode>(move.component.sceneNodeId);
+	uint32_t numMovers = static_cast<uint32_t>(movers.moveIndices.size());
+	double t = static_cast<double>(interpolation);
 
-		// nlerp the rotation
-		if (move.component.rotationDirty == 1) {
-			node.rotationLocal = 
-				glm::normalize(
-					glm::lerp(
-						move.component.prevRotation,
-						move.component.nextRotation,
-						static_cast<double>(interpolation)));
-			node.orientationDirty = 1;
+	// nlerp the rotations
+	movers.batch.clear();
+	for (uint32_t i = 0; i < numMovers; ++i) {
+		auto& move = moveItems[movers.moveIndices[i]].component;
+		if (move.rotationDirty == 1) {
+			movers.batch.push_back(i);
 		}
 		// This is needed when rotation stops to ensure the orientation isn't left where the last
 		// interpolation step put it, which is most likely approaching but not quite reaching the
 		// target "next" orientation. We continue interpolating for one frame beyond movement
 		// stopping so the orientation can be set to the exact simulated value.
-		else if (move.component.prevRotationDirty == 1) {
-			node.rotationLocal = move.component.nextRotation;
-			node.orientationDirty = 1;
-			move.component.prevRotationDirty = 0;
+		else if (move.prevRotationDirty == 1) {
+			auto& node = nodeItems[movers.nodeIndices[i]].component;
+			node.rotationLocal = move.nextRotation;
+			sceneGraph.markDirty(node, false, true);
+			move.prevRotationDirty = 0;
+		}
+	}
+
+	uint32_t batchSize = static_cast<uint32_t>(movers.batch.size());
+	for (uint32_t b = 0; b < batchSize; b += 4) {
+		uint32_t lanes = std::min(batchSize - b, 4U);
+		DQuat4 prev, next;
+
+		// a short batch repeats its last mover in the unused lanes
+		for (uint32_t l = 0; l < 4; ++l) {
+			auto& move = moveItems[movers.moveIndices[movers.batch[b + std::min(l, lanes - 1)]]].component;
+			prev.x[l] = move.prevRotation.x; prev.y[l] = move.prevRotation.y;
+			prev.z[l] = move.prevRotation.z; prev.w[l] = move.prevRotation.w;
+			next.x[l] = move.nextRotation.x; next.y[l] = move.nextRotation.y;
+			next.z[l] = move.nextRotation.z; next.w[l] = move.nextRotation.w;
+		}
+
+		nlerpDQuat4(prev, next, t, prev);
+
+		for (uint32_t l = 0; l < lanes; ++l) {
+			auto& node = nodeItems[movers.nodeIndices[movers.batch[b + l]]].component;
+			node.rotationLocal = glm::dquat(prev.w[l], prev.x[l], prev.y[l], prev.z[l]);
+			sceneGraph.markDirty(node, false, true);
+		}
+	}
+
+	// mix the translations
+	movers.batch.clear();
+	for (uint32_t i = 0; i < numMovers; ++i) {
+		auto& move = moveItems[movers.moveIndices[i]].component;
+		if (move.translationDirty == 1) {
+			movers.batch.push_back(i);
 		}
+		else if (move.prevTranslationDirty == 1) {
+			auto& node = nodeItems[movers.nodeIndices[i]].component;
+			node.translationLocal = move.nextTranslation;
+			sceneGraph.markDirty(node, true, false);
+			move.prevTranslationDirty = 0;
+		}
+	}
+
+	batchSize = static_cast<uint32_t>(movers.batch.size());
+	for (uint32_t b = 0; b < batchSize; b += 4) {
+		uint32_t lanes = std::min(batchSize - b, 4U);
+		DVec3_4 prev, next;
+
+		for (uint32_t l = 0; l < 4; ++l) {
+			auto& move = moveItems[movers.moveIndices[movers.batch[b + std::min(l, lanes - 1)]]].component;
+			prev.x[l] = move.prevTranslation.x; prev.y[l] = move.prevTranslation.y; prev.z[l] = move.prevTranslation.z;
+			next.x[l] = move.nextTranslation.x; next.y[l] = move.nextTranslation.y; next.z[l] = move.nextTranslation.z;
+		}
+
+		mixDVec3_4(prev, next, t, prev);
+
+		for (uint32_t l = 0; l < lanes; ++l) {
+			auto& node = nodeItems[movers.nodeIndices[movers.batch[b + l]]].component;
+			node.translationLocal = glm::dvec3(prev.x[l], prev.y[l], prev.z[l]);
+			sceneGraph.markDirty(node, true, false);
+		}
+	}
+
+	// drop movers that have come to rest, swapping the last one into the hole
+	for (uint32_t i = 0; i < movers.moveIndices.size();) {
+		uint32_t m = movers.moveIndices[i];
+		if (isMoving(moveItems[m].component)) {
+			++i;
+			continue;
+		}
+		movers.listPositions[m] = UINT32_MAX;
+		movers.moveIndices[i] = movers.moveIndices.back();
+		movers.nodeIndices[i] = movers.nodeIndices.back();
+		movers.moveIndices.pop_back();
+		movers.nodeIndices.pop_back();
+		if (i < movers.moveIndices.size()) {
+			movers.listPositions[movers.moveIndices[i]] = i;
+		}
+	}
+}
+
+
+/**
+* ModelInstance observer, runs at the update frame's sync point on the thread that owns the
+* loader. Instances without a modelId, or whose model isn't found, stay unresolved and aren't
+* drawn.
+*/
+void resolveModelInstances(entity::EntityManager& entityMgr, uint16_t typeId,
+						   const std::vector<entity::ComponentEvent>& added,
+						   const std::vector<entity::ComponentEvent>& removed)
+{
+	auto loaderPtr = g_resourceLoader.lock();
+	if (!loaderPtr) {
+		return;
+	}
+	auto& modelStore = entityMgr.getComponentStore<ModelInstance>();
 
-		if (move.component.translationDirty == 1) {
-			node.translationLocal = glm::mix(move.component.prevTranslation,
-											 move.component.nextTranslation,
-											 static_cast<double>(interpolation));
-			node.positionDirty = 1;
+	for (auto& event : added) {
+		if (!modelStore.getComponents().isValid(event.componentId)) {
+			continue;
+		}
+		auto& modelInstance = modelStore.getComponent(event.componentId);
+		if (modelInstance.modelPtr || modelInstance.modelId == NullId_T) {
+			continue;
 		}
-		else if (move.component.prevTranslationDirty == 1) {
-			node.translationLocal = move.component.nextTranslation;
-			node.positionDirty = 1;
-			move.component.prevTranslationDirty = 0;
+
+		modelInstance.modelPtr = loaderPtr->getResource(modelInstance.modelId, resource::Cache_Models);
+		if (!modelInstance.modelPtr) {
+			logger.warn("model %llu of entity %llu not found",
+						(unsigned long long)modelInstance.modelId.value, (unsigned long long)event.entityId.value);
 		}
 	}
 }
+
+
+void updateCameraView(Camera& cam, const glm::dvec3& positionWorld, const glm::dquat& orientationWorld)
+{
+	cam.setEyePoint(positionWorld);
+	cam.setOrientation(orientationWorld);
+	cam.calcModelView();
+}
+
+
+void setViewParameters(render::RenderSystem& render, int8_t viewport, Camera& cam)
+{
+	// set the renderer viewport to the active camera
+	mat4 viewProjMat(cam.getProjectionMatrix() * mat4(cam.getModelViewMatrix()));
+	float frustumDistance = cam.getFarClip() - cam.getNearClip();
+
+	render.setViewParameters(viewport, render::ViewParameters{
+		cam.getModelViewMatrix(),
+		cam.getProjectionMatrix(),
+		viewProjMat,
+		cam.getNearClip(),
+		cam.getFarClip(),
+		frustumDistance,
+		1.0f / frustumDistance
+	});
+}
+
+
+/**
+* Same view matrix as Camera::calcModelView, built from an interpolated snapshot camera without
+* touching the scene's Camera
+*/
+void setSnapshotView(render::RenderSystem& render, int8_t viewport, const RenderSnapshot& snapshot,
+					 const glm::dvec3& positionWorld, const glm::dquat& orientationWorld)
+{
+	glm::dmat3 rotation(glm::transpose(glm::mat3_cast(orientationWorld)));
+	glm::dmat4 viewMat(rotation);
+	viewMat[3] = glm::dvec4(-(rotation * positionWorld), 1.0);
+
+	mat4 viewProjMat(snapshot.cameraProjection * mat4(viewMat));
+	float frustumDistance = snapshot.cameraFarClip - snapshot.cameraNearClip;
+
+	render.setViewParameters(viewport, render::ViewParameters{
+		viewMat,
+		snapshot.cameraProjection,
+		viewProjMat,
+		snapshot.cameraNearClip,
+		snapshot.cameraFarClip,
+		frustumDistance,
+		1.0f / frustumDistance
+	});
+}
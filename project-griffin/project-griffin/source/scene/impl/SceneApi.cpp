@@ -25,18 +25,22 @@ namespace griffin {
 		
 		if (movable) {
 			scene::MovementComponent mc{};
-			mc.sceneNodeId = sceneNodeId;
+			mc.sceneNodeId = scene::SceneNodeRef::fromId(sceneNodeId);
 
 			s.entityManager->addComponentToEntity(std::move(mc), entityId);
 		}
+		else {
+			s.entityManager->addTagToEntity(entity::Static_Tag, entityId);
+		}
 
 		return entityId;
 	}
 
 
-	// TODO: pass in model resource id, position, orientation and scale
+	// TODO: pass in position, orientation and scale
 	EntityId createNewModelInstance(
 		SceneId sceneId,
+		Id_T modelId,
 		bool movable,
 		SceneNodeId parentNode)
 	{
@@ -47,8 +51,8 @@ namespace griffin {
 
 		// add a ModelInstance component
 		scene::ModelInstance mi{};
-		mi.sceneNodeId = sceneNodeId;
-		//mi.modelId = ?;
+		mi.sceneNodeId = scene::SceneNodeRef::fromId(sceneNodeId);
+		mi.modelId = modelId; // modelPtr is resolved by the scene's ModelInstance observer
 
 		s.entityManager->addComponentToEntity(std::move(mi), entityId);
 
@@ -70,7 +74,7 @@ namespace griffin {
 		auto movementId  = s.entityManager->getEntityComponentId(entityId, scene::MovementComponent::componentType);
 
 		scene::CameraInstance ci{};
-		ci.sceneNodeId = sceneNodeId;
+		ci.sceneNodeId = scene::SceneNodeRef::fromId(sceneNodeId);
 		ci.movementId = movementId;
 		bool makePrimary = (s.cameras.size() == 0); // if this is the first camera in the scene, make it primary
 		ci.cameraId = s.createCamera(cameraParams, makePrimary);
@@ -111,11 +115,17 @@ extern "C" {
 	uint64_t griffin_scene_createDataComponentStore(uint64_t scene, uint16_t typeId,
 													uint32_t componentSize, size_t reserve)
 	{
-		SceneId sceneId;
-		sceneId.value = scene;
+		try {
+			SceneId sceneId;
+			sceneId.value = scene;
 
-		auto& s = g_sceneMgrPtr->getScene(sceneId);
-		return s.entityManager->createDataComponentStore(typeId, componentSize, reserve);
+			auto& s = g_sceneMgrPtr->getScene(sceneId);
+			return s.entityManager->createDataComponentStore(typeId, componentSize, reserve);
+		}
+		catch (std::exception ex) {
+			logger.error("griffin_scene_createDataComponentStore: %s", ex.what());
+		}
+		return 0;
 	}
 
 
@@ -143,6 +153,39 @@ extern "C" {
 	}
 
 
+	bool griffin_scene_getDataComponentStoreView(uint64_t scene, uint16_t typeId, griffin_DataComponentStoreView* outView)
+	{
+		memset(outView, 0, sizeof(griffin_DataComponentStoreView));
+
+		try {
+			SceneId sceneId;
+			sceneId.value = scene;
+
+			auto& s = g_sceneMgrPtr->getScene(sceneId);
+			auto& entityMgr = *s.entityManager;
+
+			uint32_t count = 0;
+			uint32_t stride = 0;
+			auto items = reinterpret_cast<uint8_t*>(entityMgr.getDataComponentItems(typeId, count, stride));
+			if (items == nullptr) {
+				return false;
+			}
+
+			// the record is the component followed by its EntityId
+			outView->components = items;
+			outView->entityIds = items + stride - sizeof(EntityId);
+			outView->count = count;
+			outView->stride = stride;
+			outView->componentSize = entityMgr.getDataComponentSize(typeId);
+			return true;
+		}
+		catch (std::exception ex) {
+			logger.error("griffin_scene_getDataComponentStoreView: %s", ex.what());
+		}
+		return false;
+	}
+
+
 	// Scene Node functions
 
 	uint64_t griffin_scene_createNewSceneNode(
@@ -180,7 +223,7 @@ extern "C" {
 			Id_T modelId{};
 			modelId.value = model;
 			
-			auto entityId = createNewModelInstance(sceneId, movable, /*modelId,*/ parentNodeId);
+			auto entityId = createNewModelInstance(sceneId, modelId, movable, parentNodeId);
 			return entityId.value;
 		}
 		catch (std::exception ex) {
@@ -5,72 +5,438 @@
 #include "../SceneGraph.h"
 #include <utility/memory_reserve.h>
 #include <entity/EntityManager.h>
+#include <entity/EntitySnapshot.h>
 #include <utility/Logger.h>
+#include <utility/concurrency.h>
+#include <utility/simd_transform.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
 
+using namespace griffin;
 using namespace griffin::scene;
 
 
 // class SceneGraph
 
+namespace {
+	/**
+	* Shared by the threads taking part in one parallel propagation. Helpers hold a shared_ptr,
+	* so a helper that starts late, after the caller already finished every chunk, still finds
+	* valid counters, sees there is nothing left to take, and returns without touching the graph.
+	*/
+	struct PropagateJob {
+		std::atomic<uint32_t>	nextChunk;
+		std::atomic<uint32_t>	chunksDone;
+	};
+
+	enum PropagateFlags : uint8_t {
+		Propagate_Position		= 1,
+		Propagate_Orientation	= 2
+	};
+}
+
+
 void SceneGraph::updateNodeTransforms()
 {
-	// get the SceneNode components
+	if (!orderIsCurrent()) {
+		rebuildOrder();
+	}
+
+	// propagation is skipped when nothing has been marked since the last update
+	if (m_rootNode.descendantDirty != 0) {
+		m_rootNode.descendantDirty = 0;
+
+		uint32_t numNodes = static_cast<uint32_t>(m_parentIndex.size());
+		auto& threadPool = task_base::s_threadPool;
+
+		if (threadPool && threadPool->getNumWorkerThreads() > 1 &&
+			numNodes >= SCENEGRAPH_PARALLEL_MIN_NODES)
+		{
+			updateNodeTransformsParallel(threadPool->getNumWorkerThreads());
+		}
+		else {
+			propagateRange(0, numNodes);
+		}
+	}
+
+	// the propagation keeps moved nodes current, a reorder needs every node redone
+	if (!m_originPositionsValid) {
+		updateOriginPositions();
+	}
+}
+
+
+void SceneGraph::setOrigin(const glm::dvec3& origin)
+{
+	m_origin = origin;
+	if (orderIsCurrent()) {
+		updateOriginPositions();
+	}
+	else {
+		m_originPositionsValid = false;
+	}
+}
+
+
+void SceneGraph::updateOriginPositions()
+{
+	auto& nodeItems = entityMgr.getComponentStore<SceneNode>().getComponents().getItems();
+	uint32_t numNodes = static_cast<uint32_t>(nodeItems.size());
+
+	m_originPositions.resize(numNodes);
+	for (uint32_t i = 0; i < numNodes; ++i) {
+		m_originPositions[i] = glm::vec3(nodeItems[i].component.positionWorld - m_origin);
+	}
+	m_originPositionsValid = true;
+}
+
+
+void SceneGraph::markDirty(SceneNode& node, bool positionDirty, bool orientationDirty)
+{
+	if (positionDirty) { node.positionDirty = 1; }
+	if (orientationDirty) { node.orientationDirty = 1; }
+
+	// the node's dense index locates its hierarchy record, the component is the first member of
+	// its ComponentRecord
+	typedef ComponentStore<SceneNode>::ComponentRecord NodeRecord;
 	auto& nodeComponents = entityMgr.getComponentStore<SceneNode>().getComponents();
 	auto& nodeItems = nodeComponents.getItems();
+	auto& hierItems = entityMgr.getComponentStore<SceneHierarchy>().getComponents().getItems();
+
+	size_t innerIndex = reinterpret_cast<const NodeRecord*>(&node) - nodeItems.data();
+	assert(innerIndex < nodeItems.size() && "node does not belong to this scene graph");
+
+	// mark ancestors up to the first one that's already marked, its ancestors are marked too
+	auto parentRef = hierItems[innerIndex].component.parent;
+
+	while (parentRef != NullSceneNodeRef) {
+		innerIndex = nodeComponents.getInnerIndex(parentRef);
+		auto& parent = nodeItems[innerIndex].component;
+		if (parent.descendantDirty == 1) {
+			return;
+		}
+		parent.descendantDirty = 1;
+		parentRef = hierItems[innerIndex].component.parent;
+	}
+	m_rootNode.descendantDirty = 1;
+}
+
+
+void SceneGraph::markDirty(SceneNodeId sceneNodeId, bool positionDirty, bool orientationDirty)
+{
+	auto& nodeComponents = entityMgr.getComponentStore<SceneNode>().getComponents();
+	markDirty(nodeComponents[sceneNodeId].component, positionDirty, orientationDirty);
+}
+
+
+bool SceneGraph::orderIsCurrent() const
+{
+	auto& store = entityMgr.getComponentStore<SceneNode>();
+	assert(store.getComponents().size() == entityMgr.getComponentStore<SceneHierarchy>().getComponents().size() &&
+		   "SceneNode and SceneHierarchy stores out of step, add and remove nodes through the SceneGraph");
+
+	return m_orderValid &&
+		m_orderVersion == store.getStructureVersion() &&
+		m_parentIndex.size() == store.getComponents().size();
+}
+
+
+void SceneGraph::rebuildOrder()
+{
+	auto& store = entityMgr.getComponentStore<SceneNode>();
+	auto& hierStore = entityMgr.getComponentStore<SceneHierarchy>();
+	auto& nodeComponents = store.getComponents();
+	auto& hierItems = hierStore.getComponents().getItems();
+	uint32_t numNodes = static_cast<uint32_t>(nodeComponents.size());
+
+	// depth-first preorder from the root, each subtree ends up contiguous
+	auto& order = m_indexBuffer;
+	order.clear();
+	order.reserve(numNodes);
+
+	m_parentIndex.assign(numNodes, SCENEGRAPH_DETACHED_INDEX);
+
+	m_stackBuffer.clear();
+	auto childRef = m_rootHierarchy.firstChild;
+	for (uint32_t c = 0; c < m_rootHierarchy.numChildren; ++c) {
+		uint32_t childIndex = nodeComponents.getInnerIndex(childRef);
+		m_stackBuffer.push_back(childIndex);
+		childRef = hierItems[childIndex].component.nextSibling;
+	}
+
+	while (!m_stackBuffer.empty()) {
+		uint32_t innerIndex = m_stackBuffer.back();
+		m_stackBuffer.pop_back();
+
+		m_parentIndex[innerIndex] = SCENEGRAPH_ROOT_INDEX; // marks reached, real value set below
+		order.push_back(innerIndex);
+
+		auto& hierarchy = hierItems[innerIndex].component;
+		childRef = hierarchy.firstChild;
+		for (uint32_t c = 0; c < hierarchy.numChildren; ++c) {
+			assert(childRef != NullSceneNodeRef && "expected scene node is null, broken linked list or numChildren out of sync");
+			uint32_t childIndex = nodeComponents.getInnerIndex(childRef);
+			m_stackBuffer.push_back(childIndex);
+			childRef = hierItems[childIndex].component.nextSibling;
+		}
+	}
+
+	// nodes that aren't linked into the tree go last, they're never updated
+	uint32_t numReached = static_cast<uint32_t>(order.size());
+	for (uint32_t i = 0; i < numNodes; ++i) {
+		if (m_parentIndex[i] == SCENEGRAPH_DETACHED_INDEX) {
+			order.push_back(i);
+		}
+	}
+
+	bool inOrder = true;
+	for (uint32_t i = 0; i < numNodes && inOrder; ++i) {
+		inOrder = (order[i] == i);
+	}
+	if (!inOrder) {
+		store.reorder(order);
+		hierStore.reorder(order);
+	}
+
+	// with the stores in order, parent handles resolve directly to the new dense indices
+	for (uint32_t i = 0; i < numNodes; ++i) {
+		auto parentRef = hierItems[i].component.parent;
+		m_parentIndex[i] = (i >= numReached) ? SCENEGRAPH_DETACHED_INDEX
+						 : (parentRef == NullSceneNodeRef) ? SCENEGRAPH_ROOT_INDEX
+						 : nodeComponents.getInnerIndex(parentRef);
+	}
+
+	// children follow their parent, so walking backwards accumulates complete subtrees
+	m_subtreeSize.assign(numNodes, 1);
+	for (uint32_t i = numNodes; i-- > 0;) {
+		uint32_t p = m_parentIndex[i];
+		if (p < SCENEGRAPH_DETACHED_INDEX) {
+			m_subtreeSize[p] += m_subtreeSize[i];
+		}
+	}
+
+	m_propagate.assign(numNodes, 0);
+	m_originPositions.resize(numNodes);
+	m_originPositionsValid = false;
+
+	m_numAttached = numReached;
+	m_orderVersion = store.getStructureVersion();
+	m_orderValid = true;
+}
+
+
+void SceneGraph::rotateNodes(uint32_t first, uint32_t middle, uint32_t last)
+{
+	if (first == middle || middle == last) {
+		return;
+	}
+
+	entityMgr.getComponentStore<SceneNode>().rotate(first, middle, last);
+	entityMgr.getComponentStore<SceneHierarchy>().rotate(first, middle, last);
+
+	std::rotate(m_parentIndex.begin() + first, m_parentIndex.begin() + middle, m_parentIndex.begin() + last);
+	std::rotate(m_subtreeSize.begin() + first, m_subtreeSize.begin() + middle, m_subtreeSize.begin() + last);
+	std::rotate(m_propagate.begin() + first, m_propagate.begin() + middle, m_propagate.begin() + last);
+	std::rotate(m_originPositions.begin() + first, m_originPositions.begin() + middle, m_originPositions.begin() + last);
+
+	// parents come before their children, so only nodes from first on can have a parent that moved
+	uint32_t numNodes = static_cast<uint32_t>(m_parentIndex.size());
+	for (uint32_t i = first; i < numNodes; ++i) {
+		uint32_t& p = m_parentIndex[i];
+		if (p >= first && p < middle) {
+			p += last - middle;
+		}
+		else if (p >= middle && p < last) {
+			p -= middle - first;
+		}
+	}
+}
+
+
+void SceneGraph::addToSubtreeSizes(uint32_t parentIndex, int32_t numNodes)
+{
+	for (uint32_t p = parentIndex; p < SCENEGRAPH_DETACHED_INDEX; p = m_parentIndex[p]) {
+		m_subtreeSize[p] += numNodes;
+	}
+}
+
+
+bool SceneGraph::subtreeIsClean(const SceneNode& node, uint32_t i) const
+{
+	uint32_t p = m_parentIndex[i];
+	uint8_t parentFlags = (p == SCENEGRAPH_ROOT_INDEX) ? 0 : m_propagate[p];
 
-	// start traversal at the root node
-	m_bfsQueue.empty();
-	m_bfsQueue.push({
-		&m_rootNode,
-		0, 0,
-		{ 0.0, 0.0, 0.0 },
-		{ 0.0, 0.0, 0.0, 1.0 }
-	});
+	return (node.positionDirty == 0 && node.orientationDirty == 0 &&
+			node.descendantDirty == 0 && parentFlags == 0);
+}
+
+
+void SceneGraph::propagateRange(uint32_t begin, uint32_t end)
+{
+	auto& nodeItems = entityMgr.getComponentStore<SceneNode>().getComponents().getItems();
+
+	// orientations are composed 4 at a time, a node is queued with its parent's world orientation
+	// and the queue is flushed before a node whose parent might still be waiting in it
+	simd::DQuat4 parentRotation{};
+	simd::DQuat4 localRotation{};
+	SceneNode* queued[4];
+	uint32_t numQueued = 0;
+	uint32_t firstQueued = 0;
+
+	auto flushQueue = [&]() {
+		simd::mulNormalizeDQuat4(parentRotation, localRotation, parentRotation);
+		for (uint32_t q = 0; q < numQueued; ++q) {
+			auto& orientationWorld = queued[q]->orientationWorld;
+			orientationWorld.x = parentRotation.x[q];
+			orientationWorld.y = parentRotation.y[q];
+			orientationWorld.z = parentRotation.z[q];
+			orientationWorld.w = parentRotation.w[q];
+		}
+		numQueued = 0;
+	};
+
+	for (uint32_t i = begin; i < end; ++i) {
+		uint32_t p = m_parentIndex[i];
+		if (p == SCENEGRAPH_DETACHED_INDEX) {
+			continue;
+		}
 
-	// traverse the scene graph and calculate new world positions if needed
-	while (!m_bfsQueue.empty()) {
-		const auto& bfs = m_bfsQueue.front();
+		auto& node = nodeItems[i].component;
 
-		SceneNode& node = *bfs.sceneNode;
+		// jump over the whole branch, nothing below reads the flags of skipped nodes
+		if (subtreeIsClean(node, i)) {
+			i += m_subtreeSize[i] - 1;
+			continue;
+		}
+		node.descendantDirty = 0;
+
+		auto& parent = (p == SCENEGRAPH_ROOT_INDEX) ? m_rootNode : nodeItems[p].component;
+		uint8_t parentFlags = (p == SCENEGRAPH_ROOT_INDEX) ? 0 : m_propagate[p];
+		uint8_t flags = 0;
 
 		// recalc world position if this, or any ancestors have moved since last frame
-		bool positionDirty = (node.positionDirty == 1) || (bfs.ancestorPositionDirty == 1);
-		if (positionDirty) {
-			node.positionWorld = bfs.translationToWorld + node.translationLocal;
+		if (node.positionDirty == 1 || (parentFlags & Propagate_Position) != 0) {
+			node.positionWorld = parent.positionWorld + node.translationLocal;
+			m_originPositions[i] = glm::vec3(node.positionWorld - m_origin);
 			node.positionDirty = 0;
+			flags |= Propagate_Position;
 		}
 
 		// recalc world orientation if this, or any ancestors have rotated since last frame
-		bool orientationDirty = (node.orientationDirty == 1) || (bfs.ancestorOrientationDirty == 1);
-		if (orientationDirty) {
-			node.orientationWorld = glm::normalize(bfs.rotationToWorld * node.rotationLocal);
+		if (node.orientationDirty == 1 || (parentFlags & Propagate_Orientation) != 0) {
+			if (numQueued > 0 && p != SCENEGRAPH_ROOT_INDEX && p >= firstQueued) {
+				flushQueue();
+			}
+			if (numQueued == 0) {
+				firstQueued = i;
+			}
+			parentRotation.x[numQueued] = parent.orientationWorld.x;
+			parentRotation.y[numQueued] = parent.orientationWorld.y;
+			parentRotation.z[numQueued] = parent.orientationWorld.z;
+			parentRotation.w[numQueued] = parent.orientationWorld.w;
+			localRotation.x[numQueued] = node.rotationLocal.x;
+			localRotation.y[numQueued] = node.rotationLocal.y;
+			localRotation.z[numQueued] = node.rotationLocal.z;
+			localRotation.w[numQueued] = node.rotationLocal.w;
+			queued[numQueued] = &node;
+			if (++numQueued == 4) {
+				flushQueue();
+			}
+
 			node.orientationDirty = 0;
+			flags |= Propagate_Orientation;
 		}
 
-		if (node.numChildren > 0) {
-			// do some house cleaning of bfs_queue, make sure size doesn't get too large
-			if (m_bfsQueue.get_offset() + node.numChildren > m_bfsQueue.capacity()) {
-				m_bfsQueue.reset_offset();
-			}
+		m_propagate[i] = flags;
+	}
+
+	if (numQueued > 0) {
+		flushQueue();
+	}
+}
+
+
+void SceneGraph::updateNodeTransformsParallel(int numThreads)
+{
+	uint32_t numNodes = static_cast<uint32_t>(m_parentIndex.size());
+	uint32_t targetChunks = std::min(static_cast<uint32_t>(numThreads * SCENEGRAPH_PARALLEL_CHUNKS_PER_THREAD),
+									 static_cast<uint32_t>(SCENEGRAPH_PARALLEL_MAX_CHUNKS));
+	uint32_t chunkSize = std::max(numNodes / targetChunks, 1U);
+
+	// walk the tree in order on this thread, calculating nodes whose subtrees are too big for
+	// one chunk, and collecting the roots of subtrees that fit. Every collected subtree has its
+	// parent calculated already, so they're independent of each other.
+	auto& nodeItems = entityMgr.getComponentStore<SceneNode>().getComponents().getItems();
+
+	m_subtreeRoots.clear();
+	for (uint32_t i = 0; i < numNodes;) {
+		if (m_parentIndex[i] == SCENEGRAPH_DETACHED_INDEX) {
+			break; // only detached nodes follow
+		}
+		if (subtreeIsClean(nodeItems[i].component, i)) {
+			i += m_subtreeSize[i];
+		}
+		else if (m_subtreeSize[i] > chunkSize) {
+			propagateRange(i, i + 1);
+			++i; // descend into the first child
+		}
+		else {
+			m_subtreeRoots.push_back(i);
+			i += m_subtreeSize[i];
+		}
+	}
+
+	// group neighboring subtrees into chunks of about chunkSize nodes, so each thread writes
+	// a contiguous stretch of the store and threads only meet at chunk edges
+	m_chunkStarts.clear();
+	uint32_t accumulated = chunkSize;
+	for (uint32_t r = 0; r < m_subtreeRoots.size(); ++r) {
+		if (accumulated >= chunkSize) {
+			m_chunkStarts.push_back(r);
+			accumulated = 0;
+		}
+		accumulated += m_subtreeSize[m_subtreeRoots[r]];
+	}
+	uint32_t numChunks = static_cast<uint32_t>(m_chunkStarts.size());
+	m_chunkStarts.push_back(static_cast<uint32_t>(m_subtreeRoots.size()));
 
-			// add all children to the traversal queue
-			auto childId = node.firstChild;
-			for (uint32_t c = 0; c < node.numChildren; ++c) {
-				assert(childId != NullId_T && "expected scene node is null, broken linked list or numChildren out of sync");
-				auto& child = nodeComponents[childId].component;
+	if (numChunks == 0) {
+		return;
+	}
+
+	auto job = std::make_shared<PropagateJob>();
+	job->nextChunk = 0;
+	job->chunksDone = 0;
 
-				m_bfsQueue.push({
-					&child,
-					positionDirty, orientationDirty,
-					node.positionWorld,
-					node.orientationWorld
-				});
+	auto runChunks = [this, job, numChunks]() {
+		for (;;) {
+			uint32_t c = job->nextChunk.fetch_add(1, std::memory_order_relaxed);
+			if (c >= numChunks) {
+				break;
+			}
 
-				childId = child.nextSibling;
+			for (uint32_t r = m_chunkStarts[c]; r < m_chunkStarts[c + 1]; ++r) {
+				uint32_t root = m_subtreeRoots[r];
+				propagateRange(root, root + m_subtreeSize[root]);
 			}
+
+			job->chunksDone.fetch_add(1, std::memory_order_release);
 		}
+	};
+
+	auto& threadPool = *task_base::s_threadPool;
+	uint32_t numHelpers = std::min(static_cast<uint32_t>(numThreads), numChunks - 1);
+	for (uint32_t h = 0; h < numHelpers; ++h) {
+		threadPool.run(Thread_Workers, runChunks);
+	}
+
+	// this thread works too, then waits for chunks taken by helpers, it never waits on a
+	// helper that hasn't started so this can't deadlock when the pool is busy
+	runChunks();
 
-		m_bfsQueue.pop();
+	while (job->chunksDone.load(std::memory_order_acquire) < numChunks) {
+		std::this_thread::yield();
 	}
 }
 
@@ -78,39 +444,88 @@ void SceneGraph::updateNodeTransforms()
 SceneNodeId SceneGraph::addToScene(EntityId entityId, const glm::dvec3& translationLocal,
 								   const glm::dquat& rotationLocal, SceneNodeId parentNodeId)
 {
-	auto& nodeComponents = entityMgr.getComponentStore<SceneNode>().getComponents();
+	auto& store = entityMgr.getComponentStore<SceneNode>();
+	auto& nodeComponents = store.getComponents();
+
+	// a new node is its parent's last child in depth-first order, so it belongs at the end of
+	// its parent's subtree, found before the insert while the order arrays still match
+	uint32_t parentIndex = SCENEGRAPH_ROOT_INDEX;
+	uint32_t insertIndex = SCENEGRAPH_DETACHED_INDEX;
+	if (orderIsCurrent()) {
+		if (parentNodeId == NullId_T) {
+			insertIndex = m_numAttached;
+		}
+		else {
+			parentIndex = nodeComponents.getInnerIndex(parentNodeId);
+			if (m_parentIndex[parentIndex] != SCENEGRAPH_DETACHED_INDEX) {
+				insertIndex = parentIndex + m_subtreeSize[parentIndex];
+			}
+		}
+	}
 
-	// get the parent node where we're inserting this component
+	// get the parent node where we're inserting this component, the references are only good
+	// until the inserts below which may reallocate the stores
 	auto& parentNode = (parentNodeId == NullId_T) ? m_rootNode : nodeComponents[parentNodeId].component;
+	auto parentRef = SceneNodeRef::fromId(parentNodeId);
+	auto& parentHierarchy = getHierarchy(parentRef);
 
 	// add a SceneNode component to the entity
 	SceneNode node = {
-		0,															// numChildren
 		0,															// positionDirty
 		0,															// orientationDirty
+		0,															// descendantDirty
 		{},															// padding
 		translationLocal,											// translationLocal
 		rotationLocal,												// rotationLocal
 		parentNode.positionWorld + translationLocal,				// positionWorld
-		glm::normalize(parentNode.orientationWorld * rotationLocal),// orientationWorld
-		NullId_T,													// firstChild
-		parentNode.firstChild,										// nextSibling
-		NullId_T,													// prevSibling
-		parentNodeId												// parent
+		glm::normalize(parentNode.orientationWorld * rotationLocal)	// orientationWorld
+	};
+
+	SceneHierarchy hierarchy = {
+		0,															// numChildren
+		NullSceneNodeRef,											// firstChild
+		parentHierarchy.firstChild,									// nextSibling
+		NullSceneNodeRef,											// prevSibling
+		parentRef													// parent
 	};
 
 	auto nodeId = entityMgr.addComponentToEntity(std::move(node), entityId);
 
 	if (nodeId != NullId_T) {
+		// added right after the SceneNode so both land at the same dense index
+		auto hierarchyId = entityMgr.addComponentToEntity(std::move(hierarchy), entityId);
+		assert(hierarchyId != NullId_T && "SceneHierarchy not added along with the SceneNode");
+
+		auto nodeRef = SceneNodeRef::fromId(nodeId);
+		auto& parent = getHierarchy(parentRef);
+
 		// push new node to the front of parent't list
 		// set the prevSibling of the former first child
-		if (parentNode.firstChild != NullId_T) {
-			nodeComponents[parentNode.firstChild].component.prevSibling = nodeId;
+		if (parent.firstChild != NullSceneNodeRef) {
+			getHierarchy(parent.firstChild).prevSibling = nodeRef;
 		}
 
 		// make the new node the first child of its parent
-		parentNode.firstChild = nodeId;
-		++parentNode.numChildren;
+		parent.firstChild = nodeRef;
+		++parent.numChildren;
+
+		// the node lands at the back of the stores, move it into place, only the nodes after its
+		// place shift and the rest of the tree isn't visited
+		if (insertIndex != SCENEGRAPH_DETACHED_INDEX) {
+			uint32_t newIndex = static_cast<uint32_t>(m_parentIndex.size());
+			m_parentIndex.push_back(parentIndex);
+			m_subtreeSize.push_back(1);
+			m_propagate.push_back(0);
+			m_originPositions.push_back(glm::vec3(nodeComponents[nodeId].component.positionWorld - m_origin));
+
+			rotateNodes(insertIndex, newIndex, newIndex + 1);
+			addToSubtreeSizes(parentIndex, 1);
+			++m_numAttached;
+			m_orderVersion = store.getStructureVersion();
+		}
+		else {
+			m_orderValid = false;
+		}
 	}
 
 	return nodeId;
@@ -127,53 +542,55 @@ bool SceneGraph::removeFromScene(SceneNodeId sceneNodeId, bool cascade, std::vec
 		return false;
 	}
 
-	auto& thisNodeCR = nodeComponents[sceneNodeId];
-	auto& node = thisNodeCR.component;
-	auto& parentNode = (node.parent == NullId_T) ? m_rootNode : nodeComponents[node.parent].component;
+	EntityId entityId = nodeComponents[sceneNodeId].entityId;
+	auto nodeRef = SceneNodeRef::fromId(sceneNodeId);
 
-	// remove from scene graph
-	// if this was the firstChild, set the new one
-	if (node.prevSibling == NullId_T) {
-		parentNode.firstChild = node.nextSibling;
-		nodeComponents[parentNode.firstChild].component.prevSibling = NullId_T;
+	if (getHierarchy(nodeRef).numChildren > 0 && !cascade) {
+		// don't cascade the delete, give the node's children to its parent, excluding nodes
+		// that are directly owned by this entity, those go with it
+		auto& hierarchy = getHierarchy(nodeRef);
+		moveAllSiblings(nodeComponents.toId(hierarchy.firstChild), nodeComponents.toId(hierarchy.parent), entityId);
 	}
-	// fix the node's sibling linked list
-	else {
-		nodeComponents[node.prevSibling].component.nextSibling = node.nextSibling;
-	}
-
-	--parentNode.numChildren;
-
-	if (node.numChildren > 0) {
-		// remove all descendants
-		if (cascade) {
-			m_handleBuffer.clear();
-			collectDescendants(sceneNodeId, m_handleBuffer);
-			if (removedEntities != nullptr) {
-				auto& rmvEnt = *removedEntities;
-				for (auto descSceneNodeId : m_handleBuffer) {
-					auto entityIdOfRemoved = nodeComponents[descSceneNodeId].entityId;
-					if (entityIdOfRemoved != thisNodeCR.entityId) {
-						rmvEnt.push_back(entityIdOfRemoved);
-					}
-					removeFromScene(descSceneNodeId, true, removedEntities);
-				}
-			}
-			else {
-				for (auto descSceneNodeId : m_handleBuffer) {
-					removeFromScene(descSceneNodeId, true, nullptr);
-				}
-			}
-		}
-		// don't cascade the delete, give the node's children to its parent,
-		// excluding nodes that are directly owned by this entity
-		else {
-			moveAllSiblings(node.firstChild, node.parent, thisNodeCR.entityId);
+
+	// the moves above may have shifted the stores, look the hierarchy up again
+	auto& hierarchy = getHierarchy(nodeRef);
+
+	// remove from scene graph
+	unlinkNode(hierarchy);
+	bool hasDescendants = (hierarchy.numChildren > 0);
+
+	// a leaf is moved to the back of the stores first, so erasing it pops the back instead of
+	// swapping another node into its place, and the order stays current
+	bool leafInOrder = false;
+	if (!hasDescendants && orderIsCurrent()) {
+		uint32_t index = nodeComponents.getInnerIndex(sceneNodeId);
+		if (m_parentIndex[index] != SCENEGRAPH_DETACHED_INDEX) {
+			addToSubtreeSizes(m_parentIndex[index], -1);
+			rotateNodes(index, index + 1, static_cast<uint32_t>(m_parentIndex.size()));
+			--m_numAttached;
+			leafInOrder = true;
 		}
 	}
 
-	// remove this SceneNode component from the store and entity
-	bool removed = entityMgr.removeComponent(sceneNodeId);
+	// remove all remaining descendants, references into the stores are invalid after this
+	if (hasDescendants) {
+		removeBranch(sceneNodeId, entityId, removedEntities);
+	}
+
+	// remove this SceneNode and its SceneHierarchy from the stores and entity
+	m_handleBuffer.clear();
+	m_handleBuffer.push_back(sceneNodeId);
+	appendHierarchyIds(m_handleBuffer);
+	bool removed = (entityMgr.removeComponents(m_handleBuffer) == 2);
+
+	if (leafInOrder) {
+		m_parentIndex.pop_back();
+		m_subtreeSize.pop_back();
+		m_propagate.pop_back();
+		m_originPositions.pop_back();
+		m_orderVersion = entityMgr.getComponentStore<SceneNode>().getStructureVersion();
+		m_orderValid = removed;
+	}
 
 	return removed;
 }
@@ -187,9 +604,13 @@ bool SceneGraph::removeEntityFromScene(EntityId entityId, bool cascade, std::vec
 
 	bool removed = false;
 
-	for (SceneNodeId sceneNodeId = entityMgr.getEntityComponentId(entityId, SceneNode::componentType); sceneNodeId != NullId_T;) {
-		removed = removed &&
-			removeFromScene(sceneNodeId, cascade, removedEntities);
+	// look the id up each time, a removal may take other SceneNodes of this entity with it
+	for (;;) {
+		SceneNodeId sceneNodeId = entityMgr.getEntityComponentId(entityId, SceneNode::componentType);
+		if (sceneNodeId == NullId_T) {
+			break;
+		}
+		removed = removeFromScene(sceneNodeId, cascade, removedEntities) || removed;
 	}
 
 	return removed;
@@ -202,47 +623,94 @@ bool SceneGraph::moveNode(SceneNodeId sceneNodeId, SceneNodeId moveToParent)
 
 	auto& nodeComponents = entityMgr.getComponentStore<SceneNode>().getComponents();
 
-	if (!nodeComponents.isValid(sceneNodeId) || !nodeComponents.isValid(moveToParent)) {
+	// NullId_T is the root
+	if (!nodeComponents.isValid(sceneNodeId) ||
+		(moveToParent != NullId_T && !nodeComponents.isValid(moveToParent)))
+	{
 		return false;
 	}
 
-	auto& node = nodeComponents[sceneNodeId].component;
+	auto nodeRef = SceneNodeRef::fromId(sceneNodeId);
+	auto parentRef = SceneNodeRef::fromId(moveToParent);
+
+	auto& hierarchy = getHierarchy(nodeRef);
 	// check to make sure we're not trying to move into the current parent
-	if (node.parent == moveToParent) {
+	if (hierarchy.parent == parentRef) {
 		return false;
 	}
+	bool orderWasCurrent = orderIsCurrent();
 
-	auto& currentParent = (node.parent == NullId_T) ? m_rootNode : nodeComponents[node.parent].component;
-	auto& newParent = (moveToParent == NullId_T) ? m_rootNode : nodeComponents[moveToParent].component;
-
-	// remove from current parrent
-	// if this was the firstChild, set the new one
-	if (node.prevSibling == NullId_T) {
-		currentParent.firstChild = node.nextSibling;
-		nodeComponents[currentParent.firstChild].component.prevSibling = NullId_T;
-	}
-	// fix the node's sibling linked list
-	else {
-		nodeComponents[node.prevSibling].component.nextSibling = node.nextSibling;
-	}
+	auto& newParent = getHierarchy(parentRef);
 
-	--currentParent.numChildren;
+	// remove from current parent
+	unlinkNode(hierarchy);
 
 	// move to new parent
-	node.parent = moveToParent;
-	node.nextSibling = newParent.firstChild;
-	node.prevSibling = NullId_T;
-	if (newParent.firstChild != NullId_T) {
-		nodeComponents[newParent.firstChild].component.prevSibling = sceneNodeId;
+	hierarchy.parent = parentRef;
+	hierarchy.nextSibling = newParent.firstChild;
+	hierarchy.prevSibling = NullSceneNodeRef;
+	if (newParent.firstChild != NullSceneNodeRef) {
+		getHierarchy(newParent.firstChild).prevSibling = nodeRef;
 	}
-	newParent.firstChild = sceneNodeId;
+	newParent.firstChild = nodeRef;
 			
 	++newParent.numChildren;
 
+	// the world transform changes with the new parent
+	markDirty(nodeComponents[sceneNodeId].component, true, true);
+
+	if (orderWasCurrent) {
+		moveSubtreeInOrder(sceneNodeId, moveToParent);
+	}
+	else {
+		m_orderValid = false;
+	}
+
 	return true;
 }
 
 
+void SceneGraph::moveSubtreeInOrder(SceneNodeId sceneNodeId, SceneNodeId moveToParent)
+{
+	auto& store = entityMgr.getComponentStore<SceneNode>();
+	auto& nodeComponents = store.getComponents();
+
+	uint32_t first = nodeComponents.getInnerIndex(sceneNodeId);
+	uint32_t size = m_subtreeSize[first];
+	uint32_t parentIndex = (moveToParent == NullId_T) ? SCENEGRAPH_ROOT_INDEX : nodeComponents.getInnerIndex(moveToParent);
+	uint32_t insertIndex = (moveToParent == NullId_T) ? m_numAttached : parentIndex + m_subtreeSize[parentIndex];
+
+	// detached nodes have no place in the order, and a node moved into its own subtree leaves
+	// the tree, both are sorted out by a rebuild
+	if (m_parentIndex[first] == SCENEGRAPH_DETACHED_INDEX ||
+		(moveToParent != NullId_T && m_parentIndex[parentIndex] == SCENEGRAPH_DETACHED_INDEX) ||
+		(insertIndex > first && insertIndex < first + size))
+	{
+		m_orderValid = false;
+		return;
+	}
+
+	// the subtree keeps its inner order and moves as one block to the end of its new parent's
+	// subtree, only the nodes between its old and new places shift
+	addToSubtreeSizes(m_parentIndex[first], -static_cast<int32_t>(size));
+
+	if (insertIndex > first) {
+		rotateNodes(first, first + size, insertIndex);
+		first = insertIndex - size;
+	}
+	else {
+		rotateNodes(insertIndex, first, first + size);
+		first = insertIndex;
+	}
+
+	parentIndex = (moveToParent == NullId_T) ? SCENEGRAPH_ROOT_INDEX : nodeComponents.getInnerIndex(moveToParent);
+	m_parentIndex[first] = parentIndex;
+	addToSubtreeSizes(parentIndex, static_cast<int32_t>(size));
+
+	m_orderVersion = store.getStructureVersion();
+}
+
+
 bool SceneGraph::moveAllSiblings(
 	SceneNodeId siblingToMove,
 	SceneNodeId moveToParent,
@@ -250,38 +718,45 @@ bool SceneGraph::moveAllSiblings(
 {
 	auto& nodeComponents = entityMgr.getComponentStore<SceneNode>().getComponents();
 
-	if (!nodeComponents.isValid(siblingToMove) || !nodeComponents.isValid(moveToParent)) {
+	// NullId_T is the root
+	if (!nodeComponents.isValid(siblingToMove) ||
+		(moveToParent != NullId_T && !nodeComponents.isValid(moveToParent)))
+	{
 		return false;
 	}
 
-	auto& node = nodeComponents[siblingToMove].component;
+	auto parentRef = SceneNodeRef::fromId(moveToParent);
+
+	auto& hierarchy = getHierarchy(SceneNodeRef::fromId(siblingToMove));
 	// check to make sure we're not trying to move into the current parent
-	if (node.parent == moveToParent) {
+	if (hierarchy.parent == parentRef) {
 		return false;
 	}
 
-	auto& currentParent = (node.parent == NullId_T) ? m_rootNode : nodeComponents[node.parent].component;
+	// moves shift the stores, so the parent is looked up by its handle each time
+	auto currentParentRef = hierarchy.parent;
 
 	bool allMoved = true;
 
 	// move each child to the new parent
-	auto childId = currentParent.firstChild;
+	auto childRef = getHierarchy(currentParentRef).firstChild;
 	
-	while (childId != NullId_T) {
-		auto& childCR = nodeComponents[childId];
+	while (childRef != NullSceneNodeRef) {
+		EntityId childEntityId = nodeComponents[childRef].entityId;
+		auto nextRef = getHierarchy(childRef).nextSibling;
 		
 		// move the child as long as it isn't owned by the excluded entity
 		// also make sure we're not trying to move a node into itself
-		if ((excludeEntityId == NullId_T || childCR.entityId != excludeEntityId)
-			&& childId != moveToParent)
+		if ((excludeEntityId == NullId_T || childEntityId != excludeEntityId)
+			&& childRef != parentRef)
 		{
-			auto& child = childCR.component;
-			allMoved = allMoved && moveNode(childId, moveToParent);
-			childId = child.nextSibling;
+			allMoved = moveNode(nodeComponents.toId(childRef), moveToParent) && allMoved;
 		}
+		childRef = nextRef;
 	}
 
-	assert(currentParent.numChildren == 0 && "numChildren > 0 but all siblings should have moved");
+	assert((excludeEntityId != NullId_T || getHierarchy(currentParentRef).numChildren == 0) &&
+		   "numChildren > 0 but all siblings should have moved");
 
 	return allMoved;
 }
@@ -295,19 +770,18 @@ SceneNodeId SceneGraph::getLastImmediateChild(SceneNodeId sceneNodeId) const
 		return NullId_T;
 	}
 
-	auto& node = nodeComponents[sceneNodeId].component;
-	auto childId = node.firstChild;
-	if (childId != NullId_T) {
+	auto childRef = getHierarchy(SceneNodeRef::fromId(sceneNodeId)).firstChild;
+	if (childRef != NullSceneNodeRef) {
 		for (;;) {
-			auto& child = nodeComponents[sceneNodeId].component;
-			if (child.nextSibling == NullId_T) {
+			auto& child = getHierarchy(childRef);
+			if (child.nextSibling == NullSceneNodeRef) {
 				break;
 			}
-			childId = child.nextSibling;
+			childRef = child.nextSibling;
 		}
 	}
 
-	return childId;
+	return nodeComponents.toId(childRef);
 }
 
 
@@ -317,21 +791,33 @@ void SceneGraph::collectDescendants(
 {
 	auto& nodeComponents = entityMgr.getComponentStore<SceneNode>().getComponents();
 
-	vector_queue<SceneNodeId> bfsQueue;
-	auto& node = nodeComponents[sceneNodeId].component;
+	// in depth-first order the descendants directly follow the node
+	if (orderIsCurrent()) {
+		uint32_t first = nodeComponents.getInnerIndex(sceneNodeId);
+		uint32_t last = first + m_subtreeSize[first];
+		if (m_parentIndex[first] != SCENEGRAPH_DETACHED_INDEX) {
+			outDescendants.reserve(outDescendants.size() + (last - first - 1));
+			for (uint32_t i = first + 1; i < last; ++i) {
+				outDescendants.push_back(nodeComponents.getHandleForInnerIndex(i));
+			}
+			return;
+		}
+	}
+
+	vector_queue<SceneNodeRef> bfsQueue;
 	
-	bfsQueue.push(sceneNodeId);
+	bfsQueue.push(SceneNodeRef::fromId(sceneNodeId));
 
 	while (!bfsQueue.empty()) {
-		SceneNodeId thisId = bfsQueue.front();
-
-		auto& node = nodeComponents[thisId].component;
-		auto childId = node.firstChild;
-		for (uint32_t c = 0; c < node.numChildren; ++c) {
-			auto& child = nodeComponents[childId].component;
-			outDescendants.push_back(childId);
-			bfsQueue.push(childId);
-			childId = child.nextSibling;
+		SceneNodeRef thisRef = bfsQueue.front();
+
+		auto& hierarchy = getHierarchy(thisRef);
+		auto childRef = hierarchy.firstChild;
+		for (uint32_t c = 0; c < hierarchy.numChildren; ++c) {
+			auto& child = getHierarchy(childRef);
+			outDescendants.push_back(nodeComponents.toId(childRef));
+			bfsQueue.push(childRef);
+			childRef = child.nextSibling;
 		}
 
 		bfsQueue.pop();
@@ -339,20 +825,137 @@ void SceneGraph::collectDescendants(
 }
 
 
+void SceneGraph::unlinkNode(SceneHierarchy& hierarchy)
+{
+	auto& parentHierarchy = getHierarchy(hierarchy.parent);
+
+	// if this was the firstChild, set the new one
+	if (hierarchy.prevSibling == NullSceneNodeRef) {
+		parentHierarchy.firstChild = hierarchy.nextSibling;
+	}
+	else {
+		getHierarchy(hierarchy.prevSibling).nextSibling = hierarchy.nextSibling;
+	}
+	if (hierarchy.nextSibling != NullSceneNodeRef) {
+		getHierarchy(hierarchy.nextSibling).prevSibling = hierarchy.prevSibling;
+	}
+
+	--parentHierarchy.numChildren;
+	hierarchy.nextSibling = NullSceneNodeRef;
+	hierarchy.prevSibling = NullSceneNodeRef;
+}
+
+
+const scene::SceneHierarchy& SceneGraph::getHierarchy(SceneNodeRef sceneNodeRef) const
+{
+	if (sceneNodeRef == NullSceneNodeRef) {
+		return m_rootHierarchy;
+	}
+	auto& nodeComponents = entityMgr.getComponentStore<SceneNode>().getComponents();
+	auto& hierItems = entityMgr.getComponentStore<SceneHierarchy>().getComponents().getItems();
+
+	return hierItems[nodeComponents.getInnerIndex(sceneNodeRef)].component;
+}
+
+
+scene::SceneHierarchy& SceneGraph::getHierarchy(SceneNodeRef sceneNodeRef)
+{
+	return const_cast<SceneHierarchy&>(static_cast<const SceneGraph*>(this)->getHierarchy(sceneNodeRef));
+}
+
+
+ComponentId SceneGraph::getHierarchyId(SceneNodeId sceneNodeId) const
+{
+	auto& nodeComponents = entityMgr.getComponentStore<SceneNode>().getComponents();
+	auto& hierComponents = entityMgr.getComponentStore<SceneHierarchy>().getComponents();
+
+	return hierComponents.getHandleForInnerIndex(nodeComponents.getInnerIndex(sceneNodeId));
+}
+
+
+void SceneGraph::appendHierarchyIds(std::vector<ComponentId>& sceneNodeIds) const
+{
+	size_t numNodes = sceneNodeIds.size();
+	sceneNodeIds.reserve(numNodes * 2);
+	for (size_t n = 0; n < numNodes; ++n) {
+		sceneNodeIds.push_back(getHierarchyId(sceneNodeIds[n]));
+	}
+}
+
+
+void SceneGraph::removeBranch(SceneNodeId sceneNodeId, EntityId excludeEntityId, std::vector<EntityId>* removedEntities)
+{
+	auto& nodeComponents = entityMgr.getComponentStore<SceneNode>().getComponents();
+
+	m_handleBuffer.clear();
+	collectDescendants(sceneNodeId, m_handleBuffer);
+
+	if (removedEntities != nullptr) {
+		for (auto descSceneNodeId : m_handleBuffer) {
+			auto entityIdOfRemoved = nodeComponents[descSceneNodeId].entityId;
+			if (entityIdOfRemoved != excludeEntityId) {
+				removedEntities->push_back(entityIdOfRemoved);
+			}
+		}
+	}
+
+	// the whole branch goes, so nodes inside it don't need unlinking from each other. Both stores
+	// see the same sequence of swap-and-pop erases and stay in step.
+	appendHierarchyIds(m_handleBuffer);
+	entityMgr.removeComponents(m_handleBuffer);
+}
+
+
+void SceneGraph::createComponentStores()
+{
+	entityMgr.getComponentStore<SceneNode>();
+	entityMgr.getComponentStore<SceneHierarchy>();
+	entityMgr.getComponentStore<ModelInstance>();
+	entityMgr.getComponentStore<CameraInstance>();
+	entityMgr.getComponentStore<LightInstance>();
+	entityMgr.getComponentStore<MovementComponent>();
+	entityMgr.getComponentStore<RenderCullInfo>();
+	entityMgr.getComponentStore<ModelLOD>();
+}
+
+
+void SceneGraph::writeSnapshot(SnapshotWriter& writer) const
+{
+	writer.beginSection(SnapshotSection_SceneGraph, 0);
+	writer.writeBlock(SnapshotBlock_Items, &m_rootNode, 1, sizeof(SceneNode));
+	writer.writeBlock(SnapshotBlock_Extra, &m_rootHierarchy, 1, sizeof(SceneHierarchy));
+}
+
+
+void SceneGraph::readSnapshot(const MappedSnapshot& snapshot)
+{
+	auto section = snapshot.findSection(SnapshotSection_SceneGraph, 0);
+	if (section == nullptr || snapshot.getBlockCount(*section, SnapshotBlock_Items) != 1 ||
+		snapshot.getBlockCount(*section, SnapshotBlock_Extra) != 1)
+	{
+		throw std::runtime_error("snapshot does not contain a scene graph");
+	}
+	m_rootNode = *snapshot.getBlock<SceneNode>(*section, SnapshotBlock_Items);
+	m_rootHierarchy = *snapshot.getBlock<SceneHierarchy>(*section, SnapshotBlock_Extra);
+	m_rootNode.descendantDirty = 1; // don't trust saved marks, the first update visits every node
+	m_orderValid = false;
+}
+
+
 SceneGraph::SceneGraph(EntityManager& _entityMgr) :
 	entityMgr{ _entityMgr }
 {
-	m_bfsQueue.reserve(RESERVE_SCENEGRAPH_TRAVERSAL_QUEUE);
 	m_handleBuffer.reserve(RESERVE_SCENEGRAPH_TRAVERSAL_QUEUE);
 
 	memset(&m_rootNode, 0, sizeof(m_rootNode));
+	memset(&m_rootHierarchy, 0, sizeof(m_rootHierarchy));
 	m_rootNode.rotationLocal.w = 1.0f;
 	m_rootNode.orientationWorld.w = 1.0f;
 }
 		
 
 SceneGraph::~SceneGraph() {
-	if (m_bfsQueue.capacity() > RESERVE_SCENEGRAPH_TRAVERSAL_QUEUE) {
-		logger.info("check RESERVE_SCENEGRAPH_TRAVERSAL_QUEUE: original=%d, highest=%d", RESERVE_SCENEGRAPH_TRAVERSAL_QUEUE, m_bfsQueue.capacity());
+	if (m_handleBuffer.capacity() > RESERVE_SCENEGRAPH_TRAVERSAL_QUEUE) {
+		logger.info("check RESERVE_SCENEGRAPH_TRAVERSAL_QUEUE: original=%d, highest=%d", RESERVE_SCENEGRAPH_TRAVERSAL_QUEUE, m_handleBuffer.capacity());
 	}
 }
@@ -7,7 +7,11 @@ using namespace griffin::test;
 #define REGISTER_TEST(testFunc)	extern void testFunc();\
 								s_testRegistry.push_back(testFunc)
 
+#define REGISTER_BENCHMARK(benchFunc)	extern void benchFunc();\
+										s_benchmarkRegistry.push_back(benchFunc)
+
 std::vector<std::function<void()>> TestRunner::s_testRegistry;
+std::vector<std::function<void()>> TestRunner::s_benchmarkRegistry;
 
 
 void TestRunner::runAllTests()
@@ -17,6 +21,13 @@ void TestRunner::runAllTests()
 	}
 }
 
+void TestRunner::runAllBenchmarks()
+{
+	for (auto& b : s_benchmarkRegistry) {
+		b();
+	}
+}
+
 void TestRunner::registerAllTests()
 {
 	#pragma warning(disable : 4101)
@@ -24,6 +35,42 @@ void TestRunner::registerAllTests()
 	// register all tests in this section
 	REGISTER_TEST(concurrencyTest);
 	//REGISTER_TEST(testHandleMap);
+	REGISTER_TEST(testCompactIds);
+	REGISTER_TEST(testResourceCacheLRU);
 	//REGISTER_TEST(testReflection);
+	REGISTER_TEST(testEntityTags);
+	REGISTER_TEST(testComponentChangeTracking);
+	REGISTER_TEST(testEntitySnapshot);
+	REGISTER_TEST(testComponentStoreHistory);
+	REGISTER_TEST(testComponentObservers);
 	REGISTER_TEST(testSceneGraph);
+	REGISTER_TEST(testSceneGraphOrder);
+	REGISTER_TEST(testSceneGraphEditing);
+	REGISTER_TEST(testLodSelection);
+	REGISTER_TEST(testSectorCoordinates);
+	REGISTER_TEST(testFloatingOrigin);
+	REGISTER_TEST(testMoverInterpolation);
+	REGISTER_TEST(testVisibleLists);
+	REGISTER_TEST(testScenePreparation);
+	REGISTER_TEST(testRenderSnapshotBuffer);
+	REGISTER_TEST(testSimdTransform);
+	REGISTER_TEST(testFrustumCulling);
+	REGISTER_TEST(testCoherentFrustumCulling);
+	REGISTER_TEST(testFrustumPlaneExtraction);
+	REGISTER_TEST(testMultiFrustumCulling);
+	REGISTER_TEST(testHorizonCulling);
+	REGISTER_TEST(testOcclusionBuffer);
+	REGISTER_TEST(testKeyframeSampling);
+}
+
+void TestRunner::registerAllBenchmarks()
+{
+	// register all benchmarks in this section
+	REGISTER_BENCHMARK(benchmarkEntitySnapshot);
+	REGISTER_BENCHMARK(benchmarkComponentStoreHistory);
+	REGISTER_BENCHMARK(benchmarkSceneGraphUpdate);
+	REGISTER_BENCHMARK(benchmarkFrustumCulling);
+	REGISTER_BENCHMARK(benchmarkHorizonCulling);
+	REGISTER_BENCHMARK(benchmarkOcclusionBuffer);
+	REGISTER_BENCHMARK(benchmarkKeyframeSampling);
 }
\ No newline at end of file
@@ -16,13 +16,21 @@ namespace griffin {
 		};*/
 
 
+		/**
+		* Tests are small enough to run at every startup. Benchmarks time large inputs and only run
+		* when the program is started with the -benchmark argument.
+		*/
 		class TestRunner {
 		public:
 			void runAllTests();
 			void registerAllTests();
 
+			void runAllBenchmarks();
+			void registerAllBenchmarks();
+
 		private:
 			static std::vector<std::function<void()>> s_testRegistry;
+			static std::vector<std::function<void()>> s_benchmarkRegistry;
 		};
 	}
 }
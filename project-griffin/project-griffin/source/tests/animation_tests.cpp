@@ -0,0 +1,141 @@
+#include "Test.h"
+#include <cstdint>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <utility/Logger.h>
+#include <application/Timer.h>
+#include <render/model/Animation.h>
+
+using namespace griffin;
+using namespace griffin::render;
+
+static Timer timer;
+
+struct TestKeyFrame {
+	float		time;
+	float		x, y, z;
+};
+
+
+/**
+* The key a scan from the first key finds, what sampling did before cursors
+*/
+static uint16_t scanNextKeyframe(const TestKeyFrame* keys, uint16_t numKeys, float animTime)
+{
+	for (uint16_t k = 0; k < numKeys; ++k) {
+		if (animTime < keys[k].time) {
+			return k;
+		}
+	}
+	return numKeys;
+}
+
+
+/**
+* Samples a channel of keys at 120Hz by scanning and with cursors. Playback runs at 60Hz and loops
+* twice, seeks jump to random times.
+*/
+static void runKeyframeSampling(const uint16_t numKeys)
+{
+	const float keyRate = 120.0f;
+	const float frameRate = 60.0f;
+	const int numFrames = static_cast<int>(numKeys / keyRate * frameRate) * 2 + 100;
+	const int scanStride = 97; // the scan is slow enough to only time a sample of the frames
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> jitter(-0.2f, 0.2f);
+
+	// keys are irregular after mocap cleanup, keep them sorted
+	std::vector<TestKeyFrame> keys(numKeys);
+	for (uint16_t k = 0; k < numKeys; ++k) {
+		keys[k] = { (k + jitter(rng)) / keyRate, 0, 0, 0 };
+	}
+	keys[0].time = 0.0f;
+	float duration = keys[numKeys - 1].time;
+
+	std::vector<float> times(numFrames);
+	for (int f = 0; f < numFrames; ++f) {
+		times[f] = std::fmod(f / frameRate, duration);
+	}
+	// land exactly on keys and outside the clip too
+	times[1] = keys[10].time;
+	times[2] = -1.0f;
+	times[numFrames - 1] = duration + 1.0f;
+
+	std::vector<uint16_t> found(numFrames);
+
+	// scan from the first key
+	timer.start();
+	for (int f = 0; f < numFrames; f += scanStride) {
+		found[f] = scanNextKeyframe(keys.data(), numKeys, times[f]);
+	}
+	timer.stop();
+	double scanNanos = timer.getMillisPassed() * 1.0e6 / ((numFrames + scanStride - 1) / scanStride);
+
+	// cursor playback
+	std::vector<uint16_t> cursorFound(numFrames);
+	uint16_t cursor = 0;
+	timer.start();
+	for (int f = 0; f < numFrames; ++f) {
+		cursor = findNextKeyframe(keys.data(), numKeys, times[f], cursor);
+		cursorFound[f] = cursor;
+	}
+	timer.stop();
+	double playNanos = timer.getMillisPassed() * 1.0e6 / numFrames;
+
+	for (int f = 0; f < numFrames; ++f) {
+		if (f % scanStride == 0) {
+			assert(cursorFound[f] == found[f] && "cursor found a different key than the scan");
+		}
+		auto ub = std::upper_bound(keys.begin(), keys.end(), times[f],
+								   [](float t, const TestKeyFrame& key) { return t < key.time; });
+		assert(cursorFound[f] == ub - keys.begin() && "cursor found the wrong key");
+	}
+
+	// random seeks fall back to binary search
+	std::uniform_real_distribution<float> seek(0.0f, duration);
+	for (int f = 0; f < numFrames; ++f) {
+		times[f] = seek(rng);
+	}
+	timer.start();
+	for (int f = 0; f < numFrames; ++f) {
+		cursor = findNextKeyframe(keys.data(), numKeys, times[f], cursor);
+		cursorFound[f] = cursor;
+	}
+	timer.stop();
+	double seekNanos = timer.getMillisPassed() * 1.0e6 / numFrames;
+
+	for (int f = 0; f < numFrames; f += scanStride) {
+		assert(cursorFound[f] == scanNextKeyframe(keys.data(), numKeys, times[f]) && "seek found the wrong key");
+	}
+
+	// short channels and single keys
+	TestKeyFrame shortKeys[3] = { { 0.0f, 0, 0, 0 }, { 1.0f, 0, 0, 0 }, { 2.0f, 0, 0, 0 } };
+	for (uint16_t n = 1; n <= 3; ++n) {
+		for (float t = -1.0f; t <= 3.0f; t += 0.25f) {
+			for (uint16_t c = 0; c <= 4; ++c) { // 4 is out of range, as from another channel
+				assert(findNextKeyframe(shortKeys, n, t, c) == scanNextKeyframe(shortKeys, n, t) &&
+					   "cursor found the wrong key in a short channel");
+			}
+		}
+	}
+
+	logger.test("keyframe sampling: %u keys, scan %.1f ns/sample, cursor playback %.1f ns/sample, random seek %.1f ns/sample",
+				(unsigned int)numKeys, scanNanos, playNanos, seekNanos);
+}
+
+void testKeyframeSampling()
+{
+	runKeyframeSampling(1200);
+}
+
+/**
+* Mocap length channel, five minutes of keys
+*/
+void benchmarkKeyframeSampling()
+{
+	runKeyframeSampling(36000);
+}
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <utility/Logger.h>
 #include <utility/container/bitwise_quadtree.h>
 #include <utility/container/handle_map.h>
+#include <resource/Resource.h>
 #include <application/Timer.h>
 #include <algorithm>
 #include <array>
@@ -166,4 +167,124 @@ void testHandleMap()
 
 
 	logger.test("test_map capacity = %d", testMap.capacity());
-}
\ No newline at end of file
+}
+
+
+/**
+* Compact ids convert to and from outer ids, go stale when their item is erased, and are never 0
+* as one slot is reused through several wraps of the compact generation bits
+*/
+void testCompactIds()
+{
+	struct Test { int val; };
+	typedef CompactId_T<Test> TestRef;
+
+	handle_map<Test> testMap(0, 16);
+	std::vector<Id_T> handles;
+	for (int i = 0; i < 8; ++i) {
+		handles.push_back(testMap.insert({ i }));
+	}
+
+	// round trip
+	for (int i = 0; i < 8; ++i) {
+		TestRef ref = TestRef::fromId(handles[i]);
+		assert(ref != TestRef{} && "live item has a null compact id");
+		assert(ref.index() == handles[i].index && "compact id lost the index");
+		assert(testMap.isValid(ref) && "compact id of a live item not valid");
+		assert(testMap.toId(ref) == handles[i] && "compact id did not convert back to the outer id");
+		assert(testMap[ref].val == i && "compact id found the wrong item");
+	}
+
+	// erasing makes the compact id stale, including after the slot is reused
+	TestRef staleRef = TestRef::fromId(handles[3]);
+	testMap.erase(handles[3]);
+	assert(!testMap.isValid(staleRef) && "compact id of an erased item still valid");
+	assert(testMap.toId(staleRef) == NullId_T && "stale compact id converted to a live outer id");
+
+	Id_T reused = testMap.insert({ 100 });
+	assert(reused.index == handles[3].index && "freed slot not reused");
+	assert(!testMap.isValid(staleRef) && "stale compact id valid after its slot was reused");
+	assert(testMap.isValid(TestRef::fromId(reused)) && testMap[TestRef::fromId(reused)].val == 100 &&
+		   "compact id of the reused slot not valid");
+
+	// cycle one slot through several wraps of the compact generation, the null id is skipped
+	const int numCycles = 4 * (TestRef::GenerationMask + 1);
+	Id_T handle = reused;
+	int skipped = 0;
+	for (int c = 0; c < numCycles; ++c) {
+		TestRef prevRef = TestRef::fromId(handle);
+		testMap.erase(handle);
+		handle = testMap.insert({ c });
+
+		TestRef ref = TestRef::fromId(handle);
+		assert(ref != TestRef{} && "null compact id issued");
+		assert(ref.generation() != 0 && "compact generation 0 issued");
+		assert(!testMap.isValid(prevRef) && "previous compact id of the slot still valid");
+		assert(testMap.toId(ref) == handle && "compact id did not convert back after a wrap");
+		if ((handle.generation & TestRef::GenerationMask) == 1) {
+			++skipped;
+		}
+	}
+	assert(skipped >= 3 && "compact generation did not wrap");
+
+	// the other items were not disturbed
+	for (int i = 0; i < 8; ++i) {
+		if (i != 3) {
+			assert(testMap[TestRef::fromId(handles[i])].val == i && "unrelated item changed");
+		}
+	}
+
+	logger.test("compact ids: %d slot reuses, %d compact generation wraps", numCycles, skipped);
+}
+
+
+/**
+* The resource cache evicts the least recently used resource first, adding or getting a resource
+* makes it the most recent
+*/
+void testResourceCacheLRU()
+{
+	using namespace resource;
+
+	// every resource is 1 byte, the cache holds 3
+	ResourceCache cache(0, 8, 3);
+	auto add = [&](int val) {
+		return cache.addResource(std::make_shared<Resource_T>(std::move(val), 1));
+	};
+
+	Id_T a = add(1);
+	Id_T b = add(2);
+	Id_T c = add(3);
+	assert(cache.hasResource(a) && cache.hasResource(b) && cache.hasResource(c) && "resource evicted before full");
+
+	// order is b, c, a after touching the front
+	assert(cache.getResource(a)->getResource<int>() == 1 && "wrong resource");
+	Id_T d = add(4);
+	assert(!cache.hasResource(b) && "least recent resource not evicted");
+	assert(cache.hasResource(a) && cache.hasResource(c) && cache.hasResource(d) && "wrong resource evicted");
+
+	// touching the back changes nothing, touching the middle moves it back, order is a, c, d
+	cache.setLRUMostRecent(d);
+	cache.setLRUMostRecent(c);
+	cache.setLRUMostRecent(d);
+	Id_T e = add(5);
+	assert(!cache.hasResource(a) && cache.hasResource(c) && cache.hasResource(d) && cache.hasResource(e) &&
+		   "eviction did not follow the touch order");
+
+	// removing from the middle relinks the list, order is c, e
+	assert(cache.removeResource(d) && "remove failed");
+	Id_T f = add(6);
+	Id_T g = add(7);
+	assert(!cache.hasResource(c) && cache.hasResource(e) && cache.hasResource(f) && cache.hasResource(g) &&
+		   "eviction after a remove from the middle took the wrong resource");
+
+	// a resource held outside of the cache is not removed without force
+	ResourcePtr held = cache.getResource(e);
+	assert(!cache.removeResource(e) && "held resource removed");
+	held.reset();
+	assert(cache.removeResource(e) && cache.removeResource(f) && cache.removeResource(g) && "remove failed");
+	Id_T h = add(8);
+	assert(cache.hasResource(h) && "resource not added to the emptied cache");
+
+	logger.test("resource cache LRU: evicted in least recently used order");
+}
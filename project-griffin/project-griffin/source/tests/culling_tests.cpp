@@ -0,0 +1,486 @@
+#include "Test.h"
+#include <cstdint>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <utility/Logger.h>
+#include <utility/cpu_features.h>
+#include <application/Timer.h>
+#include <render/geometry/Intersection.h>
+#include <glm/vec3.hpp>
+#include <glm/geometric.hpp>
+
+using namespace griffin;
+using namespace griffin::geometry;
+
+static Timer timer;
+
+
+/**
+* Checks every SoA culling kernel against the scalar intersect and reports throughput in objects
+* per nanosecond for each width. N should not be a multiple of any width, to exercise the
+* remainders.
+*/
+static void runFrustumCulling(const unsigned int N, const int reps)
+{
+	// perspective projection, 60 degree vertical fov, 16:9, near 1, far 1000, column-major
+	float proj[16] = {};
+	float f = 1.0f / std::tan(0.5236f);
+	proj[0] = f / (16.0f / 9.0f);
+	proj[5] = f;
+	proj[10] = (1000.0f + 1.0f) / (1.0f - 1000.0f);
+	proj[11] = -1.0f;
+	proj[14] = (2.0f * 1000.0f * 1.0f) / (1.0f - 1000.0f);
+
+	Frustum frustum;
+	frustum.extractFromMatrixGL(proj);
+	alignas(16) Plane planes[6];
+	frustum.getPlanes(planes);
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> pos(-600.0f, 600.0f);
+	std::uniform_real_distribution<float> size(0.5f, 20.0f);
+
+	std::vector<float> x(N), y(N), z(N), r(N), ex(N), ey(N), ez(N);
+	for (unsigned int i = 0; i < N; ++i) {
+		x[i] = pos(rng); y[i] = pos(rng); z[i] = pos(rng);
+		r[i] = size(rng);
+		ex[i] = size(rng); ey[i] = size(rng); ez[i] = size(rng);
+	}
+
+	// scalar references
+	std::vector<uint32_t> sphereRef, aabbRef;
+	std::vector<AABB> aabbs(N);
+	std::vector<unsigned int> aabbResults(N);
+	for (unsigned int i = 0; i < N; ++i) {
+		aabbs[i].m_center = { x[i], y[i], z[i] };
+		aabbs[i].m_extent = { ex[i], ey[i], ez[i] };
+	}
+	CullAABBList_SSE_1(aabbs.data(), N, planes, aabbResults.data());
+
+	timer.start();
+	for (int rep = 0; rep < reps; ++rep) {
+		sphereRef.clear();
+		for (unsigned int i = 0; i < N; ++i) {
+			Sphere s{ x[i], y[i], z[i], r[i] };
+			if (intersect(planes, s) != Outside) {
+				sphereRef.push_back(i);
+			}
+		}
+	}
+	timer.stop();
+	double scalarRate = (double)N * reps / (timer.getMillisPassed() * 1.0e6);
+	logger.test("frustum culling: scalar intersect, %u of %u spheres visible, %.3f objects/ns", (unsigned int)sphereRef.size(), N, scalarRate);
+
+	for (unsigned int i = 0; i < N; ++i) {
+		if (aabbResults[i] != Outside) {
+			aabbRef.push_back(i);
+		}
+	}
+
+	static const char* kernelNames[] = { "SSE", "AVX2", "AVX512" };
+	std::vector<uint32_t> visible(N);
+	CullKernel defaultKernel = getCullKernel();
+
+	for (int k = CullKernel_SSE; k <= CullKernel_AVX512; ++k) {
+		setCullKernel(static_cast<CullKernel>(k));
+		if (getCullKernel() != k) {
+			logger.test("frustum culling: %s not supported, skipped", kernelNames[k]);
+			continue;
+		}
+
+		unsigned int numVisible = CullSphereList(x.data(), y.data(), z.data(), r.data(), N, frustum, visible.data());
+		assert(numVisible == sphereRef.size() && "sphere kernel visible count differs from scalar");
+		for (unsigned int i = 0; i < numVisible; ++i) {
+			assert(visible[i] == sphereRef[i] && "sphere kernel visible index differs from scalar");
+		}
+
+		numVisible = CullAABBList(x.data(), y.data(), z.data(), ex.data(), ey.data(), ez.data(), N, frustum, visible.data());
+		assert(numVisible == aabbRef.size() && "aabb kernel visible count differs from scalar");
+		for (unsigned int i = 0; i < numVisible; ++i) {
+			assert(visible[i] == aabbRef[i] && "aabb kernel visible index differs from scalar");
+		}
+
+		timer.start();
+		for (int rep = 0; rep < reps; ++rep) {
+			CullSphereList(x.data(), y.data(), z.data(), r.data(), N, frustum, visible.data());
+		}
+		timer.stop();
+		double sphereRate = (double)N * reps / (timer.getMillisPassed() * 1.0e6);
+
+		timer.start();
+		for (int rep = 0; rep < reps; ++rep) {
+			CullAABBList(x.data(), y.data(), z.data(), ex.data(), ey.data(), ez.data(), N, frustum, visible.data());
+		}
+		timer.stop();
+		double aabbRate = (double)N * reps / (timer.getMillisPassed() * 1.0e6);
+
+		logger.test("frustum culling: %s spheres %.3f objects/ns (%.1fx scalar), aabbs %.3f objects/ns",
+					kernelNames[k], sphereRate, sphereRate / scalarRate, aabbRate);
+	}
+
+	setCullKernel(defaultKernel);
+}
+
+void testFrustumCulling()
+{
+	runFrustumCulling(4099, 1);
+}
+
+void benchmarkFrustumCulling()
+{
+	runFrustumCulling(100003, 50);
+}
+
+
+/**
+* out = a * b, column-major 4x4
+*/
+static void mulMat4(const float* a, const float* b, float* out)
+{
+	for (int c = 0; c < 4; ++c) {
+		for (int r = 0; r < 4; ++r) {
+			out[c * 4 + r] = a[r] * b[c * 4] + a[4 + r] * b[c * 4 + 1] + a[8 + r] * b[c * 4 + 2] + a[12 + r] * b[c * 4 + 3];
+		}
+	}
+}
+
+
+/**
+* A camera drifting and turning slowly through a static field of spheres, the coherent culling
+* must give exactly the same bits as a full test every frame
+*/
+void testCoherentFrustumCulling()
+{
+	const unsigned int N = 5000;
+	const unsigned int numFrustums = 2;
+	const int numFrames = 200;
+	const float maxMove = 1.0f;
+	const float maxTurn = 0.02f;
+
+	float proj[16] = {};
+	float f = 1.0f / std::tan(0.5236f);
+	proj[0] = f / (16.0f / 9.0f);
+	proj[5] = f;
+	proj[10] = (1000.0f + 1.0f) / (1.0f - 1000.0f);
+	proj[11] = -1.0f;
+	proj[14] = (2.0f * 1000.0f * 1.0f) / (1.0f - 1000.0f);
+
+	std::mt19937 rng(2);
+	std::uniform_real_distribution<float> pos(-600.0f, 600.0f);
+	std::uniform_real_distribution<float> size(0.5f, 20.0f);
+	std::vector<float> x(N), y(N), z(N), r(N);
+	for (unsigned int i = 0; i < N; ++i) {
+		x[i] = pos(rng); y[i] = pos(rng); z[i] = pos(rng);
+		r[i] = size(rng);
+	}
+
+	std::vector<uint8_t> cache(N * numFrustums, CoherentCull_NoPlane);
+	std::vector<uint32_t> coherentBits(N), fullBits(N);
+	float referenceEyes[numFrustums][3] = {};
+	float referenceYaw[numFrustums] = {};
+	uint64_t planeTests = 0;
+
+	for (int frame = 0; frame < numFrames; ++frame) {
+		Frustum frustums[numFrustums];
+		float eyes[numFrustums * 3];
+		uint32_t stillMask = 0;
+
+		// the second frustum looks the opposite way and moves twice as fast
+		for (unsigned int c = 0; c < numFrustums; ++c) {
+			float yaw = frame * 0.003f * (c + 1) + c * 3.14159f;
+			float eye[3] = { frame * 0.05f * (c + 1), 0.0f, frame * -0.1f };
+
+			float view[16] = {};
+			view[0] = std::cos(-yaw);	view[8] = std::sin(-yaw);
+			view[2] = -std::sin(-yaw);	view[10] = std::cos(-yaw);
+			view[5] = 1.0f;				view[15] = 1.0f;
+			view[12] = -(view[0] * eye[0] + view[8] * eye[2]);
+			view[13] = -eye[1];
+			view[14] = -(view[2] * eye[0] + view[10] * eye[2]);
+
+			float viewProj[16];
+			mulMat4(proj, view, viewProj);
+			frustums[c].extractFromMatrixGL(viewProj);
+			eyes[c * 3] = eye[0]; eyes[c * 3 + 1] = eye[1]; eyes[c * 3 + 2] = eye[2];
+
+			float dx = eye[0] - referenceEyes[c][0];
+			float dz = eye[2] - referenceEyes[c][2];
+			if (frame > 0 && std::sqrt(dx * dx + dz * dz) < maxMove && std::abs(yaw - referenceYaw[c]) < maxTurn) {
+				stillMask |= 1U << c;
+			}
+			else {
+				referenceEyes[c][0] = eye[0]; referenceEyes[c][1] = eye[1]; referenceEyes[c][2] = eye[2];
+				referenceYaw[c] = yaw;
+			}
+		}
+
+		// both ends of the allowed drift can be in between an inside result and its reuse
+		planeTests += CullSphereListMultiCoherent(x.data(), y.data(), z.data(), r.data(), N,
+												  frustums, eyes, numFrustums, stillMask,
+												  2.0f * maxMove, 2.0f * maxTurn,
+												  cache.data(), coherentBits.data());
+		CullSphereListMulti_SSE(x.data(), y.data(), z.data(), r.data(), N & ~3U,
+								frustums, numFrustums, fullBits.data());
+
+		for (unsigned int i = 0; i < (N & ~3U); ++i) {
+			assert(coherentBits[i] == fullBits[i] && "coherent culling differs from the full test");
+		}
+	}
+
+	double testsPerSphere = (double)planeTests / ((double)N * numFrustums * numFrames);
+	logger.test("frustum culling: coherent culling averaged %.2f plane tests per sphere and frustum, full test is up to 6", testsPerSphere);
+}
+
+
+/**
+* Planes come out of extractFromMatrixGL normalized and facing into the frustum, and the far
+* plane sits at the far clip distance rather than on top of the near plane
+*/
+void testFrustumPlaneExtraction()
+{
+	// perspective projection, 90 degree vertical fov, square, near 1, far 1000, column-major
+	const float n = 1.0f, fa = 1000.0f;
+	float proj[16] = {};
+	proj[0] = 1.0f;
+	proj[5] = 1.0f;
+	proj[10] = (fa + n) / (n - fa);
+	proj[11] = -1.0f;
+	proj[14] = (2.0f * fa * n) / (n - fa);
+
+	Frustum frustum;
+	frustum.extractFromMatrixGL(proj);
+	Plane planes[6];
+	frustum.getPlanes(planes);
+
+	auto approx = [](float a, float b) { return std::abs(a - b) < 1.0e-3f; };
+	for (int p = 0; p < 6; ++p) {
+		assert(approx(planes[p].nx * planes[p].nx + planes[p].ny * planes[p].ny + planes[p].nz * planes[p].nz, 1.0f) &&
+			   "plane not normalized");
+		// every plane faces the middle of the frustum
+		assert(planes[p].distanceToPoint(0.0f, 0.0f, -10.0f) > 0.0f && "plane normal faces out of the frustum");
+	}
+
+	// near and far face each other down the view axis, at the clip distances
+	assert(approx(planes[Frustum::Near].nz, -1.0f) && approx(planes[Frustum::Near].distanceToPoint(0.0f, 0.0f, -n), 0.0f) &&
+		   "near plane not at the near clip distance");
+	assert(approx(planes[Frustum::Far].nz, 1.0f) && std::abs(planes[Frustum::Far].distanceToPoint(0.0f, 0.0f, -fa)) < 0.05f &&
+		   "far plane not at the far clip distance");
+	assert(planes[Frustum::Far].distanceToPoint(0.0f, 0.0f, -fa - 1.0f) < 0.0f && "point beyond the far plane inside");
+	assert(planes[Frustum::Near].distanceToPoint(0.0f, 0.0f, -0.5f) < 0.0f && "point in front of the near plane inside");
+
+	// side planes pass through the eye at 45 degrees
+	assert(planes[Frustum::Left].distanceToPoint(-20.0f, 0.0f, -10.0f) < 0.0f && planes[Frustum::Left].nx > 0.0f &&
+		   "left plane wrong");
+	assert(planes[Frustum::Right].distanceToPoint(20.0f, 0.0f, -10.0f) < 0.0f && planes[Frustum::Right].nx < 0.0f &&
+		   "right plane wrong");
+	assert(planes[Frustum::Top].distanceToPoint(0.0f, 20.0f, -10.0f) < 0.0f && planes[Frustum::Top].ny < 0.0f &&
+		   "top plane wrong");
+	assert(planes[Frustum::Bottom].distanceToPoint(0.0f, -20.0f, -10.0f) < 0.0f && planes[Frustum::Bottom].ny > 0.0f &&
+		   "bottom plane wrong");
+
+	// the scalar intersect agrees with the planes
+	Sphere inside{ 0.0f, 0.0f, -500.0f, 1.0f };
+	Sphere straddlingFar{ 0.0f, 0.0f, -fa, 5.0f };
+	Sphere beyondFar{ 0.0f, 0.0f, -fa - 10.0f, 5.0f };
+	Sphere behindEye{ 0.0f, 0.0f, 10.0f, 5.0f };
+	assert(intersect(planes, inside) == Inside && "sphere in the middle not inside");
+	assert(intersect(planes, straddlingFar) == Intersect && "sphere on the far plane not intersecting");
+	assert(intersect(planes, beyondFar) == Outside && "sphere beyond the far plane not outside");
+	assert(intersect(planes, behindEye) == Outside && "sphere behind the eye not outside");
+
+	// with a view, planes are in world space, the camera at (100,0,0) looking down -z
+	float view[16] = {};
+	view[0] = 1.0f; view[5] = 1.0f; view[10] = 1.0f; view[15] = 1.0f;
+	view[12] = -100.0f;
+	float viewProj[16];
+	mulMat4(proj, view, viewProj);
+	Frustum worldFrustum;
+	worldFrustum.extractFromMatrixGL(viewProj);
+	worldFrustum.getPlanes(planes);
+	Sphere worldInside{ 100.0f, 0.0f, -500.0f, 1.0f };
+	Sphere worldOutside{ 0.0f, 0.0f, -50.0f, 1.0f };
+	assert(intersect(planes, worldInside) == Inside && "world space sphere in view not inside");
+	assert(intersect(planes, worldOutside) == Outside && "world space sphere out of view not outside");
+
+	logger.test("frustum culling: plane extraction signs and far plane correct");
+}
+
+
+/**
+* CullSphereListMulti_SSE gives the same bits as the scalar intersect per frustum, for 32
+* frustums with different eyes, headings and clip distances
+*/
+void testMultiFrustumCulling()
+{
+	const unsigned int N = 4096;
+	const unsigned int numFrustums = 32;
+
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> pos(-600.0f, 600.0f);
+	std::uniform_real_distribution<float> size(0.5f, 20.0f);
+	std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f);
+	std::vector<float> x(N), y(N), z(N), r(N);
+	for (unsigned int i = 0; i < N; ++i) {
+		x[i] = pos(rng); y[i] = pos(rng); z[i] = pos(rng);
+		r[i] = size(rng);
+	}
+
+	Frustum frustums[numFrustums];
+	for (unsigned int c = 0; c < numFrustums; ++c) {
+		float fov = 0.3f + 0.05f * c;
+		float nearClip = 0.5f + 0.25f * c;
+		float farClip = 100.0f + 30.0f * c;
+		float proj[16] = {};
+		float f = 1.0f / std::tan(fov);
+		proj[0] = f / (16.0f / 9.0f);
+		proj[5] = f;
+		proj[10] = (farClip + nearClip) / (nearClip - farClip);
+		proj[11] = -1.0f;
+		proj[14] = (2.0f * farClip * nearClip) / (nearClip - farClip);
+
+		float yaw = angle(rng);
+		float eye[3] = { pos(rng) * 0.5f, pos(rng) * 0.1f, pos(rng) * 0.5f };
+		float view[16] = {};
+		view[0] = std::cos(-yaw);	view[8] = std::sin(-yaw);
+		view[2] = -std::sin(-yaw);	view[10] = std::cos(-yaw);
+		view[5] = 1.0f;				view[15] = 1.0f;
+		view[12] = -(view[0] * eye[0] + view[8] * eye[2]);
+		view[13] = -eye[1];
+		view[14] = -(view[2] * eye[0] + view[10] * eye[2]);
+
+		float viewProj[16];
+		mulMat4(proj, view, viewProj);
+		frustums[c].extractFromMatrixGL(viewProj);
+	}
+
+	std::vector<uint32_t> visibleBits(N);
+	CullSphereListMulti_SSE(x.data(), y.data(), z.data(), r.data(), N, frustums, numFrustums, visibleBits.data());
+
+	unsigned int numVisible = 0;
+	for (unsigned int c = 0; c < numFrustums; ++c) {
+		Plane planes[6];
+		frustums[c].getPlanes(planes);
+		for (unsigned int i = 0; i < N; ++i) {
+			Sphere s{ x[i], y[i], z[i], r[i] };
+			bool visible = (intersect(planes, s) != Outside);
+			assert(visible == ((visibleBits[i] & (1U << c)) != 0) && "multi frustum kernel differs from scalar");
+			numVisible += visible ? 1 : 0;
+		}
+	}
+	assert(numVisible > 0 && "nothing visible, the comparison proves nothing");
+
+	logger.test("frustum culling: multi frustum kernel matches scalar for %u spheres and %u frustums, %u visible pairs",
+				N, numFrustums, numVisible);
+}
+
+
+/**
+* @returns true if the segment from camera to p passes through the sphere
+*/
+static bool segmentHitsSphere(const glm::dvec3& camera, const glm::dvec3& p, const glm::dvec3& center, double radius)
+{
+	glm::dvec3 seg(p - camera);
+	double t = glm::dot(center - camera, seg) / glm::dot(seg, seg);
+	t = (t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t));
+	glm::dvec3 closest(camera + seg * t - center);
+	return glm::dot(closest, closest) <= radius * radius;
+}
+
+
+/**
+* Objects scattered over an earth sized planet seen from low altitude. Every kernel must agree,
+* and every sphere reported hidden must really be behind the occluder. The first 1000 objects are
+* placed close to the camera, so N must be well above that.
+*/
+static void runHorizonCulling(const unsigned int N, const int reps)
+{
+	const double planetRadius = 6371000.0;
+	const double occluderRadius = planetRadius - 100.0;
+	const glm::dvec3 center(0.0);
+	const glm::dvec3 camera(0.0, 0.0, planetRadius + 2000.0);
+
+	std::mt19937 rng(3);
+	std::normal_distribution<double> dir(0.0, 1.0);
+	std::uniform_real_distribution<double> height(0.0, 5000.0);
+	std::uniform_real_distribution<double> size(1.0, 500.0);
+
+	std::vector<double> x(N), y(N), z(N), r(N);
+	for (unsigned int i = 0; i < N; ++i) {
+		glm::dvec3 p(glm::normalize(glm::dvec3(dir(rng), dir(rng), dir(rng))) * (planetRadius + height(rng)));
+		x[i] = p.x; y[i] = p.y; z[i] = p.z;
+		r[i] = size(rng);
+	}
+	// a few close to the camera, where nearly everything is visible
+	for (unsigned int i = 0; i < 1000; ++i) {
+		glm::dvec3 p(glm::normalize(glm::dvec3(dir(rng) * 0.01, dir(rng) * 0.01, 1.0)) * (planetRadius + height(rng)));
+		x[i] = p.x; y[i] = p.y; z[i] = p.z;
+	}
+
+	static const char* kernelNames[] = { "SSE", "AVX2", "AVX512" };
+	std::vector<uint32_t> reference, visible(N);
+	CullKernel defaultKernel = getCullKernel();
+
+	for (int k = CullKernel_SSE; k <= CullKernel_AVX512; ++k) {
+		setCullKernel(static_cast<CullKernel>(k));
+		if (getCullKernel() != k) {
+			logger.test("horizon culling: %s not supported, skipped", kernelNames[k]);
+			continue;
+		}
+
+		unsigned int numVisible = CullHorizonSphereList(x.data(), y.data(), z.data(), r.data(), N,
+														camera, center, occluderRadius, visible.data());
+		if (k == CullKernel_SSE) {
+			reference.assign(visible.begin(), visible.begin() + numVisible);
+
+			// check the hidden spheres, center and the six extreme points must all be occluded
+			unsigned int v = 0;
+			for (unsigned int i = 0; i < N; ++i) {
+				if (v < numVisible && reference[v] == i) {
+					++v;
+					continue;
+				}
+				glm::dvec3 c(x[i], y[i], z[i]);
+				glm::dvec3 offsets[7] = { {}, { r[i], 0, 0 }, { -r[i], 0, 0 }, { 0, r[i], 0 },
+										  { 0, -r[i], 0 }, { 0, 0, r[i] }, { 0, 0, -r[i] } };
+				for (auto& o : offsets) {
+					assert(segmentHitsSphere(camera, c + o, center, occluderRadius) && "sphere reported hidden is in view");
+				}
+			}
+			assert(numVisible > 1000 && numVisible < N / 10 && "expected most of the planet to be hidden");
+		}
+		else {
+			assert(numVisible == reference.size() && "horizon kernel visible count differs from SSE");
+			for (unsigned int i = 0; i < numVisible; ++i) {
+				assert(visible[i] == reference[i] && "horizon kernel visible index differs from SSE");
+			}
+		}
+
+		timer.start();
+		for (int rep = 0; rep < reps; ++rep) {
+			CullHorizonSphereList(x.data(), y.data(), z.data(), r.data(), N, camera, center, occluderRadius, visible.data());
+		}
+		timer.stop();
+		double rate = (double)N * reps / (timer.getMillisPassed() * 1.0e6);
+
+		logger.test("horizon culling: %s %u of %u spheres visible, %.3f objects/ns", kernelNames[k], numVisible, N, rate);
+	}
+
+	// from inside the occluder nothing is hidden
+	unsigned int numVisible = CullHorizonSphereList(x.data(), y.data(), z.data(), r.data(), N,
+													center, center, occluderRadius, visible.data());
+	assert(numVisible == N && "camera inside the occluder must not hide anything");
+
+	setCullKernel(defaultKernel);
+}
+
+void testHorizonCulling()
+{
+	runHorizonCulling(20011, 1);
+}
+
+void benchmarkHorizonCulling()
+{
+	runHorizonCulling(100003, 50);
+}
\ No newline at end of file
@@ -2,7 +2,13 @@
 //#include "../ComponentStoreSerialization.h"
 #include <entity/components.h>
 #include <entity/ComponentStore.h>
+#include <entity/EntityManager.h>
+#include <entity/EntitySnapshot.h>
+#include <entity/ComponentStoreHistory.h>
 #include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <random>
 #include <tuple>
 #include <boost/fusion/adapted/std_tuple.hpp>
 #include <boost/fusion/algorithm/iteration/for_each.hpp>
@@ -10,6 +16,7 @@
 #include <fstream>
 #include <sstream>
 #include <memory>
+#include <cassert>
 #include <utility/profile/Profile.h>
 #include <utility/Logger.h>
 #include <scene/SceneGraph.h>
@@ -120,12 +127,12 @@ void testReflection() {
 		logger.test("%s : %s\n", f.name.c_str(), f.description.c_str());
 	}
 
-	int a = std::get<scene::SceneNode::Reflection::numChildren>(vals);
+	int a = std::get<scene::SceneNode::Reflection::descendantDirty>(vals);
 	uint8_t b = std::get<scene::SceneNode::Reflection::positionDirty>(vals);
 	uint8_t c = std::get<scene::SceneNode::Reflection::orientationDirty>(vals);
 
 	logger.test("scene node values: %d, %d, %d\n", a, b, c);
-	logger.test("numChildren description: %s\n", nodeProps[scene::SceneNode::Reflection::FieldToEnum("numChildren")].description.c_str());
+	logger.test("translationLocal description: %s\n", nodeProps[scene::SceneNode::Reflection::FieldToEnum("translationLocal")].description.c_str());
 	std::get<scene::SceneNode::Reflection::positionDirty>(vals) = 1;
 	std::get<scene::SceneNode::Reflection::orientationDirty>(vals) = 1;
 	logger.test("position dirty = %d\n", node.positionDirty); // should now be 1
@@ -199,3 +206,570 @@ void testReflection() {
 	logger.test("sceneNodeStore read:\n%s\n\n", sceneNodeStoreReadTest.to_string().c_str());
 	*/
 }
+
+
+void testEntityTags()
+{
+	EntityManager entityMgr;
+	std::vector<EntityId> entities;
+	for (int e = 0; e < 1000; ++e) {
+		entities.push_back(entityMgr.createEntity());
+	}
+
+	// every entity static, every third shakable
+	for (int e = 0; e < 1000; ++e) {
+		entityMgr.addTagToEntity(Static_Tag, entities[e]);
+		if (e % 3 == 0) {
+			entityMgr.addTagToEntity(Shakable_Tag, entities[e]);
+		}
+	}
+	assert(!entityMgr.addTagToEntity(Static_Tag, entities[0]) && "tag added twice");
+	assert(entityMgr.getTaggedEntities(Static_Tag).size() == 1000 && "wrong number of tagged entities");
+	assert(entityMgr.getTaggedEntities(Shakable_Tag).size() == 334 && "wrong number of tagged entities");
+
+	// removal swaps the last entity into the hole, lists must stay consistent
+	for (int e = 0; e < 1000; e += 2) {
+		entityMgr.removeTagFromEntity(Static_Tag, entities[e]);
+	}
+	assert(!entityMgr.entityHasTag(entities[0], Static_Tag) && entityMgr.entityHasTag(entities[1], Static_Tag) &&
+		   "tag mask out of sync");
+	for (auto entityId : entityMgr.getTaggedEntities(Static_Tag)) {
+		assert(entityId.index % 2 == 1 && "removed entity still in tag list");
+	}
+
+	// shakable and not static, entity indices multiple of 6
+	TagMask required, excluded;
+	required.set(Shakable_Tag);
+	excluded.set(Static_Tag);
+	std::vector<EntityId> result;
+	entityMgr.getEntitiesWithTags(required, excluded, result);
+	assert(result.size() == 167 && "wrong tag query result");
+	for (auto entityId : result) {
+		assert(entityId.index % 6 == 0 && "wrong entity in tag query result");
+	}
+
+	logger.test("entity tags: static=%d shakable=%d shakable and not static=%d",
+				static_cast<int>(entityMgr.getTaggedEntities(Static_Tag).size()),
+				static_cast<int>(entityMgr.getTaggedEntities(Shakable_Tag).size()),
+				static_cast<int>(result.size()));
+}
+
+
+void testComponentObservers()
+{
+	EntityManager entityMgr;
+	std::vector<EntityId> entities;
+	for (int e = 0; e < 100; ++e) {
+		entities.push_back(entityMgr.createEntity());
+	}
+
+	// data components have no static type, observe by store index
+	uint16_t storeIndex = entityMgr.createDataComponentStore(0, 16, 100);
+
+	int calls = 0;
+	size_t added = 0;
+	size_t removed = 0;
+	auto observerId = entityMgr.addComponentObserver(storeIndex,
+		[&](EntityManager& em, uint16_t typeId, const std::vector<ComponentEvent>& addedEvents,
+			const std::vector<ComponentEvent>& removedEvents)
+		{
+			assert(typeId == storeIndex && "observer called for the wrong type");
+			++calls;
+			added += addedEvents.size();
+			removed += removedEvents.size();
+		});
+
+	std::vector<ComponentId> components;
+	for (int e = 0; e < 100; ++e) {
+		components.push_back(entityMgr.addDataComponentToEntity(0, entities[e]));
+	}
+	for (int e = 0; e < 100; e += 4) {
+		entityMgr.removeComponent(components[e]);
+	}
+	assert(calls == 0 && "observer called from the mutation path");
+
+	entityMgr.dispatchComponentEvents();
+	assert(calls == 1 && added == 100 && removed == 25 && "events not batched into one call");
+
+	entityMgr.dispatchComponentEvents();
+	assert(calls == 1 && "events dispatched twice");
+
+	// no events are recorded once the last observer is gone
+	entityMgr.removeComponentObserver(observerId);
+	entityMgr.removeComponent(components[1]);
+	entityMgr.dispatchComponentEvents();
+	assert(calls == 1 && removed == 25 && "event recorded without an observer");
+
+	logger.test("component observers: %d batch, %d added, %d removed",
+				calls, static_cast<int>(added), static_cast<int>(removed));
+}
+
+
+/**
+* Covers the three ways getChangedSince answers: the dirty-index list, the chunk scan once the
+* list has been trimmed past the queried version, and the reset after loading a snapshot
+*/
+void testComponentChangeTracking()
+{
+	using scene::SceneNode;
+
+	const uint32_t numComponents = 1000;
+	ComponentStore<SceneNode> store(numComponents);
+	auto ids = store.createComponents(numComponents, EntityId{});
+	std::vector<uint32_t> changed;
+
+	// dirty list, each written slot reported once however often it was written
+	uint32_t since = store.advanceVersion();
+	store.getMutable(ids[3]).translationLocal.x = 1.0;
+	store.getMutable(ids[10]).translationLocal.x = 1.0;
+	store.getMutable(ids[10]).translationLocal.y = 1.0;
+	store.markChanged(ids[500]);
+	store.getChangedSince(since, changed);
+	assert((changed == std::vector<uint32_t>{ 3, 10, 500 }) && "wrong dirty list result");
+
+	// erase swaps the last component into the hole, the hole is reported
+	since = store.advanceVersion();
+	changed.clear();
+	store.removeComponent(ids[20]);
+	store.getChangedSince(since, changed);
+	assert((changed == std::vector<uint32_t>{ 20 }) && "erase hole not reported");
+
+	since = store.advanceVersion();
+	changed.clear();
+	store.getChangedSince(since, changed);
+	assert(changed.empty() && "changes reported from a closed version");
+
+	// write enough versions to trim the dirty list past an old query, the chunk scan must give
+	// the same answer
+	uint32_t size = static_cast<uint32_t>(store.getComponents().size());
+	uint32_t oldVersion = store.advanceVersion();
+	std::vector<uint8_t> expected(size, 0);
+	for (uint32_t n = 0; n < 5 * size; ++n) {
+		uint32_t i = (n * 7919) % (size / 2); // only the first half, the scan must skip the rest
+		store.markChangedInnerIndex(i);
+		expected[i] = 1;
+		store.advanceVersion();
+	}
+	changed.clear();
+	store.getChangedSince(oldVersion, changed);
+	std::sort(changed.begin(), changed.end());
+	std::vector<uint32_t> expectedIndices;
+	for (uint32_t i = 0; i < size; ++i) {
+		if (expected[i]) { expectedIndices.push_back(i); }
+	}
+	assert(changed == expectedIndices && "chunk scan fallback disagrees with the writes");
+
+	// recent queries are still answered by the dirty list
+	since = store.advanceVersion();
+	changed.clear();
+	store.markChangedInnerIndex(size - 1);
+	store.getChangedSince(since, changed);
+	assert((changed == std::vector<uint32_t>{ size - 1 }) && "dirty list lost after trimming");
+
+	// after loading a snapshot everything is changed, and nothing after the next version
+	const char* filename = "test_changes.snapshot";
+	{
+		SnapshotWriter writer(filename);
+		writer.beginSection(SnapshotSection_ComponentStore, SceneNode::componentType);
+		store.writeSnapshot(writer);
+		writer.finish();
+	}
+	ComponentStore<SceneNode> loaded(numComponents);
+	loaded.getMutable(loaded.createComponent(EntityId{}));
+	{
+		MappedSnapshot snapshot(filename);
+		loaded.readSnapshot(snapshot, *snapshot.findSection(SnapshotSection_ComponentStore, SceneNode::componentType));
+	}
+	std::remove(filename);
+
+	changed.clear();
+	loaded.getChangedSince(0, changed);
+	assert(changed.size() == size && "loaded components not all reported as changed");
+	for (uint32_t i = 0; i < size; ++i) {
+		assert(changed[i] == i && "loaded components not all reported as changed");
+	}
+
+	since = loaded.advanceVersion();
+	changed.clear();
+	loaded.getChangedSince(since, changed);
+	assert(changed.empty() && "changes reported after the load version was closed");
+
+	loaded.getMutable(ids[3]);
+	loaded.getChangedSince(since, changed);
+	assert((changed == std::vector<uint32_t>{ 3 }) && "write after load not reported");
+
+	logger.test("component change tracking: %u components, %u changed since a version older than the dirty list",
+				size, static_cast<uint32_t>(expectedIndices.size()));
+}
+
+
+/**
+* Fills an EntityManager with scene nodes, model instances, a data component and tags, with
+* removed components leaving holes in the stores, writes it to a snapshot and loads it into an
+* empty EntityManager.
+* @returns milliseconds to write and to map and load, through outWriteMillis and outReadMillis
+*/
+static void runEntitySnapshot(const uint32_t numEntities, double& outWriteMillis, double& outReadMillis)
+{
+	using scene::SceneNode;
+	using scene::ModelInstance;
+
+	const char* filename = "test_entities.snapshot";
+	const uint32_t dataSize = 16;
+
+	EntityManager src;
+	src.createDataComponentStore(0, dataSize, numEntities / 5 + 1);
+	std::vector<EntityId> entities;
+	std::vector<ComponentId> nodeIds;
+	entities.reserve(numEntities);
+	nodeIds.reserve(numEntities);
+
+	for (uint32_t e = 0; e < numEntities; ++e) {
+		auto entityId = src.createEntity();
+		entities.push_back(entityId);
+
+		SceneNode node{};
+		node.translationLocal = glm::dvec3(e, 1.0, 2.0);
+		node.positionWorld = glm::dvec3(e, -1.0, -2.0);
+		node.rotationLocal = glm::dquat(1.0, 0.0, 0.0, 0.0);
+		node.orientationWorld = glm::dquat(1.0, 0.0, 0.0, 0.0);
+		nodeIds.push_back(src.addComponentToEntity(std::move(node), entityId));
+
+		if (e % 3 == 0) {
+			// owns a resource pointer so it takes the property by property path
+			ModelInstance model{};
+			model.sceneNodeId = scene::SceneNodeRef::fromId(nodeIds.back());
+			model.modelId.value = e;
+			src.addComponentToEntity(std::move(model), entityId);
+		}
+		if (e % 5 == 0) {
+			src.addDataComponentToEntity(0, entityId);
+		}
+		if (e % 2 == 0) {
+			src.addTagToEntity(Static_Tag, entityId);
+		}
+	}
+	uint32_t srcCount = 0, stride = 0;
+	auto srcData = reinterpret_cast<uint8_t*>(src.getDataComponentItems(0, srcCount, stride));
+	uint32_t badCount = 0, badStride = 0;
+	assert(src.getDataComponentItems(1, badCount, badStride) == nullptr &&
+		   src.getDataComponentItems(MAX_COMPONENTS, badCount, badStride) == nullptr &&
+		   src.getDataComponentItems(0xFFFF, badCount, badStride) == nullptr && badCount == 0 &&
+		   "items returned for a missing store or a typeId out of range");
+	for (uint32_t i = 0; i < srcCount; ++i) {
+		memset(srcData + i * stride, static_cast<int>(i & 0xFF), dataSize);
+	}
+
+	// leave holes and a freelist in the scene node store
+	for (uint32_t e = 0; e < numEntities; e += 7) {
+		src.removeComponent(nodeIds[e]);
+	}
+
+	timer.start();
+	{
+		SnapshotWriter writer(filename);
+		src.writeSnapshot(writer);
+		writer.finish();
+	}
+	timer.stop();
+	outWriteMillis = timer.getMillisPassed();
+
+	EntityManager dst;
+	dst.getComponentStore<SceneNode>();
+	dst.getComponentStore<ModelInstance>();
+
+	timer.start();
+	{
+		MappedSnapshot snapshot(filename);
+		dst.readSnapshot(snapshot);
+	}
+	timer.stop();
+	outReadMillis = timer.getMillisPassed();
+	std::remove(filename);
+
+	assert(dst.getTaggedEntities(Static_Tag).size() == src.getTaggedEntities(Static_Tag).size() &&
+		   "tag lists not rebuilt from the snapshot");
+
+	uint32_t dstCount = 0, dstStride = 0;
+	auto dstData = reinterpret_cast<const uint8_t*>(dst.getDataComponentItems(0, dstCount, dstStride));
+	assert(dstData != nullptr && dstCount == srcCount && dstStride == stride && "data component store not recreated");
+	assert(memcmp(dstData, srcData, srcCount * stride) == 0 && "data components differ after loading");
+
+	for (uint32_t e = 0; e < numEntities; ++e) {
+		auto entityId = entities[e];
+		assert(dst.entityIsValid(entityId) && "entity id not valid after loading");
+		assert(dst.getEntityComponentMask(entityId) == src.getEntityComponentMask(entityId) &&
+			   dst.getAllEntityComponents(entityId) == src.getAllEntityComponents(entityId) &&
+			   dst.getEntityTagMask(entityId) == src.getEntityTagMask(entityId) &&
+			   "entity differs after loading");
+
+		// glm members are plain data but not trivially copyable, they must survive both paths
+		if (e % 7 != 0) {
+			auto& node = dst.getComponent<SceneNode>(nodeIds[e]);
+			assert(node.translationLocal.x == e && node.positionWorld.x == e && node.positionWorld.z == -2.0 &&
+				   node.orientationWorld.w == 1.0 && "scene node differs after loading");
+		}
+		if (e % 3 == 0) {
+			auto model = dst.getEntityComponent<ModelInstance>(entityId);
+			assert(model != nullptr && model->modelId.value == e &&
+				   model->sceneNodeId == src.getEntityComponent<ModelInstance>(entityId)->sceneNodeId &&
+				   !model->modelPtr && "model instance differs after loading");
+		}
+	}
+
+	// removed components stay removed, new ones reuse the freelist the same way
+	assert(!dst.getComponentStore<SceneNode>().isValid(nodeIds[0]) && "removed component valid after loading");
+	SceneNode node{};
+	auto srcNew = src.addComponentToEntity(SceneNode(node), entities[0]);
+	auto dstNew = dst.addComponentToEntity(SceneNode(node), entities[0]);
+	assert(srcNew == dstNew && "freelist differs after loading");
+}
+
+
+/**
+* Round trips a small EntityManager through a snapshot, and checks that a snapshot with a block
+* size overflowing 64 bits is rejected rather than read out of range
+*/
+void testEntitySnapshot()
+{
+	// glm types have user copy constructors, reflection must still see them as plain data
+	for (auto& prop : scene::SceneNode::Reflection::getProperties()) {
+		assert(prop.isTriviallyDestructible && "scene node property not copied by snapshots");
+	}
+
+	const uint32_t numEntities = 10000;
+	double writeMillis = 0, readMillis = 0;
+	runEntitySnapshot(numEntities, writeMillis, readMillis);
+
+	// corrupt the first block's count so count * elementSize wraps around to a small number
+	const char* filename = "test_corrupt.snapshot";
+	{
+		EntityManager entityMgr;
+		entityMgr.createEntity();
+		SnapshotWriter writer(filename);
+		entityMgr.writeSnapshot(writer);
+		writer.finish();
+	}
+	{
+		std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+		SnapshotHeader header{};
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		SnapshotSection section{};
+		file.seekg(header.sectionTableOffset);
+		file.read(reinterpret_cast<char*>(&section), sizeof(section));
+		section.blocks[SnapshotBlock_Ids].count = UINT64_MAX / section.blocks[SnapshotBlock_Ids].elementSize + 1;
+		file.seekp(header.sectionTableOffset);
+		file.write(reinterpret_cast<const char*>(&section), sizeof(section));
+	}
+	bool rejected = false;
+	try {
+		MappedSnapshot snapshot(filename);
+	}
+	catch (std::runtime_error&) {
+		rejected = true;
+	}
+	std::remove(filename);
+	assert(rejected && "snapshot with an overflowing block size was loaded");
+
+	logger.test("entity snapshot: %u entities, write %.2f ms, map and load %.2f ms",
+				numEntities, writeMillis, readMillis);
+}
+
+
+/**
+* One million entities should write and load well under a second
+*/
+void benchmarkEntitySnapshot()
+{
+	const uint32_t numEntities = 1000000;
+	double writeMillis = 0, readMillis = 0;
+	runEntitySnapshot(numEntities, writeMillis, readMillis);
+
+	logger.test("entity snapshot: %u entities, write %.2f ms, map and load %.2f ms",
+				numEntities, writeMillis, readMillis);
+}
+
+
+/**
+* Copy of a store's handle_map, compared byte for byte since reverting restores exact bytes
+*/
+struct StoreState {
+	typedef ComponentStore<scene::SceneNode>::ComponentMap	ComponentMap;
+
+	std::vector<ComponentStore<scene::SceneNode>::ComponentRecord>	items;
+	std::vector<ComponentMap::Meta_T>	meta;
+	IdSet_T		ids;
+	uint32_t	freeList[2];
+
+	explicit StoreState(const ComponentStore<scene::SceneNode>& store) :
+		items(store.getComponents().getItems()),
+		meta(store.getComponents().getMeta()),
+		ids(store.getComponents().getIds()),
+		freeList{ store.getComponents().getFreeListFront(), store.getComponents().getFreeListBack() }
+	{}
+
+	bool operator==(const StoreState& s) const {
+		return (items.size() == s.items.size() && meta.size() == s.meta.size() && ids.size() == s.ids.size() &&
+				memcmp(items.data(), s.items.data(), items.size() * sizeof(items[0])) == 0 &&
+				memcmp(meta.data(), s.meta.data(), meta.size() * sizeof(meta[0])) == 0 &&
+				memcmp(ids.data(), s.ids.data(), ids.size() * sizeof(ids[0])) == 0 &&
+				freeList[0] == s.freeList[0] && freeList[1] == s.freeList[1]);
+	}
+};
+
+
+/**
+* One tick of gameplay on a store: writes through getMutable, then erases and inserts that
+* move items around the dense set and through the freelist
+*/
+static void historyTick(ComponentStore<scene::SceneNode>& store, std::vector<ComponentId>& ids,
+						std::mt19937& rng, uint32_t numWrites, uint32_t numErases, uint32_t numInserts)
+{
+	for (uint32_t w = 0; w < numWrites; ++w) {
+		auto& node = store.getMutable(ids[rng() % ids.size()]);
+		node.translationLocal.x += 1.0;
+		node.positionWorld.y = static_cast<double>(rng());
+	}
+	for (uint32_t e = 0; e < numErases && !ids.empty(); ++e) {
+		size_t i = rng() % ids.size();
+		store.removeComponent(ids[i]);
+		ids[i] = ids.back();
+		ids.pop_back();
+	}
+	for (uint32_t n = 0; n < numInserts; ++n) {
+		auto id = store.createComponent(EntityId{});
+		store.getMutable(id).translationLocal.z = static_cast<double>(rng());
+		ids.push_back(id);
+	}
+}
+
+
+/**
+* Captures a few frames of writes, erases and inserts, then reverts and reapplies through
+* all of them checking that the store matches the state recorded at each capture
+*/
+void testComponentStoreHistory()
+{
+	using scene::SceneNode;
+
+	const uint32_t numComponents = 2000;
+	const uint32_t numFrames = 6;
+	ComponentStore<SceneNode> store(numComponents);
+	auto ids = store.createComponents(numComponents, EntityId{});
+	for (uint32_t i = 0; i < numComponents; ++i) {
+		store.getMutable(ids[i]).translationLocal.x = i;
+	}
+
+	ComponentStoreHistory<SceneNode> history(store, numFrames);
+	std::vector<StoreState> states;
+	states.emplace_back(store);
+	std::mt19937 rng(1);
+
+	// writes only, then structural changes, then a frame with nothing to capture
+	for (uint32_t f = 1; f < numFrames; ++f) {
+		store.advanceVersion();
+		if (f == 1) {
+			historyTick(store, ids, rng, 50, 0, 0);
+		}
+		else if (f < numFrames - 1) {
+			historyTick(store, ids, rng, 50, 20 * f, 10 * f);
+		}
+
+		uint32_t version = store.getVersion();
+		size_t bytes = history.capture();
+		assert(store.getVersion() == version && "capture advanced the store's version");
+		assert((bytes == 0) == (f == numFrames - 1) && "wrong delta payload size");
+		states.emplace_back(store);
+	}
+	assert(history.getNumApplied() == numFrames - 1 && "wrong number of deltas");
+	assert(!(states[1] == states[0]) && !(states[numFrames - 2] == states[1]) && "frames made no changes");
+
+	for (uint32_t f = numFrames - 1; f > 0; --f) {
+		assert(history.revert() && "revert failed");
+		assert(StoreState(store) == states[f - 1] && "store differs from the captured state after revert");
+	}
+	assert(!history.revert() && history.getNumReverted() == numFrames - 1 && "reverted past the first capture");
+
+	for (uint32_t f = 1; f < numFrames; ++f) {
+		assert(history.reapply() && "reapply failed");
+		assert(StoreState(store) == states[f] && "store differs from the captured state after reapply");
+	}
+	assert(!history.reapply() && "reapplied past the last capture");
+
+	// a capture after reverting discards the reverted deltas
+	history.revert();
+	history.revert();
+	assert(StoreState(store) == states[numFrames - 3] && "store differs from the captured state after revert");
+	auto id = store.createComponent(EntityId{});
+	store.getMutable(id).translationLocal.x = -1.0;
+	history.capture();
+	assert(history.getNumReverted() == 0 && !history.reapply() && "reverted deltas kept after a capture");
+	history.revert();
+	assert(StoreState(store) == states[numFrames - 3] && "store differs from the captured state after revert");
+
+	// ids inserted by the reverted frames are gone, take the live ones from the store
+	ids.clear();
+	for (uint32_t i = 0; i < store.getComponents().size(); ++i) {
+		ids.push_back(store.getComponents().getHandleForInnerIndex(i));
+	}
+
+	// a full scan finds writes that bypassed change tracking, close the versions holding the
+	// slots revert touched first
+	store.advanceVersion();
+	history.capture();
+	store.advanceVersion();
+	store.getComponents()[ids[0]].component.translationLocal.y = 5.0;
+	assert(history.capture() == 0 && "write that bypassed change tracking captured without a full scan");
+	assert(history.capture(true) > 0 && "full scan missed a write");
+	history.revert();
+	assert(store.getComponent(ids[0]).translationLocal.y != 5.0 && "full scan delta not reverted");
+
+	// the ring keeps the newest deltas
+	for (uint32_t f = 0; f < 2 * numFrames; ++f) {
+		store.advanceVersion();
+		historyTick(store, ids, rng, 10, 2, 2);
+		history.capture();
+	}
+	assert(history.getNumApplied() == numFrames && "ring kept the wrong number of deltas");
+
+	logger.test("component store history: %u frames reverted and reapplied", numFrames - 1);
+}
+
+
+/**
+* A 100k component store with ~500 writes and ~45 erases and inserts per tick
+*/
+void benchmarkComponentStoreHistory()
+{
+	using scene::SceneNode;
+
+	const uint32_t numComponents = 100000;
+	const uint32_t numTicks = 200;
+	ComponentStore<SceneNode> store(numComponents);
+	auto ids = store.createComponents(numComponents, EntityId{});
+
+	ComponentStoreHistory<SceneNode> history(store, 64);
+	std::mt19937 rng(1);
+
+	double captureMillis = 0;
+	size_t bytes = 0;
+	for (uint32_t t = 0; t < numTicks; ++t) {
+		store.advanceVersion();
+		historyTick(store, ids, rng, 500, 23, 22);
+
+		timer.start();
+		bytes += history.capture();
+		timer.stop();
+		captureMillis += timer.getMillisPassed();
+	}
+
+	timer.start();
+	while (history.revert()) {}
+	timer.stop();
+	double revertMillis = timer.getMillisPassed() / 64;
+
+	double captureMicros = captureMillis * 1000.0 / numTicks;
+	logger.test("component store history: %u components, capture %.1f us (%.2f us per touched slot), %.1f KB per tick, revert %.1f us, copying the store %.1f KB",
+				numComponents, captureMicros, captureMicros / (500 + 23 + 22), bytes / 1024.0 / numTicks, revertMillis * 1000.0,
+				store.getComponents().getItems().size() * sizeof(ComponentStore<SceneNode>::ComponentRecord) / 1024.0);
+}
@@ -0,0 +1,124 @@
+#include "Test.h"
+#include <cstdint>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <utility/Logger.h>
+#include <application/Timer.h>
+#include <render/geometry/OcclusionBuffer.h>
+
+using namespace griffin;
+using namespace griffin::geometry;
+
+static Timer timer;
+
+
+/**
+* Quad from two triangles with corners (x0,y0) and (x1,y1) at constant z
+*/
+static void addQuad(OcclusionBuffer& buffer, float x0, float y0, float x1, float y1, float z, const glm::mat4& mvp)
+{
+	glm::vec3 vertices[4] = {
+		glm::vec3(x0, y0, z), glm::vec3(x1, y0, z), glm::vec3(x1, y1, z), glm::vec3(x0, y1, z)
+	};
+	uint32_t indices[6] = { 0, 1, 2, 0, 2, 3 };
+	buffer.addOccluder(vertices, 4, indices, 6, mvp);
+}
+
+
+void testOcclusionBuffer()
+{
+	OcclusionBuffer buffer;
+	const uint32_t width = buffer.getWidth();
+	const uint32_t height = buffer.getHeight();
+
+	// reference image, an NDC rectangle drawn with an identity transform covers exactly the
+	// pixels whose centers are inside it, edges chosen to not fall on pixel centers
+	const float rx0 = -1.3f, ry0 = -0.47f, rx1 = 0.02f, ry1 = 0.61f, rz = 0.25f;
+	glm::mat4 identity;
+	addQuad(buffer, rx0, ry0, rx1, ry1, rz, identity);
+	buffer.rasterize();
+
+	int wrongPixels = 0;
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			float cx = (x + 0.5f) / width * 2.0f - 1.0f;
+			float cy = (y + 0.5f) / height * 2.0f - 1.0f;
+			float expected = (cx >= rx0 && cx <= rx1 && cy >= ry0 && cy <= ry1) ? rz : 1.0f;
+			if (std::abs(buffer.getDepth()[y * width + x] - expected) > 1.0e-6f) {
+				++wrongPixels;
+			}
+		}
+	}
+	logger.test("occlusion buffer: %d of %u pixels differ from the reference image", wrongPixels, width * height);
+	assert(wrongPixels == 0 && "rasterized depth differs from the reference image");
+
+	// rectangles fully behind the covered blocks are hidden, the rest are visible
+	assert(!buffer.isRectVisible(-0.9f, -0.3f, -0.2f, 0.4f, 0.5f) && "rect behind the occluder should be hidden");
+	assert(buffer.isRectVisible(-0.9f, -0.3f, -0.2f, 0.4f, 0.1f) && "rect in front of the occluder should be visible");
+	assert(buffer.isRectVisible(-0.1f, -0.3f, 0.3f, 0.4f, 0.5f) && "rect crossing the occluder edge should be visible");
+	assert(!buffer.isRectVisible(1.5f, -0.3f, 2.0f, 0.4f, 0.5f) && "rect off screen covers no pixels");
+
+	// perspective, a 4x2 wall 10 units in front of the camera, 60 degree fov, 2:1, near 1, far 1000
+	glm::mat4 proj;
+	float f = 1.0f / std::tan(0.5236f);
+	proj[0][0] = f / 2.0f;
+	proj[1][1] = f;
+	proj[2][2] = (1000.0f + 1.0f) / (1.0f - 1000.0f);
+	proj[2][3] = -1.0f;
+	proj[3][2] = (2.0f * 1000.0f * 1.0f) / (1.0f - 1000.0f);
+	proj[3][3] = 0.0f;
+
+	buffer.clear();
+	addQuad(buffer, -2.0f, -1.0f, 2.0f, 1.0f, -10.0f, proj);
+	buffer.rasterize();
+
+	assert(!buffer.isSphereVisible(glm::vec3(0.0f, 0.0f, -30.0f), 1.0f, proj) && "sphere behind the wall should be hidden");
+	assert(buffer.isSphereVisible(glm::vec3(0.0f, 0.0f, -5.0f), 1.0f, proj) && "sphere in front of the wall should be visible");
+	assert(buffer.isSphereVisible(glm::vec3(12.0f, 0.0f, -30.0f), 1.0f, proj) && "sphere beside the wall should be visible");
+	assert(buffer.isSphereVisible(glm::vec3(0.0f, 0.0f, -1.0f), 2.0f, proj) && "sphere crossing the near plane should be visible");
+
+	// an occluder crossing the near plane is clipped, not dropped or wrapped around
+	buffer.clear();
+	addQuad(buffer, -50.0f, -1.0f, 50.0f, 1.0f, 5.0f, proj);
+	glm::vec3 floorVertices[4] = {
+		glm::vec3(-50.0f, -1.0f, 5.0f), glm::vec3(50.0f, -1.0f, 5.0f),
+		glm::vec3(50.0f, -1.0f, -100.0f), glm::vec3(-50.0f, -1.0f, -100.0f)
+	};
+	uint32_t floorIndices[6] = { 0, 1, 2, 0, 2, 3 };
+	buffer.addOccluder(floorVertices, 4, floorIndices, 6, proj);
+	buffer.rasterize();
+	assert(!buffer.isSphereVisible(glm::vec3(0.0f, -3.0f, -20.0f), 0.5f, proj) && "sphere under the floor should be hidden");
+	assert(buffer.isSphereVisible(glm::vec3(0.0f, 1.0f, -20.0f), 0.5f, proj) && "sphere above the floor should be visible");
+}
+
+
+/**
+* Throughput with many small occluder triangles
+*/
+void benchmarkOcclusionBuffer()
+{
+	OcclusionBuffer buffer;
+	glm::mat4 identity;
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+	const uint32_t numTriangles = 20000;
+	std::vector<glm::vec3> vertices(numTriangles * 3);
+	std::vector<uint32_t> indices(numTriangles * 3);
+	for (uint32_t i = 0; i < numTriangles * 3; i += 3) {
+		float cx = pos(rng), cy = pos(rng), cz = pos(rng);
+		for (int v = 0; v < 3; ++v) {
+			vertices[i + v] = glm::vec3(cx + pos(rng) * 0.1f, cy + pos(rng) * 0.1f, cz);
+			indices[i + v] = i + v;
+		}
+	}
+
+	buffer.clear();
+	timer.start();
+	buffer.addOccluder(vertices.data(), numTriangles * 3, indices.data(), numTriangles * 3, identity);
+	buffer.rasterize();
+	timer.stop();
+	logger.test("occlusion buffer: %u triangles in %f ms", numTriangles, timer.getMillisPassed());
+}
\ No newline at end of file
@@ -3,9 +3,25 @@
 #include <utility/Logger.h>
 #include <scene/Scene.h>
 #include <scene/SceneGraph.h>
+#include <scene/LevelOfDetail.h>
+#include <scene/Sector.h>
+#include <render/geometry/Intersection.h>
+#include <render/model/Model_GL.h>
+#include <entity/EntityManager.h>
+#include <application/Timer.h>
+#include <utility/concurrency.h>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <vector>
 
 using namespace griffin;
 
+static Timer timer;
+
 void testSceneGraph() {
 	using namespace std;
 
@@ -26,4 +42,1039 @@ void testSceneGraph() {
 	*/
 
 	//logger.info(Logger::Category_Test, oss.str().c_str());
+}
+
+
+/**
+* An object moving away steps to coarser LODs, one jittering around a switching distance keeps
+* its LOD, and moving back returns it to full detail
+*/
+void testLodSelection() {
+	using namespace griffin::scene;
+
+	const float errors[4] = { 0.0f, 0.05f, 0.2f, 1.0f };
+	const float projScaleY = 1.0f / 0.57735f; // 60 degree fovy
+	LodSettings settings{};
+
+	auto select = [&](uint8_t current, double distance) {
+		float scale = getScreenErrorScale(projScaleY, settings.viewportHeight, distance);
+		return selectLod(errors, 4, current, scale, settings.errorBudget, settings.hysteresis);
+	};
+
+	uint8_t lod = 0;
+	uint8_t prevLod = 0;
+	for (double d = 1.0; d < 10000.0; d *= 1.01) {
+		lod = select(lod, d);
+		assert(lod >= prevLod && "moving away must not select a finer LOD");
+		prevLod = lod;
+	}
+	assert(lod == 3 && "far away should select the coarsest LOD");
+
+	// distance where LOD 1 projects exactly to the budget
+	double switchDistance = 0.5 * projScaleY * settings.viewportHeight * errors[1] / settings.errorBudget;
+	lod = select(0, switchDistance * 1.5);
+	assert(lod == 1 && "past the switch distance by more than the hysteresis");
+
+	int switches = 0;
+	for (int i = 0; i < 100; ++i) {
+		double jitter = (i & 1) ? 1.1 : 0.9;
+		uint8_t next = select(lod, switchDistance * jitter);
+		switches += (next != lod);
+		lod = next;
+	}
+	assert(switches == 0 && "jitter within the hysteresis must not switch LOD");
+
+	for (double d = 10000.0; d > 1.0; d /= 1.01) {
+		lod = select(lod, d);
+	}
+	assert(lod == 0 && "close up should select full detail");
+
+	settings.hysteresis = 0.0f;
+	lod = select(1, switchDistance * 0.9);
+	assert(lod == 0 && "without hysteresis LODs switch at the budget");
+
+	logger.test("LOD selection: switch distance of LOD 1 is %.1f", switchDistance);
+}
+
+
+/**
+* Sector positions round trip with float precision at planetary distances, and the origin only
+* rebases once the camera is past the margin
+*/
+void testSectorCoordinates() {
+	using namespace griffin::scene;
+
+	const glm::dvec3 far(6371000.123456, -42.5, 1.5e11);
+	SectorPosition sp = toSectorPosition(far);
+	glm::dvec3 back = toWorldPosition(sp);
+	assert(std::abs(back.x - far.x) < 1.0e-3 && std::abs(back.y - far.y) < 1.0e-3 &&
+		   std::abs(back.z - far.z) < 1.0e-3 && "sector round trip lost precision");
+	assert(std::abs(sp.offset.x) <= SCENE_SECTOR_SIZE * 0.5 && "offset outside its sector");
+
+	glm::dvec3 negative(-0.001, -SCENE_SECTOR_SIZE, 0.0);
+	assert(getSector(negative) == glm::ivec3(-1, -1, 0) && "negative positions floor to the lower sector");
+
+	glm::ivec3 origin = getSector(far);
+	glm::dvec3 center = getSectorCenter(origin);
+	double edge = SCENE_SECTOR_SIZE * 0.5;
+	assert(!needsRebase(origin, center + glm::dvec3(edge + 1.0, 0.0, 0.0)) && "rebased inside the margin");
+	assert(needsRebase(origin, center + glm::dvec3(0.0, 0.0, -edge * 2.0)) && "did not rebase past the margin");
+
+	logger.test("sector coordinates: offset of far position %.4f, %.4f, %.4f", sp.offset.x, sp.offset.y, sp.offset.z);
+}
+
+
+/**
+* Checks the SceneNode store is in depth-first order as it stands, without an update to rebuild
+* it: every node's subtree in the linked lists directly follows it, and collectDescendants, which
+* walks the subtree sizes, finds the same nodes.
+*/
+static void checkSceneGraphOrder(entity::EntityManager& entityMgr, scene::SceneGraph& sceneGraph)
+{
+	using namespace griffin::scene;
+
+	auto& nodeComponents = entityMgr.getComponentStore<scene::SceneNode>().getComponents();
+	auto& hierItems = entityMgr.getComponentStore<scene::SceneHierarchy>().getComponents().getItems();
+	uint32_t numNodes = static_cast<uint32_t>(nodeComponents.size());
+	assert(hierItems.size() == numNodes && "SceneHierarchy store out of step");
+
+	// subtree sizes from the linked lists, children always follow their parent so a backwards
+	// pass accumulates them
+	std::vector<uint32_t> subtreeSize(numNodes, 1);
+	for (uint32_t i = numNodes; i-- > 0;) {
+		auto parentRef = hierItems[i].component.parent;
+		if (parentRef != NullSceneNodeRef) {
+			uint32_t p = nodeComponents.getInnerIndex(parentRef);
+			assert(p < i && "parent after its child in the store");
+			subtreeSize[p] += subtreeSize[i];
+		}
+	}
+
+	uint32_t numReached = 0;
+	std::vector<SceneNodeId> descendants;
+	for (uint32_t i = 0; i < numNodes; ++i) {
+		auto& hierarchy = hierItems[i].component;
+		if (hierarchy.parent == NullSceneNodeRef) {
+			assert(i == numReached && "root subtrees not back to back");
+			numReached += subtreeSize[i];
+		}
+		else {
+			uint32_t p = nodeComponents.getInnerIndex(hierarchy.parent);
+			assert(i + subtreeSize[i] <= p + subtreeSize[p] && "subtree not inside its parent's");
+		}
+
+		uint32_t numChildren = 0;
+		for (auto childRef = hierarchy.firstChild; childRef != NullSceneNodeRef;
+			 childRef = hierItems[nodeComponents.getInnerIndex(childRef)].component.nextSibling)
+		{
+			++numChildren;
+		}
+		assert(numChildren == hierarchy.numChildren && "numChildren out of step with the child list");
+
+		descendants.clear();
+		sceneGraph.collectDescendants(nodeComponents.getHandleForInnerIndex(i), descendants);
+		assert(descendants.size() == subtreeSize[i] - 1 && "subtree size differs from the child lists");
+		for (auto id : descendants) {
+			uint32_t d = nodeComponents.getInnerIndex(id);
+			assert(d > i && d < i + subtreeSize[i] && "descendant outside the subtree range");
+		}
+	}
+	assert(numReached == numNodes && "node not reachable from the root");
+}
+
+
+/**
+* World positions are the sum of local translations up the tree
+*/
+static void checkSceneGraphPositions(entity::EntityManager& entityMgr)
+{
+	using namespace griffin::scene;
+
+	auto& nodeComponents = entityMgr.getComponentStore<scene::SceneNode>().getComponents();
+	auto& nodeItems = nodeComponents.getItems();
+	auto& hierItems = entityMgr.getComponentStore<scene::SceneHierarchy>().getComponents().getItems();
+
+	for (uint32_t i = 0; i < nodeItems.size(); ++i) {
+		glm::dvec3 expected = nodeItems[i].component.translationLocal;
+		for (auto parentRef = hierItems[i].component.parent; parentRef != NullSceneNodeRef;) {
+			uint32_t p = nodeComponents.getInnerIndex(parentRef);
+			expected += nodeItems[p].component.translationLocal;
+			parentRef = hierItems[p].component.parent;
+		}
+		auto& positionWorld = nodeItems[i].component.positionWorld;
+		assert(std::abs(positionWorld.x - expected.x) < 1.0e-6 && std::abs(positionWorld.y - expected.y) < 1.0e-6 &&
+			   std::abs(positionWorld.z - expected.z) < 1.0e-6 && "world position not updated");
+	}
+}
+
+
+/**
+* Adding and removing leaves and moving subtrees keep the stores in depth-first order between
+* updates, without the rebuild that used to run after each of them. The subtree sizes skip over
+* clean branches in the update.
+*/
+void testSceneGraphOrder() {
+	using namespace griffin::scene;
+
+	EntityManager entityMgr;
+	SceneGraph sceneGraph(entityMgr);
+	std::mt19937 rng(7);
+
+	auto randomTranslation = [&rng]() {
+		return glm::dvec3(static_cast<double>(rng() % 100), static_cast<double>(rng() % 100), 1.0);
+	};
+	auto isInSubtree = [&](SceneNodeId node, SceneNodeId root) {
+		std::vector<SceneNodeId> descendants;
+		sceneGraph.collectDescendants(root, descendants);
+		return (node == root || std::find(descendants.begin(), descendants.end(), node) != descendants.end());
+	};
+
+	std::vector<SceneNodeId> nodes;
+	for (int i = 0; i < 200; ++i) {
+		SceneNodeId parent = (nodes.empty() || rng() % 8 == 0) ? NullId_T : nodes[rng() % nodes.size()];
+		nodes.push_back(sceneGraph.addToScene(entityMgr.createEntity(), randomTranslation(),
+											  glm::dquat(1.0, 0.0, 0.0, 0.0), parent));
+	}
+	sceneGraph.updateNodeTransforms();
+	checkSceneGraphOrder(entityMgr, sceneGraph);
+	checkSceneGraphPositions(entityMgr);
+
+	auto& nodeComponents = entityMgr.getComponentStore<scene::SceneNode>().getComponents();
+	auto& hierComponents = entityMgr.getComponentStore<scene::SceneHierarchy>().getComponents();
+
+	for (int round = 0; round < 20; ++round) {
+		// leaves added under random nodes and the root
+		for (int a = 0; a < 10; ++a) {
+			SceneNodeId parent = (a == 0) ? NullId_T : nodes[rng() % nodes.size()];
+			nodes.push_back(sceneGraph.addToScene(entityMgr.createEntity(), randomTranslation(),
+												  glm::dquat(1.0, 0.0, 0.0, 0.0), parent));
+		}
+		checkSceneGraphOrder(entityMgr, sceneGraph);
+
+		// leaves erased
+		for (int e = 0; e < 5; ++e) {
+			for (int tries = 0; tries < 50; ++tries) {
+				size_t n = rng() % nodes.size();
+				auto& hierarchy = hierComponents.getItems()[nodeComponents.getInnerIndex(nodes[n])].component;
+				if (hierarchy.numChildren == 0) {
+					assert(sceneGraph.removeFromScene(nodes[n]) && "leaf not removed");
+					nodes.erase(nodes.begin() + n);
+					break;
+				}
+			}
+		}
+		checkSceneGraphOrder(entityMgr, sceneGraph);
+
+		// subtrees moved under other nodes and to the root
+		for (int m = 0; m < 5; ++m) {
+			SceneNodeId node = nodes[rng() % nodes.size()];
+			SceneNodeId parent = (m == 0) ? NullId_T : nodes[rng() % nodes.size()];
+			if (parent != NullId_T && isInSubtree(parent, node)) {
+				continue;
+			}
+			sceneGraph.moveNode(node, parent);
+		}
+		checkSceneGraphOrder(entityMgr, sceneGraph);
+
+		sceneGraph.updateNodeTransforms();
+		checkSceneGraphPositions(entityMgr);
+	}
+
+	// a branch whose local translation changes without markDirty is skipped, so it keeps its
+	// old world position while a marked branch is recalculated
+	SceneNodeId unmarked = NullId_T;
+	SceneNodeId marked = NullId_T;
+	for (auto id : nodes) {
+		auto& hierarchy = hierComponents.getItems()[nodeComponents.getInnerIndex(id)].component;
+		if (hierarchy.parent == NullSceneNodeRef && hierarchy.numChildren > 0) {
+			if (unmarked == NullId_T) {
+				unmarked = id;
+			}
+			else if (marked == NullId_T) {
+				marked = id;
+			}
+		}
+	}
+	assert(unmarked != NullId_T && marked != NullId_T && "expected two root subtrees with children");
+
+	glm::dvec3 unmarkedWorld = nodeComponents[unmarked].component.positionWorld;
+	nodeComponents[unmarked].component.translationLocal += glm::dvec3(1000.0, 0.0, 0.0);
+	nodeComponents[marked].component.translationLocal += glm::dvec3(1000.0, 0.0, 0.0);
+	glm::dvec3 markedWorld = nodeComponents[marked].component.positionWorld;
+	sceneGraph.markDirty(marked, true, false);
+	sceneGraph.updateNodeTransforms();
+
+	assert(nodeComponents[unmarked].component.positionWorld.x == unmarkedWorld.x && "clean subtree was not skipped");
+	assert(nodeComponents[marked].component.positionWorld.x == markedWorld.x + 1000.0 && "dirty subtree not updated");
+
+	sceneGraph.markDirty(unmarked, true, false);
+	sceneGraph.updateNodeTransforms();
+	checkSceneGraphPositions(entityMgr);
+
+	logger.test("scene graph order: %u nodes after 20 rounds of adds, erases and moves", (unsigned int)nodes.size());
+}
+
+
+/**
+* Editing the tree through the SceneGraph: child lists and sibling links after unlinking from the
+* front, middle and back of a list, moves to other nodes and the root, moving all siblings, and
+* removals with and without cascade. The order and world positions are checked after each step,
+* erasing a whole branch is the one edit that waits for the update to restore the order.
+*/
+void testSceneGraphEditing() {
+	using namespace griffin::scene;
+
+	EntityManager entityMgr;
+	SceneGraph sceneGraph(entityMgr);
+	auto& nodeComponents = entityMgr.getComponentStore<scene::SceneNode>().getComponents();
+	auto& hierComponents = entityMgr.getComponentStore<scene::SceneHierarchy>().getComponents();
+
+	auto add = [&](EntityId entityId, SceneNodeId parent, double x) {
+		return sceneGraph.addToScene(entityId, glm::dvec3(x, 0.0, 0.0), glm::dquat(1.0, 0.0, 0.0, 0.0), parent);
+	};
+	auto hierarchyOf = [&](SceneNodeId id) -> scene::SceneHierarchy& {
+		return hierComponents.getItems()[nodeComponents.getInnerIndex(id)].component;
+	};
+	// walks the child list forwards checking each back link, new children go to the front
+	auto childrenOf = [&](SceneNodeId id) {
+		std::vector<SceneNodeId> children;
+		auto& hierarchy = hierarchyOf(id);
+		auto prevRef = NullSceneNodeRef;
+		for (auto childRef = hierarchy.firstChild; childRef != NullSceneNodeRef;) {
+			SceneNodeId childId = nodeComponents.toId(childRef);
+			auto& child = hierarchyOf(childId);
+			assert(child.prevSibling == prevRef && "prevSibling doesn't link back to the previous child");
+			assert(child.parent == SceneNodeRef::fromId(id) && "child's parent is wrong");
+			children.push_back(childId);
+			prevRef = childRef;
+			childRef = child.nextSibling;
+		}
+		assert(children.size() == hierarchy.numChildren && "numChildren out of step with the child list");
+		return children;
+	};
+	auto check = [&]() {
+		checkSceneGraphOrder(entityMgr, sceneGraph);
+		sceneGraph.updateNodeTransforms();
+		checkSceneGraphPositions(entityMgr);
+	};
+
+	// a has children a1, a2, a3, and a2 has children x and y
+	SceneNodeId a = add(entityMgr.createEntity(), NullId_T, 1.0);
+	SceneNodeId b = add(entityMgr.createEntity(), NullId_T, 2.0);
+	SceneNodeId a1 = add(entityMgr.createEntity(), a, 10.0);
+	SceneNodeId a2 = add(entityMgr.createEntity(), a, 20.0);
+	SceneNodeId a3 = add(entityMgr.createEntity(), a, 30.0);
+	SceneNodeId x = add(entityMgr.createEntity(), a2, 100.0);
+	SceneNodeId y = add(entityMgr.createEntity(), a2, 200.0);
+	sceneGraph.updateNodeTransforms();
+	check();
+	assert((childrenOf(a) == std::vector<SceneNodeId>{ a3, a2, a1 }) && "children not pushed to the front");
+
+	// unlink from the middle, then the front, then the back of a list
+	assert(sceneGraph.moveNode(a2, b) && "move to b failed");
+	assert((childrenOf(a) == std::vector<SceneNodeId>{ a3, a1 }) && "middle child not unlinked");
+	assert((childrenOf(b) == std::vector<SceneNodeId>{ a2 }) && "moved child not linked");
+	assert(!sceneGraph.moveNode(a2, b) && "move to the current parent not refused");
+	check();
+	assert(nodeComponents[x].component.positionWorld.x == 2.0 + 20.0 + 100.0 && "moved subtree not updated");
+
+	assert(sceneGraph.moveNode(a3, b) && "move to b failed");
+	assert((childrenOf(a) == std::vector<SceneNodeId>{ a1 }) && "first child not unlinked");
+	assert(sceneGraph.moveNode(a1, b) && "move to b failed");
+	assert(childrenOf(a).empty() && "last child not unlinked");
+	assert((childrenOf(b) == std::vector<SceneNodeId>{ a1, a3, a2 }) && "moved children not pushed to the front");
+	check();
+
+	// move to the root and back into a subtree
+	assert(sceneGraph.moveNode(a2, NullId_T) && "move to the root failed");
+	assert(hierarchyOf(a2).parent == NullSceneNodeRef && "node not moved to the root");
+	assert((childrenOf(b) == std::vector<SceneNodeId>{ a1, a3 }) && "node moved to the root still linked to b");
+	assert((childrenOf(a2) == std::vector<SceneNodeId>{ y, x }) && "subtree lost children moving to the root");
+	check();
+	assert(nodeComponents[y].component.positionWorld.x == 20.0 + 200.0 && "node moved to the root not updated");
+
+	assert(sceneGraph.moveNode(a2, a) && "move back into a failed");
+	check();
+
+	// every child of b moves to a, in front of a's own children
+	assert(sceneGraph.moveAllSiblings(a3, a) && "moveAllSiblings failed");
+	assert(childrenOf(b).empty() && "siblings left behind");
+	assert(childrenOf(a).size() == 3 && "siblings not moved");
+	assert(!sceneGraph.moveAllSiblings(a3, a) && "moveAllSiblings to the current parent not refused");
+	check();
+
+	// without cascade, children go to the removed node's parent, nodes of the removed entity go
+	// with it. a2 gets a second node owned by its own entity.
+	EntityId a2Entity = nodeComponents[a2].entityId;
+	SceneNodeId own = add(a2Entity, a2, 7.0);
+	EntityId ownChildEntity = entityMgr.createEntity();
+	SceneNodeId ownChild = add(ownChildEntity, own, 8.0);
+	check();
+
+	std::vector<EntityId> removedEntities;
+	assert(sceneGraph.removeFromScene(a2, false, &removedEntities) && "non-cascade remove failed");
+	assert(!nodeComponents.isValid(a2) && !nodeComponents.isValid(own) && !nodeComponents.isValid(ownChild) &&
+		   "nodes of the removed entity's own branch left behind");
+	assert(nodeComponents.isValid(x) && nodeComponents.isValid(y) && "children removed without cascade");
+	assert(hierarchyOf(x).parent == SceneNodeRef::fromId(a) && hierarchyOf(y).parent == SceneNodeRef::fromId(a) &&
+		   "children not given to the removed node's parent");
+	assert(removedEntities.size() == 1 && removedEntities[0] == ownChildEntity &&
+		   "removed entities should list the own branch's child only");
+	sceneGraph.updateNodeTransforms(); // a branch was erased, which leaves the order to a rebuild
+	check();
+	assert(nodeComponents[x].component.positionWorld.x == 1.0 + 100.0 && "child given to the grandparent not updated");
+
+	// cascade takes the whole branch
+	SceneNodeId xChild = add(entityMgr.createEntity(), x, 3.0);
+	SceneNodeId xGrandchild = add(entityMgr.createEntity(), xChild, 4.0);
+	check();
+	removedEntities.clear();
+	assert(sceneGraph.removeFromScene(x, true, &removedEntities) && "cascade remove failed");
+	assert(!nodeComponents.isValid(x) && !nodeComponents.isValid(xChild) && !nodeComponents.isValid(xGrandchild) &&
+		   "cascade left descendants behind");
+	assert(removedEntities.size() == 2 && "removed entities should list both descendants");
+	assert(!sceneGraph.removeFromScene(x) && "removed a stale node");
+	sceneGraph.updateNodeTransforms();
+	check();
+	assert(nodeComponents.size() == hierComponents.size() && nodeComponents.size() == 5 && "wrong node count after removals");
+
+	// removeComponents skips stale ids and ids of other types alike, and updates the entities
+	EntityId e = entityMgr.createEntity();
+	scene::ModelInstance mi{};
+	scene::RenderCullInfo rci{};
+	auto miId = entityMgr.addComponentToEntity(std::move(mi), e);
+	auto rciId = entityMgr.addComponentToEntity(std::move(rci), e);
+	std::vector<ComponentId> ids{ miId, rciId, miId, x };
+	assert(entityMgr.removeComponents(ids) == 2 && "removeComponents count wrong");
+	assert(entityMgr.getEntityComponentId(e, scene::ModelInstance::componentType) == NullId_T &&
+		   entityMgr.getEntityComponentId(e, scene::RenderCullInfo::componentType) == NullId_T &&
+		   "removed components still listed on the entity");
+	assert(entityMgr.removeComponents(ids) == 0 && "removed stale components");
+
+	logger.test("scene graph editing: %u nodes left after moves and removals", (unsigned int)nodeComponents.size());
+}
+
+
+/**
+* Floating origin positions stay parallel to the SceneNode store as nodes are added, through the
+* root child fast path and a rebuild, and culling from them finds the new nodes. The camera sits
+* at the origin looking down -z, so origin positions are already in view space.
+*/
+void testFloatingOrigin() {
+	using namespace griffin::scene;
+	using namespace griffin::geometry;
+
+	EntityManager entityMgr;
+	SceneGraph sceneGraph(entityMgr);
+	const glm::dvec3 origin(6371000.0, 0.0, 1.0e9);
+
+	std::vector<SceneNodeId> nodes;
+	for (int i = 0; i < 4; ++i) {
+		nodes.push_back(sceneGraph.addToScene(entityMgr.createEntity(), origin + glm::dvec3(i * 2.0, 0.0, -20.0),
+											  glm::dquat(1.0, 0.0, 0.0, 0.0), NullId_T));
+	}
+	sceneGraph.setOrigin(origin);
+	sceneGraph.updateNodeTransforms();
+
+	// perspective projection, 60 degree vertical fov, square, near 1, far 1000, column-major
+	float proj[16] = {};
+	float f = 1.0f / std::tan(0.5236f);
+	proj[0] = f;
+	proj[5] = f;
+	proj[10] = (1000.0f + 1.0f) / (1.0f - 1000.0f);
+	proj[11] = -1.0f;
+	proj[14] = (2.0f * 1000.0f * 1.0f) / (1.0f - 1000.0f);
+	Frustum frustum;
+	frustum.extractFromMatrixGL(proj);
+
+	auto& nodeComponents = entityMgr.getComponentStore<scene::SceneNode>().getComponents();
+
+	auto checkAndCull = [&](const char* step) {
+		auto& originPositions = sceneGraph.getOriginPositions();
+		assert(originPositions.size() == nodeComponents.size() && "origin positions not parallel to the SceneNode store");
+
+		std::vector<float> x, y, z, r;
+		for (auto id : nodes) {
+			auto& node = nodeComponents[id].component;
+			auto& p = originPositions[nodeComponents.getInnerIndex(id)];
+			glm::dvec3 expected(node.positionWorld - origin);
+			assert(std::abs(p.x - expected.x) < 1.0e-3 && std::abs(p.y - expected.y) < 1.0e-3 &&
+				   std::abs(p.z - expected.z) < 1.0e-3 && "origin position does not match the world position");
+			x.push_back(p.x); y.push_back(p.y); z.push_back(p.z); r.push_back(1.0f);
+		}
+
+		std::vector<uint32_t> visible(nodes.size());
+		unsigned int numVisible = CullSphereList(x.data(), y.data(), z.data(), r.data(),
+												 static_cast<unsigned int>(nodes.size()), frustum, visible.data());
+		assert(numVisible == nodes.size() && "node in front of the camera culled");
+		logger.test("floating origin: %s, %u of %u nodes visible", step, numVisible, (unsigned int)nodes.size());
+	};
+
+	checkAndCull("initial");
+
+	// a child of the root keeps the order and takes the fast path
+	nodes.push_back(sceneGraph.addToScene(entityMgr.createEntity(), origin + glm::dvec3(0.0, 3.0, -30.0),
+										  glm::dquat(1.0, 0.0, 0.0, 0.0), NullId_T));
+	sceneGraph.updateNodeTransforms();
+	checkAndCull("root child added");
+
+	// a child of a node splits its parent's subtree and rebuilds the order
+	nodes.push_back(sceneGraph.addToScene(entityMgr.createEntity(), glm::dvec3(0.0, -3.0, -10.0),
+										  glm::dquat(1.0, 0.0, 0.0, 0.0), nodes[1]));
+	sceneGraph.updateNodeTransforms();
+	checkAndCull("child added");
+
+	// moving the origin recalculates every position
+	sceneGraph.setOrigin(origin + glm::dvec3(0.0, 0.0, 5.0));
+	sceneGraph.setOrigin(origin);
+	nodes.push_back(sceneGraph.addToScene(entityMgr.createEntity(), origin + glm::dvec3(-4.0, 0.0, -40.0),
+										  glm::dquat(1.0, 0.0, 0.0, 0.0), NullId_T));
+	sceneGraph.updateNodeTransforms();
+	checkAndCull("root child added after moving the origin");
+}
+
+
+/**
+* The movement system before the mover list, every MovementComponent is scanned each frame
+*/
+static void interpolateSceneNodesFullScan(entity::EntityManager& entityMgr, scene::SceneGraph& sceneGraph, float interpolation)
+{
+	auto& moveComponents = entityMgr.getComponentStore<scene::MovementComponent>().getComponents();
+
+	for (auto& move : moveComponents.getItems()) {
+		if (move.component.rotationDirty == 0 && move.component.prevRotationDirty == 0 &&
+			move.component.translationDirty == 0 && move.component.prevTranslationDirty == 0)
+		{
+			continue;
+		}
+
+		auto& node = entityMgr.getComponent<scene::SceneNode>(move.component.sceneNodeId);
+
+		if (move.component.rotationDirty == 1) {
+			node.rotationLocal =
+				glm::normalize(
+					glm::lerp(
+						move.component.prevRotation,
+						move.component.nextRotation,
+						static_cast<double>(interpolation)));
+			sceneGraph.markDirty(node, false, true);
+		}
+		else if (move.component.prevRotationDirty == 1) {
+			node.rotationLocal = move.component.nextRotation;
+			sceneGraph.markDirty(node, false, true);
+			move.component.prevRotationDirty = 0;
+		}
+
+		if (move.component.translationDirty == 1) {
+			node.translationLocal = glm::mix(move.component.prevTranslation,
+											 move.component.nextTranslation,
+											 static_cast<double>(interpolation));
+			sceneGraph.markDirty(node, true, false);
+		}
+		else if (move.component.prevTranslationDirty == 1) {
+			node.translationLocal = move.component.nextTranslation;
+			sceneGraph.markDirty(node, true, false);
+			move.component.prevTranslationDirty = 0;
+		}
+	}
+}
+
+
+/**
+* Two copies of a scene take the same simulation ticks, one interpolated through the mover list
+* and one by the full scan it replaced. Node transforms must match exactly every frame, through
+* movers starting and stopping and structure changes of both stores.
+*/
+void testMoverInterpolation() {
+	using namespace griffin::scene;
+
+	struct World {
+		EntityManager	entityMgr;
+		SceneGraph		sceneGraph{ entityMgr };
+		std::vector<ComponentId>	moveIds;	//<! NullId_T once removed
+		std::vector<SceneNodeId>	moverNodes;
+		std::vector<SceneNodeId>	plainNodes;	//<! nodes without movement
+	};
+	World listWorld, scanWorld;
+	World* worlds[2] = { &listWorld, &scanWorld };
+	MoverCache movers;
+
+	auto addNode = [](World& w, SceneNodeId parent, double x, bool movable) {
+		EntityId entityId = w.entityMgr.createEntity();
+		glm::dvec3 translation(x, 0.0, 0.0);
+		glm::dquat rotation(1.0, 0.0, 0.0, 0.0);
+		SceneNodeId nodeId = w.sceneGraph.addToScene(entityId, translation, rotation, parent);
+		if (!movable) {
+			w.plainNodes.push_back(nodeId);
+			return;
+		}
+		scene::MovementComponent move{};
+		move.sceneNodeId = SceneNodeRef::fromId(nodeId);
+		move.prevTranslation = move.nextTranslation = translation;
+		move.prevRotation = move.nextRotation = rotation;
+		w.moveIds.push_back(w.entityMgr.addComponentToEntity(std::move(move), entityId));
+		w.moverNodes.push_back(nodeId);
+	};
+	auto addNodes = [&](int count) {
+		for (World* w : worlds) {
+			size_t first = w->moveIds.size();
+			for (int i = 0; i < count; ++i) {
+				// every fourth mover is parented to an earlier one, plain leaves hang off every fifth
+				SceneNodeId parent = ((first + i) % 4 == 3 ? w->moverNodes[(first + i) / 2] : NullId_T);
+				addNode(*w, parent, static_cast<double>(first + i), true);
+				if ((first + i) % 5 == 0) {
+					addNode(*w, w->moverNodes.back(), 0.5, false);
+				}
+			}
+		}
+	};
+
+	// one simulation tick of a mover, the way the dev camera writes it
+	auto step = [&](size_t m, bool moving, const glm::dvec3& velocity, const glm::dquat& spin) {
+		for (World* w : worlds) {
+			auto& move = w->entityMgr.getMutable<scene::MovementComponent>(w->moveIds[m]);
+			move.prevTranslation = move.nextTranslation;
+			move.prevRotation = move.nextRotation;
+			move.prevTranslationDirty = move.translationDirty;
+			move.prevRotationDirty = move.rotationDirty;
+			if (moving) {
+				move.nextTranslation += velocity;
+				move.nextRotation = glm::normalize(spin * move.prevRotation);
+			}
+			move.translationDirty = (moving ? 1 : 0);
+			move.rotationDirty = (moving ? 1 : 0);
+		}
+	};
+
+	auto compare = [&](const char* what) {
+		auto& listNodes = listWorld.entityMgr.getComponentStore<scene::SceneNode>().getComponents();
+		auto& scanNodes = scanWorld.entityMgr.getComponentStore<scene::SceneNode>().getComponents();
+		for (size_t n = 0; n < listWorld.moverNodes.size(); ++n) {
+			auto& a = listNodes[listWorld.moverNodes[n]].component;
+			auto& b = scanNodes[scanWorld.moverNodes[n]].component;
+			assert(!(a.translationLocal != b.translationLocal) && !(a.positionWorld != b.positionWorld) &&
+				   a.rotationLocal.x == b.rotationLocal.x && a.rotationLocal.y == b.rotationLocal.y &&
+				   a.rotationLocal.z == b.rotationLocal.z && a.rotationLocal.w == b.rotationLocal.w &&
+				   what);
+		}
+	};
+
+	// the list holds exactly the components with a dirty flag left, each listed once
+	auto checkList = [&]() {
+		auto& moveItems = listWorld.entityMgr.getComponentStore<scene::MovementComponent>().getComponents().getItems();
+		size_t numMoving = 0;
+		for (auto& move : moveItems) {
+			auto& c = move.component;
+			if (c.translationDirty || c.rotationDirty || c.prevTranslationDirty || c.prevRotationDirty) {
+				++numMoving;
+			}
+		}
+		assert(movers.moveIndices.size() == numMoving && "mover list out of step with the moving components");
+		for (size_t i = 0; i < movers.moveIndices.size(); ++i) {
+			assert(movers.listPositions[movers.moveIndices[i]] == i && "mover list positions out of step");
+		}
+		return numMoving;
+	};
+
+	auto frame = [&](float interpolation) {
+		interpolateSceneNodes(listWorld.entityMgr, listWorld.sceneGraph, movers, interpolation);
+		interpolateSceneNodesFullScan(scanWorld.entityMgr, scanWorld.sceneGraph, interpolation);
+		for (World* w : worlds) {
+			w->sceneGraph.updateNodeTransforms();
+		}
+		compare("mover list interpolation differs from the full scan");
+		return checkList();
+	};
+
+	addNodes(40);
+	for (World* w : worlds) {
+		w->sceneGraph.updateNodeTransforms();
+	}
+	frame(0.0f);
+	assert(movers.moveIndices.empty() && "parked movers listed");
+
+	std::mt19937 rng(4);
+	std::uniform_real_distribution<double> delta(-1.0, 1.0);
+	std::vector<bool> wasMoving;
+	size_t maxListed = 0;
+
+	const int numTicks = 40;
+	for (int tick = 0; tick < numTicks; ++tick) {
+		// new movers join the MovementComponent and SceneNode stores
+		if (tick == 10) {
+			addNodes(13);
+		}
+		// a plain node leaves, the SceneNode store is compacted under the movers
+		if (tick == 20) {
+			for (World* w : worlds) {
+				assert(w->sceneGraph.removeFromScene(w->plainNodes[1]) && "remove failed");
+			}
+		}
+		// a mover loses its movement, the MovementComponent store is compacted
+		if (tick == 30) {
+			size_t m = 0;
+			while (wasMoving[m] || listWorld.moveIds[m] == NullId_T) { ++m; }
+			for (World* w : worlds) {
+				assert(w->entityMgr.removeComponent(w->moveIds[m]) && "remove failed");
+				w->moveIds[m] = NullId_T;
+			}
+		}
+		wasMoving.resize(listWorld.moveIds.size(), false);
+
+		// the last quarter of the ticks brings everything to rest
+		for (size_t m = 0; m < listWorld.moveIds.size(); ++m) {
+			if (listWorld.moveIds[m] == NullId_T) {
+				continue;
+			}
+			bool moving = (tick < numTicks * 3 / 4 && rng() % 4 == 0);
+			if (moving) {
+				glm::dvec3 velocity(delta(rng), delta(rng), delta(rng));
+				glm::dquat spin = glm::normalize(glm::dquat(1.0, delta(rng) * 0.1, delta(rng) * 0.1, delta(rng) * 0.1));
+				step(m, true, velocity, spin);
+			}
+			else if (wasMoving[m]) {
+				step(m, false, glm::dvec3(0.0), glm::dquat(1.0, 0.0, 0.0, 0.0));
+			}
+			wasMoving[m] = moving;
+		}
+
+		maxListed = std::max(maxListed, frame(0.3f));
+		frame(0.8f);
+	}
+
+	// stopped movers were set to their next transform and have left the list
+	frame(0.5f);
+	assert(movers.moveIndices.empty() && "movers at rest still listed");
+	auto& nodes = listWorld.entityMgr.getComponentStore<scene::SceneNode>().getComponents();
+	for (size_t m = 0; m < listWorld.moveIds.size(); ++m) {
+		if (listWorld.moveIds[m] == NullId_T) {
+			continue;
+		}
+		auto& move = listWorld.entityMgr.getComponent<scene::MovementComponent>(listWorld.moveIds[m]);
+		auto& node = nodes[listWorld.moverNodes[m]].component;
+		assert(!(node.translationLocal != move.nextTranslation) && node.rotationLocal.w == move.nextRotation.w &&
+			   node.rotationLocal.x == move.nextRotation.x && "stopped mover not set to its next transform");
+	}
+	assert(maxListed > 0 && "nothing moved, the comparison proves nothing");
+
+	logger.test("mover interpolation: %u movers, up to %u listed, matches the full scan over %d ticks",
+				(unsigned int)listWorld.moveIds.size(), (unsigned int)maxListed, numTicks);
+}
+
+
+/**
+* Visible lists gathered from known frustum bits hold each visible object once per bit set, in
+* RenderCullInfo order, and leave out objects without a resolved model
+*/
+void testVisibleLists() {
+	using namespace griffin::scene;
+
+	EntityManager entityMgr;
+	auto& rciStore = entityMgr.getComponentStore<scene::RenderCullInfo>();
+
+	auto addObject = [&](uint32_t bits, bool withModel, bool resolved) {
+		EntityId entityId = entityMgr.createEntity();
+		if (withModel) {
+			scene::ModelInstance mi{};
+			if (resolved) {
+				mi.modelPtr = std::make_shared<resource::Resource_T>(render::Model_GL{}, 0);
+			}
+			entityMgr.addComponentToEntity(std::move(mi), entityId);
+		}
+		scene::RenderCullInfo rci{};
+		rci.visibleFrustumBits = bits;
+		rci.sceneNodeId = SceneNodeRef{ static_cast<uint32_t>(bits) + 1 };
+		return entityMgr.addComponentToEntity(std::move(rci), entityId);
+	};
+	auto modelOf = [&](ComponentId rciId) {
+		auto& modelStore = entityMgr.getComponentStore<scene::ModelInstance>();
+		auto miId = entityMgr.getEntityComponentId(rciStore.getEntityId(rciId), scene::ModelInstance::componentType);
+		return &modelStore.getComponent(miId).modelPtr->getResource<render::Model_GL>();
+	};
+
+	ComponentId visible02 = addObject(0x5, true, true);
+	addObject(0x0, true, true);		// culled from every frustum
+	addObject(0x2, true, false);	// model not resolved yet
+	addObject(0x3, false, false);	// nothing to render
+	ComponentId visible12 = addObject(0x6, true, true);
+
+	// visible12 caches a ModelInstance that was since replaced
+	EntityId replacedEntity = rciStore.getEntityId(visible12);
+	ComponentId oldMiId = entityMgr.getEntityComponentId(replacedEntity, scene::ModelInstance::componentType);
+	rciStore.getComponent(visible12).modelInstanceId = ModelInstanceRef::fromId(oldMiId);
+	assert(entityMgr.removeComponent(oldMiId) && "remove failed");
+	scene::ModelInstance replacement{};
+	replacement.modelPtr = std::make_shared<resource::Resource_T>(render::Model_GL{}, 0);
+	ComponentId newMiId = entityMgr.addComponentToEntity(std::move(replacement), replacedEntity);
+
+	// lists left over from a frame with more frustums are cut down and cleared
+	std::vector<std::vector<VisibleEntry>> visibleLists(5, std::vector<VisibleEntry>(2));
+	gatherVisibleEntries(entityMgr, 3, visibleLists);
+	assert(visibleLists.size() == 3 && "one list per frustum expected");
+
+	auto check = [&](uint32_t f, std::vector<ComponentId> expected) {
+		auto& list = visibleLists[f];
+		assert(list.size() == expected.size() && "wrong number of visible entries");
+		for (size_t i = 0; i < expected.size(); ++i) {
+			auto& rci = rciStore.getComponent(expected[i]);
+			assert(list[i].entityId == rciStore.getEntityId(expected[i]) && "wrong entity in the visible list");
+			assert(list[i].sceneNodeId == rci.sceneNodeId && "wrong scene node in the visible list");
+			assert(list[i].model == modelOf(expected[i]) && "wrong model in the visible list");
+		}
+	};
+	check(0, { visible02 });
+	check(1, { visible12 });
+	check(2, { visible02, visible12 });
+
+	assert(rciStore.getComponent(visible12).modelInstanceId == ModelInstanceRef::fromId(newMiId) &&
+		   "stale ModelInstance not resolved again");
+
+	// gathering again gives the same lists, not appended ones
+	gatherVisibleEntries(entityMgr, 3, visibleLists);
+	check(2, { visible02, visible12 });
+
+	logger.test("visible lists: %u, %u and %u entries in 3 frustums", (unsigned int)visibleLists[0].size(),
+				(unsigned int)visibleLists[1].size(), (unsigned int)visibleLists[2].size());
+}
+
+
+/**
+* Several live scenes prepared as tasks on the worker threads give the same visible lists as the
+* same scenes prepared one after another on this thread, and each scene sees only its own objects
+*/
+void testScenePreparation() {
+	using namespace griffin::scene;
+
+	const int numScenes = 3;
+	SceneManager sceneMgr;
+	std::vector<SceneId> sceneIds;
+	std::vector<std::vector<EntityId>> expectedVisible(numScenes);
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<double> spread(-20.0, 20.0);
+	std::uniform_real_distribution<double> depth(50.0, 500.0);
+
+	for (int i = 0; i < numScenes; ++i) {
+		SceneId sceneId = sceneMgr.createScene("preparation test " + std::to_string(i), true);
+		sceneIds.push_back(sceneId);
+		auto& s = sceneMgr.getScene(sceneId);
+		auto& entityMgr = *s.entityManager;
+
+		// camera at the origin looking down -z
+		CameraParameters cameraParams{ 1.0f, 1000.0f, 1280, 720, 60.0f, Camera_Perspective, {} };
+		EntityId cameraEntity = entityMgr.createEntity();
+		SceneNodeId cameraNode = s.sceneGraph->addToScene(cameraEntity, glm::dvec3(0.0), glm::dquat(1.0, 0.0, 0.0, 0.0), NullId_T);
+		scene::CameraInstance ci{};
+		ci.sceneNodeId = SceneNodeRef::fromId(cameraNode);
+		ci.cameraId = s.createCamera(cameraParams, true);
+		entityMgr.addComponentToEntity(std::move(ci), cameraEntity);
+
+		// a different number of objects per scene, every other one behind the camera
+		for (int o = 0; o < 100 + 50 * i; ++o) {
+			bool inFront = (o % 2 == 0);
+			EntityId entityId = entityMgr.createEntity();
+			glm::dvec3 position(spread(rng), spread(rng), inFront ? -depth(rng) : depth(rng));
+			SceneNodeId nodeId = s.sceneGraph->addToScene(entityId, position, glm::dquat(1.0, 0.0, 0.0, 0.0), NullId_T);
+
+			scene::ModelInstance mi{};
+			mi.sceneNodeId = SceneNodeRef::fromId(nodeId);
+			mi.modelPtr = std::make_shared<resource::Resource_T>(render::Model_GL{}, 0);
+			entityMgr.addComponentToEntity(std::move(mi), entityId);
+
+			scene::RenderCullInfo rci{};
+			rci.sceneNodeId = SceneNodeRef::fromId(nodeId);
+			rci.boundingRadius = 1.0f;
+			entityMgr.addComponentToEntity(std::move(rci), entityId);
+
+			if (inFront) {
+				expectedVisible[i].push_back(entityId);
+			}
+		}
+	}
+
+	auto collect = [&]() {
+		std::vector<std::vector<VisibleEntry>> lists;
+		for (auto sceneId : sceneIds) {
+			auto& s = sceneMgr.getScene(sceneId);
+			assert(s.visibleLists.size() == 1 && "one visible list expected for the render camera");
+			lists.push_back(s.visibleLists[0]);
+		}
+		return lists;
+	};
+
+	// a pool with workers to spread the scenes over, then none to prepare inline
+	auto enginePool = task_base::s_threadPool;
+	if (!enginePool || enginePool->getNumWorkerThreads() < 2) {
+		task_base::s_threadPool = std::make_shared<thread_pool>(4);
+	}
+	sceneMgr.prepareActiveScenes(1.0f);
+	auto pooled = collect();
+
+	task_base::s_threadPool = nullptr;
+	sceneMgr.prepareActiveScenes(1.0f);
+	auto inlined = collect();
+	task_base::s_threadPool = enginePool;
+
+	for (int i = 0; i < numScenes; ++i) {
+		assert(pooled[i].size() == inlined[i].size() && "pooled and inline preparation differ");
+		for (size_t v = 0; v < pooled[i].size(); ++v) {
+			assert(pooled[i][v].entityId == inlined[i][v].entityId &&
+				   pooled[i][v].sceneNodeId == inlined[i][v].sceneNodeId &&
+				   pooled[i][v].model == inlined[i][v].model && "pooled and inline preparation differ");
+		}
+
+		std::vector<EntityId> visible;
+		for (auto& entry : pooled[i]) {
+			visible.push_back(entry.entityId);
+		}
+		std::sort(visible.begin(), visible.end(), [](EntityId a, EntityId b) { return a.value < b.value; });
+		std::sort(expectedVisible[i].begin(), expectedVisible[i].end(), [](EntityId a, EntityId b) { return a.value < b.value; });
+		assert(visible == expectedVisible[i] && "scene prepared on the pool found the wrong objects");
+	}
+
+	logger.test("scene preparation: %d scenes, %u, %u and %u visible, pooled and inline match", numScenes,
+				(unsigned int)pooled[0].size(), (unsigned int)pooled[1].size(), (unsigned int)pooled[2].size());
+}
+
+
+/**
+* Hand-off between the update and render sides. Publishes are stamped in order, the render side
+* only ever sees the newest, and no snapshot is owned by both sides at once, checked on one
+* thread and then with a producer and consumer thread.
+*/
+void testRenderSnapshotBuffer() {
+	using namespace griffin::scene;
+
+	auto fill = [](RenderSnapshot& snapshot, uint64_t tick) {
+		snapshot.entries.clear();
+		for (uint64_t e = 0; e < 8; ++e) {
+			RenderSnapshotEntry entry{};
+			entry.entityId.value = e + 1;
+			entry.positionWorld = glm::dvec3(static_cast<double>(tick), 0.0, 0.0);
+			entry.modelIndex = RENDER_SNAPSHOT_NO_MODEL;
+			snapshot.entries.push_back(entry);
+		}
+	};
+
+	RenderSnapshotBuffer buffer;
+	assert(!buffer.acquire() && "acquired before anything was published");
+	assert(!buffer.canInterpolate() && "can interpolate before anything was published");
+
+	fill(buffer.getWriteSnapshot(), 1);
+	buffer.publish();
+	assert(buffer.acquire() && "did not acquire the first publish");
+	assert(buffer.getCurrent().updateFrame == 1 && "first publish not current");
+	assert(!buffer.canInterpolate() && "can interpolate with one snapshot");
+	assert(!buffer.acquire() && "acquired the same publish twice");
+
+	fill(buffer.getWriteSnapshot(), 2);
+	buffer.publish();
+	assert(buffer.acquire() && buffer.canInterpolate() && "cannot interpolate after two publishes");
+	assert(buffer.getPrevious().updateFrame == 1 && buffer.getCurrent().updateFrame == 2 &&
+		   "previous and current out of order");
+
+	// two publishes between acquires, the older is skipped
+	fill(buffer.getWriteSnapshot(), 3);
+	buffer.publish();
+	fill(buffer.getWriteSnapshot(), 4);
+	buffer.publish();
+	assert(buffer.acquire() && "did not acquire after two publishes");
+	assert(buffer.getPrevious().updateFrame == 2 && buffer.getCurrent().updateFrame == 4 &&
+		   "did not skip to the newest publish");
+
+	auto& write = buffer.getWriteSnapshot();
+	assert(&write != &buffer.getPrevious() && &write != &buffer.getCurrent() &&
+		   "write snapshot owned by the render side");
+
+	// only entities in both snapshots, moved halfway
+	fill(buffer.getWriteSnapshot(), 5);
+	buffer.getWriteSnapshot().entries.erase(buffer.getWriteSnapshot().entries.begin());
+	RenderSnapshotEntry created{};
+	created.entityId.value = 100;
+	buffer.getWriteSnapshot().entries.push_back(created);
+	buffer.publish();
+	buffer.acquire();
+
+	std::vector<RenderSnapshotEntry> interpolated;
+	interpolateRenderSnapshots(buffer.getPrevious(), buffer.getCurrent(), 0.5f, interpolated);
+	assert(interpolated.size() == 7 && "interpolated entities not in both snapshots");
+	for (auto& entry : interpolated) {
+		assert(entry.entityId.value >= 2 && entry.entityId.value <= 8 && "interpolated the wrong entity");
+		assert(std::abs(entry.positionWorld.x - 4.5) < 1.0e-9 && "position not interpolated halfway");
+	}
+
+	// producer and consumer threads, every acquired snapshot must be whole and newer than the last
+	RenderSnapshotBuffer shared;
+	const uint64_t numTicks = 20000;
+	uint64_t numAcquired = 0;
+	bool consistent = true;
+
+	std::thread producer([&shared, &fill, numTicks]() {
+		for (uint64_t tick = 1; tick <= numTicks; ++tick) {
+			fill(shared.getWriteSnapshot(), tick);
+			shared.publish();
+			std::this_thread::yield();
+		}
+	});
+
+	uint64_t lastFrame = 0;
+	while (lastFrame < numTicks) {
+		if (!shared.acquire()) {
+			std::this_thread::yield();
+			continue;
+		}
+		auto& curr = shared.getCurrent();
+		for (auto& entry : curr.entries) {
+			consistent = consistent && (entry.positionWorld.x == static_cast<double>(curr.updateFrame));
+		}
+		consistent = consistent && (curr.entries.size() == 8) && (curr.updateFrame > lastFrame);
+		lastFrame = curr.updateFrame;
+		++numAcquired;
+	}
+	producer.join();
+	assert(consistent && "render side read a snapshot while it was written");
+
+	logger.test("render snapshot buffer: %llu of %llu publishes acquired by the render thread",
+				(unsigned long long)numAcquired, (unsigned long long)numTicks);
+}
+
+
+/**
+* Large synthetic scene of many small trees with every node moved each frame, reports the time
+* per node and the bytes of SceneNode data the transform pass streams per node. The pass walks
+* the store in order, so the cache lines it touches per node are the bytes divided by 64.
+*/
+void benchmarkSceneGraphUpdate() {
+	using namespace griffin::scene;
+
+	const uint32_t N = 500000;
+	const uint32_t treeSize = 64;
+	const int reps = 20;
+
+	EntityManager entityMgr;
+	SceneGraph sceneGraph(entityMgr);
+	std::mt19937 rng(4);
+
+	std::vector<SceneNodeId> nodes;
+	nodes.reserve(N);
+	for (uint32_t i = 0; i < N; ++i) {
+		uint32_t t = i % treeSize;
+		SceneNodeId parent = (t == 0) ? NullId_T : nodes[i - 1 - rng() % t];
+		nodes.push_back(sceneGraph.addToScene(entityMgr.createEntity(), glm::dvec3(1.0, 0.0, 0.0),
+											  glm::dquat(0.999, 0.01, 0.0, 0.0), parent));
+	}
+	sceneGraph.updateNodeTransforms();
+
+	timer.start();
+	for (int rep = 0; rep < reps; ++rep) {
+		for (uint32_t i = 0; i < N; i += treeSize) {
+			sceneGraph.markDirty(nodes[i], true, true);
+		}
+		sceneGraph.updateNodeTransforms();
+	}
+	timer.stop();
+
+	double nsPerNode = timer.getMillisPassed() * 1.0e6 / ((double)N * reps);
+	size_t bytesPerNode = sizeof(ComponentStore<scene::SceneNode>::ComponentRecord);
+	logger.test("scene graph: %u nodes all moved, %.2f ns per node, pass streams %u bytes (%.2f cache lines) per node",
+				N, nsPerNode, (unsigned int)bytesPerNode, bytesPerNode / 64.0);
 }
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "Test.h"
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <random>
+#include <algorithm>
+#include <utility/Logger.h>
+#include <utility/cpu_features.h>
+#include <utility/simd_transform.h>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+using namespace griffin;
+
+
+/**
+* Distance in units of last place, glm's scalar code may be compiled with contracted or
+* reordered operations under /fp:fast so exact equality isn't guaranteed
+*/
+static int64_t ulpDistance(double a, double b)
+{
+	int64_t ia, ib;
+	memcpy(&ia, &a, sizeof(double));
+	memcpy(&ib, &b, sizeof(double));
+	if (ia < 0) { ia = INT64_MIN - ia; }
+	if (ib < 0) { ib = INT64_MIN - ib; }
+	return (ia > ib ? ia - ib : ib - ia);
+}
+
+static const int64_t maxUlps = 4;
+
+
+void testSimdTransform()
+{
+	using namespace glm;
+	using namespace simd;
+
+	auto& cpu = getCpuFeatures();
+	logger.test("simd transform: sse4.1=%d avx=%d avx2=%d avx512=%d", cpu.sse41, cpu.avx, cpu.avx2, cpu.avx512);
+
+	std::mt19937_64 rng(1);
+	std::uniform_real_distribution<double> dist(-10.0, 10.0);
+	const int N = 10000;
+
+	KernelSet defaultKernelSet = getKernelSet();
+
+	for (int k = KernelSet_SSE2; k <= KernelSet_AVX2; ++k) {
+		setKernelSet(static_cast<KernelSet>(k));
+		if (getKernelSet() != k) {
+			logger.test("simd transform: kernel set %d not supported, skipped", k);
+			continue;
+		}
+		int64_t worstUlps = 0;
+		auto check = [&worstUlps](double simdVal, double glmVal) {
+			worstUlps = std::max(worstUlps, ulpDistance(simdVal, glmVal));
+		};
+
+		for (int n = 0; n < N; ++n) {
+			DQuat4 a, b, q;
+			DVec3_4 v, vOut;
+			dquat glmA[4], glmB[4];
+			dvec3 glmV[4];
+
+			for (int l = 0; l < 4; ++l) {
+				glmA[l] = dquat(dist(rng), dist(rng), dist(rng), dist(rng));
+				glmB[l] = dquat(dist(rng), dist(rng), dist(rng), dist(rng));
+				glmV[l] = dvec3(dist(rng), dist(rng), dist(rng));
+				a.x[l] = glmA[l].x; a.y[l] = glmA[l].y; a.z[l] = glmA[l].z; a.w[l] = glmA[l].w;
+				b.x[l] = glmB[l].x; b.y[l] = glmB[l].y; b.z[l] = glmB[l].z; b.w[l] = glmB[l].w;
+				v.x[l] = glmV[l].x; v.y[l] = glmV[l].y; v.z[l] = glmV[l].z;
+			}
+			// zero length product must normalize to identity
+			if (n == 0) {
+				glmB[3] = dquat(0, 0, 0, 0);
+				b.x[3] = b.y[3] = b.z[3] = b.w[3] = 0;
+			}
+
+			mulNormalizeDQuat4(a, b, q);
+			for (int l = 0; l < 4; ++l) {
+				dquat r = normalize(glmA[l] * glmB[l]);
+				check(q.x[l], r.x); check(q.y[l], r.y); check(q.z[l], r.z); check(q.w[l], r.w);
+			}
+			if (n == 0) {
+				assert(q.x[3] == 0.0 && q.y[3] == 0.0 && q.z[3] == 0.0 && q.w[3] == 1.0 &&
+					   "zero quaternion should normalize to identity");
+			}
+
+			double t = (dist(rng) + 10.0) / 20.0;
+			nlerpDQuat4(a, b, t, q);
+			for (int l = 0; l < 4; ++l) {
+				dquat r = normalize(lerp(glmA[l], glmB[l], t));
+				check(q.x[l], r.x); check(q.y[l], r.y); check(q.z[l], r.z); check(q.w[l], r.w);
+			}
+
+			// b's vector part stands in for a second set of vectors
+			DVec3_4 bv;
+			std::memcpy(&bv, &b, sizeof(bv));
+			mixDVec3_4(v, bv, t, vOut);
+			for (int l = 0; l < 4; ++l) {
+				dvec3 r = mix(glmV[l], dvec3(glmB[l].x, glmB[l].y, glmB[l].z), t);
+				check(vOut.x[l], r.x); check(vOut.y[l], r.y); check(vOut.z[l], r.z);
+			}
+
+			normalizeDQuat4(a);
+			rotateDVec3_4(a, v, vOut);
+			for (int l = 0; l < 4; ++l) {
+				dvec3 r = normalize(glmA[l]) * glmV[l];
+				check(vOut.x[l], r.x); check(vOut.y[l], r.y); check(vOut.z[l], r.z);
+			}
+
+			dmat4 matA, matB, matOut;
+			for (int c = 0; c < 4; ++c) {
+				for (int r = 0; r < 4; ++r) {
+					matA[c][r] = dist(rng) * 100000.0;
+					matB[c][r] = dist(rng);
+				}
+			}
+			dmat4 glmMat(matA * matB);
+			mulDMat4(matA, matB, matOut);
+
+			mat4 camOut;
+			toCameraRelativeMat4(matA, matB, camOut);
+			mat4 glmCam(glmMat);
+			glmCam[0][3] = glmCam[1][3] = glmCam[2][3] = 0;
+
+			for (int c = 0; c < 4; ++c) {
+				for (int r = 0; r < 4; ++r) {
+					check(matOut[c][r], glmMat[c][r]);
+					check(camOut[c][r], glmCam[c][r]);
+				}
+			}
+		}
+
+		assert(worstUlps <= maxUlps && "simd transform differs from glm");
+		logger.test("simd transform: kernel set %d, worst difference from glm = %lld ulps", k, worstUlps);
+	}
+
+	setKernelSet(defaultKernelSet);
+}
\ No newline at end of file
@@ -43,6 +43,42 @@ namespace griffin {
 	#define NullId_T	Id_T{}
 
 
+	/**
+	* Number of bits of a CompactId_T used for the index, the remaining bits hold the low bits of
+	* the generation. A handle_map referenced by compact ids may hold up to 2^bits handles, and a
+	* stale compact id goes undetected once its slot is reused 2^(32-bits) times.
+	*/
+	#define COMPACT_ID_INDEX_BITS	24
+
+	/**
+	* @struct CompactId_T
+	*	32 bit handle for references stored inside of items, where the type of the referenced item
+	*	is implied by the field so the typeId and free bit of Id_T are not needed. Convert to Id_T
+	*	at API boundaries with handle_map::toId, which restores the full generation, and from Id_T
+	*	with fromId. A value of 0 is the null id, handle_map skips generations with the compact
+	*	bits all 0 so a live item never has a null compact id.
+	* @tparam	T	type of the referenced item, keeps ids into different containers apart
+	*/
+	template <typename T>
+	struct CompactId_T {
+		static_assert(COMPACT_ID_INDEX_BITS >= 16 && COMPACT_ID_INDEX_BITS < 32,
+					  "compact generation bits must fit in the Id_T generation");
+
+		static const uint32_t IndexMask = (1U << COMPACT_ID_INDEX_BITS) - 1;
+		static const uint32_t GenerationMask = 0xFFFFFFFFU >> COMPACT_ID_INDEX_BITS;
+
+		uint32_t value;
+
+		uint32_t index() const		{ return value & IndexMask; }
+		uint32_t generation() const	{ return value >> COMPACT_ID_INDEX_BITS; }
+
+		/**
+		* @returns the compact form of an outer id, the high bits of the generation are dropped
+		*/
+		static CompactId_T fromId(Id_T handle);
+	};
+
+
 	/**
 	* @class handle_map
 	*	Stores objects using a dense inner array and sparse outer array scheme for good cache coherence
@@ -81,6 +117,16 @@ namespace griffin {
 		T&			operator[](Id_T handle)			{ return at(handle); }
 		const T&	operator[](Id_T handle) const	{ return at(handle); }
 
+		/**
+		* Get a direct reference to a stored item by compact id
+		* @param[in]	handle		compact id of the item
+		* @returns reference to the item
+		*/
+		template <typename U> T&		at(CompactId_T<U> handle);
+		template <typename U> const T&	at(CompactId_T<U> handle) const;
+		template <typename U> T&		operator[](CompactId_T<U> handle)		{ return at(handle); }
+		template <typename U> const T&	operator[](CompactId_T<U> handle) const	{ return at(handle); }
+
 		/**
 		* create one item with default initialization
 		* @tparam		Params	initialization arguments passed to constructor of item
@@ -157,6 +203,12 @@ namespace griffin {
 		*/
 		bool isValid(Id_T handle) const;
 
+		/**
+		* @returns true if the compact id refers to a valid item
+		*/
+		template <typename U>
+		bool isValid(CompactId_T<U> handle) const;
+
 		/**
 		* @returns size of the dense items array
 		*/
@@ -188,6 +240,24 @@ namespace griffin {
 		template <typename Compare>
 		size_t	defragment(Compare comp, size_t maxSwaps = 0);
 
+		/**
+		* reorder moves the dense set into an order computed by the caller in one linear pass,
+		*	for when the ideal order isn't expressible as a comparison (like a tree traversal
+		*	order) or when most items move and the insertion sort of defragment would be slow.
+		*	Handles stay valid, inner indices change. Items are permuted in place, each is moved
+		*	once and nothing is allocated after the first call.
+		* @param[in]	order	permutation of the dense set, order[i] is the current inner index
+		*	of the item to place at index i
+		*/
+		void	reorder(const std::vector<uint32_t>& order);
+
+		/**
+		* rotate moves the items at inner indices [first, middle) to just after those at
+		*	[middle, last), like std::rotate. Only items in the range move, for moving a block of
+		*	items without visiting the rest of the dense set. Handles stay valid.
+		*/
+		void	rotate(uint32_t first, uint32_t middle, uint32_t last);
+
 
 		/**
 		* these functions provide direct access to inner arrays, don't add or remove items, just
@@ -205,11 +275,32 @@ namespace griffin {
 
 		uint16_t			getItemTypeId() const		{ return m_itemTypeId; }
 
+		/**
+		* Restores the freelist after the inner arrays above were replaced wholesale, for example
+		* by a binary snapshot loader. The values must come from the same handle_map that produced
+		* the arrays, or the freelist will be corrupted.
+		*/
+		void restoreFreeList(uint32_t freeListFront, uint32_t freeListBack)
+		{
+			m_freeListFront = freeListFront;
+			m_freeListBack = freeListBack;
+			m_fragmented = 1;
+		}
+
 		/**
 		* @returns index into the inner DenseSet for a given outer id
 		*/
 		uint32_t			getInnerIndex(Id_T handle) const;
 
+		template <typename U>
+		uint32_t			getInnerIndex(CompactId_T<U> handle) const;
+
+		/**
+		* @returns the full outer id (handle) for a compact id, or NullId_T if it's null or stale
+		*/
+		template <typename U>
+		Id_T				toId(CompactId_T<U> handle) const;
+
 		/**
 		* @return the outer id (handle) for a given dense set index
 		*/
@@ -254,6 +345,8 @@ namespace griffin {
 		IdSet_T		m_sparseIds;	//!< stores a set of Id_Ts, these are "inner" ids indexing into m_items
 		DenseSet_T	m_items;		//!< stores items of type T
 		MetaSet_T	m_meta;			//!< stores Meta_T type for each item
+
+		std::vector<uint8_t>	m_reorderDone;	//!< scratch for reorder, set for each index already filled
 	};
 
 }
@@ -21,6 +21,36 @@ namespace griffin {
 	inline bool operator< (const Id_T& a, const Id_T& b) { return (a.value < b.value); }
 	inline bool operator> (const Id_T& a, const Id_T& b) { return (a.value > b.value); }
 
+	// struct CompactId_T
+
+	template <typename T>
+	inline bool operator==(const CompactId_T<T>& a, const CompactId_T<T>& b) { return (a.value == b.value); }
+	template <typename T>
+	inline bool operator!=(const CompactId_T<T>& a, const CompactId_T<T>& b) { return (a.value != b.value); }
+
+
+	template <typename T>
+	inline CompactId_T<T> CompactId_T<T>::fromId(Id_T handle)
+	{
+		assert(handle.index <= IndexMask && "index does not fit in a compact id");
+
+		return CompactId_T<T>{
+			handle.index | ((handle.generation & GenerationMask) << COMPACT_ID_INDEX_BITS)
+		};
+	}
+
+
+	/**
+	* Generations that would give a compact id of 0 are skipped
+	*/
+	inline void nextGeneration(Id_T& innerId)
+	{
+		++innerId.generation;
+		if ((innerId.generation & CompactId_T<void>::GenerationMask) == 0) {
+			++innerId.generation;
+		}
+	}
+
 	// class handle_map 
 
 	template <typename T>
@@ -103,7 +133,7 @@ namespace griffin {
 
 		// push this slot to the back of the freelist
 		innerId.free = 1;
-		++innerId.generation; // increment generation so remaining outer ids go stale
+		nextGeneration(innerId); // increment generation so remaining outer ids go stale
 		innerId.index = 0xFFFFFFFF; // max numeric value represents the end of the freelist
 		m_sparseIds[handle.index] = innerId; // write outer id changes back to the array
 
@@ -160,7 +190,7 @@ namespace griffin {
 			for (uint32_t i = 0; i < size; ++i) {
 				auto& id = m_sparseIds[i];
 				id.free = 1;
-				++id.generation;
+				nextGeneration(id);
 				id.index = i + 1;
 			}
 			m_sparseIds[size - 1].index = 0xFFFFFFFF;
@@ -241,6 +271,67 @@ namespace griffin {
 	}
 
 
+	template <typename T>
+	template <typename U>
+	inline T& handle_map<T>::at(CompactId_T<U> handle)
+	{
+		return m_items[getInnerIndex(handle)];
+	}
+
+
+	template <typename T>
+	template <typename U>
+	inline const T& handle_map<T>::at(CompactId_T<U> handle) const
+	{
+		return m_items[getInnerIndex(handle)];
+	}
+
+
+	template <typename T>
+	template <typename U>
+	inline bool handle_map<T>::isValid(CompactId_T<U> handle) const
+	{
+		if (handle.index() >= m_sparseIds.size()) {
+			return false;
+		}
+
+		Id_T innerId = m_sparseIds[handle.index()];
+
+		return (innerId.index < m_items.size() &&
+				handle.generation() == (innerId.generation & CompactId_T<U>::GenerationMask));
+	}
+
+
+	template <typename T>
+	template <typename U>
+	inline uint32_t handle_map<T>::getInnerIndex(CompactId_T<U> handle) const
+	{
+		assert(handle.index() < m_sparseIds.size() && "outer index out of range");
+
+		Id_T innerId = m_sparseIds[handle.index()];
+
+		assert(handle.generation() == (innerId.generation & CompactId_T<U>::GenerationMask) && "at called with old generation");
+		assert(innerId.index < m_items.size() && "inner index out of range");
+
+		return innerId.index;
+	}
+
+
+	template <typename T>
+	template <typename U>
+	inline Id_T handle_map<T>::toId(CompactId_T<U> handle) const
+	{
+		if (!isValid(handle)) {
+			return NullId_T;
+		}
+
+		Id_T outerId = m_sparseIds[handle.index()];
+		outerId.index = handle.index();
+
+		return outerId;
+	}
+
+
 	template <typename T>
 	inline Id_T handle_map<T>::getHandleForInnerIndex(size_t innerIndex) const
 	{
@@ -270,6 +361,57 @@ namespace griffin {
 	}
 
 
+	template <typename T>
+	void handle_map<T>::reorder(const std::vector<uint32_t>& order)
+	{
+		assert(order.size() == m_items.size() && "order must be a permutation of the dense set");
+
+		uint32_t size = static_cast<uint32_t>(order.size());
+		m_reorderDone.assign(size, 0);
+
+		// follow each cycle of the permutation, the item at its start waits in tmp while the
+		// rest of the cycle shifts into place
+		for (uint32_t start = 0; start < size; ++start) {
+			if (m_reorderDone[start] != 0 || order[start] == start) {
+				continue;
+			}
+
+			T tmp = std::move(m_items[start]);
+			Meta_T tmpMeta = m_meta[start];
+
+			uint32_t i = start;
+			for (;;) {
+				uint32_t from = order[i];
+				m_reorderDone[i] = 1;
+				if (from == start) {
+					m_items[i] = std::move(tmp);
+					m_meta[i] = tmpMeta;
+					m_sparseIds[m_meta[i].denseToSparse].index = i;
+					break;
+				}
+				m_items[i] = std::move(m_items[from]);
+				m_meta[i] = m_meta[from];
+				m_sparseIds[m_meta[i].denseToSparse].index = i;
+				i = from;
+			}
+		}
+	}
+
+
+	template <typename T>
+	void handle_map<T>::rotate(uint32_t first, uint32_t middle, uint32_t last)
+	{
+		assert(first <= middle && middle <= last && last <= m_items.size() && "rotate range out of bounds");
+
+		std::rotate(m_items.begin() + first, m_items.begin() + middle, m_items.begin() + last);
+		std::rotate(m_meta.begin() + first, m_meta.begin() + middle, m_meta.begin() + last);
+
+		for (uint32_t i = first; i < last; ++i) {
+			m_sparseIds[m_meta[i].denseToSparse].index = i;
+		}
+	}
+
+
 	template <typename T>
 	template <typename Compare>
 	size_t handle_map<T>::defragment(Compare comp, size_t maxSwaps)
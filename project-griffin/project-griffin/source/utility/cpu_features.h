@@ -0,0 +1,44 @@
+/**
+* @file cpu_features.h
+* @author Jeff Kiah
+*/
+#pragma once
+#ifndef GRIFFIN_CPU_FEATURES_H_
+#define GRIFFIN_CPU_FEATURES_H_
+
+/**
+* Functions using instruction sets above the build's baseline are marked with these so they can
+* live next to the baseline versions and be chosen at runtime. MSVC allows any intrinsic without
+* a flag, other compilers need the target enabled per function. The targets leave out fma so
+* separate multiplies and adds aren't contracted, which keeps results identical to the narrower
+* kernels. Kernels wanting fma call it explicitly.
+*/
+#if defined(_MSC_VER)
+#define GRIFFIN_TARGET_AVX2
+#define GRIFFIN_TARGET_AVX512
+#else
+#define GRIFFIN_TARGET_AVX2		__attribute__((target("avx2")))
+#define GRIFFIN_TARGET_AVX512	__attribute__((target("avx512f,avx512dq,avx2")))
+#endif
+
+
+namespace griffin {
+
+	/**
+	* Instruction sets usable on this machine. A set is reported only when both the cpu and the
+	* OS support it, so the wide registers are saved on context switch.
+	*/
+	struct CpuFeatures {
+		bool sse41;
+		bool avx;
+		bool avx2;		//<! also implies fma
+		bool avx512;	//<! avx512f and avx512dq
+	};
+
+	/**
+	* @returns the features detected on first call, cached after that
+	*/
+	const CpuFeatures& getCpuFeatures();
+}
+
+#endif
\ No newline at end of file
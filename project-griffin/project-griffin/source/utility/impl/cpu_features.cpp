@@ -0,0 +1,80 @@
+/**
+* @file cpu_features.cpp
+* @author Jeff Kiah
+*/
+#include "../cpu_features.h"
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+using namespace griffin;
+
+
+// Static Functions
+
+static void cpuid(int leaf, int subleaf, uint32_t regs[4])
+{
+	#if defined(_MSC_VER)
+	__cpuidex(reinterpret_cast<int*>(regs), leaf, subleaf);
+	#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+	#endif
+}
+
+static uint64_t readXCR0()
+{
+	#if defined(_MSC_VER)
+	return _xgetbv(0);
+	#else
+	uint32_t lo, hi;
+	__asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return (static_cast<uint64_t>(hi) << 32) | lo;
+	#endif
+}
+
+static CpuFeatures detectCpuFeatures()
+{
+	CpuFeatures f{};
+	uint32_t regs[4] = {};
+
+	cpuid(0, 0, regs);
+	uint32_t maxLeaf = regs[0];
+	if (maxLeaf < 1) {
+		return f;
+	}
+
+	cpuid(1, 0, regs);
+	f.sse41 = (regs[2] & (1 << 19)) != 0;
+	bool osxsave = (regs[2] & (1 << 27)) != 0;
+	bool avx = (regs[2] & (1 << 28)) != 0;
+	bool fma = (regs[2] & (1 << 12)) != 0;
+
+	// the OS must save xmm/ymm state (bits 1,2) and for avx512 also opmask/zmm state (bits 5-7)
+	uint64_t xcr0 = osxsave ? readXCR0() : 0;
+	bool osYmm = (xcr0 & 0x06) == 0x06;
+	bool osZmm = (xcr0 & 0xE6) == 0xE6;
+
+	f.avx = avx && osYmm;
+
+	if (maxLeaf >= 7) {
+		cpuid(7, 0, regs);
+		f.avx2 = f.avx && fma && (regs[1] & (1 << 5)) != 0;
+		f.avx512 = f.avx2 && osZmm &&
+				   (regs[1] & (1 << 16)) != 0 &&	// avx512f
+				   (regs[1] & (1 << 17)) != 0;		// avx512dq
+	}
+	return f;
+}
+
+
+// Functions
+
+const CpuFeatures& griffin::getCpuFeatures()
+{
+	static const CpuFeatures s_features = detectCpuFeatures();
+	return s_features;
+}
@@ -0,0 +1,435 @@
+/**
+* @file simd_transform.cpp
+* @author Jeff Kiah
+*/
+#include "../simd_transform.h"
+#include "../cpu_features.h"
+#include <emmintrin.h>
+#include <immintrin.h>
+
+using namespace griffin;
+using namespace griffin::simd;
+
+
+// Static Variables
+
+static KernelSet s_kernelSet = (getCpuFeatures().avx2 ? KernelSet_AVX2 : KernelSet_SSE2);
+
+
+// AVX2 Kernels
+
+GRIFFIN_TARGET_AVX2
+static inline void mulQuat_AVX2(__m256d ax, __m256d ay, __m256d az, __m256d aw,
+								__m256d bx, __m256d by, __m256d bz, __m256d bw,
+								__m256d& x, __m256d& y, __m256d& z, __m256d& w)
+{
+	// same operation order as glm's tquat operator*
+	w = _mm256_sub_pd(_mm256_sub_pd(_mm256_sub_pd(_mm256_mul_pd(aw, bw), _mm256_mul_pd(ax, bx)), _mm256_mul_pd(ay, by)), _mm256_mul_pd(az, bz));
+	x = _mm256_sub_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(aw, bx), _mm256_mul_pd(ax, bw)), _mm256_mul_pd(ay, bz)), _mm256_mul_pd(az, by));
+	y = _mm256_sub_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(aw, by), _mm256_mul_pd(ay, bw)), _mm256_mul_pd(az, bx)), _mm256_mul_pd(ax, bz));
+	z = _mm256_sub_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(aw, bz), _mm256_mul_pd(az, bw)), _mm256_mul_pd(ax, by)), _mm256_mul_pd(ay, bx));
+}
+
+GRIFFIN_TARGET_AVX2
+static inline void normalizeQuat_AVX2(__m256d& x, __m256d& y, __m256d& z, __m256d& w)
+{
+	__m256d lenSq = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y)),
+								  _mm256_add_pd(_mm256_mul_pd(z, z), _mm256_mul_pd(w, w)));
+	__m256d len = _mm256_sqrt_pd(lenSq);
+	__m256d oneOverLen = _mm256_div_pd(_mm256_set1_pd(1.0), len);
+
+	// lanes with len <= 0 become identity
+	__m256d valid = _mm256_cmp_pd(len, _mm256_setzero_pd(), _CMP_NLE_UQ);
+	x = _mm256_and_pd(_mm256_mul_pd(x, oneOverLen), valid);
+	y = _mm256_and_pd(_mm256_mul_pd(y, oneOverLen), valid);
+	z = _mm256_and_pd(_mm256_mul_pd(z, oneOverLen), valid);
+	w = _mm256_blendv_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(w, oneOverLen), valid);
+}
+
+GRIFFIN_TARGET_AVX2
+static void mulDQuat4_AVX2(const DQuat4& a, const DQuat4& b, DQuat4& out, bool normalize)
+{
+	__m256d x, y, z, w;
+	mulQuat_AVX2(_mm256_load_pd(a.x), _mm256_load_pd(a.y), _mm256_load_pd(a.z), _mm256_load_pd(a.w),
+				 _mm256_load_pd(b.x), _mm256_load_pd(b.y), _mm256_load_pd(b.z), _mm256_load_pd(b.w),
+				 x, y, z, w);
+	if (normalize) {
+		normalizeQuat_AVX2(x, y, z, w);
+	}
+	_mm256_store_pd(out.x, x);
+	_mm256_store_pd(out.y, y);
+	_mm256_store_pd(out.z, z);
+	_mm256_store_pd(out.w, w);
+	_mm256_zeroupper();
+}
+
+GRIFFIN_TARGET_AVX2
+static void normalizeDQuat4_AVX2(DQuat4& q)
+{
+	__m256d x = _mm256_load_pd(q.x);
+	__m256d y = _mm256_load_pd(q.y);
+	__m256d z = _mm256_load_pd(q.z);
+	__m256d w = _mm256_load_pd(q.w);
+	normalizeQuat_AVX2(x, y, z, w);
+	_mm256_store_pd(q.x, x);
+	_mm256_store_pd(q.y, y);
+	_mm256_store_pd(q.z, z);
+	_mm256_store_pd(q.w, w);
+	_mm256_zeroupper();
+}
+
+GRIFFIN_TARGET_AVX2
+static void rotateDVec3_4_AVX2(const DQuat4& q, const DVec3_4& v, DVec3_4& out)
+{
+	__m256d qx = _mm256_load_pd(q.x);
+	__m256d qy = _mm256_load_pd(q.y);
+	__m256d qz = _mm256_load_pd(q.z);
+	__m256d qw = _mm256_load_pd(q.w);
+	__m256d vx = _mm256_load_pd(v.x);
+	__m256d vy = _mm256_load_pd(v.y);
+	__m256d vz = _mm256_load_pd(v.z);
+
+	// uv = cross(q.xyz, v), uuv = cross(q.xyz, uv), out = v + ((uv * w) + uuv) * 2
+	__m256d uvx = _mm256_sub_pd(_mm256_mul_pd(qy, vz), _mm256_mul_pd(vy, qz));
+	__m256d uvy = _mm256_sub_pd(_mm256_mul_pd(qz, vx), _mm256_mul_pd(vz, qx));
+	__m256d uvz = _mm256_sub_pd(_mm256_mul_pd(qx, vy), _mm256_mul_pd(vx, qy));
+	__m256d uuvx = _mm256_sub_pd(_mm256_mul_pd(qy, uvz), _mm256_mul_pd(uvy, qz));
+	__m256d uuvy = _mm256_sub_pd(_mm256_mul_pd(qz, uvx), _mm256_mul_pd(uvz, qx));
+	__m256d uuvz = _mm256_sub_pd(_mm256_mul_pd(qx, uvy), _mm256_mul_pd(uvx, qy));
+	__m256d two = _mm256_set1_pd(2.0);
+
+	_mm256_store_pd(out.x, _mm256_add_pd(vx, _mm256_mul_pd(_mm256_add_pd(_mm256_mul_pd(uvx, qw), uuvx), two)));
+	_mm256_store_pd(out.y, _mm256_add_pd(vy, _mm256_mul_pd(_mm256_add_pd(_mm256_mul_pd(uvy, qw), uuvy), two)));
+	_mm256_store_pd(out.z, _mm256_add_pd(vz, _mm256_mul_pd(_mm256_add_pd(_mm256_mul_pd(uvz, qw), uuvz), two)));
+	_mm256_zeroupper();
+}
+
+GRIFFIN_TARGET_AVX2
+static void nlerpDQuat4_AVX2(const DQuat4& a, const DQuat4& b, double t, DQuat4& out)
+{
+	// same operation order as glm's lerp, a * (1 - t) + (b * t)
+	__m256d ta = _mm256_set1_pd(1.0 - t);
+	__m256d tb = _mm256_set1_pd(t);
+	__m256d x = _mm256_add_pd(_mm256_mul_pd(_mm256_load_pd(a.x), ta), _mm256_mul_pd(_mm256_load_pd(b.x), tb));
+	__m256d y = _mm256_add_pd(_mm256_mul_pd(_mm256_load_pd(a.y), ta), _mm256_mul_pd(_mm256_load_pd(b.y), tb));
+	__m256d z = _mm256_add_pd(_mm256_mul_pd(_mm256_load_pd(a.z), ta), _mm256_mul_pd(_mm256_load_pd(b.z), tb));
+	__m256d w = _mm256_add_pd(_mm256_mul_pd(_mm256_load_pd(a.w), ta), _mm256_mul_pd(_mm256_load_pd(b.w), tb));
+	normalizeQuat_AVX2(x, y, z, w);
+	_mm256_store_pd(out.x, x);
+	_mm256_store_pd(out.y, y);
+	_mm256_store_pd(out.z, z);
+	_mm256_store_pd(out.w, w);
+	_mm256_zeroupper();
+}
+
+GRIFFIN_TARGET_AVX2
+static void mixDVec3_4_AVX2(const DVec3_4& a, const DVec3_4& b, double t, DVec3_4& out)
+{
+	// same operation order as glm's mix, a + t * (b - a)
+	__m256d tt = _mm256_set1_pd(t);
+	__m256d ax = _mm256_load_pd(a.x);
+	__m256d ay = _mm256_load_pd(a.y);
+	__m256d az = _mm256_load_pd(a.z);
+	_mm256_store_pd(out.x, _mm256_add_pd(ax, _mm256_mul_pd(tt, _mm256_sub_pd(_mm256_load_pd(b.x), ax))));
+	_mm256_store_pd(out.y, _mm256_add_pd(ay, _mm256_mul_pd(tt, _mm256_sub_pd(_mm256_load_pd(b.y), ay))));
+	_mm256_store_pd(out.z, _mm256_add_pd(az, _mm256_mul_pd(tt, _mm256_sub_pd(_mm256_load_pd(b.z), az))));
+	_mm256_zeroupper();
+}
+
+GRIFFIN_TARGET_AVX2
+static inline void mulMat4Columns_AVX2(const double* a, const double* b, __m256d out[4])
+{
+	__m256d a0 = _mm256_loadu_pd(a);
+	__m256d a1 = _mm256_loadu_pd(a + 4);
+	__m256d a2 = _mm256_loadu_pd(a + 8);
+	__m256d a3 = _mm256_loadu_pd(a + 12);
+
+	// out[i] = a[0]*b[i][0] + a[1]*b[i][1] + a[2]*b[i][2] + a[3]*b[i][3], summed in glm's order
+	for (int i = 0; i < 4; ++i) {
+		const double* bi = b + i * 4;
+		__m256d c = _mm256_mul_pd(a0, _mm256_broadcast_sd(bi));
+		c = _mm256_add_pd(c, _mm256_mul_pd(a1, _mm256_broadcast_sd(bi + 1)));
+		c = _mm256_add_pd(c, _mm256_mul_pd(a2, _mm256_broadcast_sd(bi + 2)));
+		out[i] = _mm256_add_pd(c, _mm256_mul_pd(a3, _mm256_broadcast_sd(bi + 3)));
+	}
+}
+
+GRIFFIN_TARGET_AVX2
+static void mulDMat4_AVX2(const double* a, const double* b, double* out)
+{
+	__m256d c[4];
+	mulMat4Columns_AVX2(a, b, c);
+	for (int i = 0; i < 4; ++i) {
+		_mm256_storeu_pd(out + i * 4, c[i]);
+	}
+	_mm256_zeroupper();
+}
+
+GRIFFIN_TARGET_AVX2
+static void toCameraRelativeMat4_AVX2(const double* viewMat, const double* modelToWorld, float* out)
+{
+	__m256d c[4];
+	mulMat4Columns_AVX2(viewMat, modelToWorld, c);
+
+	__m128 rowMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	for (int i = 0; i < 3; ++i) {
+		_mm_storeu_ps(out + i * 4, _mm_and_ps(_mm256_cvtpd_ps(c[i]), rowMask));
+	}
+	_mm_storeu_ps(out + 12, _mm256_cvtpd_ps(c[3]));
+	_mm256_zeroupper();
+}
+
+
+// SSE2 Kernels, each __m128d holds lanes 0-1 or 2-3
+
+static inline void normalizeQuat_SSE2(__m128d& x, __m128d& y, __m128d& z, __m128d& w)
+{
+	__m128d lenSq = _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, x), _mm_mul_pd(y, y)),
+							   _mm_add_pd(_mm_mul_pd(z, z), _mm_mul_pd(w, w)));
+	__m128d len = _mm_sqrt_pd(lenSq);
+	__m128d oneOverLen = _mm_div_pd(_mm_set1_pd(1.0), len);
+
+	// lanes with len <= 0 become identity
+	__m128d valid = _mm_cmpnle_pd(len, _mm_setzero_pd());
+	x = _mm_and_pd(_mm_mul_pd(x, oneOverLen), valid);
+	y = _mm_and_pd(_mm_mul_pd(y, oneOverLen), valid);
+	z = _mm_and_pd(_mm_mul_pd(z, oneOverLen), valid);
+	w = _mm_or_pd(_mm_and_pd(_mm_mul_pd(w, oneOverLen), valid),
+				  _mm_andnot_pd(valid, _mm_set1_pd(1.0)));
+}
+
+static void mulDQuat4_SSE2(const DQuat4& a, const DQuat4& b, DQuat4& out, bool normalize)
+{
+	for (int l = 0; l < 4; l += 2) {
+		__m128d ax = _mm_load_pd(a.x + l);
+		__m128d ay = _mm_load_pd(a.y + l);
+		__m128d az = _mm_load_pd(a.z + l);
+		__m128d aw = _mm_load_pd(a.w + l);
+		__m128d bx = _mm_load_pd(b.x + l);
+		__m128d by = _mm_load_pd(b.y + l);
+		__m128d bz = _mm_load_pd(b.z + l);
+		__m128d bw = _mm_load_pd(b.w + l);
+
+		__m128d w = _mm_sub_pd(_mm_sub_pd(_mm_sub_pd(_mm_mul_pd(aw, bw), _mm_mul_pd(ax, bx)), _mm_mul_pd(ay, by)), _mm_mul_pd(az, bz));
+		__m128d x = _mm_sub_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(aw, bx), _mm_mul_pd(ax, bw)), _mm_mul_pd(ay, bz)), _mm_mul_pd(az, by));
+		__m128d y = _mm_sub_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(aw, by), _mm_mul_pd(ay, bw)), _mm_mul_pd(az, bx)), _mm_mul_pd(ax, bz));
+		__m128d z = _mm_sub_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(aw, bz), _mm_mul_pd(az, bw)), _mm_mul_pd(ax, by)), _mm_mul_pd(ay, bx));
+
+		if (normalize) {
+			normalizeQuat_SSE2(x, y, z, w);
+		}
+		_mm_store_pd(out.x + l, x);
+		_mm_store_pd(out.y + l, y);
+		_mm_store_pd(out.z + l, z);
+		_mm_store_pd(out.w + l, w);
+	}
+}
+
+static void rotateDVec3_4_SSE2(const DQuat4& q, const DVec3_4& v, DVec3_4& out)
+{
+	for (int l = 0; l < 4; l += 2) {
+		__m128d qx = _mm_load_pd(q.x + l);
+		__m128d qy = _mm_load_pd(q.y + l);
+		__m128d qz = _mm_load_pd(q.z + l);
+		__m128d qw = _mm_load_pd(q.w + l);
+		__m128d vx = _mm_load_pd(v.x + l);
+		__m128d vy = _mm_load_pd(v.y + l);
+		__m128d vz = _mm_load_pd(v.z + l);
+
+		__m128d uvx = _mm_sub_pd(_mm_mul_pd(qy, vz), _mm_mul_pd(vy, qz));
+		__m128d uvy = _mm_sub_pd(_mm_mul_pd(qz, vx), _mm_mul_pd(vz, qx));
+		__m128d uvz = _mm_sub_pd(_mm_mul_pd(qx, vy), _mm_mul_pd(vx, qy));
+		__m128d uuvx = _mm_sub_pd(_mm_mul_pd(qy, uvz), _mm_mul_pd(uvy, qz));
+		__m128d uuvy = _mm_sub_pd(_mm_mul_pd(qz, uvx), _mm_mul_pd(uvz, qx));
+		__m128d uuvz = _mm_sub_pd(_mm_mul_pd(qx, uvy), _mm_mul_pd(uvx, qy));
+		__m128d two = _mm_set1_pd(2.0);
+
+		_mm_store_pd(out.x + l, _mm_add_pd(vx, _mm_mul_pd(_mm_add_pd(_mm_mul_pd(uvx, qw), uuvx), two)));
+		_mm_store_pd(out.y + l, _mm_add_pd(vy, _mm_mul_pd(_mm_add_pd(_mm_mul_pd(uvy, qw), uuvy), two)));
+		_mm_store_pd(out.z + l, _mm_add_pd(vz, _mm_mul_pd(_mm_add_pd(_mm_mul_pd(uvz, qw), uuvz), two)));
+	}
+}
+
+static void nlerpDQuat4_SSE2(const DQuat4& a, const DQuat4& b, double t, DQuat4& out)
+{
+	__m128d ta = _mm_set1_pd(1.0 - t);
+	__m128d tb = _mm_set1_pd(t);
+	for (int l = 0; l < 4; l += 2) {
+		__m128d x = _mm_add_pd(_mm_mul_pd(_mm_load_pd(a.x + l), ta), _mm_mul_pd(_mm_load_pd(b.x + l), tb));
+		__m128d y = _mm_add_pd(_mm_mul_pd(_mm_load_pd(a.y + l), ta), _mm_mul_pd(_mm_load_pd(b.y + l), tb));
+		__m128d z = _mm_add_pd(_mm_mul_pd(_mm_load_pd(a.z + l), ta), _mm_mul_pd(_mm_load_pd(b.z + l), tb));
+		__m128d w = _mm_add_pd(_mm_mul_pd(_mm_load_pd(a.w + l), ta), _mm_mul_pd(_mm_load_pd(b.w + l), tb));
+		normalizeQuat_SSE2(x, y, z, w);
+		_mm_store_pd(out.x + l, x);
+		_mm_store_pd(out.y + l, y);
+		_mm_store_pd(out.z + l, z);
+		_mm_store_pd(out.w + l, w);
+	}
+}
+
+static void mixDVec3_4_SSE2(const DVec3_4& a, const DVec3_4& b, double t, DVec3_4& out)
+{
+	__m128d tt = _mm_set1_pd(t);
+	for (int l = 0; l < 4; l += 2) {
+		__m128d ax = _mm_load_pd(a.x + l);
+		__m128d ay = _mm_load_pd(a.y + l);
+		__m128d az = _mm_load_pd(a.z + l);
+		_mm_store_pd(out.x + l, _mm_add_pd(ax, _mm_mul_pd(tt, _mm_sub_pd(_mm_load_pd(b.x + l), ax))));
+		_mm_store_pd(out.y + l, _mm_add_pd(ay, _mm_mul_pd(tt, _mm_sub_pd(_mm_load_pd(b.y + l), ay))));
+		_mm_store_pd(out.z + l, _mm_add_pd(az, _mm_mul_pd(tt, _mm_sub_pd(_mm_load_pd(b.z + l), az))));
+	}
+}
+
+static inline void mulMat4Columns_SSE2(const double* a, const double* b, __m128d outLo[4], __m128d outHi[4])
+{
+	for (int i = 0; i < 4; ++i) {
+		const double* bi = b + i * 4;
+		__m128d b0 = _mm_set1_pd(bi[0]);
+		__m128d b1 = _mm_set1_pd(bi[1]);
+		__m128d b2 = _mm_set1_pd(bi[2]);
+		__m128d b3 = _mm_set1_pd(bi[3]);
+
+		__m128d lo = _mm_mul_pd(_mm_loadu_pd(a), b0);
+		lo = _mm_add_pd(lo, _mm_mul_pd(_mm_loadu_pd(a + 4), b1));
+		lo = _mm_add_pd(lo, _mm_mul_pd(_mm_loadu_pd(a + 8), b2));
+		outLo[i] = _mm_add_pd(lo, _mm_mul_pd(_mm_loadu_pd(a + 12), b3));
+
+		__m128d hi = _mm_mul_pd(_mm_loadu_pd(a + 2), b0);
+		hi = _mm_add_pd(hi, _mm_mul_pd(_mm_loadu_pd(a + 6), b1));
+		hi = _mm_add_pd(hi, _mm_mul_pd(_mm_loadu_pd(a + 10), b2));
+		outHi[i] = _mm_add_pd(hi, _mm_mul_pd(_mm_loadu_pd(a + 14), b3));
+	}
+}
+
+static void mulDMat4_SSE2(const double* a, const double* b, double* out)
+{
+	__m128d lo[4], hi[4];
+	mulMat4Columns_SSE2(a, b, lo, hi);
+	for (int i = 0; i < 4; ++i) {
+		_mm_storeu_pd(out + i * 4, lo[i]);
+		_mm_storeu_pd(out + i * 4 + 2, hi[i]);
+	}
+}
+
+static void toCameraRelativeMat4_SSE2(const double* viewMat, const double* modelToWorld, float* out)
+{
+	__m128d lo[4], hi[4];
+	mulMat4Columns_SSE2(viewMat, modelToWorld, lo, hi);
+
+	__m128 rowMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	for (int i = 0; i < 4; ++i) {
+		__m128 col = _mm_movelh_ps(_mm_cvtpd_ps(lo[i]), _mm_cvtpd_ps(hi[i]));
+		if (i < 3) {
+			col = _mm_and_ps(col, rowMask);
+		}
+		_mm_storeu_ps(out + i * 4, col);
+	}
+}
+
+
+// Functions
+
+KernelSet simd::getKernelSet()
+{
+	return s_kernelSet;
+}
+
+void simd::setKernelSet(KernelSet kernelSet)
+{
+	if (kernelSet == KernelSet_AVX2 && !getCpuFeatures().avx2) {
+		kernelSet = KernelSet_SSE2;
+	}
+	s_kernelSet = kernelSet;
+}
+
+
+void simd::mulDQuat4(const DQuat4& a, const DQuat4& b, DQuat4& out)
+{
+	if (s_kernelSet == KernelSet_AVX2) {
+		mulDQuat4_AVX2(a, b, out, false);
+	}
+	else {
+		mulDQuat4_SSE2(a, b, out, false);
+	}
+}
+
+void simd::mulNormalizeDQuat4(const DQuat4& a, const DQuat4& b, DQuat4& out)
+{
+	if (s_kernelSet == KernelSet_AVX2) {
+		mulDQuat4_AVX2(a, b, out, true);
+	}
+	else {
+		mulDQuat4_SSE2(a, b, out, true);
+	}
+}
+
+void simd::normalizeDQuat4(DQuat4& q)
+{
+	if (s_kernelSet == KernelSet_AVX2) {
+		normalizeDQuat4_AVX2(q);
+	}
+	else {
+		for (int l = 0; l < 4; l += 2) {
+			__m128d x = _mm_load_pd(q.x + l);
+			__m128d y = _mm_load_pd(q.y + l);
+			__m128d z = _mm_load_pd(q.z + l);
+			__m128d w = _mm_load_pd(q.w + l);
+			normalizeQuat_SSE2(x, y, z, w);
+			_mm_store_pd(q.x + l, x);
+			_mm_store_pd(q.y + l, y);
+			_mm_store_pd(q.z + l, z);
+			_mm_store_pd(q.w + l, w);
+		}
+	}
+}
+
+void simd::rotateDVec3_4(const DQuat4& q, const DVec3_4& v, DVec3_4& out)
+{
+	if (s_kernelSet == KernelSet_AVX2) {
+		rotateDVec3_4_AVX2(q, v, out);
+	}
+	else {
+		rotateDVec3_4_SSE2(q, v, out);
+	}
+}
+
+void simd::nlerpDQuat4(const DQuat4& a, const DQuat4& b, double t, DQuat4& out)
+{
+	if (s_kernelSet == KernelSet_AVX2) {
+		nlerpDQuat4_AVX2(a, b, t, out);
+	}
+	else {
+		nlerpDQuat4_SSE2(a, b, t, out);
+	}
+}
+
+void simd::mixDVec3_4(const DVec3_4& a, const DVec3_4& b, double t, DVec3_4& out)
+{
+	if (s_kernelSet == KernelSet_AVX2) {
+		mixDVec3_4_AVX2(a, b, t, out);
+	}
+	else {
+		mixDVec3_4_SSE2(a, b, t, out);
+	}
+}
+
+void simd::mulDMat4(const glm::dmat4& a, const glm::dmat4& b, glm::dmat4& out)
+{
+	if (s_kernelSet == KernelSet_AVX2) {
+		mulDMat4_AVX2(&a[0][0], &b[0][0], &out[0][0]);
+	}
+	else {
+		mulDMat4_SSE2(&a[0][0], &b[0][0], &out[0][0]);
+	}
+}
+
+void simd::toCameraRelativeMat4(const glm::dmat4& viewMat, const glm::dmat4& modelToWorld,
+								glm::mat4& outModelView)
+{
+	if (s_kernelSet == KernelSet_AVX2) {
+		toCameraRelativeMat4_AVX2(&viewMat[0][0], &modelToWorld[0][0], &outModelView[0][0]);
+	}
+	else {
+		toCameraRelativeMat4_SSE2(&viewMat[0][0], &modelToWorld[0][0], &outModelView[0][0]);
+	}
+}
@@ -16,6 +16,7 @@
 #define RESERVE_ENTITY_COMPONENTS				20
 #define RESERVE_ENTITYMANAGER_ENTITIES			1000
 #define RESERVE_ENTITYMANAGER_COMPONENTS		100
+#define RESERVE_ENTITYMANAGER_OBSERVERS			16
 
 // Resource System
 #define RESERVE_RESOURCELOADER_CALLBACKS		5
@@ -34,6 +34,7 @@ struct PropertyMetaData {
 	int offset;					//<! pointer to data member reinterpreted as an int
 	bool isArray;				//<! http://en.cppreference.com/w/cpp/types/is_array
 	bool isTriviallyCopyable;	//<! http://en.cppreference.com/w/cpp/types/is_trivially_copyable
+	bool isTriviallyDestructible;	//<! owns no resources, snapshots copy it as bytes even when not trivially copyable (glm types)
 };
 
 #define NUM_PROPERTY_FIELDS 4
@@ -55,7 +56,8 @@ struct PropertyMetaData {
 		sizeof(PROP(elem,0)PROP(elem,2)) / sizeof(PROP(elem,0)),	/* numElements */ \
 		offsetof(ClassType,PROP(elem,1)),					/* offset */ \
 		std::is_array<PROP(elem,0)PROP(elem,2)>::value,		/* isArray */ \
-		std::is_trivially_copyable<PROP(elem,0)>::value		/* isTriviallyCopyable */ \
+		std::is_trivially_copyable<PROP(elem,0)>::value,	/* isTriviallyCopyable */ \
+		std::is_trivially_destructible<PROP(elem,0)>::value	/* isTriviallyDestructible */ \
 	},
 
 #define FOR_EACH_I(macro, data, ...) \
@@ -0,0 +1,116 @@
+/**
+* @file simd_transform.h
+* @author Jeff Kiah
+*/
+#pragma once
+#ifndef GRIFFIN_SIMD_TRANSFORM_H_
+#define GRIFFIN_SIMD_TRANSFORM_H_
+
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+
+/**
+* Double precision transform kernels, an AVX2 version and an SSE2 version of each chosen at
+* runtime. Quaternion and vector kernels work on SoA batches of 4 so each register holds one
+* component of 4 transforms. Matrix kernels work one matrix at a time on glm's column-major
+* layout, where a dmat4 column is exactly one 256-bit register.
+*
+* Results match glm's scalar math, the operations are done in the same order. Expect exact
+* equality unless the compiler contracts glm's multiply-adds.
+*/
+namespace griffin {
+	namespace simd {
+
+		/**
+		* Component arrays of 4 quaternions, lane i of each array makes up quaternion i
+		*/
+		struct alignas(32) DQuat4 {
+			double	x[4];
+			double	y[4];
+			double	z[4];
+			double	w[4];
+		};
+
+		/**
+		* Component arrays of 4 vectors, lane i of each array makes up vector i
+		*/
+		struct alignas(32) DVec3_4 {
+			double	x[4];
+			double	y[4];
+			double	z[4];
+		};
+
+		enum KernelSet : uint8_t {
+			KernelSet_SSE2 = 0,
+			KernelSet_AVX2
+		};
+
+		/**
+		* @returns the kernel set in use, defaults to the best one the cpu supports
+		*/
+		KernelSet getKernelSet();
+
+		/**
+		* Forces a kernel set, useful for testing the fallback. Requests for a set the cpu does
+		* not support are lowered to SSE2.
+		*/
+		void setKernelSet(KernelSet kernelSet);
+
+
+		// Quaternion Kernels
+
+		/**
+		* out = a * b, out may alias a or b
+		*/
+		void mulDQuat4(const DQuat4& a, const DQuat4& b, DQuat4& out);
+
+		/**
+		* out = normalize(a * b), the composition used for world orientations. A zero length
+		* product normalizes to identity like glm::normalize. out may alias a or b.
+		*/
+		void mulNormalizeDQuat4(const DQuat4& a, const DQuat4& b, DQuat4& out);
+
+		/**
+		* Normalizes in place, a zero length quaternion becomes identity
+		*/
+		void normalizeDQuat4(DQuat4& q);
+
+		/**
+		* out = q * v, rotates each vector by the matching quaternion. out may alias v.
+		*/
+		void rotateDVec3_4(const DQuat4& q, const DVec3_4& v, DVec3_4& out);
+
+		/**
+		* out = normalize(lerp(a, b, t)), the nlerp used to interpolate rotations between update
+		* ticks. Same as glm::normalize(glm::lerp(a, b, t)), out may alias a or b.
+		*/
+		void nlerpDQuat4(const DQuat4& a, const DQuat4& b, double t, DQuat4& out);
+
+
+		// Vector Kernels
+
+		/**
+		* out = mix(a, b, t), same as glm::mix(a, b, t). out may alias a or b.
+		*/
+		void mixDVec3_4(const DVec3_4& a, const DVec3_4& b, double t, DVec3_4& out);
+
+
+		// Matrix Kernels
+
+		/**
+		* out = a * b, out may alias a or b
+		*/
+		void mulDMat4(const glm::dmat4& a, const glm::dmat4& b, glm::dmat4& out);
+
+		/**
+		* Combines the view and model transforms in double precision and converts the result to
+		* single precision for the GPU with the bottom row of the rotation columns cleared, the
+		* "camera space" model view used to render far from the origin without jitter.
+		* Equivalent to mat4(viewMat * modelToWorld) followed by zeroing [0..2][3].
+		*/
+		void toCameraRelativeMat4(const glm::dmat4& viewMat, const glm::dmat4& modelToWorld,
+								  glm::mat4& outModelView);
+	}
+}
+
+#endif
\ No newline at end of file